@@ -57,6 +57,17 @@ typedef uint64_t oc_clock_time_t;
 /* Maximum number of concurrent DTLS sessions */
 #define OC_MAX_DTLS_PEERS (1)
 
+/* Writes to SVR stores are held back and coalesced for up to
+   OC_STORE_MAX_DIRTY stores of at most OC_STORE_RECORD_SIZE bytes each,
+   which takes their product in RAM */
+#define OC_STORE_MAX_DIRTY (2)
+#define OC_STORE_RECORD_SIZE (1024)
+
+/* Maximum number of SVR stores whose contents are tracked between writes,
+   each taking about OC_MAX_APP_DATA_SIZE * 17 / 16 bytes; a store that is not
+   tracked is rewritten in full instead of journaled */
+#define OC_STORE_MAX_HEADS (4 * OC_MAX_NUM_DEVICES)
+
 #endif /* !OC_DYNAMIC_ALLOCATION */
 
 #endif /* CONFIG_H */
@@ -21,6 +21,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #define STORE_PATH_SIZE 64
 
@@ -54,6 +55,14 @@ oc_storage_read(const char *store, uint8_t *buf, size_t size)
   strncpy(store_path + store_path_len + 1, store, store_len);
   store_path[1 + store_path_len + store_len] = '\0';
   fp = fopen(store_path, "rb");
+  if (!fp) {
+    /* A write that was cut short after removing the old store left the
+       complete new one behind under its temporary name. */
+    char tmp_path[STORE_PATH_SIZE + 4];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", store_path);
+    if (rename(tmp_path, store_path) == 0)
+      fp = fopen(store_path, "rb");
+  }
   if (!fp)
     return -EINVAL;
 
@@ -62,23 +71,66 @@ oc_storage_read(const char *store, uint8_t *buf, size_t size)
   return size;
 }
 
+/* Stores are replaced through a temporary file so that an interrupted write
+ * leaves either the old or the new contents behind. The FATFS and SPIFFS
+ * drivers of ESP-IDF do not rename over an existing file, so the old store
+ * is removed first; oc_storage_read() picks up a temporary file that was
+ * left without one.
+ */
 long
 oc_storage_write(const char *store, uint8_t *buf, size_t size)
 {
   FILE *fp;
+  char tmp_path[STORE_PATH_SIZE + 4];
   size_t store_len = strlen(store);
 
-  if (!path_set || (store_len + store_path_len >= STORE_PATH_SIZE))
+  if (!path_set || (1 + store_len + store_path_len >= STORE_PATH_SIZE))
+    return -ENOENT;
+
+  store_path[store_path_len] = '/';
+  strncpy(store_path + store_path_len + 1, store, store_len);
+  store_path[1 + store_path_len + store_len] = '\0';
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", store_path);
+  fp = fopen(tmp_path, "wb");
+  if (!fp)
+    return -EINVAL;
+
+  if (fwrite(buf, 1, size, fp) != size || fflush(fp) != 0 ||
+      fsync(fileno(fp)) != 0) {
+    fclose(fp);
+    remove(tmp_path);
+    return -EIO;
+  }
+  fclose(fp);
+  remove(store_path);
+  if (rename(tmp_path, store_path) != 0) {
+    remove(tmp_path);
+    return -EIO;
+  }
+  return size;
+}
+
+long
+oc_storage_append(const char *store, uint8_t *buf, size_t size)
+{
+  FILE *fp;
+  size_t store_len = strlen(store);
+
+  if (!path_set || (1 + store_len + store_path_len >= STORE_PATH_SIZE))
     return -ENOENT;
 
   store_path[store_path_len] = '/';
   strncpy(store_path + store_path_len + 1, store, store_len);
   store_path[1 + store_path_len + store_len] = '\0';
-  fp = fopen(store_path, "wb");
+  fp = fopen(store_path, "ab");
   if (!fp)
     return -EINVAL;
 
-  size = fwrite(buf, 1, size, fp);
+  if (fwrite(buf, 1, size, fp) != size || fflush(fp) != 0 ||
+      fsync(fileno(fp)) != 0) {
+    fclose(fp);
+    return -EIO;
+  }
   fclose(fp);
   return size;
 }
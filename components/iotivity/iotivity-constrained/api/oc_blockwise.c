@@ -18,34 +18,160 @@
 #include <config.h>
 #ifdef OC_BLOCK_WISE
 #include "oc_blockwise.h"
+#include "oc_buffer.h"
 #include "oc_endpoint.h"
 #include "port/oc_log.h"
-#include "util/oc_list.h"
+#include "util/oc_hash.h"
 #include "util/oc_memb.h"
 
-OC_MEMB(oc_blockwise_request_states_s, oc_blockwise_request_state_t,
-        OC_MAX_NUM_CONCURRENT_REQUESTS);
-OC_MEMB(oc_blockwise_response_states_s, oc_blockwise_response_state_t,
-        OC_MAX_NUM_CONCURRENT_REQUESTS);
-OC_LIST(oc_blockwise_requests);
-OC_LIST(oc_blockwise_responses);
+OC_MEMB_ZEROED(oc_blockwise_request_states_s, oc_blockwise_request_state_t,
+               OC_MAX_NUM_CONCURRENT_REQUESTS);
+OC_MEMB_ZEROED(oc_blockwise_response_states_s,
+               oc_blockwise_response_state_t, OC_MAX_NUM_CONCURRENT_REQUESTS);
+
+/* Block-wise states are indexed by a hash of their href, endpoint, method
+ * and role, and on the client also by message ID and client callback, so
+ * that finding the state for each block of a transfer does not scan all
+ * transfers. A state released by the message layer is queued, and a scrub
+ * only visits the queued states. The number of buckets must be a power of
+ * two.
+ */
+#ifndef OC_BLOCKWISE_INDEX_BUCKETS
+#ifdef OC_DYNAMIC_ALLOCATION
+#define OC_BLOCKWISE_INDEX_BUCKETS (64)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define OC_BLOCKWISE_INDEX_BUCKETS (8)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#endif /* !OC_BLOCKWISE_INDEX_BUCKETS */
+
+typedef struct
+{
+  struct oc_memb *pool;
+  oc_blockwise_state_t *released;
+  oc_blockwise_state_t *by_key[OC_BLOCKWISE_INDEX_BUCKETS];
+#ifdef OC_CLIENT
+  oc_blockwise_state_t *by_mid[OC_BLOCKWISE_INDEX_BUCKETS];
+  oc_blockwise_state_t *by_client_cb[OC_BLOCKWISE_INDEX_BUCKETS];
+#endif /* OC_CLIENT */
+} oc_blockwise_store_t;
+
+static oc_blockwise_store_t requests = {.pool =
+                                          &oc_blockwise_request_states_s };
+static oc_blockwise_store_t responses = {.pool =
+                                           &oc_blockwise_response_states_s };
+
+#define BLOCKWISE_LINK_INSERT(head, b, link)                                   \
+  do {                                                                         \
+    (b)->link.next = *(head);                                                  \
+    if (*(head))                                                               \
+      (*(head))->link.pprev = &(b)->link.next;                                 \
+    (b)->link.pprev = (head);                                                  \
+    *(head) = (b);                                                             \
+  } while (0)
+
+#define BLOCKWISE_LINK_REMOVE(b, link)                                         \
+  do {                                                                         \
+    if ((b)->link.pprev) {                                                     \
+      *(b)->link.pprev = (b)->link.next;                                       \
+      if ((b)->link.next)                                                      \
+        (b)->link.next->link.pprev = (b)->link.pprev;                          \
+      (b)->link.next = NULL;                                                   \
+      (b)->link.pprev = NULL;                                                  \
+    }                                                                          \
+  } while (0)
+
+/* FNV-1a over the href, seeded with the endpoint, method and role */
+static uint32_t
+key_hash(const char *href, int href_len, oc_endpoint_t *endpoint,
+         oc_method_t method, oc_blockwise_role_t role)
+{
+  uint32_t hash =
+    oc_endpoint_hash(endpoint) ^ ((uint32_t)method << 8 | (uint32_t)role);
+  return oc_fnv1a(hash, href, (size_t)href_len);
+}
+
+#ifdef OC_CLIENT
+static oc_blockwise_state_t **
+mid_bucket(oc_blockwise_store_t *store, uint16_t mid)
+{
+  return &store->by_mid[mid & (OC_BLOCKWISE_INDEX_BUCKETS - 1)];
+}
+
+static oc_blockwise_state_t **
+client_cb_bucket(oc_blockwise_store_t *store, void *client_cb)
+{
+  uint32_t hash = (uint32_t)((uintptr_t)client_cb >> 3) * 2654435761u;
+  return &store->by_client_cb[(hash >> 16) & (OC_BLOCKWISE_INDEX_BUCKETS - 1)];
+}
+#endif /* OC_CLIENT */
+
+#ifdef OC_DYNAMIC_ALLOCATION
+static oc_blockwise_segment_t *
+new_segment(uint32_t offset, uint32_t size)
+{
+  oc_blockwise_segment_t *segment =
+    (oc_blockwise_segment_t *)malloc(sizeof(oc_blockwise_segment_t) + size);
+  if (segment) {
+    segment->next = NULL;
+    segment->offset = offset;
+    segment->size = size;
+  }
+  return segment;
+}
+
+static void
+free_segments(oc_blockwise_state_t *buffer)
+{
+  oc_blockwise_segment_t *segment = buffer->segments, *next;
+  while (segment) {
+    next = segment->next;
+    free(segment);
+    segment = next;
+  }
+  buffer->segments = NULL;
+  buffer->cursor = NULL;
+  oc_message_unref(buffer->message);
+  buffer->message = NULL;
+  buffer->message_payload = NULL;
+}
+
+/* Returns the last segment that starts at or before offset, which is the
+ * one holding offset if any does. The walk resumes from the segment last
+ * accessed, so a transfer that moves through its payload in order finds
+ * each block in constant time.
+ */
+static oc_blockwise_segment_t *
+find_segment(oc_blockwise_state_t *buffer, uint32_t offset)
+{
+  oc_blockwise_segment_t *segment = buffer->segments, *prev = NULL;
+  if (buffer->cursor && buffer->cursor->offset <= offset) {
+    segment = buffer->cursor;
+  }
+  while (segment && segment->offset <= offset) {
+    prev = segment;
+    segment = segment->next;
+  }
+  return prev;
+}
+#endif /* OC_DYNAMIC_ALLOCATION */
 
 static oc_blockwise_state_t *
-oc_blockwise_init_buffer(struct oc_memb *pool, const char *href, int href_len,
-                         oc_endpoint_t *endpoint, oc_method_t method,
-                         oc_blockwise_role_t role)
+oc_blockwise_init_buffer(oc_blockwise_store_t *store, const char *href,
+                         int href_len, oc_endpoint_t *endpoint,
+                         oc_method_t method, oc_blockwise_role_t role)
 {
   if (href_len == 0)
     return NULL;
 
-  oc_blockwise_state_t *buffer = (oc_blockwise_state_t *)oc_memb_alloc(pool);
+  oc_blockwise_state_t *buffer =
+    (oc_blockwise_state_t *)oc_memb_alloc(store->pool);
   if (buffer) {
 #ifdef OC_DYNAMIC_ALLOCATION
-    buffer->buffer = (uint8_t *)malloc(OC_MAX_APP_DATA_SIZE);
-    if (!buffer->buffer) {
-      oc_memb_free(pool, buffer);
-      return NULL;
-    }
+    buffer->segments = NULL;
+    buffer->cursor = NULL;
+    buffer->segment_size = (uint16_t)OC_BLOCK_SIZE;
+    buffer->message = NULL;
+    buffer->message_payload = NULL;
 #endif /* OC_DYNAMIC_ALLOCATION */
     buffer->next_block_offset = 0;
     buffer->payload_size = 0;
@@ -54,8 +180,14 @@ oc_blockwise_init_buffer(struct oc_memb *pool, const char *href, int href_len,
     buffer->role = role;
     memcpy(&buffer->endpoint, endpoint, sizeof(oc_endpoint_t));
     oc_new_string(&buffer->href, href, href_len);
-    buffer->next = 0;
+    buffer->key_hash = key_hash(href, href_len, endpoint, method, role);
+    memset(&buffer->release_link, 0, sizeof(oc_blockwise_link_t));
+    BLOCKWISE_LINK_INSERT(
+      &store->by_key[buffer->key_hash & (OC_BLOCKWISE_INDEX_BUCKETS - 1)],
+      buffer, key_link);
 #ifdef OC_CLIENT
+    memset(&buffer->mid_link, 0, sizeof(oc_blockwise_link_t));
+    memset(&buffer->client_cb_link, 0, sizeof(oc_blockwise_link_t));
     buffer->mid = 0;
     buffer->client_cb = 0;
 #endif /* OC_CLIENT */
@@ -66,32 +198,35 @@ oc_blockwise_init_buffer(struct oc_memb *pool, const char *href, int href_len,
 }
 
 static void
-oc_blockwise_free_buffer(oc_list_t list, struct oc_memb *pool,
+oc_blockwise_free_buffer(oc_blockwise_store_t *store,
                          oc_blockwise_state_t *buffer)
 {
   if (oc_string_len(buffer->uri_query))
     oc_free_string(&buffer->uri_query);
   oc_free_string(&buffer->href);
-  oc_list_remove(list, buffer);
+  BLOCKWISE_LINK_REMOVE(buffer, key_link);
+  BLOCKWISE_LINK_REMOVE(buffer, release_link);
+#ifdef OC_CLIENT
+  BLOCKWISE_LINK_REMOVE(buffer, mid_link);
+  BLOCKWISE_LINK_REMOVE(buffer, client_cb_link);
+#endif /* OC_CLIENT */
 #ifdef OC_DYNAMIC_ALLOCATION
-  free(buffer->buffer);
+  free_segments(buffer);
 #endif /* OC_DYNAMIC_ALLOCATION */
-  oc_memb_free(pool, buffer);
+  oc_memb_free(store->pool, buffer);
 }
 
 static oc_event_callback_retval_t
 oc_blockwise_request_timeout(void *data)
 {
-  oc_blockwise_free_buffer(oc_blockwise_requests,
-                           &oc_blockwise_request_states_s, data);
+  oc_blockwise_free_buffer(&requests, data);
   return OC_EVENT_DONE;
 }
 
 static oc_event_callback_retval_t
 oc_blockwise_response_timeout(void *data)
 {
-  oc_blockwise_free_buffer(oc_blockwise_responses,
-                           &oc_blockwise_response_states_s, data);
+  oc_blockwise_free_buffer(&responses, data);
   return OC_EVENT_DONE;
 }
 
@@ -102,11 +237,10 @@ oc_blockwise_alloc_request_buffer(const char *href, int href_len,
 {
   oc_blockwise_request_state_t *buffer =
     (oc_blockwise_request_state_t *)oc_blockwise_init_buffer(
-      &oc_blockwise_request_states_s, href, href_len, endpoint, method, role);
+      &requests, href, href_len, endpoint, method, role);
   if (buffer) {
     oc_ri_add_timed_event_callback_seconds(buffer, oc_blockwise_request_timeout,
                                            OC_EXCHANGE_LIFETIME);
-    oc_list_add(oc_blockwise_requests, buffer);
   }
   return (oc_blockwise_state_t *)buffer;
 }
@@ -118,7 +252,7 @@ oc_blockwise_alloc_response_buffer(const char *href, int href_len,
 {
   oc_blockwise_response_state_t *buffer =
     (oc_blockwise_response_state_t *)oc_blockwise_init_buffer(
-      &oc_blockwise_response_states_s, href, href_len, endpoint, method, role);
+      &responses, href, href_len, endpoint, method, role);
   if (buffer) {
     int i = COAP_ETAG_LEN;
     uint32_t r = oc_random_value();
@@ -132,7 +266,6 @@ oc_blockwise_alloc_response_buffer(const char *href, int href_len,
 #endif /* OC_CLIENT */
     oc_ri_add_timed_event_callback_seconds(
       buffer, oc_blockwise_response_timeout, OC_EXCHANGE_LIFETIME);
-    oc_list_add(oc_blockwise_responses, buffer);
   }
   return (oc_blockwise_state_t *)buffer;
 }
@@ -151,61 +284,139 @@ oc_blockwise_free_response_buffer(oc_blockwise_state_t *buffer)
   oc_blockwise_response_timeout(buffer);
 }
 
-#ifdef OC_CLIENT
-void
-oc_blockwise_scrub_buffers_for_client_cb(void *cb)
+static void
+oc_blockwise_release(oc_blockwise_store_t *store, oc_blockwise_state_t *buffer)
 {
-  oc_blockwise_state_t *buffer = oc_list_head(oc_blockwise_requests), *next;
-  while (buffer != NULL) {
-    next = buffer->next;
-    if (buffer->client_cb == cb) {
-      oc_blockwise_free_request_buffer(buffer);
-    }
-    buffer = next;
+  buffer->ref_count = 0;
+  if (!buffer->release_link.pprev) {
+    BLOCKWISE_LINK_INSERT(&store->released, buffer, release_link);
   }
+}
+
+/* Drops the reference held by the message layer; the state is freed by the
+ * next oc_blockwise_scrub_buffers() unless it is taken up again before.
+ */
+void
+oc_blockwise_release_request_buffer(oc_blockwise_state_t *buffer)
+{
+  oc_blockwise_release(&requests, buffer);
+}
+
+void
+oc_blockwise_release_response_buffer(oc_blockwise_state_t *buffer)
+{
+  oc_blockwise_release(&responses, buffer);
+}
 
-  buffer = oc_list_head(oc_blockwise_responses);
+/* Takes up a released state again for the message layer, before the next
+ * scrub frees it.
+ */
+void
+oc_blockwise_retain(oc_blockwise_state_t *buffer)
+{
+  buffer->ref_count = 1;
+  BLOCKWISE_LINK_REMOVE(buffer, release_link);
+}
+
+#ifdef OC_CLIENT
+static void
+scrub_store_for_client_cb(oc_blockwise_store_t *store, void *cb,
+                          void (*free_buffer)(oc_blockwise_state_t *))
+{
+  oc_blockwise_state_t *buffer = *client_cb_bucket(store, cb), *next;
   while (buffer != NULL) {
-    next = buffer->next;
+    next = buffer->client_cb_link.next;
     if (buffer->client_cb == cb) {
-      oc_blockwise_free_response_buffer(buffer);
+      free_buffer(buffer);
     }
     buffer = next;
   }
 }
-#endif /* OC_CLIENT */
 
 void
-oc_blockwise_scrub_buffers()
+oc_blockwise_scrub_buffers_for_client_cb(void *cb)
 {
-  oc_blockwise_state_t *buffer = oc_list_head(oc_blockwise_requests), *next;
-  while (buffer != NULL) {
-    next = buffer->next;
-    if (buffer->ref_count == 0) {
-      oc_blockwise_free_request_buffer(buffer);
-    }
-    buffer = next;
-  }
+  scrub_store_for_client_cb(&requests, cb, oc_blockwise_free_request_buffer);
+  scrub_store_for_client_cb(&responses, cb, oc_blockwise_free_response_buffer);
+}
+#endif /* OC_CLIENT */
 
-  buffer = oc_list_head(oc_blockwise_responses);
-  while (buffer != NULL) {
-    next = buffer->next;
+static void
+scrub_store(oc_blockwise_store_t *store,
+            void (*free_buffer)(oc_blockwise_state_t *))
+{
+  while (store->released) {
+    oc_blockwise_state_t *buffer = store->released;
+    BLOCKWISE_LINK_REMOVE(buffer, release_link);
     if (buffer->ref_count == 0) {
-      oc_blockwise_free_response_buffer(buffer);
+      free_buffer(buffer);
     }
-    buffer = next;
   }
 }
 
+void
+oc_blockwise_scrub_buffers()
+{
+  scrub_store(&requests, oc_blockwise_free_request_buffer);
+  scrub_store(&responses, oc_blockwise_free_response_buffer);
+}
+
 #ifdef OC_CLIENT
+static void
+set_mid(oc_blockwise_store_t *store, oc_blockwise_state_t *buffer,
+        uint16_t mid)
+{
+  BLOCKWISE_LINK_REMOVE(buffer, mid_link);
+  buffer->mid = mid;
+  BLOCKWISE_LINK_INSERT(mid_bucket(store, mid), buffer, mid_link);
+}
+
+void
+oc_blockwise_set_request_mid(oc_blockwise_state_t *buffer, uint16_t mid)
+{
+  set_mid(&requests, buffer, mid);
+}
+
+void
+oc_blockwise_set_response_mid(oc_blockwise_state_t *buffer, uint16_t mid)
+{
+  set_mid(&responses, buffer, mid);
+}
+
+static void
+set_client_cb(oc_blockwise_store_t *store, oc_blockwise_state_t *buffer,
+              void *client_cb)
+{
+  BLOCKWISE_LINK_REMOVE(buffer, client_cb_link);
+  buffer->client_cb = client_cb;
+  if (client_cb) {
+    BLOCKWISE_LINK_INSERT(client_cb_bucket(store, client_cb), buffer,
+                          client_cb_link);
+  }
+}
+
+void
+oc_blockwise_set_request_client_cb(oc_blockwise_state_t *buffer,
+                                   void *client_cb)
+{
+  set_client_cb(&requests, buffer, client_cb);
+}
+
+void
+oc_blockwise_set_response_client_cb(oc_blockwise_state_t *buffer,
+                                    void *client_cb)
+{
+  set_client_cb(&responses, buffer, client_cb);
+}
+
 static oc_blockwise_state_t *
-oc_blockwise_find_buffer_by_mid(oc_list_t list, uint16_t mid)
+oc_blockwise_find_buffer_by_mid(oc_blockwise_store_t *store, uint16_t mid)
 {
-  oc_blockwise_state_t *buffer = oc_list_head(list);
+  oc_blockwise_state_t *buffer = *mid_bucket(store, mid);
   while (buffer) {
     if (buffer->mid == mid && buffer->role == OC_BLOCKWISE_CLIENT)
       break;
-    buffer = buffer->next;
+    buffer = buffer->mid_link.next;
   }
   return buffer;
 }
@@ -213,26 +424,26 @@ oc_blockwise_find_buffer_by_mid(oc_list_t list, uint16_t mid)
 oc_blockwise_state_t *
 oc_blockwise_find_request_buffer_by_mid(uint16_t mid)
 {
-  return oc_blockwise_find_buffer_by_mid(oc_blockwise_requests, mid);
+  return oc_blockwise_find_buffer_by_mid(&requests, mid);
 }
 
 oc_blockwise_state_t *
 oc_blockwise_find_response_buffer_by_mid(uint16_t mid)
 {
-  return oc_blockwise_find_buffer_by_mid(oc_blockwise_responses, mid);
+  return oc_blockwise_find_buffer_by_mid(&responses, mid);
 }
 
 static oc_blockwise_state_t *
-oc_blockwise_find_buffer_by_client_cb(oc_list_t list, oc_endpoint_t *endpoint,
-                                      void *client_cb)
+oc_blockwise_find_buffer_by_client_cb(oc_blockwise_store_t *store,
+                                      oc_endpoint_t *endpoint, void *client_cb)
 {
-  oc_blockwise_state_t *buffer = oc_list_head(list);
+  oc_blockwise_state_t *buffer = *client_cb_bucket(store, client_cb);
   while (buffer) {
     if (buffer->role == OC_BLOCKWISE_CLIENT && buffer->client_cb == client_cb &&
         oc_endpoint_compare(endpoint, &buffer->endpoint) == 0) {
       break;
     }
-    buffer = buffer->next;
+    buffer = buffer->client_cb_link.next;
   }
   return buffer;
 }
@@ -241,35 +452,38 @@ oc_blockwise_state_t *
 oc_blockwise_find_request_buffer_by_client_cb(oc_endpoint_t *endpoint,
                                               void *client_cb)
 {
-  return oc_blockwise_find_buffer_by_client_cb(oc_blockwise_requests, endpoint,
-                                               client_cb);
+  return oc_blockwise_find_buffer_by_client_cb(&requests, endpoint, client_cb);
 }
 
 oc_blockwise_state_t *
 oc_blockwise_find_response_buffer_by_client_cb(oc_endpoint_t *endpoint,
                                                void *client_cb)
 {
-  return oc_blockwise_find_buffer_by_client_cb(oc_blockwise_responses, endpoint,
+  return oc_blockwise_find_buffer_by_client_cb(&responses, endpoint,
                                                client_cb);
 }
 #endif /* OC_CLIENT */
 
 static oc_blockwise_state_t *
-oc_blockwise_find_buffer(oc_list_t list, const char *href, int href_len,
-                         oc_endpoint_t *endpoint, oc_method_t method,
-                         const char *query, int query_len,
+oc_blockwise_find_buffer(oc_blockwise_store_t *store, const char *href,
+                         int href_len, oc_endpoint_t *endpoint,
+                         oc_method_t method, const char *query, int query_len,
                          oc_blockwise_role_t role)
 {
-  oc_blockwise_state_t *buffer = oc_list_head(list);
+  uint32_t hash = key_hash(href, href_len, endpoint, method, role);
+  oc_blockwise_state_t *buffer =
+    store->by_key[hash & (OC_BLOCKWISE_INDEX_BUCKETS - 1)];
   while (buffer) {
-    if (strncmp(href, oc_string(buffer->href), href_len) == 0 &&
+    if (buffer->key_hash == hash &&
+        href_len == (int)oc_string_len(buffer->href) &&
+        memcmp(href, oc_string(buffer->href), href_len) == 0 &&
         oc_endpoint_compare(&buffer->endpoint, endpoint) == 0 &&
         buffer->method == method && buffer->role == role &&
         query_len == (int)oc_string_len(buffer->uri_query) &&
         memcmp(query, oc_string(buffer->uri_query), query_len) == 0) {
       break;
     }
-    buffer = buffer->next;
+    buffer = buffer->key_link.next;
   }
   return buffer;
 }
@@ -280,8 +494,8 @@ oc_blockwise_find_request_buffer(const char *href, int href_len,
                                  const char *query, int query_len,
                                  oc_blockwise_role_t role)
 {
-  return oc_blockwise_find_buffer(oc_blockwise_requests, href, href_len,
-                                  endpoint, method, query, query_len, role);
+  return oc_blockwise_find_buffer(&requests, href, href_len, endpoint, method,
+                                  query, query_len, role);
 }
 
 oc_blockwise_state_t *
@@ -290,10 +504,160 @@ oc_blockwise_find_response_buffer(const char *href, int href_len,
                                   const char *query, int query_len,
                                   oc_blockwise_role_t role)
 {
-  return oc_blockwise_find_buffer(oc_blockwise_responses, href, href_len,
-                                  endpoint, method, query, query_len, role);
+  return oc_blockwise_find_buffer(&responses, href, href_len, endpoint, method,
+                                  query, query_len, role);
+}
+#ifdef OC_DYNAMIC_ALLOCATION
+/* Replaces the payload with a single segment of the given size for a
+ * payload to be encoded in place.
+ */
+uint8_t *
+oc_blockwise_reserve(oc_blockwise_state_t *buffer, uint32_t size)
+{
+  free_segments(buffer);
+  buffer->segments = new_segment(0, size);
+  return buffer->segments ? buffer->segments->data : NULL;
+}
+
+/* Trims a reserved segment to the length of the payload encoded into it. */
+void
+oc_blockwise_commit(oc_blockwise_state_t *buffer, uint32_t length)
+{
+  oc_blockwise_segment_t *segment = buffer->segments;
+  if (!segment) {
+    return;
+  }
+  if (length == 0) {
+    free_segments(buffer);
+  } else if (length < segment->size) {
+    segment = (oc_blockwise_segment_t *)realloc(
+      segment, sizeof(oc_blockwise_segment_t) + length);
+    if (segment) {
+      segment->size = length;
+      buffer->segments = segment;
+    }
+    buffer->cursor = NULL;
+  }
+}
+
+/* Takes over a payload that was encoded in place in a message, so that it
+ * is served from there without being copied. The message is held until
+ * the buffer is freed or its payload replaced.
+ */
+void
+oc_blockwise_adopt(oc_blockwise_state_t *buffer, oc_message_t *message,
+                   const uint8_t *payload, uint32_t length)
+{
+  free_segments(buffer);
+  oc_message_add_ref(message);
+  buffer->message = message;
+  buffer->message_payload = payload;
+  buffer->payload_size = length;
 }
 
+bool
+oc_blockwise_write(oc_blockwise_state_t *buffer, uint32_t offset,
+                   const uint8_t *data, uint32_t length)
+{
+  if (offset > (uint32_t)OC_MAX_APP_DATA_SIZE ||
+      length > (uint32_t)OC_MAX_APP_DATA_SIZE - offset)
+    return false;
+
+  while (length > 0) {
+    oc_blockwise_segment_t *prev = find_segment(buffer, offset);
+    oc_blockwise_segment_t *segment = prev;
+    if (!segment || offset >= segment->offset + segment->size) {
+      oc_blockwise_segment_t *next = prev ? prev->next : buffer->segments;
+      uint32_t start = offset - offset % buffer->segment_size;
+      uint32_t size = buffer->segment_size;
+      if (prev && start < prev->offset + prev->size) {
+        start = prev->offset + prev->size;
+      }
+      if (next && start + size > next->offset) {
+        size = next->offset - start;
+      }
+      segment = new_segment(start, size);
+      if (!segment) {
+        OC_WRN("block-wise segments exhausted\n");
+        return false;
+      }
+      segment->next = next;
+      if (prev) {
+        prev->next = segment;
+      } else {
+        buffer->segments = segment;
+      }
+    }
+    buffer->cursor = segment;
+    uint32_t n = MIN(length, segment->offset + segment->size - offset);
+    memcpy(&segment->data[offset - segment->offset], data, n);
+    offset += n;
+    data += n;
+    length -= n;
+  }
+  return true;
+}
+
+/* Gathers the payload into a single segment, for it to be parsed. */
+const uint8_t *
+oc_blockwise_get_payload(oc_blockwise_state_t *buffer)
+{
+  oc_blockwise_segment_t *segment = buffer->segments;
+  if (buffer->message) {
+    return buffer->message_payload;
+  }
+  if (!segment || buffer->payload_size == 0) {
+    return NULL;
+  }
+  if (segment->offset == 0 && segment->size >= buffer->payload_size) {
+    return segment->data;
+  }
+  oc_blockwise_segment_t *whole = new_segment(0, buffer->payload_size);
+  if (!whole) {
+    return NULL;
+  }
+  memset(whole->data, 0, buffer->payload_size);
+  for (; segment && segment->offset < buffer->payload_size;
+       segment = segment->next) {
+    memcpy(&whole->data[segment->offset], segment->data,
+           MIN(segment->size, buffer->payload_size - segment->offset));
+  }
+  free_segments(buffer);
+  buffer->segments = whole;
+  return whole->data;
+}
+#else  /* OC_DYNAMIC_ALLOCATION */
+uint8_t *
+oc_blockwise_reserve(oc_blockwise_state_t *buffer, uint32_t size)
+{
+  return (size <= (uint32_t)OC_MAX_APP_DATA_SIZE) ? buffer->buffer : NULL;
+}
+
+void
+oc_blockwise_commit(oc_blockwise_state_t *buffer, uint32_t length)
+{
+  (void)buffer;
+  (void)length;
+}
+
+bool
+oc_blockwise_write(oc_blockwise_state_t *buffer, uint32_t offset,
+                   const uint8_t *data, uint32_t length)
+{
+  if (offset > (uint32_t)OC_MAX_APP_DATA_SIZE ||
+      length > (uint32_t)OC_MAX_APP_DATA_SIZE - offset)
+    return false;
+  memcpy(&buffer->buffer[offset], data, length);
+  return true;
+}
+
+const uint8_t *
+oc_blockwise_get_payload(oc_blockwise_state_t *buffer)
+{
+  return buffer->buffer;
+}
+#endif /* !OC_DYNAMIC_ALLOCATION */
+
 const void *
 oc_blockwise_dispatch_block(oc_blockwise_state_t *buffer, uint32_t block_offset,
                             uint16_t requested_block_size,
@@ -303,11 +667,27 @@ oc_blockwise_dispatch_block(oc_blockwise_state_t *buffer, uint32_t block_offset,
     if (buffer->payload_size < requested_block_size)
       *payload_size = (uint16_t)buffer->payload_size;
     else {
-      *payload_size = MIN(requested_block_size,
-                          (uint16_t)(buffer->payload_size - block_offset));
+      *payload_size = (uint16_t)MIN(requested_block_size,
+                                    buffer->payload_size - block_offset);
     }
     buffer->next_block_offset = block_offset + *payload_size;
+#ifdef OC_DYNAMIC_ALLOCATION
+    if (buffer->message) {
+      return (const void *)&buffer->message_payload[block_offset];
+    }
+    oc_blockwise_segment_t *segment = find_segment(buffer, block_offset);
+    if (!segment ||
+        block_offset + *payload_size > segment->offset + segment->size) {
+      /* The block straddles two segments */
+      if (!oc_blockwise_get_payload(buffer))
+        return NULL;
+      segment = buffer->segments;
+    }
+    buffer->cursor = segment;
+    return (const void *)&segment->data[block_offset - segment->offset];
+#else  /* OC_DYNAMIC_ALLOCATION */
     return (const void *)&buffer->buffer[block_offset];
+#endif /* !OC_DYNAMIC_ALLOCATION */
   }
   return NULL;
 }
@@ -318,18 +698,91 @@ oc_blockwise_handle_block(oc_blockwise_state_t *buffer,
                           const uint8_t *incoming_block,
                           uint16_t incoming_block_size)
 {
-  if (incoming_block_offset >= (unsigned)OC_MAX_APP_DATA_SIZE ||
-      incoming_block_size > (OC_MAX_APP_DATA_SIZE - incoming_block_offset) ||
-      incoming_block_offset > buffer->next_block_offset)
+  if (incoming_block_offset > buffer->next_block_offset)
     return false;
 
   if (buffer->next_block_offset == incoming_block_offset) {
-    memcpy(&buffer->buffer[buffer->next_block_offset], incoming_block,
-           incoming_block_size);
+    if (!oc_blockwise_write(buffer, incoming_block_offset, incoming_block,
+                            incoming_block_size))
+      return false;
 
     buffer->next_block_offset += incoming_block_size;
   }
 
   return true;
 }
+
+#ifdef OC_CLIENT
+/* Blocks of a windowed transfer may arrive in any order. A block that lands
+ * past next_block_offset is stored in place and remembered in blocks_ahead
+ * until the ones before it have arrived.
+ */
+bool
+oc_blockwise_handle_window_block(oc_blockwise_state_t *buffer,
+                                 uint32_t block_num, uint16_t block_size,
+                                 const uint8_t *incoming_block,
+                                 uint16_t incoming_block_size)
+{
+  oc_blockwise_response_state_t *state =
+    (oc_blockwise_response_state_t *)buffer;
+  uint32_t incoming_block_offset = block_num * block_size;
+  if (block_size == 0 || incoming_block_size > block_size ||
+      incoming_block_offset >= state->body_size ||
+      incoming_block_size > (state->body_size - incoming_block_offset))
+    return false;
+
+  if (incoming_block_offset < buffer->next_block_offset)
+    return true;
+
+  uint32_t ahead = (incoming_block_offset - buffer->next_block_offset) /
+                   block_size;
+  if (ahead >= OC_BLOCK_WINDOW_MAX)
+    return false;
+
+  if (!oc_blockwise_write(buffer, incoming_block_offset, incoming_block,
+                          incoming_block_size))
+    return false;
+  state->blocks_ahead |= (uint32_t)1 << ahead;
+
+  while (state->blocks_ahead & 1) {
+    state->blocks_ahead >>= 1;
+    buffer->next_block_offset =
+      MIN(buffer->next_block_offset + block_size, state->body_size);
+  }
+
+  return true;
+}
+#endif /* OC_CLIENT */
+
+/* Returns true once every block of the buffer has been dispatched at least
+ * once. Only the last OC_BLOCK_WINDOW_MAX blocks are tracked, as a client
+ * never asks for a block that far ahead of one it has not received.
+ */
+bool
+oc_blockwise_block_served(oc_blockwise_state_t *buffer, uint32_t block_num,
+                          uint16_t block_size)
+{
+  oc_blockwise_response_state_t *state =
+    (oc_blockwise_response_state_t *)buffer;
+  if (block_num >= state->served_end) {
+    uint32_t shift = block_num + 1 - state->served_end;
+    state->blocks_served =
+      (shift >= OC_BLOCK_WINDOW_MAX) ? 0 : state->blocks_served << shift;
+    state->blocks_served |= 1;
+    state->served_end = block_num + 1;
+  } else if (state->served_end - 1 - block_num < OC_BLOCK_WINDOW_MAX) {
+    state->blocks_served |= (uint32_t)1 << (state->served_end - 1 - block_num);
+  }
+
+  if (block_size == 0 || buffer->payload_size == 0)
+    return true;
+  uint32_t num_blocks = (buffer->payload_size + block_size - 1) / block_size;
+  if (state->served_end < num_blocks)
+    return false;
+  uint32_t tracked = MIN(num_blocks, (uint32_t)OC_BLOCK_WINDOW_MAX);
+  uint32_t mask = (tracked == OC_BLOCK_WINDOW_MAX)
+                    ? ~(uint32_t)0
+                    : (((uint32_t)1 << tracked) - 1);
+  return (state->blocks_served & mask) == mask;
+}
 #endif /* OC_BLOCK_WISE */
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #ifdef OC_DYNAMIC_ALLOCATION
 #include <stdlib.h>
+#include <string.h>
 #endif /* OC_DYNAMIC_ALLOCATION */
 
 #ifdef OC_SECURITY
@@ -32,11 +33,264 @@
 #include "oc_events.h"
 
 OC_PROCESS(message_buffer_handler, "OC Message Buffer Handler");
+
+#ifdef OC_MESSAGE_POOL
+/* Messages and their payload buffers are carved together out of slabs that
+ * are taken from the heap in chunks and never returned to it, so that the
+ * steady-state packet path does not touch the heap. Freed blocks go back
+ * to a per size class free list. The list head packs a 16 bit block index
+ * with a 16 bit tag that changes on every update, which keeps the list
+ * lock-free (and safe from ABA) using only 32 bit atomics. Messages that
+ * cannot be pooled fall back to the heap.
+ */
+
+#ifndef OC_SMALL_MESSAGE_SIZE
+#define OC_SMALL_MESSAGE_SIZE (64)
+#endif /* !OC_SMALL_MESSAGE_SIZE */
+
+#ifndef OC_MESSAGE_POOL_CHUNK_SIZE
+#define OC_MESSAGE_POOL_CHUNK_SIZE (16)
+#endif /* !OC_MESSAGE_POOL_CHUNK_SIZE */
+
+#ifndef OC_MESSAGE_POOL_MAX_CHUNKS
+#define OC_MESSAGE_POOL_MAX_CHUNKS (64)
+#endif /* !OC_MESSAGE_POOL_MAX_CHUNKS */
+
+typedef struct
+{
+  oc_message_t message;
+  uint16_t index; /* 1 + block number in its pool, 0 if heap allocated */
+  uint16_t next;  /* next free block while on the free list */
+  uint8_t size_class;
+  uint8_t large; /* from oc_allocate_large_message() */
+} oc_message_block_t;
+
+typedef struct
+{
+  uint32_t head;
+  uint32_t num_chunks;
+  size_t data_size;
+  size_t block_size;
+  uint8_t *chunks[OC_MESSAGE_POOL_MAX_CHUNKS];
+  oc_message_pool_stats_t stats;
+} oc_message_pool_t;
+
+static oc_message_pool_t message_pools[OC_MESSAGE_NUM_SIZE_CLASSES];
+
+/* The last large message freed, kept for the next one */
+static oc_message_block_t *large_message_cache;
+
+#define MESSAGE_BLOCK_HEADER_SIZE                                              \
+  ((sizeof(oc_message_block_t) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+static oc_message_block_t *
+pool_block(oc_message_pool_t *pool, uint16_t index)
+{
+  uint16_t i = index - 1;
+  uint8_t *chunk = __atomic_load_n(&pool->chunks[i / OC_MESSAGE_POOL_CHUNK_SIZE],
+                                   __ATOMIC_ACQUIRE);
+  return (oc_message_block_t *)(chunk + (i % OC_MESSAGE_POOL_CHUNK_SIZE) *
+                                          pool->block_size);
+}
+
+static void
+pool_push(oc_message_pool_t *pool, oc_message_block_t *block)
+{
+  uint32_t head = __atomic_load_n(&pool->head, __ATOMIC_RELAXED), new_head;
+  do {
+    __atomic_store_n(&block->next, (uint16_t)(head & 0xffff),
+                     __ATOMIC_RELAXED);
+    new_head = ((head & 0xffff0000) + 0x10000) | block->index;
+  } while (!__atomic_compare_exchange_n(&pool->head, &head, new_head, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static oc_message_block_t *
+pool_pop(oc_message_pool_t *pool)
+{
+  uint32_t head = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE), new_head;
+  oc_message_block_t *block;
+  do {
+    if ((head & 0xffff) == 0) {
+      return NULL;
+    }
+    block = pool_block(pool, (uint16_t)(head & 0xffff));
+    new_head = ((head & 0xffff0000) + 0x10000) |
+               __atomic_load_n(&block->next, __ATOMIC_RELAXED);
+  } while (!__atomic_compare_exchange_n(&pool->head, &head, new_head, true,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+  return block;
+}
+
+/* Carves a new chunk of blocks out of the heap, keeps one for the caller
+ * and puts the rest on the free list.
+ */
+static oc_message_block_t *
+pool_grow(oc_message_pool_t *pool, int size_class)
+{
+  uint32_t c = __atomic_load_n(&pool->num_chunks, __ATOMIC_RELAXED);
+  if (c >= OC_MESSAGE_POOL_MAX_CHUNKS) {
+    return NULL;
+  }
+  c = __atomic_fetch_add(&pool->num_chunks, 1, __ATOMIC_RELAXED);
+  if (c >= OC_MESSAGE_POOL_MAX_CHUNKS) {
+    return NULL;
+  }
+
+  uint8_t *chunk = (uint8_t *)malloc(OC_MESSAGE_POOL_CHUNK_SIZE *
+                                     pool->block_size);
+  if (!chunk) {
+    return NULL;
+  }
+  __atomic_store_n(&pool->chunks[c], chunk, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&pool->stats.capacity, OC_MESSAGE_POOL_CHUNK_SIZE,
+                     __ATOMIC_RELAXED);
+
+  int i;
+  oc_message_block_t *block = NULL;
+  for (i = OC_MESSAGE_POOL_CHUNK_SIZE - 1; i >= 0; i--) {
+    block = (oc_message_block_t *)(chunk + i * pool->block_size);
+    block->index = (uint16_t)(c * OC_MESSAGE_POOL_CHUNK_SIZE + i + 1);
+    block->size_class = (uint8_t)size_class;
+    block->large = 0;
+    if (i > 0) {
+      pool_push(pool, block);
+    }
+  }
+  return block;
+}
+
+/* Block size of a pool that another thread is setting up */
+#define POOL_CLAIMED ((size_t)-1)
+
+/* Sizes a pool on first use and returns its block size. The pool is
+ * claimed first, and its block size is published with a release store only
+ * once data_size is set, so a thread that sees the block size also sees the
+ * matching data_size.
+ */
+static size_t
+pool_init(oc_message_pool_t *pool, size_t data_size)
+{
+  size_t expected = 0;
+  if (!__atomic_compare_exchange_n(&pool->block_size, &expected, POOL_CLAIMED,
+                                   false, __ATOMIC_ACQUIRE,
+                                   __ATOMIC_ACQUIRE)) {
+    return expected;
+  }
+  size_t block_size = MESSAGE_BLOCK_HEADER_SIZE + data_size;
+  block_size = (block_size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  pool->data_size = data_size;
+  __atomic_store_n(&pool->block_size, block_size, __ATOMIC_RELEASE);
+  return block_size;
+}
+
+static oc_message_block_t *
+heap_block(int size_class, size_t data_size)
+{
+  oc_message_block_t *block =
+    (oc_message_block_t *)malloc(MESSAGE_BLOCK_HEADER_SIZE + data_size);
+  if (block) {
+    block->index = 0;
+    block->size_class = (uint8_t)size_class;
+    block->large = 0;
+  }
+  return block;
+}
+
+static oc_message_t *
+init_message(oc_message_pool_t *pool, oc_message_block_t *block)
+{
+  uint32_t in_use =
+    __atomic_add_fetch(&pool->stats.in_use, 1, __ATOMIC_RELAXED);
+  uint32_t high_water =
+    __atomic_load_n(&pool->stats.high_water, __ATOMIC_RELAXED);
+  while (in_use > high_water &&
+         !__atomic_compare_exchange_n(&pool->stats.high_water, &high_water,
+                                      in_use, true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED))
+    ;
+
+  oc_message_t *message = &block->message;
+  memset(message, 0, sizeof(oc_message_t));
+  message->data = (uint8_t *)block + MESSAGE_BLOCK_HEADER_SIZE;
+  message->ref_count = 1;
+  return message;
+}
+
+static oc_message_t *
+allocate_message(int size_class)
+{
+  oc_message_pool_t *pool = &message_pools[size_class];
+  size_t data_size = (size_class == OC_MESSAGE_SMALL) ? OC_SMALL_MESSAGE_SIZE
+                                                      : (size_t)OC_PDU_SIZE;
+  oc_message_block_t *block = NULL;
+
+  size_t block_size = __atomic_load_n(&pool->block_size, __ATOMIC_ACQUIRE);
+  if (block_size == 0) {
+    block_size = pool_init(pool, data_size);
+  }
+
+  /* The pool may still be set up by another thread, and the MTU may have
+     grown after it was. */
+  if (block_size != POOL_CLAIMED && data_size <= pool->data_size) {
+    block = pool_pop(pool);
+    if (!block) {
+      block = pool_grow(pool, size_class);
+    }
+  }
+
+  if (!block) {
+    block = heap_block(size_class, data_size);
+    if (!block) {
+      return NULL;
+    }
+    __atomic_add_fetch(&pool->stats.heap_fallbacks, 1, __ATOMIC_RELAXED);
+  }
+
+  return init_message(pool, block);
+}
+
+static void
+free_message(oc_message_t *message)
+{
+  oc_message_block_t *block = (oc_message_block_t *)message;
+  oc_message_pool_t *pool = &message_pools[block->size_class];
+  __atomic_sub_fetch(&pool->stats.in_use, 1, __ATOMIC_RELAXED);
+  if (block->index == 0) {
+    oc_message_block_t *expected = NULL;
+    if (!block->large ||
+        !__atomic_compare_exchange_n(&large_message_cache, &expected, block,
+                                     false, __ATOMIC_RELEASE,
+                                     __ATOMIC_RELAXED)) {
+      free(block);
+    }
+  } else {
+    pool_push(pool, block);
+  }
+}
+
+void
+oc_message_pool_get_stats(oc_message_size_class_t size_class,
+                          oc_message_pool_stats_t *stats)
+{
+  oc_message_pool_t *pool = &message_pools[size_class];
+  stats->in_use = __atomic_load_n(&pool->stats.in_use, __ATOMIC_RELAXED);
+  stats->high_water =
+    __atomic_load_n(&pool->stats.high_water, __ATOMIC_RELAXED);
+  stats->capacity = __atomic_load_n(&pool->stats.capacity, __ATOMIC_RELAXED);
+  stats->heap_fallbacks =
+    __atomic_load_n(&pool->stats.heap_fallbacks, __ATOMIC_RELAXED);
+}
+#else  /* OC_MESSAGE_POOL */
 OC_MEMB(oc_buffers_s, oc_message_t, (OC_MAX_NUM_CONCURRENT_REQUESTS * 2));
+#endif /* !OC_MESSAGE_POOL */
 
 oc_message_t *
 oc_allocate_message(void)
 {
+#ifdef OC_MESSAGE_POOL
+  return allocate_message(OC_MESSAGE_FULL);
+#else  /* OC_MESSAGE_POOL */
   oc_message_t *message = (oc_message_t *)oc_memb_alloc(&oc_buffers_s);
   if (message) {
 #ifdef OC_DYNAMIC_ALLOCATION
@@ -46,6 +300,8 @@ oc_allocate_message(void)
       return NULL;
     }
 #endif /* OC_DYNAMIC_ALLOCATION */
+    /* The pool does not clear its blocks; leave the payload untouched. */
+    memset(&message->endpoint, 0, sizeof(oc_endpoint_t));
     message->length = 0;
     message->next = 0;
     message->ref_count = 1;
@@ -60,6 +316,51 @@ oc_allocate_message(void)
   }
 #endif /* !OC_DYNAMIC_ALLOCATION */
   return message;
+#endif /* !OC_MESSAGE_POOL */
+}
+
+#ifdef OC_DYNAMIC_ALLOCATION
+oc_message_t *
+oc_allocate_large_message(void)
+{
+  size_t data_size = COAP_MAX_HEADER_SIZE + (size_t)OC_MAX_APP_DATA_SIZE;
+#ifdef OC_MESSAGE_POOL
+  oc_message_block_t *block =
+    __atomic_exchange_n(&large_message_cache, NULL, __ATOMIC_ACQUIRE);
+  if (!block) {
+    block = heap_block(OC_MESSAGE_FULL, data_size);
+    if (!block) {
+      return NULL;
+    }
+    block->large = 1;
+  }
+  return init_message(&message_pools[OC_MESSAGE_FULL], block);
+#else  /* OC_MESSAGE_POOL */
+  oc_message_t *message = (oc_message_t *)oc_memb_alloc(&oc_buffers_s);
+  if (message) {
+    message->data = malloc(data_size);
+    if (!message->data) {
+      oc_memb_free(&oc_buffers_s, message);
+      return NULL;
+    }
+    memset(&message->endpoint, 0, sizeof(oc_endpoint_t));
+    message->length = 0;
+    message->next = 0;
+    message->ref_count = 1;
+  }
+  return message;
+#endif /* !OC_MESSAGE_POOL */
+}
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+oc_message_t *
+oc_allocate_small_message(void)
+{
+#ifdef OC_MESSAGE_POOL
+  return allocate_message(OC_MESSAGE_SMALL);
+#else  /* OC_MESSAGE_POOL */
+  return oc_allocate_message();
+#endif /* !OC_MESSAGE_POOL */
 }
 
 void
@@ -75,6 +376,9 @@ oc_message_unref(oc_message_t *message)
   if (message) {
     message->ref_count--;
     if (message->ref_count <= 0) {
+#ifdef OC_MESSAGE_POOL
+      free_message(message);
+#else /* OC_MESSAGE_POOL */
 #ifdef OC_DYNAMIC_ALLOCATION
       free(message->data);
 #endif /* OC_DYNAMIC_ALLOCATION */
@@ -83,6 +387,7 @@ oc_message_unref(oc_message_t *message)
       OC_DBG("buffer: freed TX/RX buffer; num free: %d\n",
              oc_memb_numfree(&oc_buffers_s));
 #endif /* !OC_DYNAMIC_ALLOCATION */
+#endif /* !OC_MESSAGE_POOL */
     }
   }
 }
@@ -116,7 +421,8 @@ OC_PROCESS_THREAD(message_buffer_handler, ev, data)
     if (ev == oc_events[INBOUND_NETWORK_EVENT]) {
 #ifdef OC_SECURITY
       uint8_t b = (uint8_t)((oc_message_t *)data)->data[0];
-      if (b > 19 && b < 64) {
+      if (!(((oc_message_t *)data)->endpoint.flags & TCP) && b > 19 &&
+          b < 64) {
         OC_DBG("Inbound network event: encrypted request\n");
         oc_process_post(&oc_dtls_handler, oc_events[UDP_TO_DTLS_EVENT], data);
       } else {
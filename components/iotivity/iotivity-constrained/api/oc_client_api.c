@@ -20,25 +20,88 @@
 
 #ifdef OC_CLIENT
 
-static coap_transaction_t *transaction;
-coap_packet_t request[1];
-oc_client_cb_t *client_cb;
+/* Scratch packet filled and serialized within a single dispatch */
+static coap_packet_t request[1];
+
+/* Request prepared by oc_init_put() / oc_init_post() */
+static oc_request_builder_t request_builder;
+
+oc_event_callback_retval_t oc_ri_remove_client_cb(void *data);
+
+static bool
+prepare_coap_request(oc_request_builder_t *builder, oc_client_cb_t *cb)
+{
+  memset(builder, 0, sizeof(oc_request_builder_t));
+
+  builder->transaction = coap_new_transaction(cb->mid, cb->endpoint);
+
+  if (!builder->transaction) {
+    return false;
+  }
 
 #ifdef OC_BLOCK_WISE
-static oc_blockwise_state_t *request_buffer;
+  if (cb->method == OC_PUT || cb->method == OC_POST) {
+    builder->request_buffer = oc_blockwise_alloc_request_buffer(
+      oc_string(cb->uri) + 1, oc_string_len(cb->uri) - 1, cb->endpoint,
+      cb->method, OC_BLOCKWISE_CLIENT);
+    if (!builder->request_buffer) {
+      coap_clear_transaction(builder->transaction);
+      builder->transaction = NULL;
+      return false;
+    }
+
+    oc_blockwise_set_request_mid(builder->request_buffer, cb->mid);
+    oc_blockwise_set_request_client_cb(builder->request_buffer, cb);
+  }
 #endif /* OC_BLOCK_WISE */
 
-oc_event_callback_retval_t oc_ri_remove_client_cb(void *data);
+  builder->cb = cb;
+
+  return true;
+}
 
 static bool
-dispatch_coap_request(void)
+dispatch_coap_request(oc_request_builder_t *builder)
 {
-  int payload_size = oc_rep_finalize();
+  oc_client_cb_t *cb = builder->cb;
+  coap_transaction_t *transaction = builder->transaction;
+  int payload_size = builder->payload_size;
+  coap_message_type_t type = COAP_TYPE_NON;
+
+  if (!cb || !transaction) {
+    return false;
+  }
+
+  if (cb->qos == HIGH_QOS) {
+    type = COAP_TYPE_CON;
+  }
+
+#ifdef OC_TCP
+  if (cb->endpoint->flags & TCP) {
+    coap_tcp_init_message(request, cb->method);
+  } else
+#endif /* OC_TCP */
+  {
+    coap_init_message(request, type, cb->method, cb->mid);
+  }
+
+  coap_set_header_accept(request, APPLICATION_VND_OCF_CBOR);
 
-  if ((client_cb->method == OC_PUT || client_cb->method == OC_POST) &&
-      payload_size > 0) {
+  coap_set_token(request, cb->token, cb->token_len);
+
+  coap_set_header_uri_path(request, oc_string(cb->uri), oc_string_len(cb->uri));
+
+  if (cb->observe_seq != -1)
+    coap_set_header_observe(request, cb->observe_seq);
+
+  if (oc_string_len(cb->query) > 0) {
+    coap_set_header_uri_query(request, oc_string(cb->query));
+  }
+
+  if ((cb->method == OC_PUT || cb->method == OC_POST) && payload_size > 0) {
 
 #ifdef OC_BLOCK_WISE
+    oc_blockwise_state_t *request_buffer = builder->request_buffer;
     request_buffer->payload_size = payload_size;
     uint16_t block_size;
     if (payload_size > OC_BLOCK_SIZE) {
@@ -49,11 +112,12 @@ dispatch_coap_request(void)
         coap_set_header_block1(request, 0, 1, block_size);
         coap_set_header_size1(request, payload_size);
         request->type = COAP_TYPE_CON;
-        client_cb->qos = HIGH_QOS;
+        cb->qos = HIGH_QOS;
       }
     } else {
-      coap_set_payload(request, request_buffer->buffer, payload_size);
-      request_buffer->ref_count = 0;
+      coap_set_payload(request, oc_blockwise_get_payload(request_buffer),
+                       payload_size);
+      oc_blockwise_release_request_buffer(request_buffer);
     }
 #else  /* OC_BLOCK_WISE */
     coap_set_payload(request, transaction->message->data + COAP_MAX_HEADER_SIZE,
@@ -70,76 +134,99 @@ dispatch_coap_request(void)
 
   coap_send_transaction(transaction);
 
-#ifdef OC_BLOCK_WISE
-  request_buffer = 0;
-#endif /* OC_BLOCK_WISE */
-
-  if (client_cb->observe_seq == -1) {
-    if (client_cb->qos == LOW_QOS)
-      oc_set_delayed_callback(client_cb, &oc_ri_remove_client_cb,
-                              OC_NON_LIFETIME);
+  if (cb->observe_seq == -1) {
+    if (cb->qos == LOW_QOS)
+      oc_set_delayed_callback(cb, &oc_ri_remove_client_cb, OC_NON_LIFETIME);
     else
-      oc_set_delayed_callback(client_cb, &oc_ri_remove_client_cb,
+      oc_set_delayed_callback(cb, &oc_ri_remove_client_cb,
                               OC_EXCHANGE_LIFETIME);
   }
 
-  transaction = 0;
-  client_cb = 0;
+  memset(builder, 0, sizeof(oc_request_builder_t));
 
   return true;
 }
 
-static bool
-prepare_coap_request(oc_client_cb_t *cb)
+bool
+oc_request_builder_init(oc_request_builder_t *builder, oc_method_t method,
+                        const char *uri, oc_endpoint_t *endpoint,
+                        const char *query, oc_response_handler_t handler,
+                        oc_qos_t qos, void *user_data)
 {
-  coap_message_type_t type = COAP_TYPE_NON;
+  oc_client_handler_t client_handler;
+  client_handler.response = handler;
 
-  if (cb->qos == HIGH_QOS) {
-    type = COAP_TYPE_CON;
+  oc_client_cb_t *cb = oc_ri_alloc_client_cb(uri, endpoint, method, query,
+                                             client_handler, qos, user_data);
+  if (!cb) {
+    return false;
   }
 
-  transaction = coap_new_transaction(cb->mid, cb->endpoint);
-
-  if (!transaction) {
+  if (!prepare_coap_request(builder, cb)) {
+    oc_ri_remove_client_cb(cb);
     return false;
   }
 
-#ifndef OC_BLOCK_WISE
-  oc_rep_new(transaction->message->data + COAP_MAX_HEADER_SIZE, OC_BLOCK_SIZE);
-#else  /* !OC_BLOCK_WISE */
-  if (cb->method == OC_PUT || cb->method == OC_POST) {
-    request_buffer = oc_blockwise_alloc_request_buffer(
-      oc_string(cb->uri) + 1, oc_string_len(cb->uri) - 1, cb->endpoint,
-      cb->method, OC_BLOCKWISE_CLIENT);
-    if (!request_buffer) {
-      return false;
-    }
+  return true;
+}
 
-    oc_rep_new(request_buffer->buffer, OC_MAX_APP_DATA_SIZE);
+bool
+oc_request_builder_begin_payload(oc_request_builder_t *builder)
+{
+  if (!builder->cb ||
+      (builder->cb->method != OC_PUT && builder->cb->method != OC_POST)) {
+    return false;
+  }
+#ifdef OC_BLOCK_WISE
+  uint8_t *payload = oc_blockwise_reserve(builder->request_buffer,
+                                          (uint32_t)OC_MAX_APP_DATA_SIZE);
+  if (!payload) {
+    return false;
+  }
+  oc_rep_new(payload, OC_MAX_APP_DATA_SIZE);
+#else  /* OC_BLOCK_WISE */
+  oc_rep_new(builder->transaction->message->data + COAP_MAX_HEADER_SIZE,
+             OC_BLOCK_SIZE);
+#endif /* !OC_BLOCK_WISE */
+  builder->payload_size = 0;
+  return true;
+}
 
-    request_buffer->mid = cb->mid;
-    request_buffer->client_cb = cb;
+bool
+oc_request_builder_end_payload(oc_request_builder_t *builder)
+{
+  builder->payload_size = oc_rep_finalize();
+  if (builder->payload_size < 0) {
+    builder->payload_size = 0;
+    return false;
   }
+#ifdef OC_BLOCK_WISE
+  oc_blockwise_commit(builder->request_buffer, (uint32_t)builder->payload_size);
 #endif /* OC_BLOCK_WISE */
+  return true;
+}
 
-  coap_init_message(request, type, cb->method, cb->mid);
-
-  coap_set_header_accept(request, APPLICATION_VND_OCF_CBOR);
-
-  coap_set_token(request, cb->token, cb->token_len);
-
-  coap_set_header_uri_path(request, oc_string(cb->uri), oc_string_len(cb->uri));
-
-  if (cb->observe_seq != -1)
-    coap_set_header_observe(request, cb->observe_seq);
+bool
+oc_request_builder_dispatch(oc_request_builder_t *builder)
+{
+  return dispatch_coap_request(builder);
+}
 
-  if (oc_string_len(cb->query) > 0) {
-    coap_set_header_uri_query(request, oc_string(cb->query));
+void
+oc_request_builder_discard(oc_request_builder_t *builder)
+{
+  if (builder->transaction) {
+    coap_clear_transaction(builder->transaction);
   }
-
-  client_cb = cb;
-
-  return true;
+#ifdef OC_BLOCK_WISE
+  if (builder->request_buffer) {
+    oc_blockwise_free_request_buffer(builder->request_buffer);
+  }
+#endif /* OC_BLOCK_WISE */
+  if (builder->cb) {
+    oc_ri_remove_client_cb(builder->cb);
+  }
+  memset(builder, 0, sizeof(oc_request_builder_t));
 }
 
 void
@@ -166,12 +253,11 @@ oc_do_delete(const char *uri, oc_endpoint_t *endpoint,
   if (!cb)
     return false;
 
-  bool status = false;
-
-  status = prepare_coap_request(cb);
+  oc_request_builder_t builder;
+  bool status = prepare_coap_request(&builder, cb);
 
   if (status)
-    status = dispatch_coap_request();
+    status = dispatch_coap_request(&builder);
 
   return status;
 }
@@ -188,12 +274,11 @@ oc_do_get(const char *uri, oc_endpoint_t *endpoint, const char *query,
   if (!cb)
     return false;
 
-  bool status = false;
-
-  status = prepare_coap_request(cb);
+  oc_request_builder_t builder;
+  bool status = prepare_coap_request(&builder, cb);
 
   if (status)
-    status = dispatch_coap_request();
+    status = dispatch_coap_request(&builder);
 
   return status;
 }
@@ -202,43 +287,46 @@ bool
 oc_init_put(const char *uri, oc_endpoint_t *endpoint, const char *query,
             oc_response_handler_t handler, oc_qos_t qos, void *user_data)
 {
-  oc_client_handler_t client_handler;
-  client_handler.response = handler;
-
-  oc_client_cb_t *cb = oc_ri_alloc_client_cb(uri, endpoint, OC_PUT, query,
-                                             client_handler, qos, user_data);
-  if (!cb)
+  if (!oc_request_builder_init(&request_builder, OC_PUT, uri, endpoint, query,
+                               handler, qos, user_data)) {
     return false;
+  }
 
-  return prepare_coap_request(cb);
+  if (!oc_request_builder_begin_payload(&request_builder)) {
+    oc_request_builder_discard(&request_builder);
+    return false;
+  }
+  return true;
 }
 
 bool
 oc_init_post(const char *uri, oc_endpoint_t *endpoint, const char *query,
              oc_response_handler_t handler, oc_qos_t qos, void *user_data)
 {
-  oc_client_handler_t client_handler;
-  client_handler.response = handler;
-
-  oc_client_cb_t *cb = oc_ri_alloc_client_cb(uri, endpoint, OC_POST, query,
-                                             client_handler, qos, user_data);
-  if (!cb) {
+  if (!oc_request_builder_init(&request_builder, OC_POST, uri, endpoint, query,
+                               handler, qos, user_data)) {
     return false;
   }
 
-  return prepare_coap_request(cb);
+  if (!oc_request_builder_begin_payload(&request_builder)) {
+    oc_request_builder_discard(&request_builder);
+    return false;
+  }
+  return true;
 }
 
 bool
 oc_do_put(void)
 {
-  return dispatch_coap_request();
+  oc_request_builder_end_payload(&request_builder);
+  return dispatch_coap_request(&request_builder);
 }
 
 bool
 oc_do_post(void)
 {
-  return dispatch_coap_request();
+  oc_request_builder_end_payload(&request_builder);
+  return dispatch_coap_request(&request_builder);
 }
 
 bool
@@ -255,12 +343,11 @@ oc_do_observe(const char *uri, oc_endpoint_t *endpoint, const char *query,
 
   cb->observe_seq = 0;
 
-  bool status = false;
-
-  status = prepare_coap_request(cb);
+  oc_request_builder_t builder;
+  bool status = prepare_coap_request(&builder, cb);
 
   if (status)
-    status = dispatch_coap_request();
+    status = dispatch_coap_request(&builder);
 
   return status;
 }
@@ -276,12 +363,11 @@ oc_stop_observe(const char *uri, oc_endpoint_t *endpoint)
   cb->mid = coap_get_mid();
   cb->observe_seq = 1;
 
-  bool status = false;
-
-  status = prepare_coap_request(cb);
+  oc_request_builder_t builder;
+  bool status = prepare_coap_request(&builder, cb);
 
   if (status)
-    status = dispatch_coap_request();
+    status = dispatch_coap_request(&builder);
 
   return status;
 }
@@ -307,10 +393,11 @@ oc_do_ipv4_discovery(const oc_client_cb_t *ipv6_cb, const char *query,
   memcpy(cb->token, ipv6_cb->token, cb->token_len);
 
   cb->discovery = true;
-  status = prepare_coap_request(cb);
+  oc_request_builder_t builder;
+  status = prepare_coap_request(&builder, cb);
 
   if (status)
-    status = dispatch_coap_request();
+    status = dispatch_coap_request(&builder);
 
   return status;
 }
@@ -342,12 +429,11 @@ oc_do_ip_discovery(const char *rt, oc_discovery_handler_t handler,
 
   cb->discovery = true;
 
-  bool status = false;
-
-  status = prepare_coap_request(cb);
+  oc_request_builder_t builder;
+  bool status = prepare_coap_request(&builder, cb);
 
   if (status)
-    status = dispatch_coap_request();
+    status = dispatch_coap_request(&builder);
 
 #ifdef OC_IPV4
   if (status)
@@ -17,19 +17,27 @@
 #include "oc_collection.h"
 
 #if defined(OC_COLLECTIONS) && defined(OC_SERVER)
+#include "messaging/coap/observe.h"
 #include "oc_api.h"
 #include "oc_core_res.h"
 #include "util/oc_memb.h"
+#ifdef OC_SECURITY
+#include "security/oc_acl.h"
+#endif /* OC_SECURITY */
 
-OC_MEMB(oc_collections_s, oc_collection_t, OC_MAX_NUM_COLLECTIONS);
+OC_MEMB_ZEROED(oc_collections_s, oc_collection_t, OC_MAX_NUM_COLLECTIONS);
 OC_LIST(oc_collections);
-OC_MEMB(oc_links_s, oc_link_t, OC_MAX_APP_RESOURCES);
+OC_MEMB_ZEROED(oc_links_s, oc_link_t, OC_MAX_APP_RESOURCES);
 
 oc_collection_t *
 oc_collection_alloc(void)
 {
   oc_collection_t *collection = oc_memb_alloc(&oc_collections_s);
   if (collection) {
+    collection->observe_period_seconds = 0;
+    collection->num_observers = 0;
+    collection->observers = NULL;
+    collection->lazy_payload = false;
     OC_LIST_STRUCT_INIT(collection, links);
     return collection;
   }
@@ -41,7 +49,14 @@ void
 oc_collection_free(oc_collection_t *collection)
 {
   if (collection != NULL) {
+    while (collection->observers) {
+      coap_remove_observer(collection->observers);
+    }
     oc_list_remove(oc_collections, collection);
+    oc_ri_uri_index_remove((oc_resource_t *)collection);
+#ifdef OC_SECURITY
+    oc_sec_acl_invalidate_cache(collection->device);
+#endif /* OC_SECURITY */
     oc_ri_free_resource_properties((oc_resource_t*)collection);
 
     oc_link_t *link;
@@ -177,10 +192,14 @@ oc_check_if_collection(oc_resource_t *resource)
   return false;
 }
 
-void
+bool
 oc_collection_add(oc_collection_t *collection)
 {
+  if (!oc_ri_uri_index_add((oc_resource_t *)collection)) {
+    return false;
+  }
   oc_list_add(oc_collections, collection);
+  return true;
 }
 
 bool
@@ -428,7 +447,7 @@ oc_handle_collection_request(oc_method_t method, oc_request_t *request,
   int size = oc_rep_finalize();
   size = (size <= 2) ? 0 : size;
 
-  request->response->response_buffer->response_length = (uint16_t)size;
+  request->response->response_buffer->response_length = (uint32_t)size;
   request->response->response_buffer->code = code;
 
   return true;
@@ -363,7 +363,7 @@ oc_core_1_1_discovery_handler(oc_request_t *request,
 
   if (matches && response_length) {
     request->response->response_buffer->response_length =
-      (uint16_t)response_length;
+      (uint32_t)response_length;
     request->response->response_buffer->code = oc_status_code(OC_STATUS_OK);
   } else if (request->origin && (request->origin->flags & MULTICAST) == 0) {
     request->response->response_buffer->code =
@@ -411,7 +411,7 @@ oc_core_discovery_handler(oc_request_t *request, oc_interface_mask_t interface,
   int response_length = oc_rep_finalize();
   if (matches && response_length > 0) {
     request->response->response_buffer->response_length =
-      (uint16_t)response_length;
+      (uint32_t)response_length;
     request->response->response_buffer->code = oc_status_code(OC_STATUS_OK);
   } else if (request->origin && (request->origin->flags & MULTICAST) == 0) {
     request->response->response_buffer->code =
@@ -446,10 +446,12 @@ oc_ri_process_discovery_payload(uint8_t *payload, int len,
   oc_rep_t rep_objects_pool[OC_MAX_NUM_REP_OBJECTS];
   memset(rep_objects_alloc, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(char));
   memset(rep_objects_pool, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(oc_rep_t));
-  struct oc_memb rep_objects = { sizeof(oc_rep_t), OC_MAX_NUM_REP_OBJECTS,
-                                 rep_objects_alloc, (void *)rep_objects_pool };
+  struct oc_memb rep_objects = { .size = sizeof(oc_rep_t),
+                                  .num = OC_MAX_NUM_REP_OBJECTS,
+                                  .count = rep_objects_alloc,
+                                  .mem = (void *)rep_objects_pool };
 #else  /* !OC_DYNAMIC_ALLOCATION */
-  struct oc_memb rep_objects = { sizeof(oc_rep_t), 0, 0, 0 };
+  struct oc_memb rep_objects = { .size = sizeof(oc_rep_t) };
 #endif /* OC_DYNAMIC_ALLOCATION */
   oc_rep_set_pool(&rep_objects);
 
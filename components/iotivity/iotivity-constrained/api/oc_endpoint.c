@@ -16,6 +16,7 @@
 
 #include "oc_endpoint.h"
 #include "oc_core_res.h"
+#include "util/oc_hash.h"
 #include "util/oc_memb.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,7 +32,7 @@
 #define OC_IPV6_ADDRLEN (16)
 #define OC_IPV4_ADDRLEN (4)
 
-OC_MEMB(oc_endpoints_s, oc_endpoint_t, OC_MAX_NUM_ENDPOINTS);
+OC_MEMB_ZEROED(oc_endpoints_s, oc_endpoint_t, OC_MAX_NUM_ENDPOINTS);
 OC_LIST(oc_endpoints);
 
 void
@@ -447,6 +448,27 @@ oc_endpoint_compare_address(oc_endpoint_t *ep1, oc_endpoint_t *ep2)
   return -1;
 }
 
+uint32_t
+oc_endpoint_hash(oc_endpoint_t *endpoint)
+{
+  int flags = endpoint->flags & ~MULTICAST;
+  uint32_t hash = oc_fnv1a(OC_FNV1A_INIT, &flags, sizeof(flags));
+  hash = oc_fnv1a(hash, &endpoint->device, sizeof(endpoint->device));
+  if (endpoint->flags & IPV6) {
+    hash = oc_fnv1a(hash, endpoint->addr.ipv6.address, 16);
+    hash = oc_fnv1a(hash, &endpoint->addr.ipv6.port,
+                    sizeof(endpoint->addr.ipv6.port));
+  }
+#ifdef OC_IPV4
+  else if (endpoint->flags & IPV4) {
+    hash = oc_fnv1a(hash, endpoint->addr.ipv4.address, 4);
+    hash = oc_fnv1a(hash, &endpoint->addr.ipv4.port,
+                    sizeof(endpoint->addr.ipv4.port));
+  }
+#endif /* OC_IPV4 */
+  return hash;
+}
+
 int
 oc_endpoint_compare(oc_endpoint_t *ep1, oc_endpoint_t *ep2)
 {
@@ -123,6 +123,41 @@ oc_get_block_size(void)
 }
 #endif /* OC_DYNAMIC_ALLOCATION */
 
+#include "oc_buffer_settings.h"
+#ifdef OC_BLOCK_WISE
+#include "oc_blockwise.h"
+static uint8_t _OC_BLOCK_WINDOW = 1;
+
+int
+oc_set_block_window(uint8_t num_blocks)
+{
+  if (num_blocks == 0 || num_blocks > OC_BLOCK_WINDOW_MAX)
+    return -1;
+  _OC_BLOCK_WINDOW = num_blocks;
+  return 0;
+}
+
+uint8_t
+oc_get_block_window(void)
+{
+  return _OC_BLOCK_WINDOW;
+}
+#else  /* OC_BLOCK_WISE */
+int
+oc_set_block_window(uint8_t num_blocks)
+{
+  (void)num_blocks;
+  OC_WRN("Block-wise transfers not available\n");
+  return -1;
+}
+
+uint8_t
+oc_get_block_window(void)
+{
+  return 1;
+}
+#endif /* !OC_BLOCK_WISE */
+
 int
 oc_main_init(const oc_handler_t *handler)
 {
@@ -184,6 +219,9 @@ oc_main_poll(void)
   while (oc_process_run()) {
     ticks_until_next_event = oc_etimer_request_poll();
   }
+#ifdef OC_CONNECTIVITY_EVENT_TIMER
+  oc_connectivity_set_event_timer(ticks_until_next_event);
+#endif /* OC_CONNECTIVITY_EVENT_TIMER */
   return ticks_until_next_event;
 }
 
@@ -201,6 +239,10 @@ oc_main_shutdown(void)
 
   oc_network_event_handler_mutex_destroy();
 
+#ifdef OC_SECURITY
+  oc_sec_store_close();
+#endif /* OC_SECURITY */
+
   oc_ri_shutdown();
 
   app_callbacks = NULL;
@@ -20,6 +20,16 @@
 #include "port/oc_connectivity.h"
 #include "util/oc_list.h"
 
+/* Compilers that provide the __atomic builtins use a lock-free handoff
+ * between the network threads and the event loop. Others (or builds that
+ * define OC_NETWORK_EVENTS_USE_MUTEX) fall back to a list guarded by the
+ * port's network event handler mutex.
+ */
+#if !defined(__GNUC__) && !defined(OC_NETWORK_EVENTS_USE_MUTEX)
+#define OC_NETWORK_EVENTS_USE_MUTEX
+#endif
+
+#ifdef OC_NETWORK_EVENTS_USE_MUTEX
 OC_LIST(network_events);
 
 static void
@@ -33,6 +43,36 @@ oc_process_network_event(void)
   }
   oc_network_event_handler_mutex_unlock();
 }
+#else /* OC_NETWORK_EVENTS_USE_MUTEX */
+/* Producers push onto a LIFO stack with a compare-and-swap. The event loop
+ * detaches the whole stack with a single exchange and reverses it, so that
+ * messages are dispatched in arrival order without ever blocking a
+ * network thread.
+ */
+static oc_message_t *network_events;
+
+static void
+oc_process_network_event(void)
+{
+  oc_message_t *head =
+    __atomic_exchange_n(&network_events, NULL, __ATOMIC_ACQUIRE);
+  oc_message_t *batch = NULL, *next;
+
+  while (head != NULL) {
+    next = head->next;
+    head->next = batch;
+    batch = head;
+    head = next;
+  }
+
+  while (batch != NULL) {
+    next = batch->next;
+    batch->next = NULL;
+    oc_recv_message(batch);
+    batch = next;
+  }
+}
+#endif /* !OC_NETWORK_EVENTS_USE_MUTEX */
 
 OC_PROCESS(oc_network_events, "");
 OC_PROCESS_THREAD(oc_network_events, ev, data)
@@ -49,9 +89,17 @@ OC_PROCESS_THREAD(oc_network_events, ev, data)
 void
 oc_network_event(oc_message_t *message)
 {
+#ifdef OC_NETWORK_EVENTS_USE_MUTEX
   oc_network_event_handler_mutex_lock();
   oc_list_add(network_events, message);
   oc_network_event_handler_mutex_unlock();
+#else  /* OC_NETWORK_EVENTS_USE_MUTEX */
+  oc_message_t *head = __atomic_load_n(&network_events, __ATOMIC_RELAXED);
+  do {
+    message->next = head;
+  } while (!__atomic_compare_exchange_n(&network_events, &head, message, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+#endif /* !OC_NETWORK_EVENTS_USE_MUTEX */
 
   oc_process_poll(&(oc_network_events));
   _oc_signal_event_loop();
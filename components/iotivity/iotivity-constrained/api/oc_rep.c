@@ -21,6 +21,9 @@
 #include "util/oc_memb.h"
 
 static struct oc_memb *rep_objects;
+#ifdef OC_DYNAMIC_ALLOCATION
+static oc_arena_t *rep_arena;
+#endif /* OC_DYNAMIC_ALLOCATION */
 static uint8_t *g_buf;
 CborEncoder g_encoder, root_map, links_array;
 CborError g_err;
@@ -31,6 +34,14 @@ oc_rep_set_pool(struct oc_memb *rep_objects_pool)
   rep_objects = rep_objects_pool;
 }
 
+#ifdef OC_DYNAMIC_ALLOCATION
+void
+oc_rep_set_arena(oc_arena_t *arena)
+{
+  rep_arena = arena;
+}
+#endif /* OC_DYNAMIC_ALLOCATION */
+
 void
 oc_rep_new(uint8_t *out_payload, int size)
 {
@@ -61,9 +72,17 @@ oc_rep_finalize(void)
 static oc_rep_t *
 _alloc_rep(void)
 {
-  oc_rep_t *rep = oc_memb_alloc(rep_objects);
-  if (rep != NULL) {
-    rep->name.size = 0;
+  oc_rep_t *rep;
+#ifdef OC_DYNAMIC_ALLOCATION
+  if (rep_arena) {
+    rep = oc_arena_alloc(rep_arena, sizeof(oc_rep_t));
+  } else
+#endif /* OC_DYNAMIC_ALLOCATION */
+  {
+    rep = oc_memb_alloc(rep_objects);
+    if (rep != NULL) {
+      memset(rep, 0, sizeof(oc_rep_t));
+    }
   }
 #ifdef OC_DEBUG
   oc_assert(rep != NULL);
@@ -82,6 +101,11 @@ oc_free_rep(oc_rep_t *rep)
 {
   if (rep == 0)
     return;
+#ifdef OC_DYNAMIC_ALLOCATION
+  /* Trees parsed into an arena are released along with it. */
+  if (rep_arena && oc_arena_owns(rep_arena, rep))
+    return;
+#endif /* OC_DYNAMIC_ALLOCATION */
   oc_free_rep(rep->next);
   switch (rep->type) {
   case OC_REP_BYTE_STRING_ARRAY:
@@ -305,8 +329,8 @@ oc_parse_rep_value(CborValue *value, oc_rep_t **rep, CborError *err)
   }
 }
 
-int
-oc_parse_rep(const uint8_t *in_payload, int payload_size, oc_rep_t **out_rep)
+static int
+parse_rep(const uint8_t *in_payload, int payload_size, oc_rep_t **out_rep)
 {
   CborParser parser;
   CborValue root_value, cur_value, map;
@@ -351,3 +375,184 @@ oc_parse_rep(const uint8_t *in_payload, int payload_size, oc_rep_t **out_rep)
   }
   return err;
 }
+
+int
+oc_parse_rep(const uint8_t *in_payload, int payload_size, oc_rep_t **out_rep)
+{
+#ifdef OC_DYNAMIC_ALLOCATION
+  /* Strings and arrays in the tree come from the same arena as its nodes. */
+  oc_mmem_set_arena(rep_arena);
+#endif /* OC_DYNAMIC_ALLOCATION */
+  int err = parse_rep(in_payload, payload_size, out_rep);
+#ifdef OC_DYNAMIC_ALLOCATION
+  oc_mmem_set_arena(NULL);
+#endif /* OC_DYNAMIC_ALLOCATION */
+  return err;
+}
+
+bool
+oc_rep_cursor_init(oc_rep_cursor_t *cursor, const uint8_t *payload,
+                   int payload_size)
+{
+  if (!payload || payload_size <= 0 ||
+      cbor_parser_init(payload, payload_size, 0, &cursor->parser,
+                       &cursor->value) != CborNoError) {
+    return false;
+  }
+  return cbor_value_is_map(&cursor->value);
+}
+
+static bool
+find_value(const oc_rep_cursor_t *object, const char *key, CborValue *value)
+{
+  if (!cbor_value_is_map(&object->value) ||
+      cbor_value_map_find_value(&object->value, key, value) != CborNoError) {
+    return false;
+  }
+  return cbor_value_is_valid(value);
+}
+
+static bool
+read_int(const CborValue *value, int *out)
+{
+  return cbor_value_is_integer(value) &&
+         cbor_value_get_int(value, out) == CborNoError;
+}
+
+static bool
+read_bool(const CborValue *value, bool *out)
+{
+  return cbor_value_is_boolean(value) &&
+         cbor_value_get_boolean(value, out) == CborNoError;
+}
+
+static bool
+read_double(const CborValue *value, double *out)
+{
+  return cbor_value_is_double(value) &&
+         cbor_value_get_double(value, out) == CborNoError;
+}
+
+static bool
+read_string(const CborValue *value, char *buffer, size_t *size)
+{
+  if (!cbor_value_is_text_string(value) || *size == 0) {
+    return false;
+  }
+  size_t len = *size - 1;
+  if (cbor_value_copy_text_string(value, buffer, &len, NULL) != CborNoError) {
+    return false;
+  }
+  buffer[len] = '\0';
+  *size = len;
+  return true;
+}
+
+bool
+oc_rep_cursor_get_int(const oc_rep_cursor_t *object, const char *key,
+                      int *value)
+{
+  CborValue element;
+  return find_value(object, key, &element) && read_int(&element, value);
+}
+
+bool
+oc_rep_cursor_get_bool(const oc_rep_cursor_t *object, const char *key,
+                       bool *value)
+{
+  CborValue element;
+  return find_value(object, key, &element) && read_bool(&element, value);
+}
+
+bool
+oc_rep_cursor_get_double(const oc_rep_cursor_t *object, const char *key,
+                         double *value)
+{
+  CborValue element;
+  return find_value(object, key, &element) && read_double(&element, value);
+}
+
+bool
+oc_rep_cursor_get_string(const oc_rep_cursor_t *object, const char *key,
+                         char *buffer, size_t *size)
+{
+  CborValue element;
+  return find_value(object, key, &element) &&
+         read_string(&element, buffer, size);
+}
+
+bool
+oc_rep_cursor_get_byte_string(const oc_rep_cursor_t *object, const char *key,
+                              uint8_t *buffer, size_t *size)
+{
+  CborValue element;
+  return find_value(object, key, &element) &&
+         cbor_value_is_byte_string(&element) &&
+         cbor_value_copy_byte_string(&element, buffer, size, NULL) ==
+           CborNoError;
+}
+
+bool
+oc_rep_cursor_get_object(const oc_rep_cursor_t *object, const char *key,
+                         oc_rep_cursor_t *value)
+{
+  return find_value(object, key, &value->value) &&
+         cbor_value_is_map(&value->value);
+}
+
+bool
+oc_rep_cursor_get_array(const oc_rep_cursor_t *object, const char *key,
+                        oc_rep_cursor_t *array)
+{
+  CborValue element;
+  return find_value(object, key, &element) && cbor_value_is_array(&element) &&
+         cbor_value_enter_container(&element, &array->value) == CborNoError;
+}
+
+bool
+oc_rep_cursor_at_end(const oc_rep_cursor_t *array)
+{
+  return cbor_value_at_end(&array->value);
+}
+
+bool
+oc_rep_cursor_advance(oc_rep_cursor_t *array)
+{
+  return !cbor_value_at_end(&array->value) &&
+         cbor_value_advance(&array->value) == CborNoError;
+}
+
+bool
+oc_rep_cursor_read_int(const oc_rep_cursor_t *array, int *value)
+{
+  return read_int(&array->value, value);
+}
+
+bool
+oc_rep_cursor_read_bool(const oc_rep_cursor_t *array, bool *value)
+{
+  return read_bool(&array->value, value);
+}
+
+bool
+oc_rep_cursor_read_double(const oc_rep_cursor_t *array, double *value)
+{
+  return read_double(&array->value, value);
+}
+
+bool
+oc_rep_cursor_read_string(const oc_rep_cursor_t *array, char *buffer,
+                          size_t *size)
+{
+  return read_string(&array->value, buffer, size);
+}
+
+bool
+oc_rep_cursor_read_object(const oc_rep_cursor_t *array, oc_rep_cursor_t *value)
+{
+  if (!cbor_value_is_map(&array->value)) {
+    return false;
+  }
+  value->value = array->value;
+  return true;
+}
@@ -19,6 +19,7 @@
 #include <string.h>
 
 #include "util/oc_etimer.h"
+#include "util/oc_hash.h"
 #include "util/oc_list.h"
 #include "util/oc_memb.h"
 #include "util/oc_process.h"
@@ -53,22 +54,56 @@
 #ifdef OC_SERVER
 OC_LIST(app_resources);
 OC_LIST(observe_callbacks);
-OC_MEMB(app_resources_s, oc_resource_t, OC_MAX_APP_RESOURCES);
+OC_MEMB_ZEROED(app_resources_s, oc_resource_t, OC_MAX_APP_RESOURCES);
+
+/* Application resources and collections are additionally indexed by a hash
+ * of (device, uri) so that request dispatch does not have to walk the
+ * app_resources and collections lists. The number of buckets must be a
+ * power of two.
+ */
+#ifndef OC_URI_INDEX_BUCKETS
+#ifdef OC_DYNAMIC_ALLOCATION
+#define OC_URI_INDEX_BUCKETS (64)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define OC_URI_INDEX_BUCKETS (8)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#endif /* !OC_URI_INDEX_BUCKETS */
+
+#ifdef OC_COLLECTIONS
+#define OC_URI_INDEX_ENTRIES (OC_MAX_APP_RESOURCES + OC_MAX_NUM_COLLECTIONS)
+#else /* OC_COLLECTIONS */
+#define OC_URI_INDEX_ENTRIES (OC_MAX_APP_RESOURCES)
+#endif /* !OC_COLLECTIONS */
+
+typedef struct oc_uri_index_entry_s
+{
+  struct oc_uri_index_entry_s *next;
+  oc_resource_t *resource;
+  uint32_t hash;
+} oc_uri_index_entry_t;
+
+static void *uri_index[OC_URI_INDEX_BUCKETS];
+OC_MEMB_ZEROED(uri_index_s, oc_uri_index_entry_t, OC_URI_INDEX_ENTRIES);
 #endif /* OC_SERVER */
 
 #ifdef OC_CLIENT
 #include "oc_client_state.h"
 OC_LIST(client_cbs);
-OC_MEMB(client_cbs_s, oc_client_cb_t, OC_MAX_NUM_CONCURRENT_REQUESTS);
+OC_MEMB_ZEROED(client_cbs_s, oc_client_cb_t, OC_MAX_NUM_CONCURRENT_REQUESTS);
 #endif /* OC_CLIENT */
 
 OC_LIST(timed_callbacks);
-OC_MEMB(event_callbacks_s, oc_event_callback_t,
-        1 + OCF_D * OC_MAX_NUM_DEVICES + OC_MAX_APP_RESOURCES +
-          OC_MAX_NUM_CONCURRENT_REQUESTS * 2);
+OC_MEMB_ZEROED(event_callbacks_s, oc_event_callback_t,
+               1 + OCF_D * OC_MAX_NUM_DEVICES + OC_MAX_APP_RESOURCES +
+                 OC_MAX_NUM_CONCURRENT_REQUESTS * 2);
 
 OC_PROCESS(timed_callback_events, "OC timed callbacks");
 
+#ifdef OC_DYNAMIC_ALLOCATION
+/* Holds the parsed payload of the request being served. */
+static oc_arena_t request_arena;
+#endif /* OC_DYNAMIC_ALLOCATION */
+
 extern int strncasecmp(const char *s1, const char *s2, size_t n);
 
 static unsigned int oc_coap_status_codes[__NUM_OC_STATUS_CODES__];
@@ -237,28 +272,81 @@ stop_processes(void)
 }
 
 #ifdef OC_SERVER
-oc_resource_t *
-oc_ri_get_app_resource_by_uri(const char *uri, int uri_len, int device)
+/* FNV-1a over the device index and the uri path without its leading '/'. */
+static uint32_t
+uri_index_hash(const char *uri, int uri_len, int device)
 {
-  int skip = 0;
-  if (uri[0] != '/')
-    skip = 1;
-  oc_resource_t *res = oc_ri_get_app_resources();
-  while (res != NULL) {
-    if ((int)oc_string_len(res->uri) == (uri_len + skip) &&
-        strncmp(uri, oc_string(res->uri) + skip, uri_len) == 0 &&
-        res->device == device)
-      return res;
-    res = res->next;
+  uint32_t hash = oc_fnv1a(OC_FNV1A_INIT, &device, sizeof(device));
+  return oc_fnv1a(hash, uri, (size_t)uri_len);
+}
+
+static oc_list_t
+uri_index_bucket(uint32_t hash)
+{
+  return (oc_list_t)&uri_index[hash & (OC_URI_INDEX_BUCKETS - 1)];
+}
+
+bool
+oc_ri_uri_index_add(oc_resource_t *resource)
+{
+  uint32_t hash =
+    uri_index_hash(oc_string(resource->uri) + 1,
+                   (int)oc_string_len(resource->uri) - 1, resource->device);
+  oc_list_t bucket = uri_index_bucket(hash);
+  oc_uri_index_entry_t *entry = oc_list_head(bucket);
+  while (entry != NULL) {
+    if (entry->resource == resource)
+      return true;
+    entry = entry->next;
   }
 
-#ifdef OC_COLLECTIONS
-  if (!res) {
-    res = (oc_resource_t *)oc_get_collection_by_uri(uri, uri_len, device);
+  entry = oc_memb_alloc(&uri_index_s);
+  if (!entry) {
+    OC_WRN("insufficient memory to index resource\n");
+    return false;
   }
-#endif /* OC_COLLECTIONS */
+  entry->resource = resource;
+  entry->hash = hash;
+  oc_list_push(bucket, entry);
+  return true;
+}
+
+void
+oc_ri_uri_index_remove(oc_resource_t *resource)
+{
+  uint32_t hash =
+    uri_index_hash(oc_string(resource->uri) + 1,
+                   (int)oc_string_len(resource->uri) - 1, resource->device);
+  oc_list_t bucket = uri_index_bucket(hash);
+  oc_uri_index_entry_t *entry = oc_list_head(bucket);
+  while (entry != NULL) {
+    if (entry->resource == resource) {
+      oc_list_remove(bucket, entry);
+      oc_memb_free(&uri_index_s, entry);
+      return;
+    }
+    entry = entry->next;
+  }
+}
 
-  return res;
+oc_resource_t *
+oc_ri_get_app_resource_by_uri(const char *uri, int uri_len, int device)
+{
+  if (uri_len > 0 && uri[0] == '/') {
+    uri++;
+    uri_len--;
+  }
+  uint32_t hash = uri_index_hash(uri, uri_len, device);
+  oc_uri_index_entry_t *entry = oc_list_head(uri_index_bucket(hash));
+  while (entry != NULL) {
+    oc_resource_t *res = entry->resource;
+    if (entry->hash == hash && res->device == device &&
+        (int)oc_string_len(res->uri) == (uri_len + 1) &&
+        strncmp(uri, oc_string(res->uri) + 1, uri_len) == 0)
+      return res;
+    entry = entry->next;
+  }
+  return NULL;
 }
 #endif
 
@@ -272,6 +360,7 @@ oc_ri_init(void)
 #ifdef OC_SERVER
   oc_list_init(app_resources);
   oc_list_init(observe_callbacks);
+  memset(uri_index, 0, sizeof(uri_index));
 #endif
 
 #ifdef OC_CLIENT
@@ -293,6 +382,9 @@ oc_ri_shutdown(void)
 {
   oc_random_destroy();
   stop_processes();
+#ifdef OC_DYNAMIC_ALLOCATION
+  oc_arena_release(&request_arena);
+#endif /* OC_DYNAMIC_ALLOCATION */
 }
 
 #ifdef OC_SERVER
@@ -320,7 +412,14 @@ void oc_ri_free_resource_properties(oc_resource_t *resource)
 void
 oc_ri_delete_resource(oc_resource_t *resource)
 {
+  while (resource->observers) {
+    coap_remove_observer(resource->observers);
+  }
   oc_list_remove(app_resources, resource);
+  oc_ri_uri_index_remove(resource);
+#ifdef OC_SECURITY
+  oc_sec_acl_invalidate_cache(resource->device);
+#endif /* OC_SECURITY */
   oc_ri_free_resource_properties(resource);
   oc_memb_free(&app_resources_s, resource);
 }
@@ -338,6 +437,10 @@ oc_ri_add_resource(oc_resource_t *resource)
       resource->observe_period_seconds == 0)
     valid = false;
 
+  if (valid) {
+    valid = oc_ri_uri_index_add(resource);
+  }
+
   if (valid) {
     oc_list_add(app_resources, resource);
   }
@@ -559,6 +662,7 @@ bool
 oc_ri_invoke_coap_entity_handler(void *request, void *response,
                                  oc_blockwise_state_t *request_state,
                                  oc_blockwise_state_t *response_state,
+                                 uint8_t *buffer, uint32_t *encoded_len,
                                  uint16_t block2_size, oc_endpoint_t *endpoint)
 #else  /* OC_BLOCK_WISE */
 bool
@@ -605,11 +709,21 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
 #ifndef OC_SERVER
   (void)block2_size;
 #endif /* !OC_SERVER */
-  response_buffer.buffer = response_state->buffer;
-  response_buffer.buffer_size = (uint16_t)OC_MAX_APP_DATA_SIZE;
+  /* Without a block-wise response buffer, the response is encoded straight
+   * into the outgoing PDU, which has room for OC_MAX_APP_DATA_SIZE bytes.
+   */
+  if (response_state) {
+    response_buffer.buffer =
+      oc_blockwise_reserve(response_state, (uint32_t)OC_MAX_APP_DATA_SIZE);
+    response_buffer.buffer_size =
+      response_buffer.buffer ? (uint32_t)OC_MAX_APP_DATA_SIZE : 0;
+  } else {
+    response_buffer.buffer = buffer;
+    response_buffer.buffer_size = (uint32_t)OC_MAX_APP_DATA_SIZE;
+  }
 #else  /* OC_BLOCK_WISE */
   response_buffer.buffer = buffer;
-  response_buffer.buffer_size = (uint16_t)OC_BLOCK_SIZE;
+  response_buffer.buffer_size = (uint32_t)OC_BLOCK_SIZE;
 #endif /* !OC_BLOCK_WISE */
   response_buffer.code = 0;
   response_buffer.response_length = 0;
@@ -619,6 +733,8 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
 
   request_obj.response = &response_obj;
   request_obj.request_payload = 0;
+  request_obj._payload = 0;
+  request_obj._payload_len = 0;
   request_obj.query = 0;
   request_obj.query_len = 0;
   request_obj.resource = 0;
@@ -664,8 +780,8 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
   int payload_len = 0;
 #ifdef OC_BLOCK_WISE
   if (request_state) {
-    payload = request_state->buffer;
-    payload_len = request_state->payload_size;
+    payload = oc_blockwise_get_payload(request_state);
+    payload_len = payload ? (int)request_state->payload_size : 0;
   }
 #else  /* OC_BLOCK_WISE */
   payload_len = coap_get_payload(request, &payload);
@@ -676,39 +792,24 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
   oc_rep_t rep_objects_pool[OC_MAX_NUM_REP_OBJECTS];
   memset(rep_objects_alloc, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(char));
   memset(rep_objects_pool, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(oc_rep_t));
-  struct oc_memb rep_objects = { sizeof(oc_rep_t), OC_MAX_NUM_REP_OBJECTS,
-                                 rep_objects_alloc, (void *)rep_objects_pool };
+  struct oc_memb rep_objects = { .size = sizeof(oc_rep_t),
+                                  .num = OC_MAX_NUM_REP_OBJECTS,
+                                  .count = rep_objects_alloc,
+                                  .mem = (void *)rep_objects_pool };
 #else  /* !OC_DYNAMIC_ALLOCATION */
-  struct oc_memb rep_objects = { sizeof(oc_rep_t), 0, 0, 0 };
+  struct oc_memb rep_objects = { .size = sizeof(oc_rep_t) };
+  oc_rep_set_arena(&request_arena);
 #endif /* OC_DYNAMIC_ALLOCATION */
   oc_rep_set_pool(&rep_objects);
 
-  if (payload_len > 0) {
-    /* Attempt to parse request payload using tinyCBOR via oc_rep helper
-     * functions. The result of this parse is a tree of oc_rep_t structures
-     * which will reflect the schema of the payload.
-     * Any failures while parsing the payload is viewed as an erroneous
-     * request and results in a 4.00 response being sent.
-     */
-    int parse_error =
-      oc_parse_rep(payload, payload_len, &request_obj.request_payload);
-    if (parse_error != 0) {
-      OC_WRN("ocri: error parsing request payload; tinyCBOR error code:  %d\n",
-             parse_error);
-      if (parse_error == CborErrorUnexpectedEOF)
-        entity_too_large = true;
-      bad_request = true;
-    }
-  }
-
   oc_resource_t *resource, *cur_resource = NULL;
 
-  /* If there were no errors thus far, attempt to locate the specific
-   * resource object that will handle the request using the request uri.
+  /* Attempt to locate the specific resource object that will handle the
+   * request using the request uri.
    */
   /* Check against list of declared core resources.
    */
-  if (!bad_request) {
+  {
     int i;
     for (i = 0; i < OC_NUM_CORE_RESOURCES_PER_DEVICE; i++) {
       resource = oc_core_get_resource_by_index(i, endpoint->device);
@@ -724,7 +825,7 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
 #ifdef OC_SERVER
   /* Check against list of declared application resources.
    */
-  if (!cur_resource && !bad_request) {
+  if (!cur_resource) {
     request_obj.resource = cur_resource =
       oc_ri_get_app_resource_by_uri(uri_path, uri_path_len, endpoint->device);
 
@@ -736,7 +837,45 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
   }
 #endif /* OC_SERVER */
 
-  if (cur_resource) {
+  if (payload_len > 0) {
+    int parse_error;
+    if (cur_resource
+#if defined(OC_COLLECTIONS) && defined(OC_SERVER)
+        && !resource_is_collection
+#endif /* OC_COLLECTIONS && OC_SERVER */
+        && cur_resource->lazy_payload) {
+      /* The resource's handlers read the payload in place, so only check
+       * that it is well-formed.
+       */
+      CborParser parser;
+      CborValue root;
+      parse_error = cbor_parser_init(payload, payload_len, 0, &parser, &root);
+      if (parse_error == CborNoError) {
+        parse_error = cbor_value_validate_basic(&root);
+      }
+      request_obj._payload = payload;
+      request_obj._payload_len = payload_len;
+    } else {
+      /* Attempt to parse request payload using tinyCBOR via oc_rep helper
+       * functions. The result of this parse is a tree of oc_rep_t
+       * structures which will reflect the schema of the payload.
+       */
+      parse_error =
+        oc_parse_rep(payload, payload_len, &request_obj.request_payload);
+    }
+    /* Any failures while parsing the payload is viewed as an erroneous
+     * request and results in a 4.00 response being sent.
+     */
+    if (parse_error != 0) {
+      OC_WRN("ocri: error parsing request payload; tinyCBOR error code:  %d\n",
+             parse_error);
+      if (parse_error == CborErrorUnexpectedEOF)
+        entity_too_large = true;
+      bad_request = true;
+    }
+  }
+
+  if (cur_resource && !bad_request) {
     /* If there was no interface selection, pick the "default interface". */
     if (interface == 0)
       interface = cur_resource->default_interface;
@@ -811,6 +950,10 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
      */
     oc_free_rep(request_obj.request_payload);
   }
+#ifdef OC_DYNAMIC_ALLOCATION
+  oc_rep_set_arena(NULL);
+  oc_arena_reset(&request_arena);
+#endif /* OC_DYNAMIC_ALLOCATION */
 
   if (forbidden) {
     OC_WRN("ocri: Forbidden request\n");
@@ -957,13 +1100,25 @@ oc_ri_invoke_coap_entity_handler(void *request, void *response, uint8_t *buffer,
                                            &oc_observe_notification_delayed, 0);
 
 #endif /* OC_SERVER */
+#ifdef OC_BLOCK_WISE
+    if (response_state) {
+      oc_blockwise_commit(response_state, response_buffer.response_length);
+    }
+#endif /* OC_BLOCK_WISE */
     if (response_buffer.response_length > 0) {
 #ifdef OC_BLOCK_WISE
-      response_state->payload_size = response_buffer.response_length;
-#else  /* OC_BLOCK_WISE */
-      coap_set_payload(response, response_buffer.buffer,
-                       response_buffer.response_length);
-#endif /* !OC_BLOCK_WISE */
+      if (response_state) {
+        response_state->payload_size = response_buffer.response_length;
+      } else
+#endif /* OC_BLOCK_WISE */
+      {
+        coap_set_payload(response, response_buffer.buffer,
+                         response_buffer.response_length);
+#ifdef OC_BLOCK_WISE
+        /* The payload set above is cut at one block. */
+        *encoded_len = response_buffer.response_length;
+#endif /* OC_BLOCK_WISE */
+      }
       if (endpoint->version == OIC_VER_1_1_0) {
         coap_set_header_content_format(response, APPLICATION_CBOR);
       } else {
@@ -1102,8 +1257,8 @@ oc_ri_invoke_client_cb(void *response, oc_client_cb_t *cb,
 */
 #ifdef OC_BLOCK_WISE
   if (response_state) {
-    payload = (*response_state)->buffer;
-    payload_len = (*response_state)->payload_size;
+    payload = (uint8_t *)oc_blockwise_get_payload(*response_state);
+    payload_len = payload ? (int)(*response_state)->payload_size : 0;
   }
 #else /* OC_BLOCK_WISE */
   payload_len = coap_get_payload(response, (const uint8_t **)&payload);
@@ -1114,10 +1269,12 @@ oc_ri_invoke_client_cb(void *response, oc_client_cb_t *cb,
   oc_rep_t rep_objects_pool[OC_MAX_NUM_REP_OBJECTS];
   memset(rep_objects_alloc, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(char));
   memset(rep_objects_pool, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(oc_rep_t));
-  struct oc_memb rep_objects = { sizeof(oc_rep_t), OC_MAX_NUM_REP_OBJECTS,
-                                 rep_objects_alloc, (void *)rep_objects_pool };
+  struct oc_memb rep_objects = { .size = sizeof(oc_rep_t),
+                                  .num = OC_MAX_NUM_REP_OBJECTS,
+                                  .count = rep_objects_alloc,
+                                  .mem = (void *)rep_objects_pool };
 #else  /* !OC_DYNAMIC_ALLOCATION */
-  struct oc_memb rep_objects = { sizeof(oc_rep_t), 0, 0, 0 };
+  struct oc_memb rep_objects = { .size = sizeof(oc_rep_t) };
 #endif /* OC_DYNAMIC_ALLOCATION */
   oc_rep_set_pool(&rep_objects);
 
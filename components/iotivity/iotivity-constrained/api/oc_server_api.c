@@ -29,6 +29,10 @@
 
 #include "oc_core_res.h"
 
+#ifdef OC_SECURITY
+#include "security/oc_acl.h"
+#endif /* OC_SECURITY */
+
 static int query_iterator;
 
 int
@@ -57,6 +61,12 @@ oc_get_query_value(oc_request_t *request, const char *key, char **value)
   return oc_ri_get_query_value(request->query, request->query_len, key, value);
 }
 
+bool
+oc_get_request_cursor(oc_request_t *request, oc_rep_cursor_t *cursor)
+{
+  return oc_rep_cursor_init(cursor, request->_payload, request->_payload_len);
+}
+
 static int
 response_length(void)
 {
@@ -68,7 +78,7 @@ void
 oc_send_response(oc_request_t *request, oc_status_t response_code)
 {
   request->response->response_buffer->response_length =
-    (uint16_t)response_length();
+    (uint32_t)response_length();
   request->response->response_buffer->code = oc_status_code(response_code);
 }
 
@@ -172,6 +182,7 @@ oc_new_resource(const char *name, const char *uri, uint8_t num_resource_types,
     resource->default_interface = OC_IF_BASELINE;
     resource->observe_period_seconds = 0;
     resource->num_observers = 0;
+    resource->observers = NULL;
     oc_populate_resource_object(resource, name, uri, num_resource_types,
                                 device);
   }
@@ -199,11 +210,11 @@ oc_delete_collection(oc_resource_t *collection)
   oc_collection_free((oc_collection_t*)collection);
 }
 
-void
+bool
 oc_add_collection(oc_resource_t *collection)
 {
   oc_resource_set_observable(collection, false);
-  oc_collection_add((oc_collection_t *)collection);
+  return oc_collection_add((oc_collection_t *)collection);
 }
 
 oc_resource_t *
@@ -213,10 +224,23 @@ oc_collection_get_collections(void)
 }
 #endif /* OC_COLLECTIONS */
 
+/* ACEs match resources by their types, interfaces and discoverability, so
+   changing any of these invalidates the permissions cached for the device. */
+static void
+invalidate_acl_cache(oc_resource_t *resource)
+{
+#ifdef OC_SECURITY
+  oc_sec_acl_invalidate_cache(resource->device);
+#else  /* OC_SECURITY */
+  (void)resource;
+#endif /* !OC_SECURITY */
+}
+
 void
 oc_resource_bind_resource_interface(oc_resource_t *resource, uint8_t interface)
 {
   resource->interfaces |= interface;
+  invalidate_acl_cache(resource);
 }
 
 void
@@ -230,6 +254,7 @@ void
 oc_resource_bind_resource_type(oc_resource_t *resource, const char *type)
 {
   oc_string_array_add_item(resource->types, (char *)type);
+  invalidate_acl_cache(resource);
 }
 
 #ifdef OC_SECURITY
@@ -247,6 +272,7 @@ oc_resource_set_discoverable(oc_resource_t *resource, bool state)
     resource->properties |= OC_DISCOVERABLE;
   else
     resource->properties &= ~OC_DISCOVERABLE;
+  invalidate_acl_cache(resource);
 }
 
 void
@@ -265,6 +291,18 @@ oc_resource_set_periodic_observable(oc_resource_t *resource, uint16_t seconds)
   resource->observe_period_seconds = seconds;
 }
 
+void
+oc_resource_set_lazy_payload(oc_resource_t *resource, bool state)
+{
+#if defined(OC_COLLECTIONS) && defined(OC_SERVER)
+  if (oc_check_if_collection(resource)) {
+    OC_WRN("lazy payloads are not supported by collections\n");
+    return;
+  }
+#endif /* OC_COLLECTIONS && OC_SERVER */
+  resource->lazy_payload = state;
+}
+
 void
 oc_resource_set_request_handler(oc_resource_t *resource, oc_method_t method,
                                 oc_request_callback_t callback, void *user_data)
@@ -339,7 +377,7 @@ oc_send_separate_response(oc_separate_response_t *handle,
 {
   oc_response_buffer_t response_buffer;
   response_buffer.buffer = handle->buffer;
-  response_buffer.response_length = (uint16_t)response_length();
+  response_buffer.response_length = (uint32_t)response_length();
   response_buffer.code = oc_status_code(response_code);
 
   coap_separate_t *cur = oc_list_head(handle->requests), *next = NULL;
@@ -378,8 +416,11 @@ oc_send_separate_response(oc_separate_response_t *handle,
             goto clear_separate_store;
           }
 
-          memcpy(response_state->buffer, response_buffer.buffer,
-                 response_buffer.response_length);
+          if (!oc_blockwise_write(response_state, 0, response_buffer.buffer,
+                                  response_buffer.response_length)) {
+            oc_blockwise_release_response_buffer(response_state);
+            goto clear_separate_store;
+          }
           response_state->payload_size = response_buffer.response_length;
 
           uint16_t payload_size = 0;
@@ -431,4 +472,10 @@ oc_notify_observers(oc_resource_t *resource)
 {
   return coap_notify_observers(resource, NULL, NULL);
 }
+
+int
+oc_get_num_observers(oc_resource_t *resource)
+{
+  return resource->num_observers;
+}
 #endif /* OC_SERVER */
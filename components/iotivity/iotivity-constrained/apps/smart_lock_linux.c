@@ -40,7 +40,7 @@ typedef struct oc_smartlock_t
 } oc_smartlock_t;
 
 OC_LIST(smartlocks);
-OC_MEMB(smartlocks_m, oc_smartlock_t, 100);
+OC_MEMB_ZEROED(smartlocks_m, oc_smartlock_t, 100);
 
 static void
 free_smart_lock(oc_smartlock_t *lock)
@@ -220,10 +220,12 @@ oc_link_t * oc_collection_get_links(oc_resource_t* collection);
   @param collection Collection to add to the list of collections.
    Must not be NULL. Must not be added twice or a list corruption
    will occur. The collection is not copied.
+  @return false if the collection could not be indexed by its URI, in
+   which case it has not been added.
   @see oc_set_discoverable
   @see oc_new_collection
 */
-void oc_add_collection(oc_resource_t *collection);
+bool oc_add_collection(oc_resource_t *collection);
 
 /**
   @brief Gets all known collections.
@@ -246,6 +248,17 @@ void oc_resource_set_request_handler(oc_resource_t *resource,
                                      oc_method_t method,
                                      oc_request_callback_t callback,
                                      void *user_data);
+/**
+  @brief Leaves request payloads to the resource's handlers.
+
+  Requests to the resource are handed over without building an \c oc_rep_t
+  tree, so \c request_payload is NULL. Handlers read the payload in place
+  through \c oc_get_request_cursor(), which decodes values only as they are
+  looked up and does not allocate. Requests relayed through a collection's
+  batch interface still arrive as an \c oc_rep_t tree, and collections
+  themselves cannot be set to take lazy payloads.
+*/
+void oc_resource_set_lazy_payload(oc_resource_t *resource, bool state);
 bool oc_add_resource(oc_resource_t *resource);
 void oc_delete_resource(oc_resource_t *resource);
 
@@ -293,6 +306,7 @@ int oc_iterate_query(oc_request_t *request, char **key, int *key_len,
 bool oc_iterate_query_get_values(oc_request_t *request, const char *key,
                                  char **value, int *value_len);
 int oc_get_query_value(oc_request_t *request, const char *key, char **value);
+bool oc_get_request_cursor(oc_request_t *request, oc_rep_cursor_t *cursor);
 
 void oc_send_response(oc_request_t *request, oc_status_t response_code);
 void oc_ignore_request(oc_request_t *request);
@@ -304,6 +318,7 @@ void oc_send_separate_response(oc_separate_response_t *handle,
                                oc_status_t response_code);
 
 int oc_notify_observers(oc_resource_t *resource);
+int oc_get_num_observers(oc_resource_t *resource);
 
 /** Client side */
 #include "oc_client_state.h"
@@ -327,6 +342,34 @@ bool oc_init_post(const char *uri, oc_endpoint_t *endpoint, const char *query,
 
 bool oc_do_post(void);
 
+/**
+ * A client request that is prepared, given a payload and dispatched through
+ * its own handle. Each builder owns its client callback, transaction and
+ * payload buffer, so any number of requests can be in preparation at once.
+ * The payload of a builder is written with the oc_rep_* macros between
+ * oc_request_builder_begin_payload() and oc_request_builder_end_payload(),
+ * one builder at a time.
+ */
+typedef struct
+{
+  oc_client_cb_t *cb;
+  struct coap_transaction *transaction;
+#ifdef OC_BLOCK_WISE
+  oc_blockwise_state_t *request_buffer;
+#endif /* OC_BLOCK_WISE */
+  int payload_size;
+} oc_request_builder_t;
+
+bool oc_request_builder_init(oc_request_builder_t *builder, oc_method_t method,
+                             const char *uri, oc_endpoint_t *endpoint,
+                             const char *query, oc_response_handler_t handler,
+                             oc_qos_t qos, void *user_data);
+bool oc_request_builder_begin_payload(oc_request_builder_t *builder);
+bool oc_request_builder_end_payload(oc_request_builder_t *builder);
+bool oc_request_builder_dispatch(oc_request_builder_t *builder);
+/* Releases a builder that was initialized but will not be dispatched. */
+void oc_request_builder_discard(oc_request_builder_t *builder);
+
 bool oc_do_observe(const char *uri, oc_endpoint_t *endpoint, const char *query,
                    oc_response_handler_t handler, oc_qos_t qos,
                    void *user_data);
@@ -23,14 +23,43 @@
 #include "oc_ri.h"
 #include "port/oc_connectivity.h"
 
+/* Largest number of Block2 requests a client keeps in flight during a
+   windowed transfer (see oc_set_block_window()) */
+#define OC_BLOCK_WINDOW_MAX (32)
+
 typedef enum {
   OC_BLOCKWISE_CLIENT = 0,
   OC_BLOCKWISE_SERVER
 } oc_blockwise_role_t;
 
-typedef struct oc_blockwise_state_s
+#ifdef OC_DYNAMIC_ALLOCATION
+/* A payload is held in a chain of segments sorted by offset. Blocks that
+   arrive from a peer are stored in segments of segment_size bytes, which are
+   allocated as they are first written to. A payload encoded locally is
+   held in a single segment trimmed to its length. */
+typedef struct oc_blockwise_segment_s
+{
+  struct oc_blockwise_segment_s *next;
+  uint32_t offset;
+  uint32_t size;
+  uint8_t data[];
+} oc_blockwise_segment_t;
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+/* Links a block-wise state into one of the index buckets or the release
+   queue; pprev points to the previous state's next pointer (or the bucket)
+   for O(1) removal, and is NULL while the state is not linked. */
+typedef struct oc_blockwise_link_s
 {
   struct oc_blockwise_state_s *next;
+  struct oc_blockwise_state_s **pprev;
+} oc_blockwise_link_t;
+
+typedef struct oc_blockwise_state_s
+{
+  oc_blockwise_link_t key_link;     /* states with the same key hash */
+  oc_blockwise_link_t release_link; /* states released since the last scrub */
+  uint32_t key_hash; /* of href, endpoint, method and role */
   oc_string_t href;
   oc_endpoint_t endpoint;
   oc_method_t method;
@@ -39,12 +68,22 @@ typedef struct oc_blockwise_state_s
   uint32_t next_block_offset;
   uint8_t ref_count;
 #ifdef OC_DYNAMIC_ALLOCATION
-  uint8_t *buffer;
+  oc_blockwise_segment_t *segments;
+  oc_blockwise_segment_t *cursor; /* the segment last accessed */
+  uint16_t segment_size;
+  /* Set by oc_blockwise_adopt() for a payload that stays in the message it
+     was encoded into, in place of segments */
+  oc_message_t *message;
+  const uint8_t *message_payload;
 #else  /* OC_DYNAMIC_ALLOCATION */
   uint8_t buffer[OC_MAX_APP_DATA_SIZE];
 #endif /* !OC_DYNAMIC_ALLOCATION */
   oc_string_t uri_query;
 #ifdef OC_CLIENT
+  /* Set with oc_blockwise_set_*_mid() and oc_blockwise_set_*_client_cb(),
+     which keep the states indexed by them */
+  oc_blockwise_link_t mid_link;
+  oc_blockwise_link_t client_cb_link;
   uint16_t mid;
   void *client_cb;
 #endif /* OC_CLIENT */
@@ -59,9 +98,25 @@ typedef struct oc_blockwise_response_state_s
 {
   oc_blockwise_state_t base;
   uint8_t etag[COAP_ETAG_LEN];
+  /* Server: blocks_served has bit i set when block (served_end - 1 - i) was
+     dispatched, so that a buffer is kept until every block went out even if
+     a client asked for them out of order. */
+  uint32_t served_end;
+  uint32_t blocks_served;
 
 #ifdef OC_CLIENT
   int32_t observe_seq;
+  /* Client: body_size is the Size2 of a windowed transfer and 0 for a
+     transfer that requests one block at a time. blocks_ahead has bit i set
+     when the i-th block past next_block_offset has been received.
+     window_mids holds the mid of the request for each block in flight,
+     indexed by block number modulo OC_BLOCK_WINDOW_MAX, and resent_block_num
+     is the last missing block whose request was resent early. */
+  uint32_t body_size;
+  uint32_t next_block_num;
+  uint32_t blocks_ahead;
+  uint16_t window_mids[OC_BLOCK_WINDOW_MAX];
+  uint32_t resent_block_num;
 #endif /* OC_CLIENT */
 } oc_blockwise_response_state_t;
 
@@ -95,6 +150,38 @@ void oc_blockwise_free_request_buffer(oc_blockwise_state_t *buffer);
 
 void oc_blockwise_free_response_buffer(oc_blockwise_state_t *buffer);
 
+void oc_blockwise_release_request_buffer(oc_blockwise_state_t *buffer);
+
+void oc_blockwise_release_response_buffer(oc_blockwise_state_t *buffer);
+
+void oc_blockwise_retain(oc_blockwise_state_t *buffer);
+
+#ifdef OC_CLIENT
+void oc_blockwise_set_request_mid(oc_blockwise_state_t *buffer, uint16_t mid);
+
+void oc_blockwise_set_response_mid(oc_blockwise_state_t *buffer, uint16_t mid);
+
+void oc_blockwise_set_request_client_cb(oc_blockwise_state_t *buffer,
+                                        void *client_cb);
+
+void oc_blockwise_set_response_client_cb(oc_blockwise_state_t *buffer,
+                                         void *client_cb);
+#endif /* OC_CLIENT */
+
+uint8_t *oc_blockwise_reserve(oc_blockwise_state_t *buffer, uint32_t size);
+
+void oc_blockwise_commit(oc_blockwise_state_t *buffer, uint32_t length);
+
+#ifdef OC_DYNAMIC_ALLOCATION
+void oc_blockwise_adopt(oc_blockwise_state_t *buffer, oc_message_t *message,
+                        const uint8_t *payload, uint32_t length);
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+bool oc_blockwise_write(oc_blockwise_state_t *buffer, uint32_t offset,
+                        const uint8_t *data, uint32_t length);
+
+const uint8_t *oc_blockwise_get_payload(oc_blockwise_state_t *buffer);
+
 const void *oc_blockwise_dispatch_block(oc_blockwise_state_t *buffer,
                                         uint32_t block_offset,
                                         uint16_t requested_block_size,
@@ -105,6 +192,16 @@ bool oc_blockwise_handle_block(oc_blockwise_state_t *buffer,
                                const uint8_t *incoming_block,
                                uint16_t incoming_block_size);
 
+#ifdef OC_CLIENT
+bool oc_blockwise_handle_window_block(oc_blockwise_state_t *buffer,
+                                      uint32_t block_num, uint16_t block_size,
+                                      const uint8_t *incoming_block,
+                                      uint16_t incoming_block_size);
+#endif /* OC_CLIENT */
+
+bool oc_blockwise_block_served(oc_blockwise_state_t *buffer,
+                               uint32_t block_num, uint16_t block_size);
+
 void oc_blockwise_scrub_buffers();
 
 void oc_blockwise_scrub_buffers_for_client_cb(void *cb);
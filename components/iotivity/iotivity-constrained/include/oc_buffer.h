@@ -23,10 +23,42 @@
 
 OC_PROCESS_NAME(message_buffer_handler);
 oc_message_t *oc_allocate_message(void);
+/* Allocates a message with room for an empty or token-only CoAP message
+   (ACK/RST) only. */
+oc_message_t *oc_allocate_small_message(void);
+#ifdef OC_DYNAMIC_ALLOCATION
+/* Allocates a message with room for a CoAP header followed by
+   OC_MAX_APP_DATA_SIZE bytes of payload. The last one freed is kept for
+   reuse; the others come from and go back to the heap. */
+oc_message_t *oc_allocate_large_message(void);
+#endif /* OC_DYNAMIC_ALLOCATION */
 void oc_message_add_ref(oc_message_t *message);
 void oc_message_unref(oc_message_t *message);
 
 void oc_recv_message(oc_message_t *message);
 void oc_send_message(oc_message_t *message);
 
+/* Builds with dynamic allocation whose compiler has the __atomic builtins
+   take messages from the size class pools in oc_buffer.c. */
+#if defined(OC_DYNAMIC_ALLOCATION) && defined(__GNUC__)
+#define OC_MESSAGE_POOL
+
+typedef enum {
+  OC_MESSAGE_SMALL = 0,
+  OC_MESSAGE_FULL,
+  OC_MESSAGE_NUM_SIZE_CLASSES
+} oc_message_size_class_t;
+
+typedef struct
+{
+  uint32_t in_use;         /* messages currently allocated */
+  uint32_t high_water;     /* highest value in_use has reached */
+  uint32_t capacity;       /* pooled blocks taken from the heap so far */
+  uint32_t heap_fallbacks; /* allocations that could not be pooled */
+} oc_message_pool_stats_t;
+
+void oc_message_pool_get_stats(oc_message_size_class_t size_class,
+                               oc_message_pool_stats_t *stats);
+#endif /* OC_MESSAGE_POOL */
+
 #endif /* OC_BUFFER_H */
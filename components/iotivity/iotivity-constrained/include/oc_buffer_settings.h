@@ -17,9 +17,15 @@
 #ifndef OC_BUFFER_SETTINGS_H
 #define OC_BUFFER_SETTINGS_H
 
+#include <stdint.h>
+
 int oc_set_mtu_size(long mtu_size);
 long oc_get_mtu_size(void);
 void oc_set_max_app_data_size(long size);
 long oc_get_max_app_data_size(void);
 long oc_get_block_size(void);
+/* Number of Block2 requests a client keeps in flight while it downloads a
+   block-wise response (1 to OC_BLOCK_WINDOW_MAX, default 1) */
+int oc_set_block_window(uint8_t num_blocks);
+uint8_t oc_get_block_window(void);
 #endif /* OC_BUFFER_SETTINGS_H */
@@ -42,6 +42,12 @@ struct oc_collection_s
   oc_request_handler_t put_handler;
   oc_request_handler_t post_handler;
   oc_request_handler_t delete_handler;
+  /* Collections are handled as resources, the fields above and these must
+     match oc_resource_s. */
+  uint16_t observe_period_seconds;
+  uint16_t num_observers;
+  struct coap_observer *observers;
+  bool lazy_payload;
   OC_LIST_STRUCT(links);
 };
 
@@ -56,6 +62,6 @@ oc_collection_t *oc_collection_get_all(void);
 oc_link_t *oc_get_link_by_uri(oc_collection_t *collection, const char *uri_path, int uri_path_len);
 
 bool oc_check_if_collection(oc_resource_t *resource);
-void oc_collection_add(oc_collection_t *collection);
+bool oc_collection_add(oc_collection_t *collection);
 
 #endif /* OC_COLLECTION_H */
@@ -32,5 +32,7 @@ int oc_string_to_endpoint(oc_string_t *endpoint_str, oc_endpoint_t *endpoint,
 int oc_ipv6_endpoint_is_link_local(oc_endpoint_t *endpoint);
 int oc_endpoint_compare(oc_endpoint_t *ep1, oc_endpoint_t *ep2);
 int oc_endpoint_compare_address(oc_endpoint_t *ep1, oc_endpoint_t *ep2);
+/* Hash over the fields compared by oc_endpoint_compare(). */
+uint32_t oc_endpoint_hash(oc_endpoint_t *endpoint);
 
 #endif /* OC_ENDPOINT_H */
@@ -232,10 +232,62 @@ typedef struct oc_rep_s
 } oc_rep_t;
 
 void oc_rep_set_pool(struct oc_memb *rep_objects_pool);
+#ifdef OC_DYNAMIC_ALLOCATION
+/* While an arena is set, parsed trees are allocated from it in place of the
+   pool, and oc_free_rep() leaves them to be released with the arena. Only
+   the parser draws from the arena; strings and arrays created elsewhere with
+   oc_new_string() and the array helpers may outlive the request, and still
+   come from the heap. */
+void oc_rep_set_arena(oc_arena_t *arena);
+#endif /* OC_DYNAMIC_ALLOCATION */
 
 int oc_parse_rep(const uint8_t *payload, int payload_size,
                  oc_rep_t **value_list);
 
 void oc_free_rep(oc_rep_t *rep);
 
+/* A cursor reads values straight out of an encoded payload, decoding them
+ * only when they are looked up. An object cursor looks up values by key; an
+ * array cursor reads the element it is positioned at and is moved along
+ * with oc_rep_cursor_advance(). Cursors obtained from another cursor refer
+ * to the parser held by the cursor the payload was opened with, and are
+ * valid for as long as it is.
+ */
+typedef struct
+{
+  CborParser parser;
+  CborValue value;
+} oc_rep_cursor_t;
+
+bool oc_rep_cursor_init(oc_rep_cursor_t *cursor, const uint8_t *payload,
+                        int payload_size);
+
+bool oc_rep_cursor_get_int(const oc_rep_cursor_t *object, const char *key,
+                           int *value);
+bool oc_rep_cursor_get_bool(const oc_rep_cursor_t *object, const char *key,
+                            bool *value);
+bool oc_rep_cursor_get_double(const oc_rep_cursor_t *object, const char *key,
+                              double *value);
+/* Copies a string into buffer, which is NUL terminated. On input *size is
+   the size of buffer, on output the length of the string. */
+bool oc_rep_cursor_get_string(const oc_rep_cursor_t *object, const char *key,
+                              char *buffer, size_t *size);
+bool oc_rep_cursor_get_byte_string(const oc_rep_cursor_t *object,
+                                   const char *key, uint8_t *buffer,
+                                   size_t *size);
+bool oc_rep_cursor_get_object(const oc_rep_cursor_t *object, const char *key,
+                              oc_rep_cursor_t *value);
+bool oc_rep_cursor_get_array(const oc_rep_cursor_t *object, const char *key,
+                             oc_rep_cursor_t *array);
+
+bool oc_rep_cursor_at_end(const oc_rep_cursor_t *array);
+bool oc_rep_cursor_advance(oc_rep_cursor_t *array);
+bool oc_rep_cursor_read_int(const oc_rep_cursor_t *array, int *value);
+bool oc_rep_cursor_read_bool(const oc_rep_cursor_t *array, bool *value);
+bool oc_rep_cursor_read_double(const oc_rep_cursor_t *array, double *value);
+bool oc_rep_cursor_read_string(const oc_rep_cursor_t *array, char *buffer,
+                               size_t *size);
+bool oc_rep_cursor_read_object(const oc_rep_cursor_t *array,
+                               oc_rep_cursor_t *value);
+
 #endif /* OC_REP_H */
@@ -103,6 +103,8 @@ typedef struct
   const char *query;
   int query_len;
   oc_rep_t *request_payload;
+  const uint8_t *_payload;
+  int _payload_len;
   oc_response_t *response;
 } oc_request_t;
 
@@ -115,6 +117,8 @@ typedef struct oc_request_handler_s
   void *user_data;
 } oc_request_handler_t;
 
+struct coap_observer;
+
 struct oc_resource_s
 {
   struct oc_resource_s *next;
@@ -130,7 +134,9 @@ struct oc_resource_s
   oc_request_handler_t post_handler;
   oc_request_handler_t delete_handler;
   uint16_t observe_period_seconds;
-  uint8_t num_observers;
+  uint16_t num_observers;
+  struct coap_observer *observers;
+  bool lazy_payload;
 };
 
 typedef struct oc_link_s oc_link_t;
@@ -181,6 +187,8 @@ oc_resource_t *oc_ri_alloc_resource(void);
 bool oc_ri_add_resource(oc_resource_t *resource);
 void oc_ri_delete_resource(oc_resource_t *resource);
 void oc_ri_free_resource_properties(oc_resource_t *resource);
+bool oc_ri_uri_index_add(oc_resource_t *resource);
+void oc_ri_uri_index_remove(oc_resource_t *resource);
 
 #ifdef OC_MAX_NUM_COLLECTIONS
 #define OC_COLLECTIONS
@@ -600,63 +600,6 @@ static coap_status_t coap_parse_message_common(void *packet,
 }
 /*---------------------------------------------------------------------------*/
 #ifdef OC_TCP
-static void coap_tcp_serialize_length(void *packet, size_t option_length,
-                                      uint8_t *num_extended_length_bytes)
-{
-  coap_packet_t *const coap_pkt = (coap_packet_t *) packet;
-  uint8_t len = 0;
-  size_t extended_len = 0;
-
-  size_t total_length = option_length;
-  if (coap_pkt->payload && coap_pkt->payload_len > 0) {
-    total_length += COAP_PAYLOAD_MARKER_LEN + coap_pkt->payload_len;
-  }
-
-  if (total_length < COAP_TCP_EXTENDED_LENGTH_1_DEFAULT_LEN) {
-    OC_DBG("-TCP Len < COAP_TCP_EXTENDED_LENGTH_1_DEFAULT_LEN(%d) \n",
-            COAP_TCP_EXTENDED_LENGTH_1_DEFAULT_LEN);
-    len = total_length;
-    goto exit;
-  }
-
-  len = COAP_TCP_EXTENDED_LENGTH_1_DEFAULT_LEN;
-  *num_extended_length_bytes = 1;
-
-  if (total_length < COAP_TCP_EXTENDED_LENGTH_2_DEFAULT_LEN) {
-    extended_len = total_length - COAP_TCP_EXTENDED_LENGTH_1_DEFAULT_LEN;
-    OC_DBG("-TCP Len < COAP_TCP_EXTENDED_LENGTH_2_DEFAULT_LEN(%d) \n",
-            COAP_TCP_EXTENDED_LENGTH_2_DEFAULT_LEN);
-    goto exit;
-  }
-
-  len += 1;
-  *num_extended_length_bytes <<= 1;
-
-  if (total_length < COAP_TCP_EXTENDED_LENGTH_3_DEFAULT_LEN) {
-    extended_len = total_length - COAP_TCP_EXTENDED_LENGTH_2_DEFAULT_LEN;
-    OC_DBG("-TCP Len < COAP_TCP_EXTENDED_LENGTH_3_DEFAULT_LEN(%d) \n",
-            COAP_TCP_EXTENDED_LENGTH_3_DEFAULT_LEN);
-    goto exit;
-  }
-
-  len += 1;
-  *num_extended_length_bytes <<= 1;
-  extended_len = total_length - COAP_TCP_EXTENDED_LENGTH_3_DEFAULT_LEN;
-
-exit:
-  coap_pkt->buffer[0] = 0x00;
-  coap_pkt->buffer[0] |=
-    COAP_TCP_HEADER_LEN_MASK & (len) << COAP_TCP_HEADER_LEN_POSITION;
-
-  int i = 0;
-  for (i = 1; i <= *num_extended_length_bytes; i++) {
-    coap_pkt->buffer[i] = (uint8_t)((extended_len)
-                            >> (8 * (*num_extended_length_bytes - i)));
-  }
-
-  OC_DBG("-Totel length %ld option len : %ld \n", total_length, option_length);
-  OC_DBG("-TCP length field %u Extended length header len : %ld \n", len, extended_len);
-}
 /*---------------------------------------------------------------------------*/
 static void coap_tcp_get_message_length(const uint8_t *data,
                                         size_t *message_length,
@@ -757,14 +700,12 @@ coap_serialize_message(void *packet, uint8_t *buffer)
 #ifdef OC_TCP
   if (coap_pkt->transport_type == COAP_TRANSPORT_TCP) {
     OC_DBG("-Serializing CoAP over TCP packet to %p, \n", coap_pkt->buffer);
-    uint8_t num_extended_length_bytes = 0;
-    coap_tcp_serialize_length(packet, option_length, &num_extended_length_bytes);
-    coap_pkt->buffer[0] |= COAP_HEADER_TOKEN_LEN_MASK &
-                          (coap_pkt->token_len)
-                            << COAP_HEADER_TOKEN_LEN_POSITION;
-    coap_pkt->buffer[1 + num_extended_length_bytes] = coap_pkt->code;
-
-    token_location = 2 + num_extended_length_bytes;
+    size_t length = option_length;
+    if (coap_pkt->payload && coap_pkt->payload_len > 0) {
+      length += COAP_PAYLOAD_MARKER_LEN + coap_pkt->payload_len;
+    }
+    token_location = (uint8_t)coap_tcp_serialize_header(
+      coap_pkt->buffer, coap_pkt->token_len, coap_pkt->code, length);
   } else
 #endif /* OC_TCP */
   {
@@ -789,7 +730,7 @@ coap_serialize_message(void *packet, uint8_t *buffer)
   /* empty packet, dont need to do more stuff */
   if (!coap_pkt->code) {
     OC_DBG("Done serializing empty message at %p-\n", coap_pkt->buffer);
-    return 4;
+    return token_location;
   }
 
   /* set Token */
@@ -888,6 +829,45 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
 }
 /*---------------------------------------------------------------------------*/
 #ifdef OC_TCP
+size_t
+coap_tcp_serialize_header(uint8_t *buffer, uint8_t token_len, uint8_t code,
+                          size_t length)
+{
+  uint8_t len;
+  uint8_t num_extended_length_bytes = 0;
+  size_t extended_len = 0;
+
+  if (length < COAP_TCP_EXTENDED_LENGTH_1_DEFAULT_LEN) {
+    len = (uint8_t)length;
+  } else if (length < COAP_TCP_EXTENDED_LENGTH_2_DEFAULT_LEN) {
+    len = COAP_TCP_EXTENDED_LENGTH_1;
+    num_extended_length_bytes = 1;
+    extended_len = length - COAP_TCP_EXTENDED_LENGTH_1_DEFAULT_LEN;
+  } else if (length < COAP_TCP_EXTENDED_LENGTH_3_DEFAULT_LEN) {
+    len = COAP_TCP_EXTENDED_LENGTH_2;
+    num_extended_length_bytes = 2;
+    extended_len = length - COAP_TCP_EXTENDED_LENGTH_2_DEFAULT_LEN;
+  } else {
+    len = COAP_TCP_EXTENDED_LENGTH_3;
+    num_extended_length_bytes = 4;
+    extended_len = length - COAP_TCP_EXTENDED_LENGTH_3_DEFAULT_LEN;
+  }
+
+  buffer[0] = (COAP_TCP_HEADER_LEN_MASK & len << COAP_TCP_HEADER_LEN_POSITION) |
+              (COAP_HEADER_TOKEN_LEN_MASK & token_len
+                                              << COAP_HEADER_TOKEN_LEN_POSITION);
+  int i;
+  for (i = 1; i <= num_extended_length_bytes; i++) {
+    buffer[i] =
+      (uint8_t)(extended_len >> (8 * (num_extended_length_bytes - i)));
+  }
+  buffer[1 + num_extended_length_bytes] = code;
+
+  OC_DBG("-TCP length %u, %u extended length bytes\n", (unsigned int)length,
+         num_extended_length_bytes);
+  return COAP_TCP_DEFAULT_HEADER_LEN + num_extended_length_bytes;
+}
+/*---------------------------------------------------------------------------*/
 size_t coap_tcp_get_packet_size(const uint8_t *data)
 {
   size_t total_length = 0;
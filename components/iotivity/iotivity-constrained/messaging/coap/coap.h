@@ -299,6 +299,13 @@ int coap_set_payload(void *packet, const void *payload, size_t length);
 #ifdef OC_TCP
 void coap_tcp_init_message(void *packet, uint8_t code);
 
+/* Writes the header of a CoAP over TCP message (RFC 8323) whose options and
+ * payload take up length bytes, up to where the token begins, and returns
+ * its size.
+ */
+size_t coap_tcp_serialize_header(uint8_t *buffer, uint8_t token_len,
+                                 uint8_t code, size_t length);
+
 size_t coap_tcp_get_packet_size(const uint8_t *data);
 
 coap_status_t coap_tcp_parse_message(void *packet, uint8_t *data, uint32_t data_len);
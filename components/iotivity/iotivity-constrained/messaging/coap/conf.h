@@ -80,6 +80,21 @@
   (OC_MAX_APP_RESOURCES + OC_MAX_NUM_CONCURRENT_REQUESTS)
 #endif /* COAP_MAX_OBSERVERS */
 
+/* Number of recently received requests remembered per endpoint and message
+ * ID for duplicate detection, and the number of hash buckets used to look
+ * them up (must be a power of two). */
+#ifndef COAP_DEDUP_CACHE_SIZE
+#ifdef OC_DYNAMIC_ALLOCATION
+#define COAP_DEDUP_CACHE_SIZE (250)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define COAP_DEDUP_CACHE_SIZE (OC_MAX_NUM_CONCURRENT_REQUESTS * 2)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#endif /* COAP_DEDUP_CACHE_SIZE */
+
+#ifndef COAP_DEDUP_HASH_BUCKETS
+#define COAP_DEDUP_HASH_BUCKETS (64)
+#endif /* COAP_DEDUP_HASH_BUCKETS */
+
 /* Interval in notifies in which NON notifies are changed to CON notifies to
  * check client. */
 #define COAP_OBSERVE_REFRESH_INTERVAL 5
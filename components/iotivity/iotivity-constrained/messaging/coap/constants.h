@@ -100,6 +100,9 @@
 #define COAP_TCP_EXTENDED_LENGTH_3 15
 #define COAP_TCP_EXTENDED_LENGTH_3_DEFAULT_LEN 65805
 
+/* Option of the Capabilities and Settings Message (CSM) */
+#define COAP_SIGNAL_OPTION_MAX_MESSAGE_SIZE 2
+
 /* CoAP message types */
 typedef enum {
   COAP_TYPE_CON, /* confirmables */
@@ -140,6 +143,13 @@ typedef enum {
   GATEWAY_TIMEOUT_5_04 = 164,        /* GATEWAY_TIMEOUT */
   PROXYING_NOT_SUPPORTED_5_05 = 165, /* PROXYING_NOT_SUPPORTED */
 
+  /* Signaling codes of CoAP over TCP (RFC 8323) */
+  CSM_7_01 = 225,
+  PING_7_02 = 226,
+  PONG_7_03 = 227,
+  RELEASE_7_04 = 228,
+  ABORT_7_05 = 229,
+
   /* Stack errors */
   MEMORY_ALLOCATION_ERROR = 192,
   PACKET_SERIALIZATION_ERROR,
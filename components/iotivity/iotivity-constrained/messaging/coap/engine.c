@@ -52,10 +52,15 @@
 
 #include "api/oc_events.h"
 #include "oc_buffer.h"
+#include "oc_endpoint.h"
 #include "oc_ri.h"
+#include "port/oc_clock.h"
+#include "util/oc_list.h"
+#include "util/oc_memb.h"
 
 #ifdef OC_BLOCK_WISE
 #include "oc_blockwise.h"
+#include "oc_buffer_settings.h"
 #endif /* OC_BLOCK_WISE */
 
 #ifdef OC_CLIENT
@@ -67,29 +72,177 @@ OC_PROCESS(coap_engine, "CoAP Engine");
 #ifdef OC_BLOCK_WISE
 extern bool oc_ri_invoke_coap_entity_handler(
   void *request, void *response, oc_blockwise_state_t *request_state,
-  oc_blockwise_state_t *response_state, uint16_t block2_size,
-  oc_endpoint_t *endpoint);
+  oc_blockwise_state_t *response_state, uint8_t *buffer, uint32_t *encoded_len,
+  uint16_t block2_size, oc_endpoint_t *endpoint);
 #else  /* OC_BLOCK_WISE */
 extern bool oc_ri_invoke_coap_entity_handler(void *request, void *response,
                                              uint8_t *buffer,
                                              oc_endpoint_t *endpoint);
 #endif /* !OC_BLOCK_WISE */
 
-#define OC_REQUEST_HISTORY_SIZE (250)
-static uint16_t history[OC_REQUEST_HISTORY_SIZE];
-static uint8_t history_dev[OC_REQUEST_HISTORY_SIZE];
-static uint8_t idx;
+/* Requests received within the last EXCHANGE_LIFETIME (NON_LIFETIME for NON
+ * requests) are remembered by (endpoint, mid). A duplicate is answered by
+ * replaying the response that was sent for the original request. In static
+ * builds responses are not retained, so duplicate NON requests are dropped
+ * and duplicate CON requests are processed again.
+ */
+typedef struct coap_dedup_entry_s
+{
+  struct coap_dedup_entry_s *next; /* for LIST, oldest first */
+  struct coap_dedup_entry_s *hash_next;
+  oc_endpoint_t endpoint;
+  oc_clock_time_t expiry;
+  uint32_t hash;
+  uint16_t mid;
+#ifdef OC_DYNAMIC_ALLOCATION
+  uint16_t response_len;
+  uint8_t *response;
+#endif /* OC_DYNAMIC_ALLOCATION */
+} coap_dedup_entry_t;
+
+OC_MEMB_ZEROED(dedup_entries_s, coap_dedup_entry_t, COAP_DEDUP_CACHE_SIZE);
+OC_LIST(dedup_entries);
+static coap_dedup_entry_t *dedup_buckets[COAP_DEDUP_HASH_BUCKETS];
+static int dedup_num_entries;
+
+static void
+dedup_free_entry(coap_dedup_entry_t *entry)
+{
+  coap_dedup_entry_t **link =
+    &dedup_buckets[entry->hash & (COAP_DEDUP_HASH_BUCKETS - 1)];
+  while (*link != NULL) {
+    if (*link == entry) {
+      *link = entry->hash_next;
+      break;
+    }
+    link = &(*link)->hash_next;
+  }
+  oc_list_remove(dedup_entries, entry);
+#ifdef OC_DYNAMIC_ALLOCATION
+  free(entry->response);
+#endif /* OC_DYNAMIC_ALLOCATION */
+  oc_memb_free(&dedup_entries_s, entry);
+  dedup_num_entries--;
+}
+
+static void
+dedup_expire_entries(oc_clock_time_t now)
+{
+  coap_dedup_entry_t *entry = oc_list_head(dedup_entries);
+  while (entry != NULL && (dedup_num_entries >= COAP_DEDUP_CACHE_SIZE ||
+                           entry->expiry <= now)) {
+    dedup_free_entry(entry);
+    entry = oc_list_head(dedup_entries);
+  }
+}
+
+static coap_dedup_entry_t *
+dedup_find(oc_endpoint_t *endpoint, uint16_t mid, uint32_t hash,
+           oc_clock_time_t now)
+{
+  coap_dedup_entry_t *entry =
+    dedup_buckets[hash & (COAP_DEDUP_HASH_BUCKETS - 1)];
+  while (entry != NULL) {
+    if (entry->hash == hash && entry->mid == mid && entry->expiry > now &&
+        oc_endpoint_compare(&entry->endpoint, endpoint) == 0) {
+      return entry;
+    }
+    entry = entry->hash_next;
+  }
+  return NULL;
+}
+
+static coap_dedup_entry_t *
+dedup_add(oc_endpoint_t *endpoint, uint16_t mid, uint32_t hash,
+          oc_clock_time_t expiry)
+{
+  coap_dedup_entry_t *entry = oc_memb_alloc(&dedup_entries_s);
+  if (!entry) {
+    OC_WRN("insufficient memory to track request for duplicates\n");
+    return NULL;
+  }
+  memcpy(&entry->endpoint, endpoint, sizeof(oc_endpoint_t));
+  entry->mid = mid;
+  entry->hash = hash;
+  entry->expiry = expiry;
+  entry->hash_next = dedup_buckets[hash & (COAP_DEDUP_HASH_BUCKETS - 1)];
+  dedup_buckets[hash & (COAP_DEDUP_HASH_BUCKETS - 1)] = entry;
+  oc_list_add(dedup_entries, entry);
+  dedup_num_entries++;
+  return entry;
+}
+
+static void
+dedup_set_response(coap_dedup_entry_t *entry, oc_message_t *response)
+{
+#ifdef OC_DYNAMIC_ALLOCATION
+  free(entry->response);
+  entry->response_len = 0;
+  entry->response = malloc(response->length);
+  if (entry->response) {
+    memcpy(entry->response, response->data, response->length);
+    entry->response_len = (uint16_t)response->length;
+  }
+#else  /* OC_DYNAMIC_ALLOCATION */
+  (void)entry;
+  (void)response;
+#endif /* !OC_DYNAMIC_ALLOCATION */
+}
+
+static bool
+dedup_replay_response(coap_dedup_entry_t *entry, oc_endpoint_t *endpoint)
+{
+#ifdef OC_DYNAMIC_ALLOCATION
+  if (entry->response_len == 0) {
+    return false;
+  }
+  oc_message_t *message = oc_allocate_message();
+  if (message) {
+    memcpy(&message->endpoint, endpoint, sizeof(*endpoint));
+    memcpy(message->data, entry->response, entry->response_len);
+    message->length = entry->response_len;
+    coap_send_message(message);
+    if (message->ref_count == 0)
+      oc_message_unref(message);
+  }
+  return true;
+#else  /* OC_DYNAMIC_ALLOCATION */
+  (void)entry;
+  (void)endpoint;
+  return false;
+#endif /* !OC_DYNAMIC_ALLOCATION */
+}
 
+/* Returns true if the request was a duplicate and has been dealt with.
+ * Otherwise the request is recorded and *entry points to its record.
+ */
 static bool
-check_if_duplicate(uint16_t mid, uint8_t device)
+check_if_duplicate(coap_packet_t *request, oc_endpoint_t *endpoint,
+                   coap_dedup_entry_t **entry)
 {
-  size_t i;
-  for (i = 0; i < OC_REQUEST_HISTORY_SIZE; i++) {
-    if (history[i] == mid && history_dev[i] == device) {
+  oc_clock_time_t now = oc_clock_time();
+  uint32_t hash = oc_endpoint_hash(endpoint) ^ request->mid;
+
+  dedup_expire_entries(now);
+
+  *entry = dedup_find(endpoint, request->mid, hash, now);
+  if (*entry) {
+    if (dedup_replay_response(*entry, endpoint)) {
+      OC_DBG("replaying response to duplicate request\n");
+      return true;
+    }
+    if (request->type == COAP_TYPE_NON) {
       OC_DBG("dropping duplicate request\n");
       return true;
     }
+    return false;
   }
+
+  oc_clock_time_t lifetime = (request->type == COAP_TYPE_CON)
+                               ? OC_EXCHANGE_LIFETIME
+                               : OC_NON_LIFETIME;
+  *entry = dedup_add(endpoint, request->mid, hash,
+                     now + lifetime * OC_CLOCK_SECOND);
   return false;
 }
 
@@ -98,7 +251,7 @@ coap_send_empty_ack(uint16_t mid, oc_endpoint_t *endpoint)
 {
   coap_packet_t ack[1];
   coap_init_message(ack, COAP_TYPE_ACK, 0, mid);
-  oc_message_t *ack_message = oc_allocate_message();
+  oc_message_t *ack_message = oc_allocate_small_message();
   if (ack_message) {
     memcpy(&ack_message->endpoint, endpoint, sizeof(*endpoint));
     ack_message->length = coap_serialize_message(ack, ack_message->data);
@@ -108,6 +261,95 @@ coap_send_empty_ack(uint16_t mid, oc_endpoint_t *endpoint)
   }
 }
 
+#if defined(OC_CLIENT) && defined(OC_BLOCK_WISE)
+/* Number of blocks past a missing one that may arrive before the missing
+   block is taken for lost rather than reordered. */
+#define BLOCK_REORDER_THRESHOLD (3)
+
+/* Blocks arriving past one that is still missing mean that its request or
+ * response was most likely lost. Its request is then resent at once, once
+ * per missing block, instead of waiting out the retransmission timeout
+ * with the window stalled behind it.
+ */
+static void
+resend_missing_block(oc_blockwise_state_t *response_buffer,
+                     uint32_t block_num, uint16_t block_size)
+{
+  oc_blockwise_response_state_t *response_state =
+    (oc_blockwise_response_state_t *)response_buffer;
+  uint32_t missing = response_buffer->next_block_offset / block_size;
+  if (block_num <= missing || missing == response_state->resent_block_num) {
+    return;
+  }
+  /* Wait for a few more blocks, unless this was the last one requested. */
+  if (block_num < missing + BLOCK_REORDER_THRESHOLD &&
+      block_num + 1 < response_state->next_block_num) {
+    return;
+  }
+  response_state->resent_block_num = missing;
+  coap_transaction_t *t = coap_get_transaction_by_mid(
+    response_state->window_mids[missing % OC_BLOCK_WINDOW_MAX]);
+  if (t) {
+    OC_DBG("resending request for block %u\n", (unsigned int)missing);
+    coap_send_transaction(t);
+  }
+}
+
+/* Keeps up to oc_get_block_window() Block2 requests of a windowed transfer
+ * in flight. Every request is a transaction of its own, so when a block is
+ * lost only the request for that block is retransmitted.
+ */
+static void
+request_block_window(oc_client_cb_t *client_cb,
+                     oc_blockwise_state_t *response_buffer,
+                     oc_endpoint_t *endpoint, uint16_t block_size)
+{
+  static coap_packet_t request[1];
+  oc_blockwise_response_state_t *response_state =
+    (oc_blockwise_response_state_t *)response_buffer;
+  uint32_t num_blocks =
+    (response_state->body_size + block_size - 1) / block_size;
+  uint32_t window_end =
+    response_buffer->next_block_offset / block_size + oc_get_block_window();
+
+  while (response_state->next_block_num < MIN(num_blocks, window_end)) {
+    uint16_t mid = coap_get_mid();
+    coap_transaction_t *t = coap_new_transaction(mid, endpoint);
+    if (!t) {
+      break;
+    }
+#ifdef OC_TCP
+    if (endpoint->flags & TCP) {
+      coap_tcp_init_message(request, client_cb->method);
+    } else
+#endif /* OC_TCP */
+    {
+      coap_init_message(request, COAP_TYPE_CON, client_cb->method, mid);
+    }
+    coap_set_token(request, client_cb->token, client_cb->token_len);
+    coap_set_header_uri_path(request, oc_string(client_cb->uri),
+                             oc_string_len(client_cb->uri));
+    if (oc_string_len(client_cb->query) > 0) {
+      coap_set_header_uri_query(request, oc_string(client_cb->query));
+    }
+    coap_set_header_block2(request, response_state->next_block_num, 0,
+                           block_size);
+    t->message->length = coap_serialize_message(request, t->message->data);
+    if (t->message->length == 0) {
+      coap_clear_transaction(t);
+      break;
+    }
+    OC_DBG("requesting block %u\n",
+           (unsigned int)response_state->next_block_num);
+    oc_blockwise_set_response_mid(response_buffer, mid);
+    response_state->window_mids[response_state->next_block_num %
+                                OC_BLOCK_WINDOW_MAX] = mid;
+    response_state->next_block_num++;
+    coap_send_transaction(t);
+  }
+}
+#endif /* OC_CLIENT && OC_BLOCK_WISE */
+
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -128,6 +370,7 @@ coap_receive(oc_message_t *msg)
     message[1]; /* this way the packet can be treated as pointer as usual */
   static coap_packet_t response[1];
   static coap_transaction_t *transaction = NULL;
+  coap_dedup_entry_t *dedup_entry = NULL;
 
   /* block options */
   uint32_t block1_num = 0, block1_offset = 0, block2_num = 0, block2_offset = 0;
@@ -138,10 +381,19 @@ coap_receive(oc_message_t *msg)
 
 #ifdef OC_BLOCK_WISE
   oc_blockwise_state_t *request_buffer = 0, *response_buffer = 0;
+  uint32_t encoded_len = 0;
 #endif /* OC_BLOCK_WISE */
 
-  coap_status_code =
-    coap_parse_message(message, msg->data, (uint16_t)msg->length);
+#ifdef OC_TCP
+  if (msg->endpoint.flags & TCP) {
+    coap_status_code =
+      coap_tcp_parse_message(message, msg->data, (uint32_t)msg->length);
+  } else
+#endif /* OC_TCP */
+  {
+    coap_status_code =
+      coap_parse_message(message, msg->data, (uint16_t)msg->length);
+  }
 
   if (coap_status_code == COAP_NO_ERROR) {
 
@@ -180,9 +432,12 @@ coap_receive(oc_message_t *msg)
     block2_size = MIN(block2_size, (uint16_t)OC_BLOCK_SIZE);
 #endif /* OC_BLOCK_WISE */
 
-    transaction = coap_get_transaction_by_mid(message->mid);
-    if (transaction)
-      coap_clear_transaction(transaction);
+    /* Messages over TCP carry no message ID and need no acknowledgement. */
+    if (!(msg->endpoint.flags & TCP)) {
+      transaction = coap_get_transaction_by_mid(message->mid);
+      if (transaction)
+        coap_clear_transaction(transaction);
+    }
     transaction = NULL;
 
     /* handle requests */
@@ -207,15 +462,19 @@ coap_receive(oc_message_t *msg)
       OC_DBG("  Payload: %.*s\n", (int)message->payload_len, message->payload);
 #endif
 
+      if (!(msg->endpoint.flags & TCP) &&
+          check_if_duplicate(message, &msg->endpoint, &dedup_entry)) {
+        return 0;
+      }
+
+#ifdef OC_TCP
+      if (msg->endpoint.flags & TCP) {
+        coap_tcp_init_message(response, CONTENT_2_05);
+      } else
+#endif /* OC_TCP */
       if (message->type == COAP_TYPE_CON) {
         coap_init_message(response, COAP_TYPE_ACK, CONTENT_2_05, message->mid);
       } else {
-        if (check_if_duplicate(message->mid, (uint8_t)msg->endpoint.device)) {
-          return 0;
-        }
-        history[idx] = message->mid;
-        history_dev[idx] = (uint8_t)msg->endpoint.device;
-        idx = (idx + 1) % OC_REQUEST_HISTORY_SIZE;
         coap_init_message(response, COAP_TYPE_NON, CONTENT_2_05,
                           coap_get_mid());
       }
@@ -260,7 +519,7 @@ coap_receive(oc_message_t *msg)
                 response->code = CONTINUE_2_31;
                 coap_set_header_block1(response, block1_num, block1_more,
                                        block1_size);
-                request_buffer->ref_count = 1;
+                oc_blockwise_retain(request_buffer);
                 goto send_message;
               } else {
                 OC_DBG("received all blocks for payload\n");
@@ -268,7 +527,7 @@ coap_receive(oc_message_t *msg)
                                        block1_size);
                 request_buffer->payload_size =
                   request_buffer->next_block_offset;
-                request_buffer->ref_count = 0;
+                oc_blockwise_release_request_buffer(request_buffer);
 
                 response_buffer = oc_blockwise_find_response_buffer(
                   href, href_len, &msg->endpoint, message->code,
@@ -322,7 +581,12 @@ coap_receive(oc_message_t *msg)
                 (oc_blockwise_response_state_t *)response_buffer;
               coap_set_header_etag(response, response_state->etag,
                                    COAP_ETAG_LEN);
-              response_buffer->ref_count = more;
+              if (oc_blockwise_block_served(response_buffer, block2_num,
+                                            block2_size)) {
+                oc_blockwise_release_response_buffer(response_buffer);
+              } else {
+                oc_blockwise_retain(response_buffer);
+              }
               goto send_message;
             } else {
               OC_ERR("could not dispatch block\n");
@@ -374,6 +638,25 @@ coap_receive(oc_message_t *msg)
           goto init_reset_message;
         } else {
           OC_DBG("no block options; processing regular request\n");
+#ifdef OC_DYNAMIC_ALLOCATION
+          /* Plain GETs are encoded in place in a transaction message with
+           * room for the largest payload. A response that fits in a single
+           * block then goes out from there, and a larger one is served block
+           * by block from the same message, which a block-wise response
+           * buffer takes over. Observe registrations keep the response
+           * buffer they may be notified from.
+           */
+          if (message->code == COAP_GET && incoming_block_len == 0 &&
+              !IS_OPTION(message, COAP_OPTION_OBSERVE)) {
+            oc_message_t *large = oc_allocate_large_message();
+            if (large) {
+              memcpy(&large->endpoint, &msg->endpoint, sizeof(oc_endpoint_t));
+              oc_message_unref(transaction->message);
+              transaction->message = large;
+              goto request_handler;
+            }
+          }
+#endif /* OC_DYNAMIC_ALLOCATION */
           if (incoming_block_len <= block1_size) {
             OC_DBG("creating response buffer\n");
             response_buffer = oc_blockwise_alloc_response_buffer(
@@ -400,7 +683,7 @@ coap_receive(oc_message_t *msg)
                                 message->uri_query_len);
                 }
                 request_buffer->payload_size = incoming_block_len;
-                request_buffer->ref_count = 0;
+                oc_blockwise_release_request_buffer(request_buffer);
               }
               goto request_handler;
             } else {
@@ -418,9 +701,10 @@ coap_receive(oc_message_t *msg)
 #endif /* !OC_BLOCK_WISE */
 #ifdef OC_BLOCK_WISE
       request_handler:
-        if (oc_ri_invoke_coap_entity_handler(message, response, request_buffer,
-                                             response_buffer, block2_size,
-                                             &msg->endpoint)) {
+        if (oc_ri_invoke_coap_entity_handler(
+              message, response, request_buffer, response_buffer,
+              transaction->message->data + COAP_MAX_HEADER_SIZE, &encoded_len,
+              block2_size, &msg->endpoint)) {
 #else  /* OC_BLOCK_WISE */
         if (oc_ri_invoke_coap_entity_handler(message, response,
                                              transaction->message->data +
@@ -428,32 +712,65 @@ coap_receive(oc_message_t *msg)
                                              &msg->endpoint)) {
 #endif /* !OC_BLOCK_WISE */
 #ifdef OC_BLOCK_WISE
-          uint16_t payload_size = 0;
-          const void *payload = oc_blockwise_dispatch_block(
-            response_buffer, 0, block2_size, &payload_size);
-          if (payload) {
-            coap_set_payload(response, payload, payload_size);
+#ifdef OC_DYNAMIC_ALLOCATION
+          if (!response_buffer && encoded_len > block2_size) {
+            OC_DBG("response exceeds a single block; handing it to a "
+                   "block-wise response buffer\n");
+            /* Serializing block 0 in place would overwrite the payload, so
+               the transaction sends it from a message of its own. */
+            oc_message_t *encoded = transaction->message;
+            response_buffer = oc_blockwise_alloc_response_buffer(
+              href, href_len, &msg->endpoint, message->code,
+              OC_BLOCKWISE_SERVER);
+            transaction->message =
+              response_buffer ? oc_allocate_message() : NULL;
+            if (!transaction->message) {
+              OC_ERR("could not create response buffer\n");
+              transaction->message = encoded;
+              goto init_reset_message;
+            }
+            memcpy(&transaction->message->endpoint, &msg->endpoint,
+                   sizeof(oc_endpoint_t));
+            oc_blockwise_adopt(response_buffer, encoded,
+                               encoded->data + COAP_MAX_HEADER_SIZE,
+                               encoded_len);
+            oc_message_unref(encoded);
+            if (message->uri_query_len > 0) {
+              oc_new_string(&response_buffer->uri_query, message->uri_query,
+                            message->uri_query_len);
+            }
           }
-          if (block2 || response_buffer->payload_size > block2_size) {
-            coap_set_header_block2(
-              response, 0,
-              (response_buffer->payload_size > block2_size) ? 1 : 0,
-              block2_size);
-            coap_set_header_size2(response, response_buffer->payload_size);
-            oc_blockwise_response_state_t *response_state =
-              (oc_blockwise_response_state_t *)response_buffer;
-            coap_set_header_etag(response, response_state->etag, COAP_ETAG_LEN);
-          } else {
-            response_buffer->ref_count = 0;
+#endif /* OC_DYNAMIC_ALLOCATION */
+          if (response_buffer) {
+            uint16_t payload_size = 0;
+            const void *payload = oc_blockwise_dispatch_block(
+              response_buffer, 0, block2_size, &payload_size);
+            if (payload) {
+              coap_set_payload(response, payload, payload_size);
+            }
+            if (block2 || response_buffer->payload_size > block2_size) {
+              coap_set_header_block2(
+                response, 0,
+                (response_buffer->payload_size > block2_size) ? 1 : 0,
+                block2_size);
+              coap_set_header_size2(response, response_buffer->payload_size);
+              oc_blockwise_response_state_t *response_state =
+                (oc_blockwise_response_state_t *)response_buffer;
+              coap_set_header_etag(response, response_state->etag,
+                                   COAP_ETAG_LEN);
+              oc_blockwise_block_served(response_buffer, 0, block2_size);
+            } else {
+              oc_blockwise_release_response_buffer(response_buffer);
+            }
           }
 #endif /* OC_BLOCK_WISE */
         }
 #ifdef OC_BLOCK_WISE
         else {
           if (request_buffer)
-            request_buffer->ref_count = 0;
+            oc_blockwise_release_request_buffer(request_buffer);
           if (response_buffer)
-            response_buffer->ref_count = 0;
+            oc_blockwise_release_response_buffer(response_buffer);
         }
 #endif /* OC_BLOCK_WISE */
         if (response->code != 0) {
@@ -512,14 +829,21 @@ coap_receive(oc_message_t *msg)
           }
           payload = oc_blockwise_dispatch_block(request_buffer, 0, block1_size,
                                                 &payload_size);
-          request_buffer->ref_count = 1;
+          oc_blockwise_retain(request_buffer);
         }
         if (payload) {
           OC_DBG("dispatching next block\n");
           transaction = coap_new_transaction(response_mid, &msg->endpoint);
           if (transaction) {
-            coap_init_message(response, COAP_TYPE_CON, client_cb->method,
-                              response_mid);
+#ifdef OC_TCP
+            if (msg->endpoint.flags & TCP) {
+              coap_tcp_init_message(response, client_cb->method);
+            } else
+#endif /* OC_TCP */
+            {
+              coap_init_message(response, COAP_TYPE_CON, client_cb->method,
+                                response_mid);
+            }
             uint8_t more =
               (request_buffer->next_block_offset < request_buffer->payload_size)
                 ? 1
@@ -537,11 +861,11 @@ coap_receive(oc_message_t *msg)
             if (oc_string_len(client_cb->query) > 0) {
               coap_set_header_uri_query(response, oc_string(client_cb->query));
             }
-            request_buffer->mid = response_mid;
+            oc_blockwise_set_request_mid(request_buffer, response_mid);
             goto send_message;
           }
         } else {
-          request_buffer->ref_count = 0;
+          oc_blockwise_release_request_buffer(request_buffer);
         }
       }
 
@@ -555,7 +879,7 @@ coap_receive(oc_message_t *msg)
           if (response_buffer) {
             OC_DBG("created new response buffer for uri %s\n",
                    oc_string(response_buffer->href));
-            response_buffer->client_cb = client_cb;
+            oc_blockwise_set_response_client_cb(response_buffer, client_cb);
           }
         }
       } else {
@@ -573,18 +897,58 @@ coap_receive(oc_message_t *msg)
 
         const uint8_t *incoming_block;
         int incoming_block_len = coap_get_payload(message, &incoming_block);
-        if (incoming_block_len > 0 &&
-            oc_blockwise_handle_block(response_buffer, block2_offset,
-                                      incoming_block,
-                                      (uint16_t)incoming_block_len)) {
+        /* With a block window configured, a response whose first block
+         * announces the size of the whole body is fetched with several
+         * block requests in flight.
+         */
+        uint32_t size2 = 0;
+        if (block2 && block2_num == 0 && block2_more &&
+            incoming_block_len > 0 && response_state->observe_seq == -1 &&
+            oc_get_block_window() > 1 &&
+            coap_get_header_size2(message, &size2) == 1 &&
+            size2 > (uint32_t)incoming_block_len &&
+            size2 <= (uint32_t)OC_MAX_APP_DATA_SIZE) {
+          OC_DBG("windowed block-wise transfer of %u bytes\n",
+                 (unsigned int)size2);
+          response_state->body_size = size2;
+          response_state->next_block_num = 1;
+          response_state->resent_block_num = 0;
+        }
+        if (response_state->body_size > 0) {
+          if (block2 && incoming_block_len > 0 &&
+              oc_blockwise_handle_window_block(response_buffer, block2_num,
+                                               block2_size, incoming_block,
+                                               (uint16_t)incoming_block_len)) {
+            if (response_buffer->next_block_offset <
+                response_state->body_size) {
+              resend_missing_block(response_buffer, block2_num, block2_size);
+              request_block_window(client_cb, response_buffer, &msg->endpoint,
+                                   block2_size);
+              goto send_message;
+            }
+            response_buffer->payload_size = response_state->body_size;
+          } else if (message->type != COAP_TYPE_RST) {
+            goto send_message;
+          }
+        } else if (incoming_block_len > 0 &&
+                   oc_blockwise_handle_block(response_buffer, block2_offset,
+                                             incoming_block,
+                                             (uint16_t)incoming_block_len)) {
           OC_DBG("processing incoming block\n");
           if (block2 && block2_more) {
             OC_DBG("issuing request for next block\n");
             transaction = coap_new_transaction(response_mid, &msg->endpoint);
             if (transaction) {
-              coap_init_message(response, COAP_TYPE_CON, client_cb->method,
-                                response_mid);
-              response_buffer->mid = response_mid;
+#ifdef OC_TCP
+              if (msg->endpoint.flags & TCP) {
+                coap_tcp_init_message(response, client_cb->method);
+              } else
+#endif /* OC_TCP */
+              {
+                coap_init_message(response, COAP_TYPE_CON, client_cb->method,
+                                  response_mid);
+              }
+              oc_blockwise_set_response_mid(response_buffer, response_mid);
               coap_set_header_block2(response, block2_num + 1, 0, block2_size);
               coap_set_header_uri_path(response, oc_string(client_cb->uri),
                                        oc_string_len(client_cb->uri));
@@ -620,16 +984,25 @@ coap_receive(oc_message_t *msg)
   }
 
 init_reset_message:
-  coap_init_message(response, COAP_TYPE_RST, 0, message->mid);
+#ifdef OC_TCP
+  /* There is no Reset message over TCP. */
+  if (msg->endpoint.flags & TCP) {
+    coap_clear_transaction(transaction);
+    transaction = NULL;
+  } else
+#endif /* OC_TCP */
+  {
+    coap_init_message(response, COAP_TYPE_RST, 0, message->mid);
+  }
 #ifdef OC_BLOCK_WISE
 #ifdef OC_CLIENT
 free_blockwise_buffers:
 #endif /* OC_CLIENT */
   if (request_buffer) {
-    request_buffer->ref_count = 0;
+    oc_blockwise_release_request_buffer(request_buffer);
   }
   if (response_buffer) {
-    response_buffer->ref_count = 0;
+    oc_blockwise_release_response_buffer(response_buffer);
   }
 #endif /* OC_BLOCK_WISE */
 
@@ -662,6 +1035,9 @@ send_message:
       transaction->message->length =
         coap_serialize_message(response, transaction->message->data);
       if (transaction->message->length) {
+        if (dedup_entry) {
+          dedup_set_response(dedup_entry, transaction->message);
+        }
         coap_send_transaction(transaction);
       } else {
         coap_clear_transaction(transaction);
@@ -50,6 +50,7 @@
 #ifdef OC_SERVER
 
 #include "observe.h"
+#include "util/oc_hash.h"
 #include "util/oc_memb.h"
 #include <stdio.h>
 #include <string.h>
@@ -62,6 +63,7 @@
 #include "oc_collection.h"
 #endif /* OC_COLLECTIONS */
 
+#include "oc_buffer.h"
 #include "oc_coap.h"
 #include "oc_endpoint.h"
 #include "oc_rep.h"
@@ -69,32 +71,84 @@
 /*-------------------*/
 int32_t observe_counter = 3;
 /*---------------------------------------------------------------------------*/
-OC_LIST(observers_list);
-OC_MEMB(observers_memb, coap_observer_t, COAP_MAX_OBSERVERS);
+OC_MEMB_ZEROED(observers_memb, coap_observer_t, COAP_MAX_OBSERVERS);
+
+/* Besides their resource's list, observers are indexed by a hash of their
+ * endpoint and by a hash of their token, so that registration, removal and
+ * client eviction do not scan all observers. The number of buckets must be
+ * a power of two.
+ */
+#ifndef COAP_OBSERVER_INDEX_BUCKETS
+#ifdef OC_DYNAMIC_ALLOCATION
+#define COAP_OBSERVER_INDEX_BUCKETS (64)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define COAP_OBSERVER_INDEX_BUCKETS (8)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#endif /* !COAP_OBSERVER_INDEX_BUCKETS */
+
+static coap_observer_t *client_index[COAP_OBSERVER_INDEX_BUCKETS];
+static coap_observer_t *token_index[COAP_OBSERVER_INDEX_BUCKETS];
+
+#define OBSERVER_LINK_INSERT(head, o, link)                                    \
+  do {                                                                         \
+    (o)->link.next = *(head);                                                  \
+    if (*(head))                                                               \
+      (*(head))->link.pprev = &(o)->link.next;                                 \
+    (o)->link.pprev = (head);                                                  \
+    *(head) = (o);                                                             \
+  } while (0)
+
+#define OBSERVER_LINK_REMOVE(o, link)                                          \
+  do {                                                                         \
+    *(o)->link.pprev = (o)->link.next;                                         \
+    if ((o)->link.next)                                                        \
+      (o)->link.next->link.pprev = (o)->link.pprev;                            \
+    (o)->link.next = NULL;                                                     \
+    (o)->link.pprev = NULL;                                                    \
+  } while (0)
 
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
+static coap_observer_t **
+client_bucket(oc_endpoint_t *endpoint)
+{
+  return &client_index[oc_endpoint_hash(endpoint) &
+                       (COAP_OBSERVER_INDEX_BUCKETS - 1)];
+}
+/*---------------------------------------------------------------------------*/
+static coap_observer_t **
+token_bucket(const uint8_t *token, size_t token_len)
+{
+  uint32_t hash = oc_fnv1a(OC_FNV1A_INIT, token, token_len);
+  return &token_index[hash & (COAP_OBSERVER_INDEX_BUCKETS - 1)];
+}
+/*---------------------------------------------------------------------------*/
+static void
+free_observer(coap_observer_t *o)
+{
+  o->resource->num_observers--;
+  OBSERVER_LINK_REMOVE(o, resource_link);
+  OBSERVER_LINK_REMOVE(o, client_link);
+  OBSERVER_LINK_REMOVE(o, token_link);
+  oc_memb_free(&observers_memb, o);
+}
+/*---------------------------------------------------------------------------*/
 static int
 coap_remove_observer_handle_by_uri(oc_endpoint_t *endpoint, const char *uri,
                                    int uri_len)
 {
-  int removed = 0;
-  coap_observer_t *obs = (coap_observer_t *)oc_list_head(observers_list), *next;
+  coap_observer_t *obs = *client_bucket(endpoint);
 
   while (obs) {
-    next = obs->next;
     if (((oc_endpoint_compare(&obs->endpoint, endpoint) == 0)) &&
         (obs->url == uri || memcmp(obs->url, uri, uri_len) == 0)) {
-      obs->resource->num_observers--;
-      oc_list_remove(observers_list, obs);
-      oc_memb_free(&observers_memb, obs);
-      removed++;
-      break;
+      free_observer(obs);
+      return 1;
     }
-    obs = next;
+    obs = obs->client_link.next;
   }
-  return removed;
+  return 0;
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -133,16 +187,11 @@ add_observer(oc_resource_t *resource, oc_endpoint_t *endpoint,
     o->block2_size = block2_size;
 #endif /* OC_BLOCK_WISE */
     resource->num_observers++;
-#ifdef OC_DYNAMIC_ALLOCATION
+    OBSERVER_LINK_INSERT(&resource->observers, o, resource_link);
+    OBSERVER_LINK_INSERT(client_bucket(endpoint), o, client_link);
+    OBSERVER_LINK_INSERT(token_bucket(token, token_len), o, token_link);
     OC_DBG("Adding observer (%u) for /%s [0x%02X%02X]\n",
-           oc_list_length(observers_list) + 1, o->url, o->token[0],
-           o->token[1]);
-#else  /* OC_DYNAMIC_ALLOCATION */
-    OC_DBG("Adding observer (%u/%u) for /%s [0x%02X%02X]\n",
-           oc_list_length(observers_list) + 1, COAP_MAX_OBSERVERS, o->url,
-           o->token[0], o->token[1]);
-#endif /* !OC_DYNAMIC_ALLOCATION */
-    oc_list_add(observers_list, o);
+           resource->num_observers, o->url, o->token[0], o->token[1]);
     return dup;
   }
   OC_WRN("insufficient memory to add new observer\n");
@@ -162,27 +211,25 @@ coap_remove_observer(coap_observer_t *o)
     oc_string(o->resource->uri) + 1, oc_string_len(o->resource->uri) - 1,
     &o->endpoint, OC_GET, NULL, 0, OC_BLOCKWISE_SERVER);
   if (response_state) {
-    response_state->ref_count = 0;
+    oc_blockwise_release_response_buffer(response_state);
   }
 #endif /* OC_BLOCK_WISE */
 
-  oc_list_remove(observers_list, o);
-  oc_memb_free(&observers_memb, o);
+  free_observer(o);
 }
 /*---------------------------------------------------------------------------*/
 int
 coap_remove_observer_by_client(oc_endpoint_t *endpoint)
 {
   int removed = 0;
-  coap_observer_t *obs = (coap_observer_t *)oc_list_head(observers_list), *next;
+  coap_observer_t *obs = *client_bucket(endpoint), *next;
 
   OC_DBG("Unregistering observers for client at: ");
   OC_LOGipaddr(*endpoint);
 
   while (obs) {
-    next = obs->next;
+    next = obs->client_link.next;
     if (oc_endpoint_compare(&obs->endpoint, endpoint) == 0) {
-      obs->resource->num_observers--;
       coap_remove_observer(obs);
       removed++;
     }
@@ -197,19 +244,18 @@ coap_remove_observer_by_token(oc_endpoint_t *endpoint, uint8_t *token,
                               size_t token_len)
 {
   int removed = 0;
-  coap_observer_t *obs = (coap_observer_t *)oc_list_head(observers_list);
+  coap_observer_t *obs = *token_bucket(token, token_len);
   OC_DBG("Unregistering observers for request token 0x%02X%02X\n", token[0],
          token[1]);
   while (obs) {
-    if (oc_endpoint_compare(&obs->endpoint, endpoint) == 0 &&
-        obs->token_len == token_len &&
-        memcmp(obs->token, token, token_len) == 0) {
-      obs->resource->num_observers--;
+    if (obs->token_len == token_len &&
+        memcmp(obs->token, token, token_len) == 0 &&
+        oc_endpoint_compare(&obs->endpoint, endpoint) == 0) {
       coap_remove_observer(obs);
       removed++;
       break;
     }
-    obs = obs->next;
+    obs = obs->token_link.next;
   }
   OC_DBG("Removed %d observers\n", removed);
   return removed;
@@ -222,11 +268,10 @@ coap_remove_observer_by_mid(oc_endpoint_t *endpoint, uint16_t mid)
   coap_observer_t *obs = NULL;
   OC_DBG("Unregistering observers for request MID %u\n", mid);
 
-  for (obs = (coap_observer_t *)oc_list_head(observers_list); obs != NULL;
-       obs = obs->next) {
-    if (oc_endpoint_compare(&obs->endpoint, endpoint) == 0 &&
-        obs->last_mid == mid) {
-      obs->resource->num_observers--;
+  for (obs = *client_bucket(endpoint); obs != NULL;
+       obs = obs->client_link.next) {
+    if (obs->last_mid == mid &&
+        oc_endpoint_compare(&obs->endpoint, endpoint) == 0) {
       coap_remove_observer(obs);
       removed++;
       break;
@@ -239,6 +284,185 @@ coap_remove_observer_by_mid(oc_endpoint_t *endpoint, uint16_t mid)
 /*---------------------------------------------------------------------------*/
 /*- Notification ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
+/* Notifications that fit in a single block only differ between observers in
+ * their header, token and Observe value. The options and payload are
+ * serialized once per content format version into a template that carries
+ * no token and a 3 byte Observe option, which is always the first option,
+ * and then copied behind each observer's header and token. Templates live
+ * outside the message pool, which the notifications themselves draw from.
+ */
+#define NOTIFICATION_TEMPLATE_OBSERVE_OFFSET (COAP_HEADER_LEN + 1)
+#define NOTIFICATION_TEMPLATE_OBSERVE_PLACEHOLDER (0xFFFFFF)
+
+typedef struct
+{
+  uint8_t *data;
+  size_t length;
+} notification_template_t;
+
+#ifndef OC_DYNAMIC_ALLOCATION
+static uint8_t notification_template_data[2][OC_PDU_SIZE];
+#endif /* !OC_DYNAMIC_ALLOCATION */
+
+static bool
+new_notification_template(oc_response_buffer_t *response_buf,
+                          ocf_version_t version,
+                          notification_template_t *template)
+{
+  coap_packet_t notification[1];
+  coap_init_message(notification, COAP_TYPE_NON, CONTENT_2_05, 0);
+  coap_set_status_code(notification, response_buf->code);
+  coap_set_header_observe(notification,
+                          NOTIFICATION_TEMPLATE_OBSERVE_PLACEHOLDER);
+  if (version == OIC_VER_1_1_0) {
+    coap_set_header_content_format(notification, APPLICATION_CBOR);
+  } else {
+    coap_set_header_content_format(notification, APPLICATION_VND_OCF_CBOR);
+  }
+  coap_set_payload(notification, response_buf->buffer,
+                   response_buf->response_length);
+
+#ifdef OC_DYNAMIC_ALLOCATION
+  template->data = malloc(OC_PDU_SIZE);
+  if (!template->data) {
+    return false;
+  }
+#else  /* OC_DYNAMIC_ALLOCATION */
+  template->data =
+    notification_template_data[(version == OIC_VER_1_1_0) ? 1 : 0];
+#endif /* !OC_DYNAMIC_ALLOCATION */
+  template->length = coap_serialize_message(notification, template->data);
+  /* Observe: delta 6, length 3 */
+  return template->length >= NOTIFICATION_TEMPLATE_OBSERVE_OFFSET + 3 &&
+         template->data[COAP_HEADER_LEN] == ((COAP_OPTION_OBSERVE << 4) | 3);
+}
+
+static void
+send_notification(coap_observer_t *obs, notification_template_t *template)
+{
+  uint8_t type = COAP_TYPE_NON;
+  uint32_t observe = 1;
+  uint8_t code = template->data[1];
+
+  if (obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0) {
+    OC_DBG("coap_observe_notify: forcing CON notification to check for "
+           "client liveness\n");
+    type = COAP_TYPE_CON;
+  }
+  if (code < BAD_REQUEST_4_00 && obs->resource->num_observers) {
+    observe = (uint32_t)(obs->obs_counter)++;
+    observe_counter++;
+  }
+
+  coap_transaction_t *transaction =
+    coap_new_transaction(coap_get_mid(), &obs->endpoint);
+  if (!transaction) {
+    return;
+  }
+  obs->last_mid = transaction->mid;
+
+  uint8_t *data = transaction->message->data;
+  size_t body_len = template->length - COAP_HEADER_LEN;
+  size_t header_len = COAP_HEADER_LEN;
+#ifdef OC_TCP
+  if (obs->endpoint.flags & TCP) {
+    header_len =
+      coap_tcp_serialize_header(data, obs->token_len, code, body_len);
+  } else
+#endif /* OC_TCP */
+  {
+    data[0] = (1 << COAP_HEADER_VERSION_POSITION) |
+              (COAP_HEADER_TYPE_MASK & type << COAP_HEADER_TYPE_POSITION) |
+              (COAP_HEADER_TOKEN_LEN_MASK & obs->token_len);
+    data[1] = code;
+    data[2] = (uint8_t)(transaction->mid >> 8);
+    data[3] = (uint8_t)transaction->mid;
+  }
+  memcpy(data + header_len, obs->token, obs->token_len);
+  uint8_t *options = data + header_len + obs->token_len;
+  memcpy(options, template->data + COAP_HEADER_LEN, body_len);
+  options[1] = (uint8_t)(observe >> 16);
+  options[2] = (uint8_t)(observe >> 8);
+  options[3] = (uint8_t)observe;
+  transaction->message->length = header_len + obs->token_len + body_len;
+
+  coap_send_transaction(transaction);
+}
+
+#ifdef OC_BLOCK_WISE
+/* Sends the first block of a notification that exceeds the observer's
+ * block size, and keeps the rest in a block-wise response buffer.
+ */
+static int
+send_blockwise_notification(coap_observer_t *obs,
+                            oc_response_buffer_t *response_buf)
+{
+  oc_blockwise_state_t *response_state = oc_blockwise_find_response_buffer(
+    oc_string(obs->resource->uri) + 1, oc_string_len(obs->resource->uri) - 1,
+    &obs->endpoint, OC_GET, NULL, 0, OC_BLOCKWISE_SERVER);
+  if (response_state) {
+    return 0;
+  }
+  response_state = oc_blockwise_alloc_response_buffer(
+    oc_string(obs->resource->uri) + 1, oc_string_len(obs->resource->uri) - 1,
+    &obs->endpoint, OC_GET, OC_BLOCKWISE_SERVER);
+  if (!response_state) {
+    return -1;
+  }
+
+  coap_packet_t notification[1];
+#ifdef OC_TCP
+  if (obs->endpoint.flags & TCP) {
+    coap_tcp_init_message(notification, CONTENT_2_05);
+  } else
+#endif /* OC_TCP */
+  {
+    coap_init_message(notification, COAP_TYPE_CON, CONTENT_2_05, 0);
+  }
+  if (!oc_blockwise_write(response_state, 0, response_buf->buffer,
+                          response_buf->response_length)) {
+    oc_blockwise_release_response_buffer(response_state);
+    return -1;
+  }
+  response_state->payload_size = response_buf->response_length;
+  uint16_t payload_size = 0;
+  const void *payload = oc_blockwise_dispatch_block(
+    response_state, 0, obs->block2_size, &payload_size);
+  if (payload) {
+    coap_set_payload(notification, payload, payload_size);
+    coap_set_header_block2(notification, 0, 1, obs->block2_size);
+    coap_set_header_size2(notification, response_state->payload_size);
+    oc_blockwise_response_state_t *bwt_res_state =
+      (oc_blockwise_response_state_t *)response_state;
+    coap_set_header_etag(notification, bwt_res_state->etag, COAP_ETAG_LEN);
+  }
+
+  coap_set_status_code(notification, response_buf->code);
+  if (notification->code < BAD_REQUEST_4_00 && obs->resource->num_observers) {
+    coap_set_header_observe(notification, (obs->obs_counter)++);
+    observe_counter++;
+  } else {
+    coap_set_header_observe(notification, 1);
+  }
+  if (obs->endpoint.version == OIC_VER_1_1_0) {
+    coap_set_header_content_format(notification, APPLICATION_CBOR);
+  } else {
+    coap_set_header_content_format(notification, APPLICATION_VND_OCF_CBOR);
+  }
+  coap_set_token(notification, obs->token, obs->token_len);
+  coap_transaction_t *transaction =
+    coap_new_transaction(coap_get_mid(), &obs->endpoint);
+  if (transaction) {
+    obs->last_mid = transaction->mid;
+    notification->mid = transaction->mid;
+    transaction->message->length =
+      coap_serialize_message(notification, transaction->message->data);
+    coap_send_transaction(transaction);
+  }
+  return 0;
+}
+#endif /* OC_BLOCK_WISE */
+
 int
 coap_notify_observers(oc_resource_t *resource,
                       oc_response_buffer_t *response_buf,
@@ -256,9 +480,8 @@ coap_notify_observers(oc_resource_t *resource,
   }
   num_observers = resource->num_observers;
 
-#ifdef OC_BLOCK_WISE
-  oc_blockwise_state_t *response_state;
-#endif /* OC_BLOCK_WISE */
+  /* One template per content format version: OCF 1.0 and OIC 1.1 */
+  notification_template_t templates[2] = { { NULL, 0 }, { NULL, 0 } };
 
 #ifndef OC_DYNAMIC_ALLOCATION
   uint8_t buffer[OC_MAX_APP_DATA_SIZE];
@@ -299,12 +522,11 @@ coap_notify_observers(oc_resource_t *resource,
     }
   }
 
-  coap_observer_t *obs = NULL;
-  /* iterate over observers */
-  for (obs = (coap_observer_t *)oc_list_head(observers_list); obs;
-       obs = obs->next) {
-    if ((obs->resource != resource) ||
-        (endpoint && oc_endpoint_compare(&obs->endpoint, endpoint) != 0)) {
+  coap_observer_t *obs = NULL, *next;
+  /* iterate over the resource's observers */
+  for (obs = resource->observers; obs; obs = next) {
+    next = obs->resource_link.next;
+    if (endpoint && oc_endpoint_compare(&obs->endpoint, endpoint) != 0) {
       continue;
     }
 
@@ -327,87 +549,31 @@ coap_notify_observers(oc_resource_t *resource,
                                0) == 1)
 #endif /* !OC_BLOCK_WISE */
         response.separate_response->active = 1;
-    } else {
+    } else if (response_buf) {
       OC_DBG("coap_notify_observers: notifying observer\n");
-      coap_transaction_t *transaction = NULL;
-      if (response_buf) {
-        coap_packet_t notification[1];
-        coap_init_message(notification, COAP_TYPE_NON, CONTENT_2_05, 0);
-
 #ifdef OC_BLOCK_WISE
-        if (response_buf->response_length > obs->block2_size) {
-          notification->type = COAP_TYPE_CON;
-          response_state = oc_blockwise_find_response_buffer(
-            oc_string(obs->resource->uri) + 1,
-            oc_string_len(obs->resource->uri) - 1, &obs->endpoint, OC_GET, NULL,
-            0, OC_BLOCKWISE_SERVER);
-          if (response_state) {
-            continue;
-          }
-          response_state = oc_blockwise_alloc_response_buffer(
-            oc_string(obs->resource->uri) + 1,
-            oc_string_len(obs->resource->uri) - 1, &obs->endpoint, OC_GET,
-            OC_BLOCKWISE_SERVER);
-          if (!response_state) {
-            goto leave_notify_observers;
-          }
-          memcpy(response_state->buffer, response_buf->buffer,
-                 response_buf->response_length);
-          response_state->payload_size = response_buf->response_length;
-          uint16_t payload_size = 0;
-          const void *payload = oc_blockwise_dispatch_block(
-            response_state, 0, obs->block2_size, &payload_size);
-          if (payload) {
-            coap_set_payload(notification, payload, payload_size);
-            coap_set_header_block2(notification, 0, 1, obs->block2_size);
-            coap_set_header_size2(notification, response_state->payload_size);
-            oc_blockwise_response_state_t *bwt_res_state =
-              (oc_blockwise_response_state_t *)response_state;
-            coap_set_header_etag(notification, bwt_res_state->etag,
-                                 COAP_ETAG_LEN);
-          }
-        } else
-#endif /* OC_BLOCK_WISE */
-        {
-          if (obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0) {
-            OC_DBG("coap_observe_notify: forcing CON notification to check for "
-                   "client liveness\n");
-            notification->type = COAP_TYPE_CON;
-          }
-          coap_set_payload(notification, response_buf->buffer,
-                           response_buf->response_length);
-        }
-
-        coap_set_status_code(notification, response_buf->code);
-        if (notification->code < BAD_REQUEST_4_00 &&
-            obs->resource->num_observers) {
-          coap_set_header_observe(notification, (obs->obs_counter)++);
-          observe_counter++;
-        } else {
-          coap_set_header_observe(notification, 1);
-        }
-        if (obs->endpoint.version == OIC_VER_1_1_0) {
-          coap_set_header_content_format(notification, APPLICATION_CBOR);
-        } else {
-          coap_set_header_content_format(notification,
-                                         APPLICATION_VND_OCF_CBOR);
-        }
-        coap_set_token(notification, obs->token, obs->token_len);
-        transaction = coap_new_transaction(coap_get_mid(), &obs->endpoint);
-        if (transaction) {
-          obs->last_mid = transaction->mid;
-          notification->mid = transaction->mid;
-          transaction->message->length =
-            coap_serialize_message(notification, transaction->message->data);
-
-          coap_send_transaction(transaction);
+      if (response_buf->response_length > obs->block2_size) {
+        if (send_blockwise_notification(obs, response_buf) < 0) {
+          goto leave_notify_observers;
         }
+        continue;
+      }
+#endif /* OC_BLOCK_WISE */
+      int v = (obs->endpoint.version == OIC_VER_1_1_0) ? 1 : 0;
+      if (!templates[v].length &&
+          !new_notification_template(response_buf, obs->endpoint.version,
+                                     &templates[v])) {
+        OC_WRN("coap_notify_observers: could not serialize notification\n");
+        goto leave_notify_observers;
       }
+      send_notification(obs, &templates[v]);
     }
   }
 
 leave_notify_observers:
 #ifdef OC_DYNAMIC_ALLOCATION
+  free(templates[0].data);
+  free(templates[1].data);
   if (buffer)
     free(buffer);
 #endif /* OC_DYNAMIC_ALLOCATION */
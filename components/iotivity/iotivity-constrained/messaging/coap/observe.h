@@ -55,9 +55,19 @@
 
 #define COAP_OBSERVER_URL_LEN 20
 
+/* Links an observer into one of the lists below; pprev points to the
+   previous observer's next pointer (or the list head) for O(1) removal. */
+typedef struct coap_observer_link
+{
+  struct coap_observer *next;
+  struct coap_observer **pprev;
+} coap_observer_link_t;
+
 typedef struct coap_observer
 {
-  struct coap_observer *next; /* for LIST */
+  coap_observer_link_t resource_link; /* resource->observers */
+  coap_observer_link_t client_link;   /* observers of the same endpoint */
+  coap_observer_link_t token_link;    /* observers with the same token hash */
 
   oc_resource_t *resource;
 
@@ -77,7 +87,6 @@ typedef struct coap_observer
   uint8_t retrans_counter;
 } coap_observer_t;
 
-oc_list_t coap_get_observers(void);
 void coap_remove_observer(coap_observer_t *o);
 int coap_remove_observer_by_client(oc_endpoint_t *endpoint);
 int coap_remove_observer_by_token(oc_endpoint_t *endpoint, uint8_t *token,
@@ -34,8 +34,8 @@ struct oc_separate_response_s
 struct oc_response_buffer_s
 {
   uint8_t *buffer;
-  uint16_t buffer_size;
-  uint16_t response_length;
+  uint32_t buffer_size;
+  uint32_t response_length;
   int code;
 };
 
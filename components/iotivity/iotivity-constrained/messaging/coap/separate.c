@@ -56,7 +56,8 @@
 #include <stdio.h>
 #include <string.h>
 
-OC_MEMB(separate_requests, coap_separate_t, OC_MAX_NUM_CONCURRENT_REQUESTS);
+OC_MEMB_ZEROED(separate_requests, coap_separate_t,
+               OC_MAX_NUM_CONCURRENT_REQUESTS);
 
 /*---------------------------------------------------------------------------*/
 /*- Separate Response API ---------------------------------------------------*/
@@ -120,7 +121,7 @@ coap_separate_accept(void *request, oc_separate_response_t *separate_response,
       coap_set_header_observe(ack, observe);
     }
     coap_set_token(ack, coap_req->token, coap_req->token_len);
-    oc_message_t *message = oc_allocate_message();
+    oc_message_t *message = oc_allocate_small_message();
     if (message != NULL) {
       memcpy(&message->endpoint, endpoint, sizeof(oc_endpoint_t));
       message->length = coap_serialize_message(ack, message->data);
@@ -157,7 +158,14 @@ void
 coap_separate_resume(void *response, coap_separate_t *separate_store,
                      uint8_t code, uint16_t mid)
 {
-  coap_init_message(response, separate_store->type, code, mid);
+#ifdef OC_TCP
+  if (separate_store->endpoint.flags & TCP) {
+    coap_tcp_init_message(response, code);
+  } else
+#endif /* OC_TCP */
+  {
+    coap_init_message(response, separate_store->type, code, mid);
+  }
   if (separate_store->token_len) {
     coap_set_token(response, separate_store->token, separate_store->token_len);
   }
@@ -65,7 +65,8 @@
 #endif
 
 /*---------------------------------------------------------------------------*/
-OC_MEMB(transactions_memb, coap_transaction_t, COAP_MAX_OPEN_TRANSACTIONS);
+OC_MEMB_ZEROED(transactions_memb, coap_transaction_t,
+               COAP_MAX_OPEN_TRANSACTIONS);
 OC_LIST(transactions_list);
 
 static struct oc_process *transaction_handler_process = NULL;
@@ -115,11 +116,14 @@ coap_send_transaction(coap_transaction_t *t)
   OC_DBG("Sending transaction %u\n", t->mid);
   bool confirmable = false;
 
-  confirmable =
-    (COAP_TYPE_CON == ((COAP_HEADER_TYPE_MASK & t->message->data[0]) >>
-                       COAP_HEADER_TYPE_POSITION))
-      ? true
-      : false;
+  /* TCP delivers reliably, so its messages are never retransmitted. */
+  if (!(t->message->endpoint.flags & TCP)) {
+    confirmable =
+      (COAP_TYPE_CON == ((COAP_HEADER_TYPE_MASK & t->message->data[0]) >>
+                         COAP_HEADER_TYPE_POSITION))
+        ? true
+        : false;
+  }
 
   if (confirmable) {
     if (t->retrans_counter < COAP_MAX_RETRANSMIT) {
@@ -83,4 +83,24 @@ oc_storage_write(const char *store, uint8_t *buf, size_t size)
   return size;
 }
 
+long
+oc_storage_append(const char *store, uint8_t *buf, size_t size)
+{
+  int fd;
+  size_t store_len = strlen(store);
+
+  if (!path_set || (store_len + store_path_len >= STORE_PATH_SIZE))
+    return -ENOENT;
+
+  strncpy(store_path + store_path_len, store, store_len);
+  store_path[store_path_len + store_len] = '\0';
+  fd = cfs_open(store_path, CFS_WRITE | CFS_APPEND);
+  if (!fd)
+    return -EINVAL;
+
+  size = cfs_write(fd, buf, size);
+  cfs_close(fd);
+  return size;
+}
+
 #endif /* OC_SECURITY */
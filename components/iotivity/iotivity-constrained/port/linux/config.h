@@ -7,6 +7,20 @@
 typedef uint64_t oc_clock_time_t;
 #define OC_CLOCK_CONF_TICKS_PER_SECOND CLOCKS_PER_SEC
 
+/* Number of threads serving the sockets of all logical devices */
+#define OC_NETWORK_THREADS (1)
+
+/* Signal the event loop from the connectivity layer when the next event
+   returned by oc_main_poll() is due */
+#define OC_CONNECTIVITY_EVENT_TIMER
+
+/* Maximum number of CoAP over TCP connections kept open at a time */
+#define OC_MAX_TCP_PEERS (8)
+
+/* Track current and peak usage, and allocation failures, of every
+   OC_MEMB() pool */
+#define OC_MEMB_STATS
+
 /* Security Layer */
 /* Max inactivity timeout before tearing down DTLS connection */
 #define OC_DTLS_INACTIVITY_TIMEOUT (600)
@@ -16,6 +30,11 @@ typedef uint64_t oc_clock_time_t;
 #define OC_COLLECTIONS
 #define OC_BLOCK_WISE
 
+/* Number of UDP datagrams read with a single recvmmsg() and written with a
+   single sendmmsg(); leave undefined for one recvfrom()/sendto() per
+   datagram */
+#define OC_UDP_BATCH_SIZE (16)
+
 #else /* OC_DYNAMIC_ALLOCATION */
 /* List of constraints below for a build that does not employ dynamic
    memory allocation
@@ -24,6 +43,10 @@ typedef uint64_t oc_clock_time_t;
 #define OC_BYTES_POOL_SIZE (1800)
 #define OC_INTS_POOL_SIZE (100)
 #define OC_DOUBLES_POOL_SIZE (4)
+/* Free blocks in place instead of compacting the pools on every free. The
+   pools are then handed out in 8-byte granules, so every string, however
+   short, takes at least 8 bytes of OC_BYTES_POOL_SIZE. */
+#define OC_MMEM_FREE_LIST
 
 /* Server-side parameters */
 /* Maximum number of server resources */
@@ -57,6 +80,17 @@ typedef uint64_t oc_clock_time_t;
 /* Maximum number of concurrent DTLS sessions */
 #define OC_MAX_DTLS_PEERS (1)
 
+/* Writes to SVR stores are held back and coalesced for up to
+   OC_STORE_MAX_DIRTY stores of at most OC_STORE_RECORD_SIZE bytes each,
+   which takes their product in RAM */
+#define OC_STORE_MAX_DIRTY (2)
+#define OC_STORE_RECORD_SIZE (1024)
+
+/* Maximum number of SVR stores whose contents are tracked between writes,
+   each taking about OC_MAX_APP_DATA_SIZE * 17 / 16 bytes; a store that is not
+   tracked is rewritten in full instead of journaled */
+#define OC_STORE_MAX_HEADS (4 * OC_MAX_NUM_DEVICES)
+
 #endif /* !OC_DYNAMIC_ALLOCATION */
 
 #endif /* CONFIG_H */
@@ -14,11 +14,17 @@
 // limitations under the License.
 */
 
+#define _GNU_SOURCE
 #define __USE_GNU
 #include "oc_buffer.h"
 #include "oc_core_res.h"
 #include "oc_endpoint.h"
+#include "oc_signal_event_loop.h"
+#ifdef OC_TCP
+#include "messaging/coap/coap.h"
+#endif /* OC_TCP */
 #include "port/oc_assert.h"
+#include "port/oc_clock.h"
 #include "port/oc_connectivity.h"
 #include <arpa/inet.h>
 #include <assert.h>
@@ -27,13 +33,20 @@
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
 #include <net/if.h>
+#ifdef OC_TCP
+#include <netinet/tcp.h>
+#endif /* OC_TCP */
 #include <pthread.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
@@ -55,11 +68,44 @@ static const uint8_t ALL_OCF_NODES_SL[] = {
 };
 #define ALL_COAP_NODES_V4 0xe00001bb
 
+#ifndef OC_NETWORK_THREADS
+#define OC_NETWORK_THREADS (1)
+#endif /* !OC_NETWORK_THREADS */
+
+#ifdef OC_TCP
+#ifndef OC_MAX_TCP_PEERS
+#define OC_MAX_TCP_PEERS (4)
+#endif /* !OC_MAX_TCP_PEERS */
+
+/* Messages that may wait for a peer which is slow to take them before its
+ * connection is closed */
+#ifndef OC_MAX_TCP_SEND_QUEUE
+#define OC_MAX_TCP_SEND_QUEUE (16)
+#endif /* !OC_MAX_TCP_SEND_QUEUE */
+
+/* Max-Message-Size to assume until the peer's CSM says otherwise (RFC 8323) */
+#define TCP_DEFAULT_MAX_MESSAGE_SIZE (1152)
+#endif /* OC_TCP */
+
+#define OC_MAX_EPOLL_EVENTS (32)
+#define IP_MAX_SOCKETS (8)
+
 static pthread_mutex_t mutex;
 struct sockaddr_nl ifchange_nl;
 int ifchange_sock;
 bool ifchange_initialized;
 
+/* A descriptor watched by a network reactor. Sockets of a logical device
+ * point back to their ip_context_t; the others are the reactors' control
+ * descriptors.
+ */
+typedef struct
+{
+  struct ip_context_t *dev;
+  int fd;
+  enum transport_flags flags;
+} ip_socket_t;
+
 typedef struct ip_context_t {
   struct ip_context_t *next;
   struct sockaddr_storage mcast;
@@ -84,17 +130,99 @@ typedef struct ip_context_t {
   uint16_t dtls4_port;
 #endif /* OC_SECURITY */
 #endif /* OC_IPV4 */
-  pthread_t event_thread;
-  int terminate;
+#ifdef OC_TCP
+  int tcp_sock;
+  uint16_t tcp_port;
+#ifdef OC_IPV4
+  int tcp4_sock;
+  uint16_t tcp4_port;
+#endif /* OC_IPV4 */
+#endif /* OC_TCP */
+#ifdef OC_UDP_BATCH_SIZE
+  oc_message_t *rx_messages[OC_UDP_BATCH_SIZE];
+  struct mmsghdr tx_msgs[OC_UDP_BATCH_SIZE];
+  struct iovec tx_iov[OC_UDP_BATCH_SIZE];
+  struct sockaddr_storage tx_receivers[OC_UDP_BATCH_SIZE];
+  int tx_socks[OC_UDP_BATCH_SIZE];
+  int num_tx;
+  size_t tx_pdu_size;
+#ifdef OC_DYNAMIC_ALLOCATION
+  uint8_t *tx_data;
+#else  /* OC_DYNAMIC_ALLOCATION */
+  uint8_t tx_data[OC_UDP_BATCH_SIZE * OC_PDU_SIZE];
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#endif /* OC_UDP_BATCH_SIZE */
+  ip_socket_t sockets[IP_MAX_SOCKETS];
+  int num_sockets;
   int device;
 } ip_context_t;
 
+/* Each reactor thread waits on one epoll instance serving the sockets of
+ * all logical devices assigned to it (device % OC_NETWORK_THREADS).
+ * Dispatch happens under the reactor's mutex, and every pass bumps epoch
+ * so that a device can be detached without racing a batch of events that
+ * was already returned by epoll_wait().
+ */
+typedef struct
+{
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  unsigned int epoch;
+  int epoll_fd;
+  ip_socket_t wakeup;
+  int terminate;
+} ip_reactor_t;
+
+static ip_reactor_t reactors[OC_NETWORK_THREADS];
+static ip_socket_t ifchange_socket;
+static ip_socket_t timer_socket;
+static int num_ip_contexts;
+
 #ifdef OC_DYNAMIC_ALLOCATION
 OC_LIST(ip_contexts);
 #else /* OC_DYNAMIC_ALLOCATION */
 static ip_context_t devices[OC_MAX_NUM_DEVICES];
 #endif /* !OC_DYNAMIC_ALLOCATION */
 
+#ifdef OC_UDP_BATCH_SIZE
+/* Outbound datagrams are queued per device and written with sendmmsg()
+ * once the event loop has run through the events that produced them.
+ */
+OC_PROCESS(ip_outbound_flush, "IP outbound flush");
+static bool flush_scheduled;
+#endif /* OC_UDP_BATCH_SIZE */
+
+#ifdef OC_TCP
+/* A CoAP over TCP connection that was accepted from, or opened to, a peer
+ * and is kept open for all later messages exchanged with it. Its socket
+ * never blocks: messages wait in send_q for as long as the connect() is in
+ * progress or the socket takes no more, and a reactor sends the rest once
+ * it finds the socket writable. Slots are never freed, so that an epoll
+ * event which was returned for a connection before it got closed only ever
+ * finds an idle slot (fd -1) or a live one. All slots are guarded by
+ * tcp_mutex: the reactors read from and write to them, and so does the
+ * event loop.
+ */
+typedef struct
+{
+  ip_socket_t socket;
+  struct sockaddr_storage peer;
+  oc_message_t *rx; /* holds a partially received message */
+  OC_LIST_STRUCT(send_q);
+  size_t sent; /* bytes of the first message in send_q already sent */
+  uint32_t peer_max_message_size;
+  uint32_t events; /* what the reactor watches the socket for */
+  bool connecting;
+  oc_clock_time_t last_used;
+} tcp_conn_t;
+
+static tcp_conn_t tcp_conns[OC_MAX_TCP_PEERS];
+static pthread_mutex_t tcp_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void tcp_socket_event(ip_socket_t *ip_socket);
+#endif /* OC_TCP */
+
 void
 oc_network_event_handler_mutex_init(void)
 {
@@ -117,6 +245,7 @@ oc_network_event_handler_mutex_unlock(void)
 
 void oc_network_event_handler_mutex_destroy(void) {
   close(ifchange_sock);
+  ifchange_initialized = false;
   pthread_mutex_destroy(&mutex);
 }
 
@@ -314,181 +443,277 @@ static int process_interface_change_event(void) {
   return ret;
 }
 
-static void *network_event_thread(void *data) {
-  struct sockaddr_storage client;
-  memset(&client, 0, sizeof(struct sockaddr_storage));
-  struct sockaddr_in6 *c = (struct sockaddr_in6 *)&client;
-  socklen_t len = sizeof(client);
+static void
+deliver_message(ip_context_t *dev, oc_message_t *message,
+                struct sockaddr_storage *client, enum transport_flags flags)
+{
+  message->endpoint.flags = flags;
+  message->endpoint.device = dev->device;
 
 #ifdef OC_IPV4
-  struct sockaddr_in *c4 = (struct sockaddr_in *)&client;
-#endif
+  if (flags & IPV4) {
+    struct sockaddr_in *c4 = (struct sockaddr_in *)client;
+    memcpy(message->endpoint.addr.ipv4.address, &c4->sin_addr.s_addr,
+           sizeof(c4->sin_addr.s_addr));
+    message->endpoint.addr.ipv4.port = ntohs(c4->sin_port);
+  } else
+#endif /* OC_IPV4 */
+  {
+    struct sockaddr_in6 *c = (struct sockaddr_in6 *)client;
+    memcpy(message->endpoint.addr.ipv6.address, c->sin6_addr.s6_addr,
+           sizeof(c->sin6_addr.s6_addr));
+    message->endpoint.addr.ipv6.scope = c->sin6_scope_id;
+    message->endpoint.addr.ipv6.port = ntohs(c->sin6_port);
+  }
 
-  ip_context_t *dev = (ip_context_t *)data;
+#ifdef OC_DEBUG
+  PRINT("Incoming message of size %d bytes from ", message->length);
+  PRINTipaddr(message->endpoint);
+  PRINT("\n\n");
+#endif /* OC_DEBUG */
 
-  fd_set rfds, setfds;
-  FD_ZERO(&rfds);
-  /* Monitor network interface changes on the platform from only the 0th logical
-   * device
-   */
-  if (dev->device == 0) {
-    FD_SET(ifchange_sock, &rfds);
+  oc_network_event(message);
+}
+
+#ifdef OC_UDP_BATCH_SIZE
+/* Reads up to OC_UDP_BATCH_SIZE datagrams with one recvmmsg() into the
+ * device's pre-allocated receive buffers, refilling only the ones that
+ * were handed to the stack by the previous call.
+ */
+static void
+read_datagrams(ip_context_t *dev, int sock, enum transport_flags flags)
+{
+  struct mmsghdr msgs[OC_UDP_BATCH_SIZE];
+  struct iovec iov[OC_UDP_BATCH_SIZE];
+  struct sockaddr_storage clients[OC_UDP_BATCH_SIZE];
+  int i, n, count;
+
+  for (n = 0; n < OC_UDP_BATCH_SIZE; n++) {
+    if (!dev->rx_messages[n]) {
+      dev->rx_messages[n] = oc_allocate_message();
+      if (!dev->rx_messages[n]) {
+        break;
+      }
+    }
+    iov[n].iov_base = dev->rx_messages[n]->data;
+    iov[n].iov_len = OC_PDU_SIZE;
+    memset(&msgs[n], 0, sizeof(struct mmsghdr));
+    msgs[n].msg_hdr.msg_name = &clients[n];
+    msgs[n].msg_hdr.msg_namelen = sizeof(clients[n]);
+    msgs[n].msg_hdr.msg_iov = &iov[n];
+    msgs[n].msg_hdr.msg_iovlen = 1;
   }
-  FD_SET(dev->server_sock, &rfds);
-  FD_SET(dev->mcast_sock, &rfds);
-#ifdef OC_SECURITY
-  FD_SET(dev->secure_sock, &rfds);
-#endif /* OC_SECURITY */
 
-#ifdef OC_IPV4
-  FD_SET(dev->server4_sock, &rfds);
-  FD_SET(dev->mcast4_sock, &rfds);
-#ifdef OC_SECURITY
-  FD_SET(dev->secure4_sock, &rfds);
-#endif /* OC_SECURITY */
-#endif /* OC_IPV4 */
+  if (n == 0) {
+    return;
+  }
+
+  count = recvmmsg(sock, msgs, n, MSG_DONTWAIT, NULL);
+  for (i = 0; i < count; i++) {
+    oc_message_t *message = dev->rx_messages[i];
+    dev->rx_messages[i] = NULL;
+    message->length = msgs[i].msg_len;
+    deliver_message(dev, message, &clients[i], flags);
+  }
+}
+#else  /* OC_UDP_BATCH_SIZE */
+static void
+read_datagrams(ip_context_t *dev, int sock, enum transport_flags flags)
+{
+  struct sockaddr_storage client;
+  socklen_t len = sizeof(client);
+  oc_message_t *message = oc_allocate_message();
+
+  if (!message) {
+    return;
+  }
 
+  int count = recvfrom(sock, message->data, OC_PDU_SIZE, 0,
+                       (struct sockaddr *)&client, &len);
+  if (count < 0) {
+    oc_message_unref(message);
+    return;
+  }
+  message->length = count;
+  deliver_message(dev, message, &client, flags);
+}
+#endif /* !OC_UDP_BATCH_SIZE */
+
+static void *
+network_event_thread(void *data)
+{
+  ip_reactor_t *reactor = (ip_reactor_t *)data;
+  struct epoll_event events[OC_MAX_EPOLL_EVENTS];
+  uint64_t count;
   int i, n;
 
-  while (dev->terminate != 1) {
-    len = sizeof(client);
-    setfds = rfds;
-    n = select(FD_SETSIZE, &setfds, NULL, NULL, NULL);
+  while (reactor->terminate != 1) {
+    n = epoll_wait(reactor->epoll_fd, events, OC_MAX_EPOLL_EVENTS, -1);
 
+    pthread_mutex_lock(&reactor->mutex);
     for (i = 0; i < n; i++) {
-      if (dev->device == 0) {
-        if (FD_ISSET(ifchange_sock, &setfds)) {
-          if (process_interface_change_event() < 0) {
-            OC_WRN("caught errors while handling a network interface change\n");
-          }
-          FD_CLR(ifchange_sock, &setfds);
-          continue;
+      ip_socket_t *ip_socket = (ip_socket_t *)events[i].data.ptr;
+      if (ip_socket->flags & TCP) {
+#ifdef OC_TCP
+        tcp_socket_event(ip_socket);
+#endif /* OC_TCP */
+      } else if (ip_socket->dev) {
+        read_datagrams(ip_socket->dev, ip_socket->fd, ip_socket->flags);
+      } else if (ip_socket == &ifchange_socket) {
+        if (process_interface_change_event() < 0) {
+          OC_WRN("caught errors while handling a network interface change\n");
         }
+      } else if (read(ip_socket->fd, &count, sizeof(count)) < 0) {
+        OC_WRN("reading reactor control descriptor %d\n", errno);
+      } else if (ip_socket == &timer_socket) {
+        /* The next event scheduled by oc_main_poll() is due. */
+        _oc_signal_event_loop();
       }
+    }
+    reactor->epoch++;
+    pthread_cond_broadcast(&reactor->cond);
+    pthread_mutex_unlock(&reactor->mutex);
+  }
+  pthread_exit(NULL);
+}
 
-      len = sizeof(client);
-      oc_message_t *message = oc_allocate_message();
+static int
+reactor_add(ip_reactor_t *reactor, ip_socket_t *ip_socket)
+{
+  struct epoll_event event;
+  memset(&event, 0, sizeof(struct epoll_event));
+  event.events = EPOLLIN;
+  event.data.ptr = ip_socket;
+  if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, ip_socket->fd, &event) ==
+      -1) {
+    OC_ERR("adding descriptor %d to epoll %d\n", ip_socket->fd, errno);
+    return -1;
+  }
+  return 0;
+}
 
-      if (!message) {
-        break;
-      }
+static void
+reactor_wakeup(ip_reactor_t *reactor)
+{
+  uint64_t one = 1;
+  if (write(reactor->wakeup.fd, &one, sizeof(one)) < 0) {
+    OC_WRN("waking up network reactor %d\n", errno);
+  }
+}
 
-      if (FD_ISSET(dev->server_sock, &setfds)) {
-        int count = recvfrom(dev->server_sock, message->data, OC_PDU_SIZE, 0,
-                             (struct sockaddr *)&client, &len);
-        if (count < 0) {
-          oc_message_unref(message);
-          continue;
-        }
-        message->length = count;
-        message->endpoint.flags = IPV6;
-        message->endpoint.device = dev->device;
-        FD_CLR(dev->server_sock, &setfds);
-        goto common;
-      }
+static int
+start_reactors(void)
+{
+  int i;
+  for (i = 0; i < OC_NETWORK_THREADS; i++) {
+    ip_reactor_t *reactor = &reactors[i];
+    memset(reactor, 0, sizeof(ip_reactor_t));
+    pthread_mutex_init(&reactor->mutex, NULL);
+    pthread_cond_init(&reactor->cond, NULL);
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    reactor->wakeup.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (reactor->epoll_fd < 0 || reactor->wakeup.fd < 0 ||
+        reactor_add(reactor, &reactor->wakeup) < 0) {
+      OC_ERR("creating network reactor %d\n", errno);
+      return -1;
+    }
+  }
 
-      if (FD_ISSET(dev->mcast_sock, &setfds)) {
-        int count = recvfrom(dev->mcast_sock, message->data, OC_PDU_SIZE, 0,
-                             (struct sockaddr *)&client, &len);
-        if (count < 0) {
-          oc_message_unref(message);
-          continue;
-        }
-        message->length = count;
-        message->endpoint.flags = IPV6 | MULTICAST;
-        message->endpoint.device = dev->device;
-        FD_CLR(dev->mcast_sock, &setfds);
-        goto common;
-      }
+  /* Interface changes and the event loop timer are served by the first
+     reactor. */
+  ifchange_socket.fd = ifchange_sock;
+  timer_socket.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (timer_socket.fd < 0 || reactor_add(&reactors[0], &ifchange_socket) < 0 ||
+      reactor_add(&reactors[0], &timer_socket) < 0) {
+    OC_ERR("creating event loop timer %d\n", errno);
+    return -1;
+  }
 
-#ifdef OC_IPV4
-      if (FD_ISSET(dev->server4_sock, &setfds)) {
-        int count = recvfrom(dev->server4_sock, message->data, OC_PDU_SIZE, 0,
-                             (struct sockaddr *)&client, &len);
-        if (count < 0) {
-          oc_message_unref(message);
-          continue;
-        }
-        message->length = count;
-        message->endpoint.flags = IPV4;
-        message->endpoint.device = dev->device;
-        FD_CLR(dev->server4_sock, &setfds);
-        goto common;
-      }
+  for (i = 0; i < OC_NETWORK_THREADS; i++) {
+    if (pthread_create(&reactors[i].thread, NULL, &network_event_thread,
+                       &reactors[i]) != 0) {
+      OC_ERR("creating network polling thread\n");
+      return -1;
+    }
+  }
+  return 0;
+}
 
-      if (FD_ISSET(dev->mcast4_sock, &setfds)) {
-        int count = recvfrom(dev->mcast4_sock, message->data, OC_PDU_SIZE, 0,
-                             (struct sockaddr *)&client, &len);
-        if (count < 0) {
-          oc_message_unref(message);
-          continue;
-        }
-        message->length = count;
-        message->endpoint.flags = IPV4 | MULTICAST;
-        message->endpoint.device = dev->device;
-        FD_CLR(dev->mcast4_sock, &setfds);
-        goto common;
-      }
-#endif /* OC_IPV4 */
+static void
+stop_reactors(void)
+{
+  int i;
+  for (i = 0; i < OC_NETWORK_THREADS; i++) {
+    reactors[i].terminate = 1;
+    reactor_wakeup(&reactors[i]);
+    pthread_join(reactors[i].thread, NULL);
+    close(reactors[i].epoll_fd);
+    close(reactors[i].wakeup.fd);
+    pthread_mutex_destroy(&reactors[i].mutex);
+    pthread_cond_destroy(&reactors[i].cond);
+  }
+  close(timer_socket.fd);
+}
 
-#ifdef OC_SECURITY
-      if (FD_ISSET(dev->secure_sock, &setfds)) {
-        int count = recvfrom(dev->secure_sock, message->data, OC_PDU_SIZE, 0,
-                             (struct sockaddr *)&client, &len);
-        if (count < 0) {
-          oc_message_unref(message);
-          continue;
-        }
-        message->length = count;
-        message->endpoint.flags = IPV6 | SECURED;
-        message->endpoint.device = dev->device;
-        FD_CLR(dev->secure_sock, &setfds);
-      }
-#ifdef OC_IPV4
-      if (FD_ISSET(dev->secure4_sock, &setfds)) {
-        int count = recvfrom(dev->secure4_sock, message->data, OC_PDU_SIZE, 0,
-                             (struct sockaddr *)&client, &len);
-        if (count < 0) {
-          oc_message_unref(message);
-          continue;
-        }
-        message->length = count;
-        message->endpoint.flags = IPV4 | SECURED;
-        message->endpoint.device = dev->device;
-        FD_CLR(dev->secure4_sock, &setfds);
-      }
-#endif /* OC_IPV4 */
-#endif /* OC_SECURITY */
-    common:
-#ifdef OC_IPV4
-      if (message->endpoint.flags & IPV4) {
-        memcpy(message->endpoint.addr.ipv4.address, &c4->sin_addr.s_addr,
-               sizeof(c4->sin_addr.s_addr));
-        message->endpoint.addr.ipv4.port = ntohs(c4->sin_port);
-      } else if (message->endpoint.flags & IPV6) {
-#else  /* OC_IPV4 */
-      if (message->endpoint.flags & IPV6) {
-#endif /* !OC_IPV4 */
-        memcpy(message->endpoint.addr.ipv6.address, c->sin6_addr.s6_addr,
-               sizeof(c->sin6_addr.s6_addr));
-        message->endpoint.addr.ipv6.scope = c->sin6_scope_id;
-        message->endpoint.addr.ipv6.port = ntohs(c->sin6_port);
-      }
+static void
+add_device_socket(ip_context_t *dev, int fd, enum transport_flags flags)
+{
+  ip_socket_t *ip_socket = &dev->sockets[dev->num_sockets++];
+  ip_socket->dev = dev;
+  ip_socket->fd = fd;
+  ip_socket->flags = flags;
+  reactor_add(&reactors[dev->device % OC_NETWORK_THREADS], ip_socket);
+}
 
-#ifdef OC_DEBUG
-      PRINT("Incoming message of size %d bytes from ", message->length);
-      PRINTipaddr(message->endpoint);
-      PRINT("\n\n");
-#endif /* OC_DEBUG */
+/* Detaches the device's sockets from its reactor and waits for the reactor
+ * to finish any batch of events it may already hold for them.
+ */
+static void
+remove_device_sockets(ip_context_t *dev)
+{
+  ip_reactor_t *reactor = &reactors[dev->device % OC_NETWORK_THREADS];
+  int i;
+
+  pthread_mutex_lock(&reactor->mutex);
+  for (i = 0; i < dev->num_sockets; i++) {
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, dev->sockets[i].fd, NULL);
+  }
+  dev->num_sockets = 0;
+  unsigned int epoch = reactor->epoch;
+  reactor_wakeup(reactor);
+  while (reactor->epoch == epoch) {
+    pthread_cond_wait(&reactor->cond, &reactor->mutex);
+  }
+  pthread_mutex_unlock(&reactor->mutex);
+}
+
+void
+oc_connectivity_set_event_timer(oc_clock_time_t next_event)
+{
+  struct itimerspec timeout;
+
+  if (num_ip_contexts == 0) {
+    return;
+  }
 
-      oc_network_event(message);
+  memset(&timeout, 0, sizeof(struct itimerspec));
+  if (next_event != 0) {
+    oc_clock_time_t now = oc_clock_time();
+    oc_clock_time_t ticks = (next_event > now) ? next_event - now : 0;
+    timeout.it_value.tv_sec = ticks / OC_CLOCK_SECOND;
+    timeout.it_value.tv_nsec =
+      (ticks % OC_CLOCK_SECOND) * (1000000000 / OC_CLOCK_SECOND);
+    if (ticks == 0) {
+      /* A zero it_value would disarm the timer. */
+      timeout.it_value.tv_nsec = 1;
     }
   }
-  pthread_exit(NULL);
+  timerfd_settime(timer_socket.fd, 0, &timeout, NULL);
 }
 
 static void
-get_interface_addresses(unsigned char family, uint16_t port, bool secure)
+get_interface_addresses(unsigned char family, uint16_t port,
+                        enum transport_flags flags)
 {
   struct
   {
@@ -586,9 +811,7 @@ get_interface_addresses(unsigned char family, uint16_t port, bool secure)
         if (addrmsg->ifa_scope == RT_SCOPE_LINK && family == AF_INET6) {
           ep.addr.ipv6.scope = addrmsg->ifa_index;
         }
-        if (secure) {
-          ep.flags |= SECURED;
-        }
+        ep.flags |= flags;
 #ifdef OC_IPV4
         if (family == AF_INET) {
           ep.addr.ipv4.port = port;
@@ -614,74 +837,755 @@ oc_connectivity_get_endpoints(int device)
 {
   oc_init_endpoint_list();
   ip_context_t *dev = get_ip_context_for_device(device);
-  get_interface_addresses(AF_INET6, dev->port, false);
+  get_interface_addresses(AF_INET6, dev->port, 0);
 #ifdef OC_SECURITY
-  get_interface_addresses(AF_INET6, dev->dtls_port, true);
+  get_interface_addresses(AF_INET6, dev->dtls_port, SECURED);
 #endif /* OC_SECURITY */
 #ifdef OC_IPV4
-  get_interface_addresses(AF_INET, dev->port4, false);
+  get_interface_addresses(AF_INET, dev->port4, 0);
 #ifdef OC_SECURITY
-  get_interface_addresses(AF_INET, dev->dtls4_port, true);
+  get_interface_addresses(AF_INET, dev->dtls4_port, SECURED);
 #endif /* OC_SECURITY */
 #endif /* OC_IPV4 */
+#ifdef OC_TCP
+  get_interface_addresses(AF_INET6, dev->tcp_port, TCP);
+#ifdef OC_IPV4
+  get_interface_addresses(AF_INET, dev->tcp4_port, TCP);
+#endif /* OC_IPV4 */
+#endif /* OC_TCP */
   return oc_get_endpoint_list();
 }
 
-void oc_send_buffer(oc_message_t *message) {
-#ifdef OC_DEBUG
-  PRINT("Outgoing message of size %d bytes to ", message->length);
-  PRINTipaddr(message->endpoint);
-  PRINT("\n\n");
-#endif /* OC_DEBUG */
+static int
+get_send_socket(ip_context_t *dev, oc_endpoint_t *endpoint)
+{
+  (void)endpoint;
+#ifdef OC_SECURITY
+  if (endpoint->flags & SECURED) {
+#ifdef OC_IPV4
+    if (endpoint->flags & IPV4) {
+      return dev->secure4_sock;
+    }
+#endif /* OC_IPV4 */
+    return dev->secure_sock;
+  }
+#endif /* OC_SECURITY */
+#ifdef OC_IPV4
+  if (endpoint->flags & IPV4) {
+    return dev->server4_sock;
+  }
+#endif /* OC_IPV4 */
+  return dev->server_sock;
+}
 
-  struct sockaddr_storage receiver;
-  memset(&receiver, 0, sizeof(struct sockaddr_storage));
+static void
+set_receiver(struct sockaddr_storage *receiver, oc_endpoint_t *endpoint)
+{
+  memset(receiver, 0, sizeof(struct sockaddr_storage));
 #ifdef OC_IPV4
-  if (message->endpoint.flags & IPV4) {
-    struct sockaddr_in *r = (struct sockaddr_in *)&receiver;
-    memcpy(&r->sin_addr.s_addr, message->endpoint.addr.ipv4.address,
+  if (endpoint->flags & IPV4) {
+    struct sockaddr_in *r = (struct sockaddr_in *)receiver;
+    memcpy(&r->sin_addr.s_addr, endpoint->addr.ipv4.address,
            sizeof(r->sin_addr.s_addr));
     r->sin_family = AF_INET;
-    r->sin_port = htons(message->endpoint.addr.ipv4.port);
-  } else {
-#else
+    r->sin_port = htons(endpoint->addr.ipv4.port);
+  } else
+#endif /* OC_IPV4 */
   {
-#endif
-    struct sockaddr_in6 *r = (struct sockaddr_in6 *)&receiver;
-    memcpy(r->sin6_addr.s6_addr, message->endpoint.addr.ipv6.address,
+    struct sockaddr_in6 *r = (struct sockaddr_in6 *)receiver;
+    memcpy(r->sin6_addr.s6_addr, endpoint->addr.ipv6.address,
            sizeof(r->sin6_addr.s6_addr));
     r->sin6_family = AF_INET6;
-    r->sin6_port = htons(message->endpoint.addr.ipv6.port);
-    r->sin6_scope_id = message->endpoint.addr.ipv6.scope;
+    r->sin6_port = htons(endpoint->addr.ipv6.port);
+    r->sin6_scope_id = endpoint->addr.ipv6.scope;
   }
-  int send_sock = -1;
+}
 
-  ip_context_t *dev = get_ip_context_for_device(message->endpoint.device);
+#ifdef OC_UDP_BATCH_SIZE
+/* Writes the device's queued datagrams, one sendmmsg() per run of
+ * datagrams that leave through the same socket.
+ */
+static void
+flush_outbound(ip_context_t *dev)
+{
+  int i = 0, run, x;
+
+  while (i < dev->num_tx) {
+    for (run = 1; i + run < dev->num_tx &&
+                  dev->tx_socks[i + run] == dev->tx_socks[i];
+         run++)
+      ;
+    x = sendmmsg(dev->tx_socks[i], &dev->tx_msgs[i], run, 0);
+    if (x <= 0) {
+      OC_WRN("sendmmsg() returned errno %d\n", errno);
+      /* Drop the datagram at the head of the run and carry on. */
+      x = 1;
+    }
+    OC_DBG("Sent %d datagrams\n", x);
+    i += x;
+  }
+  dev->num_tx = 0;
+}
 
-#ifdef OC_SECURITY
-  if (message->endpoint.flags & SECURED) {
-#ifdef OC_IPV4
-    if (message->endpoint.flags & IPV4) {
-      send_sock = dev->secure4_sock;
+static void
+flush_all_outbound(void)
+{
+  flush_scheduled = false;
+#ifdef OC_DYNAMIC_ALLOCATION
+  ip_context_t *dev = oc_list_head(ip_contexts);
+  while (dev != NULL) {
+    flush_outbound(dev);
+    dev = dev->next;
+  }
+#else  /* OC_DYNAMIC_ALLOCATION */
+  int i;
+  for (i = 0; i < OC_MAX_NUM_DEVICES; i++) {
+    flush_outbound(&devices[i]);
+  }
+#endif /* !OC_DYNAMIC_ALLOCATION */
+}
+
+OC_PROCESS_THREAD(ip_outbound_flush, ev, data)
+{
+  (void)ev;
+  (void)data;
+  OC_PROCESS_BEGIN();
+  while (1) {
+    OC_PROCESS_YIELD();
+    flush_all_outbound();
+  }
+  OC_PROCESS_END();
+}
+
+/* Copies the datagram to the device's outbound queue. Returns false if it
+ * has to be sent right away instead.
+ */
+static bool
+queue_outbound(ip_context_t *dev, int sock, oc_message_t *message)
+{
+  if (message->length > dev->tx_pdu_size) {
+    flush_outbound(dev);
+    return false;
+  }
+
+  int i = dev->num_tx++;
+  uint8_t *buffer = dev->tx_data + i * dev->tx_pdu_size;
+  memcpy(buffer, message->data, message->length);
+  set_receiver(&dev->tx_receivers[i], &message->endpoint);
+  dev->tx_socks[i] = sock;
+  dev->tx_iov[i].iov_base = buffer;
+  dev->tx_iov[i].iov_len = message->length;
+  memset(&dev->tx_msgs[i], 0, sizeof(struct mmsghdr));
+  dev->tx_msgs[i].msg_hdr.msg_name = &dev->tx_receivers[i];
+  dev->tx_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+  dev->tx_msgs[i].msg_hdr.msg_iov = &dev->tx_iov[i];
+  dev->tx_msgs[i].msg_hdr.msg_iovlen = 1;
+
+  if (dev->num_tx == OC_UDP_BATCH_SIZE) {
+    flush_outbound(dev);
+  } else if (!flush_scheduled) {
+    if (oc_process_post(&ip_outbound_flush, OC_PROCESS_EVENT_CONTINUE, NULL) ==
+        OC_PROCESS_ERR_OK) {
+      flush_scheduled = true;
     } else {
-      send_sock = dev->secure_sock;
+      flush_outbound(dev);
     }
-#else  /* OC_IPV4 */
-    send_sock = dev->secure_sock;
-#endif /* !OC_IPV4 */
-  } else
-#endif /* OC_SECURITY */
+  }
+  return true;
+}
+#endif /* OC_UDP_BATCH_SIZE */
+
+#ifdef OC_TCP
+static tcp_conn_t *
+tcp_get_conn(ip_socket_t *ip_socket)
+{
+  uintptr_t p = (uintptr_t)ip_socket;
+  if (p < (uintptr_t)tcp_conns ||
+      p >= (uintptr_t)(tcp_conns + OC_MAX_TCP_PEERS)) {
+    return NULL;
+  }
+  return (tcp_conn_t *)ip_socket;
+}
+
+static void
+tcp_close(tcp_conn_t *conn)
+{
+  OC_DBG("closing TCP connection %d\n", conn->socket.fd);
+  ip_reactor_t *reactor =
+    &reactors[conn->socket.dev->device % OC_NETWORK_THREADS];
+  epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, conn->socket.fd, NULL);
+  close(conn->socket.fd);
+  conn->socket.fd = -1;
+  conn->socket.dev = NULL;
+  conn->events = 0;
+  conn->connecting = false;
+  if (conn->rx) {
+    oc_message_unref(conn->rx);
+    conn->rx = NULL;
+  }
+  oc_message_t *message = (oc_message_t *)oc_list_pop(conn->send_q);
+  while (message != NULL) {
+    oc_message_unref(message);
+    message = (oc_message_t *)oc_list_pop(conn->send_q);
+  }
+}
+
+static int
+tcp_watch(tcp_conn_t *conn, uint32_t events)
+{
+  if (events == conn->events) {
+    return 0;
+  }
+  ip_reactor_t *reactor =
+    &reactors[conn->socket.dev->device % OC_NETWORK_THREADS];
+  struct epoll_event event;
+  memset(&event, 0, sizeof(struct epoll_event));
+  event.events = events;
+  event.data.ptr = &conn->socket;
+  if (epoll_ctl(reactor->epoll_fd, conn->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                conn->socket.fd, &event) == -1) {
+    OC_ERR("watching TCP connection %d: errno %d\n", conn->socket.fd, errno);
+    return -1;
+  }
+  conn->events = events;
+  return 0;
+}
+
+/* Sends as much of the waiting messages as the socket takes without
+ * blocking, and has the reactor watch for it becoming writable while any
+ * are left. Returns -1 if the connection is to be closed.
+ */
+static int
+tcp_flush(tcp_conn_t *conn)
+{
+  oc_message_t *message = (oc_message_t *)oc_list_head(conn->send_q);
+  while (message != NULL) {
+    ssize_t x = send(conn->socket.fd, message->data + conn->sent,
+                     message->length - conn->sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (x < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      OC_WRN("send() returned errno %d\n", errno);
+      return -1;
+    }
+    conn->sent += x;
+    if (conn->sent == message->length) {
+      oc_list_pop(conn->send_q);
+      oc_message_unref(message);
+      conn->sent = 0;
+      conn->last_used = oc_clock_time();
+      message = (oc_message_t *)oc_list_head(conn->send_q);
+    }
+  }
+  return tcp_watch(conn, message ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+}
+
+/* Sends the message after those already waiting for the socket, unless it
+ * is larger than the peer takes. Returns -1 if the connection is to be
+ * closed.
+ */
+static int
+tcp_write(tcp_conn_t *conn, oc_message_t *message)
+{
+  if (message->length > conn->peer_max_message_size) {
+    OC_WRN("dropping TCP message of %u bytes; the peer takes at most %u\n",
+           (unsigned int)message->length,
+           (unsigned int)conn->peer_max_message_size);
+    return 0;
+  }
+  if (oc_list_length(conn->send_q) >= OC_MAX_TCP_SEND_QUEUE) {
+    OC_WRN("TCP connection %d is not keeping up\n", conn->socket.fd);
+    return -1;
+  }
+  oc_message_add_ref(message);
+  oc_list_add(conn->send_q, message);
+  return conn->connecting ? 0 : tcp_flush(conn);
+}
+
+/* Sends a signaling message that was built in a buffer of our own. */
+static int
+tcp_write_signal(tcp_conn_t *conn, const uint8_t *data, size_t length)
+{
+  oc_message_t *message = oc_allocate_message();
+  if (!message) {
+    OC_WRN("no buffer for a TCP signaling message\n");
+    return -1;
+  }
+  memcpy(message->data, data, length);
+  message->length = length;
+  int ret = tcp_write(conn, message);
+  oc_message_unref(message);
+  return ret;
+}
+
+/* Every peer sends a Capabilities and Settings Message first. Ours
+ * announces the largest message this port can receive.
+ */
+static int
+tcp_send_csm(tcp_conn_t *conn)
+{
+  uint8_t csm[COAP_TCP_DEFAULT_HEADER_LEN + 5];
+  uint32_t max_message_size = (uint32_t)OC_PDU_SIZE;
+  uint8_t value_len = (max_message_size > 0xffff) ? 4 : 2;
+  size_t len = coap_tcp_serialize_header(csm, 0, CSM_7_01, 1 + value_len);
+  csm[len++] = (COAP_SIGNAL_OPTION_MAX_MESSAGE_SIZE << 4) | value_len;
+  while (value_len-- > 0) {
+    csm[len++] = (uint8_t)(max_message_size >> (8 * value_len));
+  }
+  return tcp_write_signal(conn, csm, len);
+}
+
+/* Takes the Max-Message-Size from the options of a peer's CSM; the others
+ * concern features this port does not use.
+ */
+static void
+tcp_read_csm(tcp_conn_t *conn, const uint8_t *option, const uint8_t *end)
+{
+  unsigned int number = 0;
+  while (option < end && *option != 0xff) {
+    unsigned int delta = *option >> 4, len = *option & 0x0f;
+    option++;
+    if (delta == 15 || len == 15) {
+      return;
+    }
+    if (delta >= 13) {
+      if (option + delta - 12 > end) {
+        return;
+      }
+      delta = (delta == 13) ? 13u + option[0]
+                            : 269u + ((unsigned int)option[0] << 8 | option[1]);
+      option += (delta < 269) ? 1 : 2;
+    }
+    if (len >= 13) {
+      if (option + len - 12 > end) {
+        return;
+      }
+      len = (len == 13) ? 13u + option[0]
+                        : 269u + ((unsigned int)option[0] << 8 | option[1]);
+      option += (len < 269) ? 1 : 2;
+    }
+    if (option + len > end) {
+      return;
+    }
+    number += delta;
+    if (number == COAP_SIGNAL_OPTION_MAX_MESSAGE_SIZE && len <= 4) {
+      uint32_t value = 0;
+      unsigned int i;
+      for (i = 0; i < len; i++) {
+        value = (value << 8) | option[i];
+      }
+      conn->peer_max_message_size = value;
+    }
+    option += len;
+  }
+}
+
+/* Sets up a socket in a free slot, or in the one that has been idle the
+ * longest when all slots are taken. Our CSM is the first message to wait
+ * for a socket whose connect() is still in progress, which is watched for
+ * becoming writable. Called with tcp_mutex held.
+ */
+static tcp_conn_t *
+tcp_add_conn(ip_context_t *dev, int fd, struct sockaddr_storage *peer,
+             bool connecting)
+{
+  tcp_conn_t *conn = NULL;
+  int i;
+  for (i = 0; i < OC_MAX_TCP_PEERS; i++) {
+    if (tcp_conns[i].socket.fd == -1) {
+      conn = &tcp_conns[i];
+      break;
+    }
+    if (!conn || tcp_conns[i].last_used < conn->last_used) {
+      conn = &tcp_conns[i];
+    }
+  }
+  if (conn->socket.fd != -1) {
+    OC_DBG("all TCP connections in use; closing the least recently used\n");
+    tcp_close(conn);
+  }
+
+  int opt = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+  conn->socket.dev = dev;
+  conn->socket.fd = fd;
+  conn->socket.flags = TCP | ((peer->ss_family == AF_INET6) ? IPV6 : IPV4);
+  memcpy(&conn->peer, peer, sizeof(struct sockaddr_storage));
+  OC_LIST_STRUCT_INIT(conn, send_q);
+  conn->sent = 0;
+  conn->peer_max_message_size = TCP_DEFAULT_MAX_MESSAGE_SIZE;
+  conn->connecting = connecting;
+  conn->last_used = oc_clock_time();
+
+  if (tcp_send_csm(conn) < 0 ||
+      (connecting && tcp_watch(conn, EPOLLOUT) < 0)) {
+    tcp_close(conn);
+    return NULL;
+  }
+  return conn;
+}
+
+static bool
+tcp_peer_matches(tcp_conn_t *conn, ip_context_t *dev,
+                 struct sockaddr_storage *peer)
+{
+  if (conn->socket.fd == -1 || conn->socket.dev != dev ||
+      conn->peer.ss_family != peer->ss_family) {
+    return false;
+  }
 #ifdef OC_IPV4
-    if (message->endpoint.flags & IPV4) {
-    send_sock = dev->server4_sock;
+  if (peer->ss_family == AF_INET) {
+    struct sockaddr_in *a = (struct sockaddr_in *)&conn->peer;
+    struct sockaddr_in *b = (struct sockaddr_in *)peer;
+    return a->sin_port == b->sin_port &&
+           a->sin_addr.s_addr == b->sin_addr.s_addr;
+  }
+#endif /* OC_IPV4 */
+  struct sockaddr_in6 *a = (struct sockaddr_in6 *)&conn->peer;
+  struct sockaddr_in6 *b = (struct sockaddr_in6 *)peer;
+  return a->sin6_port == b->sin6_port &&
+         memcmp(&a->sin6_addr, &b->sin6_addr, sizeof(a->sin6_addr)) == 0;
+}
+
+/* Starts opening a connection to the peer, which a reactor completes in
+ * tcp_finish_connect().
+ */
+static tcp_conn_t *
+tcp_connect(ip_context_t *dev, struct sockaddr_storage *peer)
+{
+  int fd = socket(peer->ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  IPPROTO_TCP);
+  if (fd < 0) {
+    OC_ERR("creating TCP socket %d\n", errno);
+    return NULL;
+  }
+  bool connecting = false;
+  if (connect(fd, (struct sockaddr *)peer, sizeof(struct sockaddr_storage)) <
+      0) {
+    if (errno != EINPROGRESS) {
+      OC_WRN("connect() returned errno %d\n", errno);
+      close(fd);
+      return NULL;
+    }
+    connecting = true;
+  }
+  OC_DBG("opening TCP connection %d\n", fd);
+  return tcp_add_conn(dev, fd, peer, connecting);
+}
+
+/* Called by a reactor once the socket of a connection being opened is
+ * writable: either the connect() failed and the connection is closed along
+ * with the messages waiting for it, or they are sent, starting with our CSM.
+ */
+static void
+tcp_finish_connect(tcp_conn_t *conn)
+{
+  int error = 0;
+  socklen_t len = sizeof(error);
+  if (getsockopt(conn->socket.fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 ||
+      error != 0) {
+    OC_WRN("connect() failed with errno %d\n", error ? error : errno);
+    tcp_close(conn);
+    return;
+  }
+  struct sockaddr_storage addr;
+  len = sizeof(addr);
+  if (getpeername(conn->socket.fd, (struct sockaddr *)&addr, &len) < 0) {
+    /* An event for an earlier connection in this slot; still in progress */
+    return;
+  }
+  OC_DBG("opened TCP connection %d\n", conn->socket.fd);
+  conn->connecting = false;
+  if (tcp_flush(conn) < 0) {
+    tcp_close(conn);
+  }
+}
+
+/* Sends the message over the connection to its endpoint, which is opened
+ * first if there is none.
+ */
+static void
+tcp_send(ip_context_t *dev, oc_message_t *message)
+{
+  struct sockaddr_storage receiver;
+  set_receiver(&receiver, &message->endpoint);
+
+  pthread_mutex_lock(&tcp_mutex);
+  tcp_conn_t *conn = NULL;
+  int i;
+  for (i = 0; i < OC_MAX_TCP_PEERS; i++) {
+    if (tcp_peer_matches(&tcp_conns[i], dev, &receiver)) {
+      conn = &tcp_conns[i];
+      break;
+    }
+  }
+  if (!conn) {
+    conn = tcp_connect(dev, &receiver);
+  }
+  if (conn && tcp_write(conn, message) < 0) {
+    tcp_close(conn);
+  }
+  pthread_mutex_unlock(&tcp_mutex);
+}
+
+/* Handles the signaling messages of RFC 8323 and passes all others on to
+ * the stack. Returns -1 if the connection is to be closed.
+ */
+static int
+tcp_handle_message(tcp_conn_t *conn, oc_message_t *message)
+{
+  uint8_t *data = message->data;
+  uint8_t len = data[0] >> COAP_TCP_HEADER_LEN_POSITION;
+  size_t header_len = COAP_TCP_DEFAULT_HEADER_LEN;
+  if (len >= COAP_TCP_EXTENDED_LENGTH_1) {
+    header_len += 1 << (len - COAP_TCP_EXTENDED_LENGTH_1);
+  }
+  uint8_t code = data[header_len - 1];
+
+  if (code < CSM_7_01) {
+    deliver_message(conn->socket.dev, message, &conn->peer,
+                    conn->socket.flags);
+    return 0;
+  }
+
+  int ret = 0;
+  if (code == PING_7_02) {
+    uint8_t pong[COAP_TCP_DEFAULT_HEADER_LEN + COAP_TOKEN_LEN];
+    uint8_t token_len = data[0] & COAP_HEADER_TOKEN_LEN_MASK;
+    if (token_len > COAP_TOKEN_LEN) {
+      token_len = COAP_TOKEN_LEN;
+    }
+    size_t pong_len = coap_tcp_serialize_header(pong, token_len, PONG_7_03, 0);
+    memcpy(pong + pong_len, data + header_len, token_len);
+    ret = tcp_write_signal(conn, pong, pong_len + token_len);
+  } else if (code == CSM_7_01) {
+    uint8_t token_len = data[0] & COAP_HEADER_TOKEN_LEN_MASK;
+    tcp_read_csm(conn, data + header_len + token_len, data + message->length);
+  } else if (code == RELEASE_7_04 || code == ABORT_7_05) {
+    OC_DBG("peer released TCP connection %d\n", conn->socket.fd);
+    ret = -1;
+  }
+  oc_message_unref(message);
+  return ret;
+}
+
+/* Hands every complete message in the receive buffer to
+ * tcp_handle_message(), and moves what is left of a partial one to the
+ * front. A buffer that holds exactly one message is handed on without
+ * copying it.
+ */
+static int
+tcp_process_messages(tcp_conn_t *conn)
+{
+  oc_message_t *rx = conn->rx;
+  size_t pos = 0;
+
+  while (pos < rx->length) {
+    uint8_t *data = rx->data + pos;
+    size_t available = rx->length - pos;
+    uint8_t len = data[0] >> COAP_TCP_HEADER_LEN_POSITION;
+    size_t length_bytes = 1;
+    if (len >= COAP_TCP_EXTENDED_LENGTH_1) {
+      length_bytes += 1 << (len - COAP_TCP_EXTENDED_LENGTH_1);
+    }
+    if (available < length_bytes) {
+      break;
+    }
+    size_t size = coap_tcp_get_packet_size(data);
+    if (size > (size_t)OC_PDU_SIZE) {
+      OC_WRN("incoming TCP message of %u bytes is too large\n",
+             (unsigned int)size);
+      return -1;
+    }
+    if (available < size) {
+      break;
+    }
+    oc_message_t *message = rx;
+    if (pos == 0 && size == rx->length) {
+      conn->rx = NULL;
+    } else {
+      message = oc_allocate_message();
+      if (message) {
+        memcpy(message->data, data, size);
+      }
+    }
+    pos += size;
+    if (!message) {
+      OC_WRN("dropping incoming TCP message; out of buffers\n");
+      continue;
+    }
+    message->length = size;
+    if (tcp_handle_message(conn, message) < 0) {
+      return -1;
+    }
+    if (!conn->rx) {
+      return 0;
+    }
+  }
+
+  rx->length -= pos;
+  if (rx->length == 0) {
+    oc_message_unref(rx);
+    conn->rx = NULL;
+  } else if (pos > 0) {
+    memmove(rx->data, rx->data + pos, rx->length);
+  }
+  return 0;
+}
+
+static void
+tcp_receive(tcp_conn_t *conn)
+{
+  while (1) {
+    if (!conn->rx) {
+      conn->rx = oc_allocate_message();
+      if (!conn->rx) {
+        return;
+      }
+    }
+    oc_message_t *rx = conn->rx;
+    ssize_t count = recv(conn->socket.fd, rx->data + rx->length,
+                         OC_PDU_SIZE - rx->length, MSG_DONTWAIT);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (rx->length == 0) {
+        oc_message_unref(rx);
+        conn->rx = NULL;
+      }
+      return;
+    }
+    if (count <= 0) {
+      OC_DBG("TCP connection %d closed by peer\n", conn->socket.fd);
+      tcp_close(conn);
+      return;
+    }
+    rx->length += count;
+    conn->last_used = oc_clock_time();
+    if (tcp_process_messages(conn) < 0) {
+      tcp_close(conn);
+      return;
+    }
+  }
+}
+
+static void
+tcp_accept(ip_context_t *dev, int listen_sock)
+{
+  struct sockaddr_storage peer;
+  socklen_t len = sizeof(peer);
+  memset(&peer, 0, sizeof(peer));
+  int fd = accept4(listen_sock, (struct sockaddr *)&peer, &len,
+                   SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0) {
+    OC_WRN("accept() returned errno %d\n", errno);
+    return;
+  }
+  OC_DBG("accepted TCP connection %d\n", fd);
+  pthread_mutex_lock(&tcp_mutex);
+  tcp_add_conn(dev, fd, &peer, false);
+  pthread_mutex_unlock(&tcp_mutex);
+}
+
+/* Called by a reactor for a device's listening socket or a connection. */
+static void
+tcp_socket_event(ip_socket_t *ip_socket)
+{
+  tcp_conn_t *conn = tcp_get_conn(ip_socket);
+  if (!conn) {
+    tcp_accept(ip_socket->dev, ip_socket->fd);
+    return;
+  }
+  pthread_mutex_lock(&tcp_mutex);
+  if (conn->socket.fd != -1 && conn->connecting) {
+    tcp_finish_connect(conn);
+  } else if (conn->socket.fd != -1 && tcp_flush(conn) < 0) {
+    tcp_close(conn);
+  } else if (conn->socket.fd != -1) {
+    tcp_receive(conn);
+  }
+  pthread_mutex_unlock(&tcp_mutex);
+}
+
+static void
+tcp_close_device_conns(ip_context_t *dev)
+{
+  int i;
+  pthread_mutex_lock(&tcp_mutex);
+  for (i = 0; i < OC_MAX_TCP_PEERS; i++) {
+    if (tcp_conns[i].socket.fd != -1 && tcp_conns[i].socket.dev == dev) {
+      tcp_close(&tcp_conns[i]);
+    }
+  }
+  pthread_mutex_unlock(&tcp_mutex);
+}
+
+static int
+tcp_listen(int family, uint16_t *port)
+{
+  struct sockaddr_storage addr;
+  socklen_t socklen = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.ss_family = family;
+
+  int sock = socket(family, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+  if (sock < 0) {
+    OC_ERR("creating TCP socket %d\n", errno);
+    return -1;
+  }
+  int opt = 1;
+  if (family == AF_INET6 &&
+      setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt)) == -1) {
+    OC_ERR("setting sock option %d\n", errno);
+    close(sock);
+    return -1;
+  }
+  if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+      listen(sock, SOMAXCONN) == -1 ||
+      getsockname(sock, (struct sockaddr *)&addr, &socklen) == -1) {
+    OC_ERR("setting up TCP socket %d\n", errno);
+    close(sock);
+    return -1;
+  }
+  if (family == AF_INET6) {
+    *port = ntohs(((struct sockaddr_in6 *)&addr)->sin6_port);
   } else {
-    send_sock = dev->server_sock;
+    *port = ntohs(((struct sockaddr_in *)&addr)->sin_port);
   }
-#else  /* OC_IPV4 */
-  {
-    send_sock = dev->server_sock;
+  return sock;
+}
+#endif /* OC_TCP */
+
+void oc_send_buffer(oc_message_t *message) {
+#ifdef OC_DEBUG
+  PRINT("Outgoing message of size %d bytes to ", message->length);
+  PRINTipaddr(message->endpoint);
+  PRINT("\n\n");
+#endif /* OC_DEBUG */
+
+  ip_context_t *dev = get_ip_context_for_device(message->endpoint.device);
+#ifdef OC_TCP
+  if (message->endpoint.flags & TCP) {
+    tcp_send(dev, message);
+    return;
   }
-#endif /* !OC_IPV4 */
+#endif /* OC_TCP */
+  int send_sock = get_send_socket(dev, &message->endpoint);
+
+#ifdef OC_UDP_BATCH_SIZE
+  if (queue_outbound(dev, send_sock, message)) {
+    return;
+  }
+#endif /* OC_UDP_BATCH_SIZE */
+
+  struct sockaddr_storage receiver;
+  set_receiver(&receiver, &message->endpoint);
 
   int bytes_sent = 0, x;
   while (bytes_sent < (int)message->length) {
@@ -725,6 +1629,9 @@ oc_send_discovery_request(oc_message_t *message)
         }
         message->endpoint.addr.ipv6.scope = mif;
         oc_send_buffer(message);
+#ifdef OC_UDP_BATCH_SIZE
+        flush_outbound(dev);
+#endif /* OC_UDP_BATCH_SIZE */
       }
 #ifdef OC_IPV4
     } else if (message->endpoint.flags & IPV4 && interface->ifa_addr &&
@@ -737,6 +1644,9 @@ oc_send_discovery_request(oc_message_t *message)
         goto done;
       }
       oc_send_buffer(message);
+#ifdef OC_UDP_BATCH_SIZE
+      flush_outbound(dev);
+#endif /* OC_UDP_BATCH_SIZE */
     }
 #else  /* OC_IPV4 */
     }
@@ -860,6 +1770,22 @@ int oc_connectivity_init(int device) {
   ip_context_t *dev = &devices[device];
 #endif /* !OC_DYNAMIC_ALLOCATION */
   dev->device = device;
+  dev->num_sockets = 0;
+
+#ifdef OC_UDP_BATCH_SIZE
+  dev->num_tx = 0;
+  dev->tx_pdu_size = OC_PDU_SIZE;
+#ifdef OC_DYNAMIC_ALLOCATION
+  dev->tx_data = (uint8_t *)malloc(OC_UDP_BATCH_SIZE * dev->tx_pdu_size);
+  if (!dev->tx_data) {
+    oc_abort("Insufficient memory");
+  }
+#endif /* OC_DYNAMIC_ALLOCATION */
+  if (num_ip_contexts == 0) {
+    flush_scheduled = false;
+    oc_process_start(&ip_outbound_flush, NULL);
+  }
+#endif /* OC_UDP_BATCH_SIZE */
 
   memset(&dev->mcast, 0, sizeof(struct sockaddr_storage));
   memset(&dev->server, 0, sizeof(struct sockaddr_storage));
@@ -964,6 +1890,19 @@ int oc_connectivity_init(int device) {
   }
 #endif /* OC_IPV4 */
 
+#ifdef OC_TCP
+  dev->tcp_sock = tcp_listen(AF_INET6, &dev->tcp_port);
+  if (dev->tcp_sock < 0) {
+    return -1;
+  }
+#ifdef OC_IPV4
+  dev->tcp4_sock = tcp_listen(AF_INET, &dev->tcp4_port);
+  if (dev->tcp4_sock < 0) {
+    return -1;
+  }
+#endif /* OC_IPV4 */
+#endif /* OC_TCP */
+
   /* Netlink socket to listen for network interface changes.
    * Only initialized once, and change events are captured by only
    * the network event thread for the 0th logical device.
@@ -988,12 +1927,37 @@ int oc_connectivity_init(int device) {
     ifchange_initialized = true;
   }
 
-  if (pthread_create(&dev->event_thread, NULL, &network_event_thread, dev) !=
-      0) {
-    OC_ERR("creating network polling thread\n");
-    return -1;
+  if (num_ip_contexts++ == 0) {
+#ifdef OC_TCP
+    int i;
+    for (i = 0; i < OC_MAX_TCP_PEERS; i++) {
+      tcp_conns[i].socket.fd = -1;
+    }
+#endif /* OC_TCP */
+    if (start_reactors() < 0) {
+      return -1;
+    }
   }
 
+  add_device_socket(dev, dev->server_sock, IPV6);
+  add_device_socket(dev, dev->mcast_sock, IPV6 | MULTICAST);
+#ifdef OC_SECURITY
+  add_device_socket(dev, dev->secure_sock, IPV6 | SECURED);
+#endif /* OC_SECURITY */
+#ifdef OC_IPV4
+  add_device_socket(dev, dev->server4_sock, IPV4);
+  add_device_socket(dev, dev->mcast4_sock, IPV4 | MULTICAST);
+#ifdef OC_SECURITY
+  add_device_socket(dev, dev->secure4_sock, IPV4 | SECURED);
+#endif /* OC_SECURITY */
+#endif /* OC_IPV4 */
+#ifdef OC_TCP
+  add_device_socket(dev, dev->tcp_sock, IPV6 | TCP);
+#ifdef OC_IPV4
+  add_device_socket(dev, dev->tcp4_sock, IPV4 | TCP);
+#endif /* OC_IPV4 */
+#endif /* OC_TCP */
+
   OC_DBG("Successfully initialized connectivity for device %d\n", device);
 
   return 0;
@@ -1003,7 +1967,21 @@ void
 oc_connectivity_shutdown(int device)
 {
   ip_context_t *dev = get_ip_context_for_device(device);
-  dev->terminate = 1;
+
+  remove_device_sockets(dev);
+#ifdef OC_TCP
+  tcp_close_device_conns(dev);
+#endif /* OC_TCP */
+  if (--num_ip_contexts == 0) {
+    stop_reactors();
+  }
+
+#ifdef OC_UDP_BATCH_SIZE
+  flush_outbound(dev);
+  if (num_ip_contexts == 0) {
+    oc_process_exit(&ip_outbound_flush);
+  }
+#endif /* OC_UDP_BATCH_SIZE */
 
   close(dev->server_sock);
   close(dev->mcast_sock);
@@ -1020,8 +1998,23 @@ oc_connectivity_shutdown(int device)
 #endif /* OC_IPV4 */
 #endif /* OC_SECURITY */
 
-  pthread_cancel(dev->event_thread);
-  pthread_join(dev->event_thread, NULL);
+#ifdef OC_TCP
+  close(dev->tcp_sock);
+#ifdef OC_IPV4
+  close(dev->tcp4_sock);
+#endif /* OC_IPV4 */
+#endif /* OC_TCP */
+
+#ifdef OC_UDP_BATCH_SIZE
+  int i;
+  for (i = 0; i < OC_UDP_BATCH_SIZE; i++) {
+    oc_message_unref(dev->rx_messages[i]);
+    dev->rx_messages[i] = NULL;
+  }
+#ifdef OC_DYNAMIC_ALLOCATION
+  free(dev->tx_data);
+#endif /* OC_DYNAMIC_ALLOCATION */
+#endif /* OC_UDP_BATCH_SIZE */
 
 #ifdef OC_DYNAMIC_ALLOCATION
   oc_list_remove(ip_contexts, dev);
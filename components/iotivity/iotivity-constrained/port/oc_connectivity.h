@@ -136,6 +136,13 @@ struct oc_message_s
 
 void oc_send_buffer(oc_message_t *message);
 
+#ifdef OC_CONNECTIVITY_EVENT_TIMER
+/* Called by oc_main_poll() with the time of the next scheduled event, or 0
+   if there is none, so that the port can signal the event loop when it is
+   due. */
+void oc_connectivity_set_event_timer(oc_clock_time_t next_event);
+#endif /* OC_CONNECTIVITY_EVENT_TIMER */
+
 int oc_connectivity_init(int device);
 
 void oc_connectivity_shutdown(int device);
@@ -23,5 +23,6 @@
 int oc_storage_config(const char *store);
 long oc_storage_read(const char *store, uint8_t *buf, size_t size);
 long oc_storage_write(const char *store, uint8_t *buf, size_t size);
+long oc_storage_append(const char *store, uint8_t *buf, size_t size);
 
 #endif /* OC_STORAGE_H */
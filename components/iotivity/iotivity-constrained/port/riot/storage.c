@@ -42,4 +42,13 @@ oc_storage_write(const char *store, uint8_t *buf, size_t size)
   (void)size;
   return size;
 }
+
+long
+oc_storage_append(const char *store, uint8_t *buf, size_t size)
+{
+  (void)store;
+  (void)buf;
+  (void)size;
+  return size;
+}
 #endif /* OC_SECURITY */
@@ -89,4 +89,24 @@ oc_storage_write(const char *store, uint8_t *buf, size_t size)
   fclose(fp);
   return size;
 }
+
+long
+oc_storage_append(const char *store, uint8_t *buf, size_t size)
+{
+  FILE *fp;
+  size_t store_len = strlen(store);
+
+  if (!path_set || (store_len + store_path_len >= STORE_PATH_SIZE))
+    return -ENOENT;
+
+  strncpy(store_path + store_path_len, store, store_len);
+  store_path[store_path_len + store_len] = '\0';
+  fp = fopen(store_path, "ab");
+  if (!fp)
+    return -EINVAL;
+
+  size = fwrite(buf, 1, size, fp);
+  fclose(fp);
+  return size;
+}
 #endif /* OC_SECURITY */
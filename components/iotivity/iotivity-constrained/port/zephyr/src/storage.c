@@ -386,4 +386,17 @@ oc_storage_write(const char *store, uint8_t *buf, size_t size)
   return size;
 }
 
+/*
+ * Stores are erased and rewritten as a whole, so appending is not supported;
+ * callers fall back to oc_storage_write().
+ */
+long
+oc_storage_append(const char *store, uint8_t *buf, size_t size)
+{
+  (void)store;
+  (void)buf;
+  (void)size;
+  return -ENOTSUP;
+}
+
 #endif /* OC_SECURITY */
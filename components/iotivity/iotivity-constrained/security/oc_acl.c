@@ -27,17 +27,50 @@
 #include "oc_pstat.h"
 #include "oc_rep.h"
 #include "oc_store.h"
+#include "util/oc_hash.h"
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
 extern int strncasecmp(const char *s1, const char *s2, size_t n);
 
+#ifndef OC_ACL_CACHE_SIZE
+#ifdef OC_DYNAMIC_ALLOCATION
+#define OC_ACL_CACHE_SIZE (64)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define OC_ACL_CACHE_SIZE (8)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#endif /* !OC_ACL_CACHE_SIZE */
+
+/* Direct-mapped cache of the permissions that the ACL grants a subject on
+   a resource over a given kind of connection. Entries stamped with an older
+   generation are stale; changes to the ACL, to credentials, to the set of
+   resources, and to the discoverability, types or interfaces of a resource
+   that ACEs match against bump the device's generation. */
+typedef struct
+{
+  oc_resource_t *resource;
+  uint32_t generation;
+  oc_uuid_t uuid;
+  bool has_uuid;
+  bool secured;
+  uint16_t permission;
+} oc_acl_cache_entry_t;
+
+typedef struct
+{
+  uint32_t generation;
+  oc_acl_cache_entry_t entries[OC_ACL_CACHE_SIZE];
+  oc_sec_acl_cache_stats_t stats;
+} oc_acl_cache_t;
+
 #ifdef OC_DYNAMIC_ALLOCATION
 #include "port/oc_assert.h"
 static oc_sec_acl_t *aclist;
+static oc_acl_cache_t *acl_cache;
 #else /* OC_DYNAMIC_ALLOCATION */
 static oc_sec_acl_t aclist[OC_MAX_NUM_DEVICES];
+static oc_acl_cache_t acl_cache[OC_MAX_NUM_DEVICES];
 #endif /* !OC_DYNAMIC_ALLOCATION */
 
 static const char *auth_crypt = "auth-crypt";
@@ -49,8 +82,9 @@ static const char *wc_non_discoverable = "-";
 #define MAX_NUM_RES_PERM_PAIRS                                                 \
   ((OC_MAX_NUM_SUBJECTS + 2) *                                                 \
    (OC_MAX_APP_RESOURCES + OCF_D * OC_MAX_NUM_DEVICES))
-OC_MEMB(ace_l, oc_sec_ace_t, MAX_NUM_RES_PERM_PAIRS);
-OC_MEMB(res_l, oc_ace_res_t, OC_MAX_APP_RESOURCES + OCF_D * OC_MAX_NUM_DEVICES);
+OC_MEMB_ZEROED(ace_l, oc_sec_ace_t, MAX_NUM_RES_PERM_PAIRS);
+OC_MEMB_ZEROED(res_l, oc_ace_res_t,
+               OC_MAX_APP_RESOURCES + OCF_D * OC_MAX_NUM_DEVICES);
 
 void
 oc_sec_acl_init(void)
@@ -58,7 +92,9 @@ oc_sec_acl_init(void)
 #ifdef OC_DYNAMIC_ALLOCATION
   aclist =
     (oc_sec_acl_t *)calloc(oc_core_get_num_devices(), sizeof(oc_sec_acl_t));
-  if (!aclist) {
+  acl_cache =
+    (oc_acl_cache_t *)calloc(oc_core_get_num_devices(), sizeof(oc_acl_cache_t));
+  if (!aclist || !acl_cache) {
     oc_abort("Insufficient memory");
   }
 #endif /* OC_DYNAMIC_ALLOCATION */
@@ -74,6 +110,24 @@ oc_sec_get_acl(int device)
   return &aclist[device];
 }
 
+void
+oc_sec_acl_invalidate_cache(int device)
+{
+#ifdef OC_DYNAMIC_ALLOCATION
+  /* Resources are set up before the SVRs are. */
+  if (!acl_cache) {
+    return;
+  }
+#endif /* OC_DYNAMIC_ALLOCATION */
+  acl_cache[device].generation++;
+}
+
+void
+oc_sec_acl_get_cache_stats(int device, oc_sec_acl_cache_stats_t *stats)
+{
+  *stats = acl_cache[device].stats;
+}
+
 static bool
 unique_aceid(int aceid, int device)
 {
@@ -310,48 +364,19 @@ dump_acl(int device)
 }
 #endif /* OC_DEBUG */
 
-bool
-oc_sec_check_acl(oc_method_t method, oc_resource_t *resource,
-                 oc_endpoint_t *endpoint)
+static uint16_t
+oc_sec_get_permission(oc_resource_t *resource, oc_uuid_t *uuid, bool secured,
+                      int device)
 {
 #ifdef OC_DEBUG
-  dump_acl(endpoint->device);
+  dump_acl(device);
 #endif /* OC_DEBUG */
-  oc_uuid_t *uuid = oc_sec_dtls_get_peer_uuid(endpoint);
-
-  if (uuid) {
-    oc_sec_doxm_t *doxm = oc_sec_get_doxm(endpoint->device);
-    oc_sec_creds_t *creds = oc_sec_get_creds(endpoint->device);
-    oc_sec_pstat_t *pstat = oc_sec_get_pstat(endpoint->device);
-    if (memcmp(uuid->id, aclist[endpoint->device].rowneruuid.id, 16) == 0 &&
-        memcmp(oc_string(resource->uri), "/oic/sec/acl2", 12) == 0) {
-      OC_DBG("oc_acl: peer's UUID matches acl2's rowneruuid\n");
-      return true;
-    }
-    if (memcmp(uuid->id, doxm->rowneruuid.id, 16) == 0 &&
-        memcmp(oc_string(resource->uri), "/oic/sec/doxm", 13) == 0) {
-      OC_DBG("oc_acl: peer's UUID matches doxm's rowneruuid\n");
-      return true;
-    }
-    if (memcmp(uuid->id, pstat->rowneruuid.id, 16) == 0 &&
-        memcmp(oc_string(resource->uri), "/oic/sec/pstat", 14) == 0) {
-      OC_DBG("oc_acl: peer's UUID matches pstat's rowneruuid\n");
-      return true;
-    }
-    if (memcmp(uuid->id, creds->rowneruuid.id, 16) == 0 &&
-        memcmp(oc_string(resource->uri), "/oic/sec/cred", 13) == 0) {
-      OC_DBG("oc_acl: peer's UUID matches cred's rowneruuid\n");
-      return true;
-    }
-  }
-
   uint16_t permission = 0;
   oc_sec_ace_t *match = NULL;
   if (uuid) {
     do {
       match = oc_sec_acl_find_subject(match, OC_SUBJECT_UUID,
-                                      (oc_ace_subject_t *)uuid, -1, 0,
-                                      endpoint->device);
+                                      (oc_ace_subject_t *)uuid, -1, 0, device);
 
       if (match) {
         permission |= oc_ace_get_permission(match, resource);
@@ -360,12 +385,12 @@ oc_sec_check_acl(oc_method_t method, oc_resource_t *resource,
       }
     } while (match);
 
-    oc_sec_cred_t *role_cred = oc_sec_find_cred(uuid, endpoint->device);
+    oc_sec_cred_t *role_cred = oc_sec_find_cred(uuid, device);
     if (role_cred && oc_string_len(role_cred->role.role) > 0) {
       do {
         match = oc_sec_acl_find_subject(match, OC_SUBJECT_ROLE,
                                         (oc_ace_subject_t *)&role_cred->role,
-                                        -1, 0, endpoint->device);
+                                        -1, 0, device);
 
         if (match) {
           permission |= oc_ace_get_permission(match, resource);
@@ -377,13 +402,13 @@ oc_sec_check_acl(oc_method_t method, oc_resource_t *resource,
     }
   }
 
-  if (endpoint->flags & SECURED) {
+  if (secured) {
     oc_ace_subject_t _auth_crypt;
     memset(&_auth_crypt, 0, sizeof(oc_ace_subject_t));
     _auth_crypt.conn = OC_CONN_AUTH_CRYPT;
     do {
       match = oc_sec_acl_find_subject(match, OC_SUBJECT_CONN, &_auth_crypt, -1,
-                                      0, endpoint->device);
+                                      0, device);
       if (match) {
         permission |= oc_ace_get_permission(match, resource);
         OC_DBG("oc_check_acl: Found ACE with permission %d for auth-crypt "
@@ -398,7 +423,7 @@ oc_sec_check_acl(oc_method_t method, oc_resource_t *resource,
   _anon_clear.conn = OC_CONN_ANON_CLEAR;
   do {
     match = oc_sec_acl_find_subject(match, OC_SUBJECT_CONN, &_anon_clear, -1, 0,
-                                    endpoint->device);
+                                    device);
     if (match) {
       permission |= oc_ace_get_permission(match, resource);
       OC_DBG("oc_check_acl: Found ACE with permission %d for anon-clear "
@@ -407,6 +432,82 @@ oc_sec_check_acl(oc_method_t method, oc_resource_t *resource,
     }
   } while (match);
 
+  return permission;
+}
+
+static uint32_t
+acl_cache_hash(oc_resource_t *resource, oc_uuid_t *uuid, bool secured)
+{
+  uint8_t is_secured = secured ? 1 : 0;
+  uint32_t hash = oc_fnv1a(OC_FNV1A_INIT, &resource, sizeof(resource));
+  if (uuid) {
+    hash = oc_fnv1a(hash, uuid->id, sizeof(uuid->id));
+  }
+  return oc_fnv1a(hash, &is_secured, sizeof(is_secured));
+}
+
+static uint16_t
+oc_sec_get_cached_permission(oc_resource_t *resource, oc_uuid_t *uuid,
+                             bool secured, int device)
+{
+  oc_acl_cache_t *cache = &acl_cache[device];
+  oc_acl_cache_entry_t *entry =
+    &cache->entries[acl_cache_hash(resource, uuid, secured) %
+                    OC_ACL_CACHE_SIZE];
+  if (entry->resource == resource &&
+      entry->generation == cache->generation && entry->secured == secured &&
+      entry->has_uuid == (uuid != NULL) &&
+      (!uuid || memcmp(entry->uuid.id, uuid->id, 16) == 0)) {
+    cache->stats.hits++;
+    return entry->permission;
+  }
+  cache->stats.misses++;
+  entry->permission = oc_sec_get_permission(resource, uuid, secured, device);
+  entry->resource = resource;
+  entry->generation = cache->generation;
+  entry->secured = secured;
+  entry->has_uuid = (uuid != NULL);
+  if (uuid) {
+    memcpy(entry->uuid.id, uuid->id, 16);
+  }
+  return entry->permission;
+}
+
+bool
+oc_sec_check_acl(oc_method_t method, oc_resource_t *resource,
+                 oc_endpoint_t *endpoint)
+{
+  oc_uuid_t *uuid = oc_sec_dtls_get_peer_uuid(endpoint);
+
+  if (uuid) {
+    oc_sec_doxm_t *doxm = oc_sec_get_doxm(endpoint->device);
+    oc_sec_creds_t *creds = oc_sec_get_creds(endpoint->device);
+    oc_sec_pstat_t *pstat = oc_sec_get_pstat(endpoint->device);
+    if (memcmp(uuid->id, aclist[endpoint->device].rowneruuid.id, 16) == 0 &&
+        memcmp(oc_string(resource->uri), "/oic/sec/acl2", 12) == 0) {
+      OC_DBG("oc_acl: peer's UUID matches acl2's rowneruuid\n");
+      return true;
+    }
+    if (memcmp(uuid->id, doxm->rowneruuid.id, 16) == 0 &&
+        memcmp(oc_string(resource->uri), "/oic/sec/doxm", 13) == 0) {
+      OC_DBG("oc_acl: peer's UUID matches doxm's rowneruuid\n");
+      return true;
+    }
+    if (memcmp(uuid->id, pstat->rowneruuid.id, 16) == 0 &&
+        memcmp(oc_string(resource->uri), "/oic/sec/pstat", 14) == 0) {
+      OC_DBG("oc_acl: peer's UUID matches pstat's rowneruuid\n");
+      return true;
+    }
+    if (memcmp(uuid->id, creds->rowneruuid.id, 16) == 0 &&
+        memcmp(oc_string(resource->uri), "/oic/sec/cred", 13) == 0) {
+      OC_DBG("oc_acl: peer's UUID matches cred's rowneruuid\n");
+      return true;
+    }
+  }
+
+  uint16_t permission = oc_sec_get_cached_permission(
+    resource, uuid, (endpoint->flags & SECURED) != 0, endpoint->device);
+
   if (permission != 0) {
     switch (method) {
     case OC_GET:
@@ -542,6 +643,7 @@ got_ace:
   goto done;
 
 new_ace:
+  oc_sec_acl_invalidate_cache(device);
   ace = oc_memb_alloc(&ace_l);
 
   if (!ace) {
@@ -590,6 +692,7 @@ new_ace:
   oc_list_add(aclist[device].subjects, ace);
 
 new_res:
+  oc_sec_acl_invalidate_cache(device);
   res = oc_memb_alloc(&res_l);
 
   if (res) {
@@ -649,6 +752,7 @@ oc_sec_ace_update_res(oc_ace_subject_type_t type, oc_ace_subject_t *subject,
 static void
 oc_ace_free_resources(int device, oc_sec_ace_t **ace, const char *href)
 {
+  oc_sec_acl_invalidate_cache(device);
   oc_ace_res_t *res = (oc_ace_res_t *)oc_list_head((*ace)->resources),
                *next = NULL;
   while (res != NULL) {
@@ -683,6 +787,7 @@ oc_acl_remove_ace(int aceid, int device)
   while (ace != NULL) {
     next = ace->next;
     if (ace->aceid == aceid) {
+      oc_sec_acl_invalidate_cache(device);
       oc_ace_free_resources(device, &ace, NULL);
       oc_list_remove(aclist[device].subjects, ace);
       oc_memb_free(&ace_l, ace);
@@ -698,6 +803,7 @@ static void
 oc_sec_clear_acl(int device)
 {
   oc_sec_acl_t *acl_d = &aclist[device];
+  oc_sec_acl_invalidate_cache(device);
   oc_sec_ace_t *ace = (oc_sec_ace_t *)oc_list_pop(acl_d->subjects);
   while (ace != NULL) {
     oc_ace_free_resources(device, &ace, NULL);
@@ -88,6 +88,12 @@ typedef struct
   oc_uuid_t rowneruuid;
 } oc_sec_acl_t;
 
+typedef struct
+{
+  uint32_t hits;
+  uint32_t misses;
+} oc_sec_acl_cache_stats_t;
+
 void oc_sec_acl_init(void);
 oc_sec_acl_t *oc_sec_get_acl(int device);
 void oc_sec_acl_default(int device);
@@ -100,6 +106,8 @@ void delete_acl(oc_request_t *request, oc_interface_mask_t interface,
                 void *data);
 bool oc_sec_check_acl(oc_method_t method, oc_resource_t *resource,
                       oc_endpoint_t *endpoint);
+void oc_sec_acl_invalidate_cache(int device);
+void oc_sec_acl_get_cache_stats(int device, oc_sec_acl_cache_stats_t *stats);
 void oc_sec_set_post_otm_acl(int device);
 
 #endif /* OC_ACL_H */
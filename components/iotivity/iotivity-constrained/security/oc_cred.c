@@ -18,6 +18,7 @@
 
 #include "oc_cred.h"
 #include "config.h"
+#include "oc_acl.h"
 #include "oc_api.h"
 #include "oc_base64.h"
 #include "oc_core_res.h"
@@ -30,7 +31,8 @@
 #include "util/oc_memb.h"
 #include <stdlib.h>
 
-OC_MEMB(creds, oc_sec_cred_t, OC_MAX_NUM_DEVICES *OC_MAX_NUM_SUBJECTS + 1);
+OC_MEMB_ZEROED(creds, oc_sec_cred_t,
+               OC_MAX_NUM_DEVICES *OC_MAX_NUM_SUBJECTS + 1);
 #define OXM_JUST_WORKS "oic.sec.doxm.jw"
 
 #ifdef OC_DYNAMIC_ALLOCATION
@@ -43,6 +45,7 @@ static oc_sec_creds_t devices[OC_MAX_NUM_DEVICES];
 void
 oc_sec_cred_default(int device)
 {
+  oc_sec_acl_invalidate_cache(device);
   oc_sec_cred_t *cred = (oc_sec_cred_t *)oc_list_pop(devices[device].creds);
   while (cred != NULL) {
     oc_memb_free(&creds, cred);
@@ -100,6 +103,7 @@ oc_sec_remove_cred(oc_sec_cred_t *cred, int device)
 {
   oc_list_remove(devices[device].creds, cred);
   if (oc_string_len(cred->role.role) > 0) {
+    oc_sec_acl_invalidate_cache(device);
     oc_free_string(&cred->role.role);
     if (oc_string_len(cred->role.authority) > 0) {
       oc_free_string(&cred->role.authority);
@@ -357,6 +361,7 @@ oc_sec_decode_cred(oc_rep_t *rep, oc_sec_cred_t **owner, bool from_storage,
           credobj->credid = credid;
           credobj->credtype = credtype;
           if (role) {
+            oc_sec_acl_invalidate_cache(device);
             oc_new_string(&credobj->role.role, oc_string(*role),
                           oc_string_len(*role));
             if (authority) {
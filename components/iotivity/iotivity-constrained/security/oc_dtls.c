@@ -45,8 +45,50 @@
 #include "oc_svr.h"
 
 OC_PROCESS(oc_dtls_handler, "DTLS Process");
-OC_MEMB(dtls_peers_s, oc_sec_dtls_peer_t, OC_MAX_DTLS_PEERS);
-OC_LIST(dtls_peers);
+OC_MEMB_ZEROED(dtls_peers_s, oc_sec_dtls_peer_t, OC_MAX_DTLS_PEERS);
+
+/* Peers are hashed by endpoint for lookups on every datagram, and by
+   address so that events posted for a peer can be validated without
+   touching memory that may already have been freed. Peers whose handshake
+   is in progress are also kept on a separate list, which is all that the
+   retransmission timer needs to walk. */
+static oc_sec_dtls_peer_t *endpoint_index[OC_DTLS_PEER_BUCKETS];
+static oc_sec_dtls_peer_t *active_index[OC_DTLS_PEER_BUCKETS];
+static oc_sec_dtls_peer_t *handshake_peers;
+
+#ifndef OC_DTLS_SESSION_CACHE_SIZE
+#ifdef OC_DYNAMIC_ALLOCATION
+#define OC_DTLS_SESSION_CACHE_SIZE (64)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define OC_DTLS_SESSION_CACHE_SIZE (2)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#endif /* !OC_DTLS_SESSION_CACHE_SIZE */
+
+/* Sessions of completed PSK handshakes, most recently used first. Server
+   entries are found by session ID from a ClientHello, client entries by the
+   endpoint of the server they were established with. */
+OC_MEMB_ZEROED(dtls_sessions_s, oc_sec_dtls_session_t,
+               OC_DTLS_SESSION_CACHE_SIZE);
+OC_LIST(dtls_sessions);
+static int num_sessions;
+
+#define PEER_LINK_INSERT(head, p, link)                                        \
+  do {                                                                         \
+    (p)->link.next = *(head);                                                  \
+    if (*(head))                                                               \
+      (*(head))->link.pprev = &(p)->link.next;                                 \
+    (p)->link.pprev = (head);                                                  \
+    *(head) = (p);                                                             \
+  } while (0)
+
+#define PEER_LINK_REMOVE(p, link)                                              \
+  do {                                                                         \
+    *(p)->link.pprev = (p)->link.next;                                         \
+    if ((p)->link.next)                                                        \
+      (p)->link.next->link.pprev = (p)->link.pprev;                            \
+    (p)->link.next = NULL;                                                     \
+    (p)->link.pprev = NULL;                                                    \
+  } while (0)
 
 static mbedtls_entropy_context entropy_ctx;
 static mbedtls_ctr_drbg_context ctr_drbg_ctx;
@@ -84,13 +126,27 @@ static void oc_mbedtls_debug(void *ctx, int level, const char *file, int line,
 }
 #endif /* OC_DEBUG */
 
+static oc_sec_dtls_peer_t **
+endpoint_bucket(oc_endpoint_t *endpoint)
+{
+  return &endpoint_index[oc_endpoint_hash(endpoint) &
+                         (OC_DTLS_PEER_BUCKETS - 1)];
+}
+
+static oc_sec_dtls_peer_t **
+active_bucket(oc_sec_dtls_peer_t *peer)
+{
+  return &active_index[((uintptr_t)peer / sizeof(oc_sec_dtls_peer_t)) &
+                       (OC_DTLS_PEER_BUCKETS - 1)];
+}
+
 static bool is_peer_active(oc_sec_dtls_peer_t *peer) {
-  oc_sec_dtls_peer_t *p = (oc_sec_dtls_peer_t *)oc_list_head(dtls_peers);
+  oc_sec_dtls_peer_t *p = *active_bucket(peer);
   while (p != NULL) {
     if (p == peer) {
       return true;
     }
-    p = p->next;
+    p = p->active_link.next;
   }
   return false;
 }
@@ -98,15 +154,191 @@ static bool is_peer_active(oc_sec_dtls_peer_t *peer) {
 static oc_sec_dtls_peer_t *
 oc_sec_dtls_get_peer(oc_endpoint_t *endpoint)
 {
-  oc_sec_dtls_peer_t *peer = oc_list_head(dtls_peers);
+  oc_sec_dtls_peer_t *peer = *endpoint_bucket(endpoint);
   while (peer != NULL) {
     if (oc_endpoint_compare(&peer->endpoint, endpoint) == 0) {
       return peer;
     }
-    peer = peer->next;
+    peer = peer->endpoint_link.next;
+  }
+  return NULL;
+}
+
+static void
+free_session(oc_sec_dtls_session_t *entry)
+{
+  oc_list_remove(dtls_sessions, entry);
+  mbedtls_ssl_session_free(&entry->session);
+  oc_memb_free(&dtls_sessions_s, entry);
+  num_sessions--;
+}
+
+static oc_sec_dtls_session_t *
+alloc_session(int role, int device)
+{
+  if (num_sessions >= OC_DTLS_SESSION_CACHE_SIZE) {
+    OC_DBG("oc_dtls: evicting least recently used session\n");
+    free_session((oc_sec_dtls_session_t *)oc_list_tail(dtls_sessions));
+  }
+  oc_sec_dtls_session_t *entry = oc_memb_alloc(&dtls_sessions_s);
+  if (entry) {
+    memset(entry, 0, sizeof(oc_sec_dtls_session_t));
+    entry->role = role;
+    entry->device = device;
+    oc_list_push(dtls_sessions, entry);
+    num_sessions++;
+  }
+  return entry;
+}
+
+static oc_sec_dtls_session_t *
+find_server_session(int device, const unsigned char *id, size_t id_len)
+{
+  oc_sec_dtls_session_t *entry = oc_list_head(dtls_sessions);
+  while (entry != NULL) {
+    if (entry->role == MBEDTLS_SSL_IS_SERVER && entry->device == device &&
+        entry->session.id_len == id_len &&
+        memcmp(entry->session.id, id, id_len) == 0) {
+      return entry;
+    }
+    entry = entry->next;
+  }
+  return NULL;
+}
+
+#ifdef OC_CLIENT
+static oc_sec_dtls_session_t *
+find_client_session(oc_endpoint_t *endpoint)
+{
+  oc_sec_dtls_session_t *entry = oc_list_head(dtls_sessions);
+  while (entry != NULL) {
+    if (entry->role == MBEDTLS_SSL_IS_CLIENT &&
+        oc_endpoint_compare(&entry->endpoint, endpoint) == 0) {
+      return entry;
+    }
+    entry = entry->next;
   }
   return NULL;
 }
+#endif /* OC_CLIENT */
+
+static void
+touch_session(oc_sec_dtls_session_t *entry)
+{
+  oc_list_remove(dtls_sessions, entry);
+  oc_list_push(dtls_sessions, entry);
+}
+
+static int
+get_session_cb(void *data, mbedtls_ssl_session *session)
+{
+  int device = (int)((mbedtls_ssl_config *)data - server_conf);
+  oc_sec_dtls_session_t *entry =
+    find_server_session(device, session->id, session->id_len);
+  if (!entry || !entry->authenticated ||
+      entry->session.ciphersuite != session->ciphersuite ||
+      entry->session.compression != session->compression) {
+    return -1;
+  }
+  /* Sessions only outlive the credential they were authenticated with. */
+  oc_sec_cred_t *cred = oc_sec_find_cred(&entry->uuid, device);
+  if (!cred || memcmp(cred->key, entry->psk, sizeof(entry->psk)) != 0) {
+    OC_DBG("oc_dtls: dropping session of a stale credential\n");
+    free_session(entry);
+    return -1;
+  }
+  OC_DBG("oc_dtls: resuming cached session\n");
+  memcpy(session->master, entry->session.master, sizeof(session->master));
+  session->verify_result = entry->session.verify_result;
+  touch_session(entry);
+  return 0;
+}
+
+static int
+set_session_cb(void *data, const mbedtls_ssl_session *session)
+{
+  if (session->ciphersuite != MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256) {
+    return -1;
+  }
+  int device = (int)((mbedtls_ssl_config *)data - server_conf);
+  oc_sec_dtls_session_t *entry = alloc_session(MBEDTLS_SSL_IS_SERVER, device);
+  if (!entry) {
+    return -1;
+  }
+  entry->session.ciphersuite = session->ciphersuite;
+  entry->session.compression = session->compression;
+  entry->session.id_len = session->id_len;
+  memcpy(entry->session.id, session->id, session->id_len);
+  memcpy(entry->session.master, session->master, sizeof(session->master));
+  entry->session.verify_result = session->verify_result;
+  return 0;
+}
+
+/* Binds a server session to the identity that the PSK callback resolved
+   during the full handshake, and restores that identity on resumption,
+   where the PSK callback does not run. */
+static void
+on_handshake_complete(oc_sec_dtls_peer_t *peer)
+{
+  mbedtls_ssl_session *session = peer->ssl_ctx.session;
+  if (peer->role != MBEDTLS_SSL_IS_SERVER || !session) {
+    return;
+  }
+  oc_sec_dtls_session_t *entry = find_server_session(
+    peer->endpoint.device, session->id, session->id_len);
+  if (!entry) {
+    return;
+  }
+  if (entry->authenticated) {
+    memcpy(peer->uuid.id, entry->uuid.id, 16);
+    return;
+  }
+  oc_sec_cred_t *cred = oc_sec_find_cred(&peer->uuid, peer->endpoint.device);
+  if (cred) {
+    memcpy(entry->uuid.id, peer->uuid.id, 16);
+    memcpy(entry->psk, cred->key, sizeof(entry->psk));
+    entry->authenticated = true;
+  } else {
+    free_session(entry);
+  }
+}
+
+#ifdef OC_CLIENT
+static void
+save_client_session(oc_sec_dtls_peer_t *peer)
+{
+  if (peer->ssl_ctx.state != MBEDTLS_SSL_HANDSHAKE_OVER ||
+      peer->ssl_ctx.session->ciphersuite !=
+        MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256) {
+    return;
+  }
+  oc_sec_dtls_session_t *entry = find_client_session(&peer->endpoint);
+  if (entry) {
+    free_session(entry);
+  }
+  entry = alloc_session(MBEDTLS_SSL_IS_CLIENT, peer->endpoint.device);
+  if (entry) {
+    memcpy(&entry->endpoint, &peer->endpoint, sizeof(oc_endpoint_t));
+    if (mbedtls_ssl_get_session(&peer->ssl_ctx, &entry->session) != 0) {
+      free_session(entry);
+    }
+  }
+}
+#endif /* OC_CLIENT */
+
+/* Keeps the handshake list in step with the state of the SSL context; called
+   after every operation that can advance or restart a handshake. */
+static void
+update_handshake_state(oc_sec_dtls_peer_t *peer)
+{
+  bool pending = (peer->ssl_ctx.state != MBEDTLS_SSL_HANDSHAKE_OVER);
+  if (pending && !peer->handshake_link.pprev) {
+    PEER_LINK_INSERT(&handshake_peers, peer, handshake_link);
+  } else if (!pending && peer->handshake_link.pprev) {
+    PEER_LINK_REMOVE(peer, handshake_link);
+    on_handshake_complete(peer);
+  }
+}
 
 static oc_event_callback_retval_t oc_sec_dtls_inactive(void *data);
 
@@ -119,6 +351,11 @@ oc_sec_dtls_remove_peer(oc_endpoint_t *endpoint, bool inactivity_cb)
     if (!inactivity_cb) {
       oc_ri_remove_timed_event_callback(peer, oc_sec_dtls_inactive);
     }
+#ifdef OC_CLIENT
+    if (peer->role == MBEDTLS_SSL_IS_CLIENT) {
+      save_client_session(peer);
+    }
+#endif /* OC_CLIENT */
     mbedtls_ssl_free(&peer->ssl_ctx);
     oc_message_t *message = (oc_message_t *)oc_list_pop(peer->send_q);
     while (message != NULL) {
@@ -131,7 +368,11 @@ oc_sec_dtls_remove_peer(oc_endpoint_t *endpoint, bool inactivity_cb)
       message = (oc_message_t *)oc_list_pop(peer->recv_q);
     }
     oc_etimer_stop(&peer->timer.fin_timer);
-    oc_list_remove(dtls_peers, peer);
+    PEER_LINK_REMOVE(peer, endpoint_link);
+    PEER_LINK_REMOVE(peer, active_link);
+    if (peer->handshake_link.pprev) {
+      PEER_LINK_REMOVE(peer, handshake_link);
+    }
     oc_memb_free(&dtls_peers_s, peer);
   }
 }
@@ -208,32 +449,33 @@ ssl_send(void *ctx, const unsigned char *buf, size_t len)
 static void
 check_retr_timers()
 {
-  oc_sec_dtls_peer_t *peer = (oc_sec_dtls_peer_t *)oc_list_head(dtls_peers),
-                     *next;
+  oc_sec_dtls_peer_t *peer = handshake_peers, *next;
   while (peer != NULL) {
-    next = peer->next;
-    if (peer->ssl_ctx.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
-      if (oc_etimer_expired(&peer->timer.fin_timer)) {
-        int ret = mbedtls_ssl_handshake(&peer->ssl_ctx);
-        if (ret == MBEDTLS_ERR_SSL_HELLO_VERIFY_REQUIRED) {
-          mbedtls_ssl_session_reset(&peer->ssl_ctx);
-          if (peer->role == MBEDTLS_SSL_IS_SERVER &&
-              mbedtls_ssl_set_client_transport_id(
-                &peer->ssl_ctx, (const unsigned char *)&peer->endpoint.addr,
-                sizeof(peer->endpoint.addr)) != 0) {
-            oc_sec_dtls_remove_peer(&peer->endpoint, false);
-          }
+    next = peer->handshake_link.next;
+    if (oc_etimer_expired(&peer->timer.fin_timer)) {
+      int ret = mbedtls_ssl_handshake(&peer->ssl_ctx);
+      if (ret == MBEDTLS_ERR_SSL_HELLO_VERIFY_REQUIRED) {
+        mbedtls_ssl_session_reset(&peer->ssl_ctx);
+        if (peer->role == MBEDTLS_SSL_IS_SERVER &&
+            mbedtls_ssl_set_client_transport_id(
+              &peer->ssl_ctx, (const unsigned char *)&peer->endpoint.addr,
+              sizeof(peer->endpoint.addr)) != 0) {
+          oc_sec_dtls_remove_peer(&peer->endpoint, false);
+          peer = next;
+          continue;
         }
-        if (ret != 0 && ret != MBEDTLS_ERR_SSL_WANT_READ &&
-            ret != MBEDTLS_ERR_SSL_WANT_WRITE &&
-            ret != MBEDTLS_ERR_SSL_CONN_EOF) {
+      }
+      if (ret != 0 && ret != MBEDTLS_ERR_SSL_WANT_READ &&
+          ret != MBEDTLS_ERR_SSL_WANT_WRITE &&
+          ret != MBEDTLS_ERR_SSL_CONN_EOF) {
 #ifdef OC_DEBUG
-          char buf[256];
-          mbedtls_strerror(ret, buf, 256);
-          OC_ERR("oc_dtls: mbedtls_error: %s", buf);
+        char buf[256];
+        mbedtls_strerror(ret, buf, 256);
+        OC_ERR("oc_dtls: mbedtls_error: %s", buf);
 #endif /* OC_DEBUG */
-          oc_sec_dtls_remove_peer(&peer->endpoint, false);
-        }
+        oc_sec_dtls_remove_peer(&peer->endpoint, false);
+      } else {
+        update_handshake_state(peer);
       }
     }
     peer = next;
@@ -262,13 +504,8 @@ get_psk_cb(void *data, mbedtls_ssl_context *ssl, const unsigned char *identity,
   (void)data;
   (void)identity_len;
   OC_DBG("oc_dtls: In PSK callback\n");
-  oc_sec_dtls_peer_t *peer = oc_list_head(dtls_peers);
-  while (peer != NULL) {
-    if (&peer->ssl_ctx == ssl) {
-      break;
-    }
-    peer = peer->next;
-  }
+  /* The BIO context of every SSL handle is its peer object. */
+  oc_sec_dtls_peer_t *peer = (oc_sec_dtls_peer_t *)ssl->p_bio;
   if (peer) {
     OC_DBG("oc_dtls: Found peer object\n");
     oc_sec_cred_t *cred =
@@ -322,7 +559,7 @@ oc_sec_dtls_add_peer(oc_endpoint_t *endpoint, int role)
       memcpy(&peer->endpoint, endpoint, sizeof(oc_endpoint_t));
       OC_LIST_STRUCT_INIT(peer, recv_q);
       OC_LIST_STRUCT_INIT(peer, send_q);
-      peer->next = 0;
+      memset(&peer->handshake_link, 0, sizeof(oc_sec_dtls_peer_link_t));
       peer->role = role;
       memset(&peer->timer, 0, sizeof(oc_sec_dtls_retr_timer_t)); // fix
       mbedtls_ssl_init(&peer->ssl_ctx);
@@ -356,7 +593,22 @@ oc_sec_dtls_add_peer(oc_endpoint_t *endpoint, int role)
         oc_memb_free(&dtls_peers_s, peer);
         return NULL;
       }
-      oc_list_add(dtls_peers, peer);
+#ifdef OC_CLIENT
+      if (role == MBEDTLS_SSL_IS_CLIENT) {
+        oc_sec_dtls_session_t *entry = find_client_session(endpoint);
+        if (entry) {
+          OC_DBG("oc_dtls: offering cached session\n");
+          if (mbedtls_ssl_set_session(&peer->ssl_ctx, &entry->session) == 0) {
+            touch_session(entry);
+          } else {
+            free_session(entry);
+          }
+        }
+      }
+#endif /* OC_CLIENT */
+      PEER_LINK_INSERT(endpoint_bucket(endpoint), peer, endpoint_link);
+      PEER_LINK_INSERT(active_bucket(peer), peer, active_link);
+      update_handshake_state(peer);
 
       oc_ri_add_timed_event_callback_seconds(peer, oc_sec_dtls_inactive,
                                              OC_DTLS_INACTIVITY_TIMEOUT);
@@ -406,6 +658,8 @@ oc_sec_dtls_init_context(void)
     mbedtls_ssl_conf_ciphersuites(&server_conf[i], ciphers);
     mbedtls_ssl_conf_authmode(&server_conf[i], MBEDTLS_SSL_VERIFY_REQUIRED);
     mbedtls_ssl_conf_psk_cb(&server_conf[i], get_psk_cb, NULL);
+    mbedtls_ssl_conf_session_cache(&server_conf[i], &server_conf[i],
+                                   get_session_cb, set_session_cb);
     oc_uuid_t *device_id = oc_core_get_device_id(i);
     if (mbedtls_ssl_conf_psk(&server_conf[i], device_id->id, 0, device_id->id,
                              16) != 0) {
@@ -708,8 +962,11 @@ oc_sec_dtls_init_connection(oc_message_t *message)
       OC_ERR("oc_dtls: mbedtls_error: %s\n", buf);
 #endif /* OC_DEBUG */
       oc_sec_dtls_remove_peer(&peer->endpoint, false);
-    } else if (ret == 0) {
-      oc_dtls_handler_schedule_write(peer);
+    } else {
+      update_handshake_state(peer);
+      if (ret == 0) {
+        oc_dtls_handler_schedule_write(peer);
+      }
     }
   }
   oc_message_unref(message);
@@ -797,6 +1054,7 @@ read_application_data(oc_sec_dtls_peer_t *peer)
         return;
       }
     } while (ret == 0 && peer->ssl_ctx.state != MBEDTLS_SSL_HANDSHAKE_OVER);
+    update_handshake_state(peer);
 #ifdef OC_CLIENT
     if (ret == 0) {
       oc_dtls_handler_schedule_write(peer);
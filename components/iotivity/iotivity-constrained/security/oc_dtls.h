@@ -28,6 +28,21 @@
 
 OC_PROCESS_NAME(oc_dtls_handler);
 
+/* Number of hash buckets that DTLS peers are indexed in; bucket indices are
+   taken from the low bits of a hash, so this must be a power of two. */
+#ifndef OC_DTLS_PEER_BUCKETS
+#ifdef OC_DYNAMIC_ALLOCATION
+#define OC_DTLS_PEER_BUCKETS (64)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define OC_DTLS_PEER_BUCKETS (8)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#endif /* !OC_DTLS_PEER_BUCKETS */
+
+#if OC_DTLS_PEER_BUCKETS <= 0 ||                                               \
+  (OC_DTLS_PEER_BUCKETS & (OC_DTLS_PEER_BUCKETS - 1)) != 0
+#error "OC_DTLS_PEER_BUCKETS must be a power of two"
+#endif
+
 void oc_sec_dtls_close_connection(oc_endpoint_t *endpoint);
 int oc_sec_dtls_update_psk_identity(int device);
 bool oc_sec_derive_owner_psk(oc_endpoint_t *endpoint, const uint8_t *oxm,
@@ -48,9 +63,19 @@ typedef struct
   oc_clock_time_t int_ticks;
 } oc_sec_dtls_retr_timer_t;
 
-typedef struct oc_sec_dtls_peer_s
+struct oc_sec_dtls_peer_s;
+
+typedef struct
 {
   struct oc_sec_dtls_peer_s *next;
+  struct oc_sec_dtls_peer_s **pprev;
+} oc_sec_dtls_peer_link_t;
+
+typedef struct oc_sec_dtls_peer_s
+{
+  oc_sec_dtls_peer_link_t endpoint_link;
+  oc_sec_dtls_peer_link_t active_link;
+  oc_sec_dtls_peer_link_t handshake_link;
   OC_LIST_STRUCT(recv_q);
   OC_LIST_STRUCT(send_q);
   mbedtls_ssl_context ssl_ctx;
@@ -63,4 +88,16 @@ typedef struct oc_sec_dtls_peer_s
   oc_clock_time_t timestamp;
 } oc_sec_dtls_peer_t;
 
+typedef struct oc_sec_dtls_session_s
+{
+  struct oc_sec_dtls_session_s *next;
+  int role;
+  int device;
+  oc_endpoint_t endpoint;
+  oc_uuid_t uuid;
+  uint8_t psk[16];
+  bool authenticated;
+  mbedtls_ssl_session session;
+} oc_sec_dtls_session_t;
+
 #endif /* OC_DTLS_H */
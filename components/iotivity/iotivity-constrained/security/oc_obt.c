@@ -39,7 +39,7 @@ typedef struct
   void *data;
 } oc_devicelist_cb_t;
 
-OC_MEMB(oc_devicelist_s, oc_devicelist_cb_t, 1);
+OC_MEMB_ZEROED(oc_devicelist_s, oc_devicelist_cb_t, 1);
 
 typedef struct
 {
@@ -54,7 +54,7 @@ typedef struct oc_otm_ctx_t
   oc_device_t *device;
 } oc_otm_ctx_t;
 
-OC_MEMB(oc_otm_ctx_m, oc_otm_ctx_t, 1);
+OC_MEMB_ZEROED(oc_otm_ctx_m, oc_otm_ctx_t, 1);
 OC_LIST(oc_otm_ctx_l);
 
 typedef struct oc_switch_dos_ctx_t
@@ -65,7 +65,7 @@ typedef struct oc_switch_dos_ctx_t
   oc_dostype_t dos;
 } oc_switch_dos_ctx_t;
 
-OC_MEMB(oc_switch_dos_ctx_m, oc_switch_dos_ctx_t, 1);
+OC_MEMB_ZEROED(oc_switch_dos_ctx_m, oc_switch_dos_ctx_t, 1);
 OC_LIST(oc_switch_dos_ctx_l);
 
 typedef struct
@@ -75,7 +75,7 @@ typedef struct
   oc_switch_dos_ctx_t *switch_dos;
 } oc_hard_reset_ctx_t;
 
-OC_MEMB(oc_hard_reset_ctx_m, oc_hard_reset_ctx_t, 1);
+OC_MEMB_ZEROED(oc_hard_reset_ctx_m, oc_hard_reset_ctx_t, 1);
 
 typedef struct oc_credprov_ctx_t
 {
@@ -87,7 +87,7 @@ typedef struct oc_credprov_ctx_t
   uint8_t key[16];
 } oc_credprov_ctx_t;
 
-OC_MEMB(oc_credprov_ctx_m, oc_credprov_ctx_t, 1);
+OC_MEMB_ZEROED(oc_credprov_ctx_m, oc_credprov_ctx_t, 1);
 OC_LIST(oc_credprov_ctx_l);
 
 typedef struct oc_acl2prov_ctx_t
@@ -99,13 +99,13 @@ typedef struct oc_acl2prov_ctx_t
   oc_switch_dos_ctx_t *switch_dos;
 } oc_acl2prov_ctx_t;
 
-OC_MEMB(oc_acl2prov_m, oc_acl2prov_ctx_t, 1);
+OC_MEMB_ZEROED(oc_acl2prov_m, oc_acl2prov_ctx_t, 1);
 OC_LIST(oc_acl2prov_l);
 
-OC_MEMB(oc_aces_m, oc_sec_ace_t, 1);
-OC_MEMB(oc_res_m, oc_ace_res_t, 1);
+OC_MEMB_ZEROED(oc_aces_m, oc_sec_ace_t, 1);
+OC_MEMB_ZEROED(oc_res_m, oc_ace_res_t, 1);
 
-OC_MEMB(oc_devices_s, oc_device_t, 1);
+OC_MEMB_ZEROED(oc_devices_s, oc_device_t, 1);
 OC_LIST(oc_devices);
 OC_LIST(oc_cache);
 
@@ -218,7 +218,7 @@ oc_obt_dump_state(void)
   int size = oc_rep_finalize();
   if (size > 0) {
     OC_DBG("oc_obt: dumped current state: size %d\n", size);
-    oc_storage_write("obt_state", buf, size);
+    oc_sec_store_write("obt_state", buf, size);
   }
 
   free(buf);
@@ -235,9 +235,9 @@ oc_obt_load_state(void)
     return;
   }
 
-  ret = oc_storage_read("obt_state", buf, OC_MAX_APP_DATA_SIZE);
+  ret = oc_sec_store_read("obt_state", buf, OC_MAX_APP_DATA_SIZE);
   if (ret > 0) {
-    struct oc_memb rep_objects = { sizeof(oc_rep_t), 0, 0, 0 };
+    struct oc_memb rep_objects = { .size = sizeof(oc_rep_t) };
     oc_rep_set_pool(&rep_objects);
     uint16_t err = oc_parse_rep(buf, ret, &rep);
     head = rep;
@@ -22,13 +22,61 @@
 #include "oc_doxm.h"
 #include "oc_dtls.h"
 #include "oc_pstat.h"
+#include "oc_ri.h"
 #include "port/oc_storage.h"
+#include "util/oc_hash.h"
+#include "util/oc_list.h"
+#include "util/oc_memb.h"
 #include <config.h>
 
 #ifdef OC_DYNAMIC_ALLOCATION
 #include <stdlib.h>
 #endif /* OC_DYNAMIC_ALLOCATION */
 
+#ifndef OC_STORE_JOURNAL_MIN_SIZE
+#define OC_STORE_JOURNAL_MIN_SIZE (512)
+#endif /* !OC_STORE_JOURNAL_MIN_SIZE */
+
+/* Writes to a store are held in RAM for this many milliseconds, so that the
+   bursts of updates made while a device is onboarded reach storage once. */
+#ifndef OC_STORE_FLUSH_DELAY
+#define OC_STORE_FLUSH_DELAY (1000)
+#endif /* !OC_STORE_FLUSH_DELAY */
+
+/* Maximum number of stores with pending writes */
+#ifndef OC_STORE_MAX_DIRTY
+#ifdef OC_DYNAMIC_ALLOCATION
+#define OC_STORE_MAX_DIRTY (16)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define OC_STORE_MAX_DIRTY (2)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#endif /* !OC_STORE_MAX_DIRTY */
+
+/* Largest write that is held back in a build without dynamic allocation,
+   where every pending write takes this many bytes; larger writes go to
+   storage at once. */
+#if !defined(OC_DYNAMIC_ALLOCATION) && !defined(OC_STORE_RECORD_SIZE)
+#define OC_STORE_RECORD_SIZE (OC_MAX_APP_DATA_SIZE)
+#endif /* !OC_DYNAMIC_ALLOCATION && !OC_STORE_RECORD_SIZE */
+
+/* Stores are compared in chunks of this many bytes to find where a write
+   starts to differ from what is in storage. */
+#ifndef OC_STORE_CHUNK_SIZE
+#define OC_STORE_CHUNK_SIZE (64)
+#endif /* !OC_STORE_CHUNK_SIZE */
+
+/* Maximum number of stores whose contents are tracked between writes */
+#ifndef OC_STORE_MAX_HEADS
+#ifdef OC_DYNAMIC_ALLOCATION
+#define OC_STORE_MAX_HEADS (16)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define OC_STORE_MAX_HEADS (4 * OC_MAX_NUM_DEVICES)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#endif /* !OC_STORE_MAX_HEADS */
+
+#define STORE_CHUNKS(size)                                                     \
+  (((size) + OC_STORE_CHUNK_SIZE - 1) / OC_STORE_CHUNK_SIZE)
+
 #define SVR_TAG_MAX (32)
 static void
 gen_svr_tag(const char *name, int device_index, char *svr_tag)
@@ -38,6 +86,517 @@ gen_svr_tag(const char *name, int device_index, char *svr_tag)
   svr_tag[svr_tag_len] = '\0';
 }
 
+/* Each store is a base image plus a journal of deltas against it. A journal
+ * record replaces everything from a byte offset onwards:
+ *
+ *   offset (2) | length (2) | hash before (4) | hash after (4) | bytes
+ *
+ * all little-endian. Since SVRs are encoded with indefinite-length arrays,
+ * adding an ACE or credential only rewrites the tail of the image. Records
+ * are only applied to the image whose hash they were recorded against, so a
+ * journal left behind by an interrupted compaction, or a torn final record,
+ * is ignored on load and replaced by the next write.
+ */
+#define JOURNAL_HEADER_SIZE (12)
+
+typedef struct oc_store_record_s
+{
+  struct oc_store_record_s *next;
+  char store[SVR_TAG_MAX];
+  size_t size;
+#ifdef OC_DYNAMIC_ALLOCATION
+  uint8_t *data;
+#else  /* OC_DYNAMIC_ALLOCATION */
+  uint8_t data[OC_MAX_APP_DATA_SIZE];
+#endif /* !OC_DYNAMIC_ALLOCATION */
+} oc_store_record_t;
+
+/* What a store holds in storage, once it has been read or written: a copy
+ * of its contents in image, the hash of their first (i + 1) chunks in
+ * hashes[i], and the length of its journal. Writes are journaled against
+ * this without reading the store back, so every change to a store's files
+ * has to go through this module. The hashes only rule chunks out quickly;
+ * a chunk is unchanged once its bytes match the image.
+ */
+typedef struct oc_store_head_s
+{
+  struct oc_store_head_s *next;
+  char store[SVR_TAG_MAX];
+  size_t len;
+  long journal_len;
+  bool clean;
+#ifdef OC_DYNAMIC_ALLOCATION
+  uint32_t *hashes;
+  uint8_t *image;
+#else  /* OC_DYNAMIC_ALLOCATION */
+  uint32_t hashes[STORE_CHUNKS(OC_MAX_APP_DATA_SIZE)];
+  uint8_t image[OC_MAX_APP_DATA_SIZE];
+#endif /* !OC_DYNAMIC_ALLOCATION */
+} oc_store_head_t;
+
+OC_MEMB(store_records_s, oc_store_record_t, OC_STORE_MAX_DIRTY);
+OC_LIST(store_records);
+OC_MEMB(store_heads_s, oc_store_head_t, OC_STORE_MAX_HEADS);
+OC_LIST(store_heads);
+static bool flush_pending;
+static oc_sec_store_stats_t store_stats;
+#ifndef OC_DYNAMIC_ALLOCATION
+/* Holds a journal while it is replayed, or a record while it is written */
+static uint8_t store_scratch[OC_MAX_APP_DATA_SIZE];
+#endif /* !OC_DYNAMIC_ALLOCATION */
+
+static void
+gen_journal_tag(const char *store, char *journal_tag)
+{
+  snprintf(journal_tag, SVR_TAG_MAX, "%s_j", store);
+}
+
+static uint32_t
+get_u32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static void
+set_u32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+/* Reads the base image of store into buf and applies its journal, which is
+ * read into journal. On return *journal_len holds the length of the valid
+ * prefix of the journal, and *clean whether the journal holds nothing else.
+ */
+static long
+replay_store(const char *store, uint8_t *buf, uint8_t *journal, size_t size,
+             long *journal_len, bool *clean)
+{
+  char journal_tag[SVR_TAG_MAX];
+  long len = oc_storage_read(store, buf, size);
+  *journal_len = 0;
+  *clean = true;
+  if (len <= 0) {
+    return len;
+  }
+  gen_journal_tag(store, journal_tag);
+  long jlen = oc_storage_read(journal_tag, journal, size);
+  if (jlen <= 0) {
+    return len;
+  }
+  long pos = 0;
+  uint32_t hash = oc_fnv1a(OC_FNV1A_INIT, buf, len);
+  while (pos + JOURNAL_HEADER_SIZE <= jlen) {
+    uint8_t *record = journal + pos;
+    size_t offset = record[0] | (record[1] << 8);
+    size_t length = record[2] | (record[3] << 8);
+    if (get_u32(record + 4) != hash || offset > (size_t)len ||
+        offset + length > size ||
+        pos + JOURNAL_HEADER_SIZE + (long)length > jlen) {
+      break;
+    }
+    uint32_t next = oc_fnv1a(OC_FNV1A_INIT, buf, offset);
+    next = oc_fnv1a(next, record + JOURNAL_HEADER_SIZE, length);
+    if (get_u32(record + 8) != next) {
+      break;
+    }
+    memcpy(buf + offset, record + JOURNAL_HEADER_SIZE, length);
+    len = offset + length;
+    hash = next;
+    pos += JOURNAL_HEADER_SIZE + length;
+  }
+  if (pos != jlen) {
+    OC_WRN("oc_store: ignoring %ld bytes of journal for %s\n", jlen - pos,
+           store);
+  }
+  *journal_len = pos;
+  *clean = (pos == jlen);
+  return len;
+}
+
+static oc_store_record_t *
+find_record(const char *store)
+{
+  oc_store_record_t *record = oc_list_head(store_records);
+  while (record != NULL) {
+    if (strcmp(record->store, store) == 0) {
+      return record;
+    }
+    record = record->next;
+  }
+  return NULL;
+}
+
+static oc_store_head_t *
+find_head(const char *store)
+{
+  oc_store_head_t *head = oc_list_head(store_heads);
+  while (head != NULL) {
+    if (strcmp(head->store, store) == 0) {
+      return head;
+    }
+    head = head->next;
+  }
+  return NULL;
+}
+
+static void
+free_head(oc_store_head_t *head)
+{
+  oc_list_remove(store_heads, head);
+#ifdef OC_DYNAMIC_ALLOCATION
+  free(head->hashes);
+  free(head->image);
+#endif /* OC_DYNAMIC_ALLOCATION */
+  oc_memb_free(&store_heads_s, head);
+}
+
+static void
+drop_head(const char *store)
+{
+  oc_store_head_t *head = find_head(store);
+  if (head) {
+    free_head(head);
+  }
+}
+
+/* Records that store now holds the len bytes of buf, followed by
+ * journal_len bytes of journal. Heads are kept in order of use, and the
+ * least recently used one is recycled when the pool runs out; a store with
+ * no head is rewritten in full on its next write.
+ */
+static void
+set_head(const char *store, const uint8_t *buf, size_t len, long journal_len,
+         bool clean)
+{
+  oc_store_head_t *head = find_head(store);
+  if (head) {
+    oc_list_remove(store_heads, head);
+  } else {
+    head = oc_memb_alloc(&store_heads_s);
+    if (!head && oc_list_head(store_heads)) {
+      free_head(oc_list_head(store_heads));
+      head = oc_memb_alloc(&store_heads_s);
+    }
+    if (!head) {
+      return;
+    }
+#ifdef OC_DYNAMIC_ALLOCATION
+    head->hashes = NULL;
+    head->image = NULL;
+#endif /* OC_DYNAMIC_ALLOCATION */
+    strcpy(head->store, store);
+  }
+#ifdef OC_DYNAMIC_ALLOCATION
+  if (head->hashes == NULL || STORE_CHUNKS(head->len) != STORE_CHUNKS(len)) {
+    uint32_t *hashes =
+      realloc(head->hashes, (STORE_CHUNKS(len) + 1) * sizeof(uint32_t));
+    if (!hashes) {
+      free(head->hashes);
+      free(head->image);
+      oc_memb_free(&store_heads_s, head);
+      return;
+    }
+    head->hashes = hashes;
+  }
+  if (head->image == NULL || head->len != len) {
+    uint8_t *image = realloc(head->image, len + 1);
+    if (!image) {
+      free(head->hashes);
+      free(head->image);
+      oc_memb_free(&store_heads_s, head);
+      return;
+    }
+    head->image = image;
+  }
+#endif /* OC_DYNAMIC_ALLOCATION */
+  memcpy(head->image, buf, len);
+  uint32_t hash = OC_FNV1A_INIT;
+  size_t offset = 0;
+  while (offset < len) {
+    size_t chunk = (len - offset < OC_STORE_CHUNK_SIZE) ? len - offset
+                                                         : OC_STORE_CHUNK_SIZE;
+    hash = oc_fnv1a(hash, buf + offset, chunk);
+    head->hashes[offset / OC_STORE_CHUNK_SIZE] = hash;
+    offset += chunk;
+  }
+  head->len = len;
+  head->journal_len = journal_len;
+  head->clean = clean;
+  oc_list_add(store_heads, head);
+}
+
+static uint32_t
+head_hash(oc_store_head_t *head)
+{
+  return head->len ? head->hashes[STORE_CHUNKS(head->len) - 1]
+                   : OC_FNV1A_INIT;
+}
+
+long
+oc_sec_store_read(const char *store, uint8_t *buf, size_t size)
+{
+  oc_store_record_t *record = find_record(store);
+  if (record) {
+    if (record->size > size) {
+      return -1;
+    }
+    memcpy(buf, record->data, record->size);
+    return record->size;
+  }
+#ifdef OC_DYNAMIC_ALLOCATION
+  uint8_t *journal = malloc(size);
+  if (!journal) {
+    return -1;
+  }
+#else  /* OC_DYNAMIC_ALLOCATION */
+  uint8_t *journal = store_scratch;
+  if (size > OC_MAX_APP_DATA_SIZE) {
+    size = OC_MAX_APP_DATA_SIZE;
+  }
+#endif /* !OC_DYNAMIC_ALLOCATION */
+  long journal_len;
+  bool clean;
+  long ret = replay_store(store, buf, journal, size, &journal_len, &clean);
+  /* This is the only place a store is read back from storage, so the next
+     write is journaled against what was found here. */
+  if (ret > 0 && ret < (long)size) {
+    set_head(store, buf, ret, journal_len, clean);
+  } else {
+    drop_head(store);
+  }
+#ifdef OC_DYNAMIC_ALLOCATION
+  free(journal);
+#endif /* OC_DYNAMIC_ALLOCATION */
+  return ret;
+}
+
+static long
+compact_store(const char *store, uint8_t *buf, size_t size, long journal_len,
+              bool clean)
+{
+  char journal_tag[SVR_TAG_MAX];
+  OC_DBG("oc_store: compacting %s, size %d\n", store, (int)size);
+  long ret = oc_storage_write(store, buf, size);
+  store_stats.physical_writes++;
+  if (ret < 0) {
+    drop_head(store);
+    return ret;
+  }
+  if (journal_len > 0 || !clean) {
+    gen_journal_tag(store, journal_tag);
+    oc_storage_write(journal_tag, buf, 0);
+    store_stats.physical_writes++;
+  }
+  set_head(store, buf, size, 0, true);
+  return ret;
+}
+
+static long
+write_store(const char *store, uint8_t *buf, size_t size)
+{
+  if ((long)size > OC_MAX_APP_DATA_SIZE) {
+    return -1;
+  }
+  oc_store_head_t *head = find_head(store);
+  if (!head || head->len == 0) {
+    /* Nothing is known about what is in storage, so start over, dropping
+       any journal that was left behind. */
+    char journal_tag[SVR_TAG_MAX];
+    uint8_t byte;
+    gen_journal_tag(store, journal_tag);
+    bool clean = (oc_storage_read(journal_tag, &byte, 1) <= 0);
+    return compact_store(store, buf, size, 0, clean);
+  }
+
+  uint32_t hash = oc_fnv1a(OC_FNV1A_INIT, buf, size);
+  if (head->len == size && head_hash(head) == hash &&
+      memcmp(head->image, buf, size) == 0) {
+    return size;
+  }
+
+  /* Skip the leading chunks that are unchanged. */
+  size_t common = (head->len < size) ? head->len : size;
+  size_t offset = 0;
+  uint32_t prefix = OC_FNV1A_INIT;
+  while (offset + OC_STORE_CHUNK_SIZE <= common) {
+    prefix = oc_fnv1a(prefix, buf + offset, OC_STORE_CHUNK_SIZE);
+    if (prefix != head->hashes[offset / OC_STORE_CHUNK_SIZE] ||
+        memcmp(head->image + offset, buf + offset, OC_STORE_CHUNK_SIZE) != 0) {
+      break;
+    }
+    offset += OC_STORE_CHUNK_SIZE;
+  }
+  size_t record_len = JOURNAL_HEADER_SIZE + size - offset;
+  size_t max_journal_len =
+    (size > OC_STORE_JOURNAL_MIN_SIZE) ? size : OC_STORE_JOURNAL_MIN_SIZE;
+  if ((long)max_journal_len > OC_MAX_APP_DATA_SIZE) {
+    max_journal_len = OC_MAX_APP_DATA_SIZE;
+  }
+  if (!head->clean || offset > 0xffff || size - offset > 0xffff ||
+      head->journal_len + record_len > max_journal_len) {
+    return compact_store(store, buf, size, head->journal_len, head->clean);
+  }
+
+#ifdef OC_DYNAMIC_ALLOCATION
+  uint8_t *record = malloc(record_len);
+  if (!record) {
+    return compact_store(store, buf, size, head->journal_len, false);
+  }
+#else  /* OC_DYNAMIC_ALLOCATION */
+  uint8_t *record = store_scratch;
+#endif /* !OC_DYNAMIC_ALLOCATION */
+  record[0] = (uint8_t)offset;
+  record[1] = (uint8_t)(offset >> 8);
+  record[2] = (uint8_t)(size - offset);
+  record[3] = (uint8_t)((size - offset) >> 8);
+  set_u32(record + 4, head_hash(head));
+  set_u32(record + 8, hash);
+  memcpy(record + JOURNAL_HEADER_SIZE, buf + offset, size - offset);
+
+  long ret;
+  char journal_tag[SVR_TAG_MAX];
+  gen_journal_tag(store, journal_tag);
+  store_stats.physical_writes++;
+  if (oc_storage_append(journal_tag, record, record_len) ==
+      (long)record_len) {
+    OC_DBG("oc_store: journaled %d bytes for %s\n", (int)record_len, store);
+    set_head(store, buf, size, head->journal_len + record_len, true);
+    ret = size;
+  } else {
+    ret = compact_store(store, buf, size, head->journal_len, false);
+  }
+#ifdef OC_DYNAMIC_ALLOCATION
+  free(record);
+#endif /* OC_DYNAMIC_ALLOCATION */
+  return ret;
+}
+
+static void
+free_record(oc_store_record_t *record)
+{
+  oc_list_remove(store_records, record);
+#ifdef OC_DYNAMIC_ALLOCATION
+  free(record->data);
+#endif /* OC_DYNAMIC_ALLOCATION */
+  oc_memb_free(&store_records_s, record);
+}
+
+static void
+flush_record(oc_store_record_t *record)
+{
+  write_store(record->store, record->data, record->size);
+  free_record(record);
+}
+
+static oc_event_callback_retval_t
+flush_stores(void *data)
+{
+  (void)data;
+  flush_pending = false;
+  oc_sec_store_flush();
+  return OC_EVENT_DONE;
+}
+
+long
+oc_sec_store_write(const char *store, uint8_t *buf, size_t size)
+{
+  store_stats.writes++;
+  if ((long)size > OC_MAX_APP_DATA_SIZE || strlen(store) >= SVR_TAG_MAX) {
+    return -1;
+  }
+  oc_store_record_t *record = find_record(store);
+#ifndef OC_DYNAMIC_ALLOCATION
+  if (size > OC_STORE_RECORD_SIZE) {
+    if (record) {
+      free_record(record);
+    }
+    return write_store(store, buf, size);
+  }
+#endif /* !OC_DYNAMIC_ALLOCATION */
+  if (record) {
+    OC_DBG("oc_store: coalescing write to %s\n", store);
+#ifdef OC_DYNAMIC_ALLOCATION
+    if (record->size != size) {
+      uint8_t *data = realloc(record->data, size ? size : 1);
+      if (!data) {
+        flush_record(record);
+        return write_store(store, buf, size);
+      }
+      record->data = data;
+    }
+#endif /* OC_DYNAMIC_ALLOCATION */
+  } else {
+    record = oc_memb_alloc(&store_records_s);
+    if (!record) {
+      /* Make room by flushing the store that has waited longest. */
+      oc_store_record_t *oldest = oc_list_head(store_records);
+      if (oldest) {
+        flush_record(oldest);
+        record = oc_memb_alloc(&store_records_s);
+      }
+    }
+    if (!record) {
+      return write_store(store, buf, size);
+    }
+#ifdef OC_DYNAMIC_ALLOCATION
+    record->data = malloc(size ? size : 1);
+    if (!record->data) {
+      oc_memb_free(&store_records_s, record);
+      return write_store(store, buf, size);
+    }
+#endif /* OC_DYNAMIC_ALLOCATION */
+    strcpy(record->store, store);
+    oc_list_add(store_records, record);
+  }
+  memcpy(record->data, buf, size);
+  record->size = size;
+
+  if (!flush_pending) {
+    flush_pending = true;
+    oc_ri_add_timed_event_callback_ticks(
+      NULL, flush_stores,
+      (oc_clock_time_t)(OC_STORE_FLUSH_DELAY * OC_CLOCK_SECOND / 1000));
+  }
+  return size;
+}
+
+void
+oc_sec_store_flush(void)
+{
+  if (flush_pending) {
+    oc_ri_remove_timed_event_callback(NULL, flush_stores);
+    flush_pending = false;
+  }
+  oc_store_record_t *record = oc_list_head(store_records);
+  while (record != NULL) {
+    flush_record(record);
+    record = oc_list_head(store_records);
+  }
+}
+
+/* Also forgets what is known about the contents of every store, so it has
+   to be called before storage is reconfigured. */
+void
+oc_sec_store_close(void)
+{
+  oc_sec_store_flush();
+  oc_store_head_t *head = oc_list_head(store_heads);
+  while (head != NULL) {
+    free_head(head);
+    head = oc_list_head(store_heads);
+  }
+}
+
+void
+oc_sec_store_get_stats(oc_sec_store_stats_t *stats)
+{
+  *stats = store_stats;
+}
+
 void
 oc_sec_load_doxm(int device)
 {
@@ -56,18 +615,19 @@ oc_sec_load_doxm(int device)
 #endif /* !OC_DYNAMIC_ALLOCATION */
     char svr_tag[SVR_TAG_MAX];
     gen_svr_tag("doxm", device, svr_tag);
-    ret = oc_storage_read(svr_tag, buf, OC_MAX_APP_DATA_SIZE);
+    ret = oc_sec_store_read(svr_tag, buf, OC_MAX_APP_DATA_SIZE);
     if (ret > 0) {
 #ifndef OC_DYNAMIC_ALLOCATION
       char rep_objects_alloc[OC_MAX_NUM_REP_OBJECTS];
       oc_rep_t rep_objects_pool[OC_MAX_NUM_REP_OBJECTS];
       memset(rep_objects_alloc, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(char));
       memset(rep_objects_pool, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(oc_rep_t));
-      struct oc_memb rep_objects = { sizeof(oc_rep_t), OC_MAX_NUM_REP_OBJECTS,
-                                     rep_objects_alloc,
-                                     (void *)rep_objects_pool };
+      struct oc_memb rep_objects = { .size = sizeof(oc_rep_t),
+                                      .num = OC_MAX_NUM_REP_OBJECTS,
+                                      .count = rep_objects_alloc,
+                                      .mem = (void *)rep_objects_pool };
 #else  /* !OC_DYNAMIC_ALLOCATION */
-      struct oc_memb rep_objects = { sizeof(oc_rep_t), 0, 0, 0 };
+      struct oc_memb rep_objects = { .size = sizeof(oc_rep_t) };
 #endif /* OC_DYNAMIC_ALLOCATION */
       oc_rep_set_pool(&rep_objects);
       oc_parse_rep(buf, (uint16_t)ret, &rep);
@@ -103,18 +663,19 @@ oc_sec_load_pstat(int device)
 
   char svr_tag[SVR_TAG_MAX];
   gen_svr_tag("pstat", device, svr_tag);
-  ret = oc_storage_read(svr_tag, buf, OC_MAX_APP_DATA_SIZE);
+  ret = oc_sec_store_read(svr_tag, buf, OC_MAX_APP_DATA_SIZE);
   if (ret > 0) {
 #ifndef OC_DYNAMIC_ALLOCATION
     char rep_objects_alloc[OC_MAX_NUM_REP_OBJECTS];
     oc_rep_t rep_objects_pool[OC_MAX_NUM_REP_OBJECTS];
     memset(rep_objects_alloc, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(char));
     memset(rep_objects_pool, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(oc_rep_t));
-    struct oc_memb rep_objects = { sizeof(oc_rep_t), OC_MAX_NUM_REP_OBJECTS,
-                                   rep_objects_alloc,
-                                   (void *)rep_objects_pool };
+    struct oc_memb rep_objects = { .size = sizeof(oc_rep_t),
+                                    .num = OC_MAX_NUM_REP_OBJECTS,
+                                    .count = rep_objects_alloc,
+                                    .mem = (void *)rep_objects_pool };
 #else  /* !OC_DYNAMIC_ALLOCATION */
-    struct oc_memb rep_objects = { sizeof(oc_rep_t), 0, 0, 0 };
+    struct oc_memb rep_objects = { .size = sizeof(oc_rep_t) };
 #endif /* OC_DYNAMIC_ALLOCATION */
     oc_rep_set_pool(&rep_objects);
     oc_parse_rep(buf, (uint16_t)ret, &rep);
@@ -148,7 +709,7 @@ oc_sec_load_cred(int device)
 
     char svr_tag[SVR_TAG_MAX];
     gen_svr_tag("cred", device, svr_tag);
-    ret = oc_storage_read(svr_tag, buf, OC_MAX_APP_DATA_SIZE);
+    ret = oc_sec_store_read(svr_tag, buf, OC_MAX_APP_DATA_SIZE);
 
     if (ret > 0) {
 #ifndef OC_DYNAMIC_ALLOCATION
@@ -156,11 +717,12 @@ oc_sec_load_cred(int device)
       oc_rep_t rep_objects_pool[OC_MAX_NUM_REP_OBJECTS];
       memset(rep_objects_alloc, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(char));
       memset(rep_objects_pool, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(oc_rep_t));
-      struct oc_memb rep_objects = { sizeof(oc_rep_t), OC_MAX_NUM_REP_OBJECTS,
-                                     rep_objects_alloc,
-                                     (void *)rep_objects_pool };
+      struct oc_memb rep_objects = { .size = sizeof(oc_rep_t),
+                                      .num = OC_MAX_NUM_REP_OBJECTS,
+                                      .count = rep_objects_alloc,
+                                      .mem = (void *)rep_objects_pool };
 #else  /* !OC_DYNAMIC_ALLOCATION */
-      struct oc_memb rep_objects = { sizeof(oc_rep_t), 0, 0, 0 };
+      struct oc_memb rep_objects = { .size = sizeof(oc_rep_t) };
 #endif /* OC_DYNAMIC_ALLOCATION */
       oc_rep_set_pool(&rep_objects);
       oc_parse_rep(buf, (uint16_t)ret, &rep);
@@ -192,18 +754,19 @@ oc_sec_load_acl(int device)
 
     char svr_tag[SVR_TAG_MAX];
     gen_svr_tag("acl", device, svr_tag);
-    ret = oc_storage_read(svr_tag, buf, OC_MAX_APP_DATA_SIZE);
+    ret = oc_sec_store_read(svr_tag, buf, OC_MAX_APP_DATA_SIZE);
     if (ret > 0) {
 #ifndef OC_DYNAMIC_ALLOCATION
       char rep_objects_alloc[OC_MAX_NUM_REP_OBJECTS];
       oc_rep_t rep_objects_pool[OC_MAX_NUM_REP_OBJECTS];
       memset(rep_objects_alloc, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(char));
       memset(rep_objects_pool, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(oc_rep_t));
-      struct oc_memb rep_objects = { sizeof(oc_rep_t), OC_MAX_NUM_REP_OBJECTS,
-                                     rep_objects_alloc,
-                                     (void *)rep_objects_pool };
+      struct oc_memb rep_objects = { .size = sizeof(oc_rep_t),
+                                      .num = OC_MAX_NUM_REP_OBJECTS,
+                                      .count = rep_objects_alloc,
+                                      .mem = (void *)rep_objects_pool };
 #else  /* !OC_DYNAMIC_ALLOCATION */
-      struct oc_memb rep_objects = { sizeof(oc_rep_t), 0, 0, 0 };
+      struct oc_memb rep_objects = { .size = sizeof(oc_rep_t) };
 #endif /* OC_DYNAMIC_ALLOCATION */
       oc_rep_set_pool(&rep_objects);
       oc_parse_rep(buf, (uint16_t)ret, &rep);
@@ -234,7 +797,7 @@ oc_sec_dump_pstat(int device)
     OC_DBG("oc_store: encoded pstat size %d\n", size);
     char svr_tag[SVR_TAG_MAX];
     gen_svr_tag("pstat", device, svr_tag);
-    oc_storage_write(svr_tag, buf, size);
+    oc_sec_store_write(svr_tag, buf, size);
   }
 
 #ifdef OC_DYNAMIC_ALLOCATION
@@ -260,7 +823,7 @@ oc_sec_dump_cred(int device)
     OC_DBG("oc_store: encoded cred size %d\n", size);
     char svr_tag[SVR_TAG_MAX];
     gen_svr_tag("cred", device, svr_tag);
-    oc_storage_write(svr_tag, buf, size);
+    oc_sec_store_write(svr_tag, buf, size);
   }
 
 #ifdef OC_DYNAMIC_ALLOCATION
@@ -287,7 +850,7 @@ oc_sec_dump_doxm(int device)
     OC_DBG("oc_store: encoded doxm size %d\n", size);
     char svr_tag[SVR_TAG_MAX];
     gen_svr_tag("doxm", device, svr_tag);
-    oc_storage_write(svr_tag, buf, size);
+    oc_sec_store_write(svr_tag, buf, size);
   }
 
 #ifdef OC_DYNAMIC_ALLOCATION
@@ -313,7 +876,7 @@ oc_sec_dump_acl(int device)
     OC_DBG("oc_store: encoded ACL size %d\n", size);
     char svr_tag[SVR_TAG_MAX];
     gen_svr_tag("acl", device, svr_tag);
-    oc_storage_write(svr_tag, buf, size);
+    oc_sec_store_write(svr_tag, buf, size);
   }
 
 #ifdef OC_DYNAMIC_ALLOCATION
@@ -340,18 +903,19 @@ oc_sec_load_unique_ids(int device)
 #endif /* !OC_DYNAMIC_ALLOCATION */
     char svr_tag[SVR_TAG_MAX];
     gen_svr_tag("u_ids", device, svr_tag);
-    ret = oc_storage_read(svr_tag, buf, OC_MAX_APP_DATA_SIZE);
+    ret = oc_sec_store_read(svr_tag, buf, OC_MAX_APP_DATA_SIZE);
     if (ret > 0) {
 #ifndef OC_DYNAMIC_ALLOCATION
       char rep_objects_alloc[OC_MAX_NUM_REP_OBJECTS];
       oc_rep_t rep_objects_pool[OC_MAX_NUM_REP_OBJECTS];
       memset(rep_objects_alloc, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(char));
       memset(rep_objects_pool, 0, OC_MAX_NUM_REP_OBJECTS * sizeof(oc_rep_t));
-      struct oc_memb rep_objects = { sizeof(oc_rep_t), OC_MAX_NUM_REP_OBJECTS,
-                                     rep_objects_alloc,
-                                     (void *)rep_objects_pool };
+      struct oc_memb rep_objects = { .size = sizeof(oc_rep_t),
+                                      .num = OC_MAX_NUM_REP_OBJECTS,
+                                      .count = rep_objects_alloc,
+                                      .mem = (void *)rep_objects_pool };
 #else  /* !OC_DYNAMIC_ALLOCATION */
-      struct oc_memb rep_objects = { sizeof(oc_rep_t), 0, 0, 0 };
+      struct oc_memb rep_objects = { .size = sizeof(oc_rep_t) };
 #endif /* OC_DYNAMIC_ALLOCATION */
       oc_rep_set_pool(&rep_objects);
       int err = oc_parse_rep(buf, ret, &rep);
@@ -411,7 +975,7 @@ oc_sec_dump_unique_ids(int device)
     OC_DBG("oc_store: encoded unique identifiers: size %d\n", size);
     char svr_tag[SVR_TAG_MAX];
     gen_svr_tag("u_ids", device, svr_tag);
-    oc_storage_write(svr_tag, buf, size);
+    oc_sec_store_write(svr_tag, buf, size);
   }
 
 #ifdef OC_DYNAMIC_ALLOCATION
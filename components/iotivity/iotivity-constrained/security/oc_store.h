@@ -17,6 +17,20 @@
 #ifndef OC_STORE_H
 #define OC_STORE_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+  uint32_t writes;
+  uint32_t physical_writes;
+} oc_sec_store_stats_t;
+
+long oc_sec_store_read(const char *store, uint8_t *buf, size_t size);
+long oc_sec_store_write(const char *store, uint8_t *buf, size_t size);
+void oc_sec_store_flush(void);
+void oc_sec_store_close(void);
+void oc_sec_store_get_stats(oc_sec_store_stats_t *stats);
 void oc_sec_load_pstat(int device);
 void oc_sec_load_doxm(int device);
 void oc_sec_load_cred(int device);
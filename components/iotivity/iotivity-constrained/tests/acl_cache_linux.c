@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include "oc_core_res.h"
+
+#ifdef OC_SECURITY
+#include "security/oc_acl.h"
+
+#define NUM_CHECKS (1000)
+
+OC_MEMB(rep_objects, oc_rep_t, 16);
+static oc_resource_t *light;
+
+static void
+get_light(oc_request_t *request, oc_interface_mask_t interface,
+          void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_send_response(request, OC_STATUS_OK);
+}
+
+static void
+register_resources(void)
+{
+  light = oc_new_resource(NULL, "/a/light", 1, 0);
+  ASSERT(light != NULL);
+  oc_resource_bind_resource_type(light, "core.light");
+  oc_resource_set_discoverable(light, true);
+  oc_resource_set_request_handler(light, OC_GET, get_light, NULL);
+  ASSERT(oc_add_resource(light));
+}
+
+/* Lets anon-clear clients retrieve every discoverable resource. */
+static void
+add_discoverable_ace(void)
+{
+  uint8_t payload[256];
+  oc_rep_t *rep = NULL;
+  oc_rep_new(payload, sizeof(payload));
+  oc_rep_start_root_object();
+  oc_rep_set_array(root, aclist2);
+  oc_rep_object_array_start_item(aclist2);
+  oc_rep_set_object(aclist2, subject);
+  oc_rep_set_text_string(subject, conntype, "anon-clear");
+  oc_rep_close_object(aclist2, subject);
+  oc_rep_set_array(aclist2, resources);
+  oc_rep_object_array_start_item(resources);
+  oc_rep_set_text_string(resources, wc, "+");
+  oc_rep_object_array_end_item(resources);
+  oc_rep_close_array(aclist2, resources);
+  oc_rep_set_uint(aclist2, permission, OC_PERM_RETRIEVE);
+  oc_rep_set_uint(aclist2, aceid, 100);
+  oc_rep_object_array_end_item(aclist2);
+  oc_rep_close_array(root, aclist2);
+  oc_rep_end_root_object();
+  int len = oc_rep_finalize();
+  ASSERT(len > 0);
+  oc_rep_set_pool(&rep_objects);
+  ASSERT(oc_parse_rep(payload, len, &rep) == 0);
+  ASSERT(oc_sec_decode_acl(rep, true, 0));
+  oc_free_rep(rep);
+}
+
+static void
+check_stats(uint32_t hits, uint32_t misses)
+{
+  oc_sec_acl_cache_stats_t stats;
+  oc_sec_acl_get_cache_stats(0, &stats);
+  ASSERT(stats.hits == hits);
+  ASSERT(stats.misses == misses);
+}
+
+int
+main(void)
+{
+  int i;
+
+  test_init_stack(1, register_resources);
+
+  oc_resource_t *acl2 = oc_core_get_resource_by_index(OCF_SEC_ACL, 0);
+  oc_resource_t *d = oc_core_get_resource_by_index(OCF_D, 0);
+  oc_endpoint_t endpoint;
+  memset(&endpoint, 0, sizeof(endpoint));
+  endpoint.flags = IPV6;
+  endpoint.device = 0;
+
+  /* Before ownership transfer anon-clear clients may update acl2. */
+  oc_sec_acl_default(0);
+  oc_sec_acl_cache_stats_t start;
+  oc_sec_acl_get_cache_stats(0, &start);
+  ASSERT(oc_sec_check_acl(OC_POST, acl2, &endpoint));
+  ASSERT(oc_sec_check_acl(OC_GET, d, &endpoint));
+  ASSERT(!oc_sec_check_acl(OC_POST, d, &endpoint));
+  check_stats(start.hits + 1, start.misses + 2);
+
+  /* Repeated checks are answered from the cache. */
+  for (i = 0; i < NUM_CHECKS; i++) {
+    ASSERT(oc_sec_check_acl(OC_GET, d, &endpoint));
+  }
+  check_stats(start.hits + 1 + NUM_CHECKS, start.misses + 2);
+
+  /* Changes to the ACL take effect on the next check. */
+  oc_sec_set_post_otm_acl(0);
+  ASSERT(!oc_sec_check_acl(OC_POST, acl2, &endpoint));
+  ASSERT(oc_sec_check_acl(OC_GET, d, &endpoint));
+  check_stats(start.hits + 1 + NUM_CHECKS, start.misses + 4);
+
+  oc_sec_acl_default(0);
+  ASSERT(oc_sec_check_acl(OC_POST, acl2, &endpoint));
+
+  /* A resource that stops being discoverable is no longer matched by the
+     "+" wildcard, even though the decision for it was cached. */
+  add_discoverable_ace();
+  ASSERT(oc_sec_check_acl(OC_GET, light, &endpoint));
+  ASSERT(oc_sec_check_acl(OC_GET, light, &endpoint));
+  oc_resource_set_discoverable(light, false);
+  ASSERT(!oc_sec_check_acl(OC_GET, light, &endpoint));
+  oc_resource_set_discoverable(light, true);
+  ASSERT(oc_sec_check_acl(OC_GET, light, &endpoint));
+
+  oc_main_shutdown();
+
+  return 0;
+}
+#else /* OC_SECURITY */
+int
+main(void)
+{
+  printf("ACL cache test requires OC_SECURITY\n");
+  return 0;
+}
+#endif /* !OC_SECURITY */
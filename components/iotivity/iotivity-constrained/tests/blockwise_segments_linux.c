@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Block-wise payloads are assembled from blocks written out of order, and
+ * a resource larger than 64 KB is posted to and fetched from a server that
+ * shares this process.
+ */
+
+#include "test.h"
+
+#include "oc_blockwise.h"
+
+#if defined(OC_BLOCK_WISE) && defined(OC_DYNAMIC_ALLOCATION)
+#define BLOB_SIZE (200000)
+#define SEGMENT (16)
+
+static uint8_t blob[BLOB_SIZE];
+static uint8_t posted[BLOB_SIZE];
+static size_t posted_size;
+static oc_endpoint_t server;
+static bool done;
+static bool received_intact;
+
+static size_t
+count_segments(oc_blockwise_state_t *buffer)
+{
+  size_t n = 0;
+  oc_blockwise_segment_t *segment = buffer->segments;
+  for (; segment; segment = segment->next) {
+    ASSERT(!segment->next ||
+           segment->offset + segment->size <= segment->next->offset);
+    n++;
+  }
+  return n;
+}
+
+static void
+test_segments(void)
+{
+  oc_endpoint_t ep;
+  uint8_t data[5 * SEGMENT];
+  size_t i;
+
+  memset(&ep, 0, sizeof(ep));
+  for (i = 0; i < sizeof(data); i++) {
+    data[i] = (uint8_t)(i + 1);
+  }
+
+  oc_blockwise_state_t *buffer = oc_blockwise_alloc_request_buffer(
+    "a/blob", 6, &ep, OC_POST, OC_BLOCKWISE_SERVER);
+  ASSERT(buffer != NULL);
+  ASSERT(buffer->segments == NULL);
+  buffer->segment_size = SEGMENT;
+
+  /* The last block arrives first, then one that straddles two segments,
+     then the rest. */
+  ASSERT(oc_blockwise_write(buffer, 4 * SEGMENT, &data[4 * SEGMENT], SEGMENT));
+  ASSERT(count_segments(buffer) == 1);
+  ASSERT(oc_blockwise_write(buffer, SEGMENT + 8, &data[SEGMENT + 8], SEGMENT));
+  ASSERT(count_segments(buffer) == 3);
+  ASSERT(oc_blockwise_write(buffer, 0, data, SEGMENT + 8));
+  ASSERT(oc_blockwise_write(buffer, 2 * SEGMENT + 8, &data[2 * SEGMENT + 8],
+                            2 * SEGMENT - 8));
+  ASSERT(count_segments(buffer) == 5);
+  buffer->payload_size = sizeof(data);
+
+  uint16_t size = 0;
+  const uint8_t *block =
+    oc_blockwise_dispatch_block(buffer, 3 * SEGMENT, SEGMENT, &size);
+  ASSERT(block != NULL && size == SEGMENT);
+  ASSERT(memcmp(block, &data[3 * SEGMENT], SEGMENT) == 0);
+
+  /* Parsing needs the payload in one piece. */
+  const uint8_t *payload = oc_blockwise_get_payload(buffer);
+  ASSERT(payload != NULL);
+  ASSERT(count_segments(buffer) == 1);
+  ASSERT(memcmp(payload, data, sizeof(data)) == 0);
+
+  ASSERT(!oc_blockwise_write(buffer, (uint32_t)OC_MAX_APP_DATA_SIZE - 1, data,
+                             2));
+  oc_blockwise_free_request_buffer(buffer);
+
+  /* A payload encoded in place keeps only the bytes it used. */
+  buffer = oc_blockwise_alloc_response_buffer("a/blob", 6, &ep, OC_GET,
+                                              OC_BLOCKWISE_SERVER);
+  ASSERT(buffer != NULL);
+  uint8_t *reserved = oc_blockwise_reserve(buffer, 1024);
+  ASSERT(reserved != NULL);
+  memcpy(reserved, data, sizeof(data));
+  oc_blockwise_commit(buffer, sizeof(data));
+  ASSERT(count_segments(buffer) == 1 && buffer->segments->size == sizeof(data));
+  buffer->payload_size = sizeof(data);
+  ASSERT(memcmp(oc_blockwise_get_payload(buffer), data, sizeof(data)) == 0);
+  oc_blockwise_commit(buffer, 0);
+  ASSERT(buffer->segments == NULL);
+  oc_blockwise_free_response_buffer(buffer);
+}
+
+static void
+get_blob(oc_request_t *request, oc_interface_mask_t interface,
+         void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_rep_start_root_object();
+  oc_rep_set_byte_string(root, data, blob, BLOB_SIZE);
+  oc_rep_end_root_object();
+  oc_send_response(request, OC_STATUS_OK);
+}
+
+static void
+post_blob(oc_request_t *request, oc_interface_mask_t interface,
+          void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_rep_t *rep = request->request_payload;
+  posted_size = 0;
+  if (rep && rep->type == OC_REP_BYTE_STRING &&
+      oc_string_len(rep->value.string) <= BLOB_SIZE) {
+    posted_size = oc_string_len(rep->value.string);
+    memcpy(posted, oc_string(rep->value.string), posted_size);
+  }
+  oc_send_response(request, OC_STATUS_CHANGED);
+}
+
+static void
+register_resources(void)
+{
+  oc_resource_t *res = oc_new_resource(NULL, "/a/blob", 1, 0);
+  ASSERT(res != NULL);
+  oc_resource_bind_resource_type(res, "core.blob");
+  oc_resource_bind_resource_interface(res, OC_IF_RW);
+  oc_resource_set_default_interface(res, OC_IF_RW);
+  oc_resource_set_request_handler(res, OC_GET, get_blob, NULL);
+  oc_resource_set_request_handler(res, OC_POST, post_blob, NULL);
+  ASSERT(oc_add_resource(res));
+}
+
+static void
+blob_response(oc_client_response_t *data)
+{
+  oc_rep_t *rep = data->payload;
+  done = true;
+  received_intact = (data->code == OC_STATUS_OK && rep != NULL &&
+                     rep->type == OC_REP_BYTE_STRING &&
+                     oc_string_len(rep->value.string) == BLOB_SIZE &&
+                     memcmp(oc_string(rep->value.string), blob, BLOB_SIZE) == 0);
+}
+
+static void
+post_response(oc_client_response_t *data)
+{
+  (void)data;
+  done = true;
+}
+
+static void
+run_until_done(void)
+{
+  POLL_UNTIL(done, 30);
+  ASSERT(done);
+}
+
+int
+main(void)
+{
+  size_t i;
+
+  for (i = 0; i < BLOB_SIZE; i++) {
+    blob[i] = (uint8_t)(i * 13 + i / 509);
+  }
+  oc_set_max_app_data_size(BLOB_SIZE + 1024);
+
+  /* Server buffers draw their ETag from the random source that starting the
+     stack opens. */
+  test_init_stack(1, register_resources);
+  test_segments();
+
+  test_get_endpoint(0, IPV6, &server);
+
+  done = false;
+  ASSERT(oc_init_post("/a/blob", &server, NULL, post_response, HIGH_QOS,
+                      NULL));
+  oc_rep_start_root_object();
+  oc_rep_set_byte_string(root, data, blob, BLOB_SIZE);
+  oc_rep_end_root_object();
+  ASSERT(oc_do_post());
+  run_until_done();
+#ifndef OC_SECURITY
+  ASSERT(posted_size == BLOB_SIZE);
+  ASSERT(memcmp(posted, blob, BLOB_SIZE) == 0);
+#endif /* !OC_SECURITY */
+
+  done = false;
+  ASSERT(oc_do_get("/a/blob", &server, NULL, blob_response, LOW_QOS, NULL));
+  run_until_done();
+#ifndef OC_SECURITY
+  ASSERT(received_intact);
+#endif /* !OC_SECURITY */
+
+  oc_main_shutdown();
+
+  return 0;
+}
+#else  /* OC_BLOCK_WISE && OC_DYNAMIC_ALLOCATION */
+int
+main(void)
+{
+  printf("built without OC_BLOCK_WISE or OC_DYNAMIC_ALLOCATION\n");
+  return 0;
+}
+#endif /* !OC_BLOCK_WISE || !OC_DYNAMIC_ALLOCATION */
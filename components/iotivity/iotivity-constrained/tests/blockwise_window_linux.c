@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* A 64 KB resource is fetched block by block and with several block
+ * requests in flight. The server runs in a child process, and every
+ * datagram between it and the client goes through a relay that holds it
+ * for LINK_DELAY_MS, standing in for a slow link. To measure over a real
+ * delayed link instead, run the test under e.g.
+ * `tc qdisc add dev lo root netem delay 20ms` with LINK_DELAY_MS set to 0.
+ */
+
+#include "test.h"
+
+#if defined(OC_BLOCK_WISE) && defined(OC_DYNAMIC_ALLOCATION)
+#include "messaging/coap/constants.h"
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Responses are at most 64 KB - 1 bytes long, and the blob leaves room for
+   its CBOR encoding */
+#define BLOB_SIZE (64000)
+#define LINK_DELAY_MS (10)
+#define WINDOW (8)
+#define RELAY_QUEUE_LEN (128)
+#define RELAY_MTU (4096)
+
+static uint8_t blob[BLOB_SIZE];
+static oc_endpoint_t server;
+static bool done;
+static size_t received_size;
+static bool received_intact;
+
+typedef struct
+{
+  int to_server;
+  oc_clock_time_t due;
+  size_t len;
+  uint8_t data[RELAY_MTU];
+} relay_packet_t;
+
+/* Datagrams from the client arrive on client_sock and leave towards the
+   server from server_sock; the server's replies take the opposite way. */
+static struct
+{
+  int client_sock;
+  int server_sock;
+  struct sockaddr_in6 client_addr;
+  struct sockaddr_in6 server_addr;
+  relay_packet_t queue[RELAY_QUEUE_LEN];
+  unsigned int head, count;
+  int drop_to_server;
+  int drop_to_client;
+  int num_to_server, num_to_client;
+  pthread_mutex_t mutex;
+  bool quit;
+} relay;
+
+static void
+relay_receive(int sock, int to_server)
+{
+  struct sockaddr_in6 from;
+  socklen_t from_len = sizeof(from);
+  relay_packet_t *p = &relay.queue[(relay.head + relay.count) %
+                                   RELAY_QUEUE_LEN];
+  ssize_t len = recvfrom(sock, p->data, RELAY_MTU, 0,
+                         (struct sockaddr *)&from, &from_len);
+  if (len <= 0) {
+    return;
+  }
+  pthread_mutex_lock(&relay.mutex);
+  int num = to_server ? ++relay.num_to_server : ++relay.num_to_client;
+  int drop = to_server ? relay.drop_to_server : relay.drop_to_client;
+  if (to_server) {
+    memcpy(&relay.client_addr, &from, sizeof(from));
+  }
+  if (num != drop && relay.count < RELAY_QUEUE_LEN) {
+    p->to_server = to_server;
+    p->len = (size_t)len;
+    p->due = oc_clock_time() + LINK_DELAY_MS * OC_CLOCK_SECOND / 1000;
+    relay.count++;
+  }
+  pthread_mutex_unlock(&relay.mutex);
+}
+
+static void *
+relay_thread(void *data)
+{
+  (void)data;
+  struct pollfd fds[2] = { { relay.client_sock, POLLIN, 0 },
+                           { relay.server_sock, POLLIN, 0 } };
+  while (!relay.quit) {
+    if (poll(fds, 2, 1) > 0) {
+      if (fds[0].revents & POLLIN) {
+        relay_receive(relay.client_sock, 1);
+      }
+      if (fds[1].revents & POLLIN) {
+        relay_receive(relay.server_sock, 0);
+      }
+    }
+    oc_clock_time_t now = oc_clock_time();
+    while (relay.count > 0 && relay.queue[relay.head].due <= now) {
+      relay_packet_t *p = &relay.queue[relay.head];
+      if (p->to_server) {
+        sendto(relay.server_sock, p->data, p->len, 0,
+               (struct sockaddr *)&relay.server_addr,
+               sizeof(relay.server_addr));
+      } else {
+        sendto(relay.client_sock, p->data, p->len, 0,
+               (struct sockaddr *)&relay.client_addr,
+               sizeof(relay.client_addr));
+      }
+      relay.head = (relay.head + 1) % RELAY_QUEUE_LEN;
+      relay.count--;
+    }
+  }
+  return NULL;
+}
+
+static int
+relay_socket(uint16_t *port)
+{
+  struct sockaddr_in6 addr;
+  socklen_t len = sizeof(addr);
+  int sock = socket(AF_INET6, SOCK_DGRAM, 0);
+  ASSERT(sock >= 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_addr = in6addr_loopback;
+  ASSERT(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  ASSERT(getsockname(sock, (struct sockaddr *)&addr, &len) == 0);
+  if (port) {
+    *port = ntohs(addr.sin6_port);
+  }
+  return sock;
+}
+
+static void
+get_blob(oc_request_t *request, oc_interface_mask_t interface,
+         void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_rep_start_root_object();
+  oc_rep_set_byte_string(root, data, blob, BLOB_SIZE);
+  oc_rep_end_root_object();
+  oc_send_response(request, OC_STATUS_OK);
+}
+
+static void
+register_resources(void)
+{
+  oc_resource_t *res = oc_new_resource(NULL, "/a/blob", 1, 0);
+  ASSERT(res != NULL);
+  oc_resource_bind_resource_type(res, "core.blob");
+  oc_resource_bind_resource_interface(res, OC_IF_R);
+  oc_resource_set_default_interface(res, OC_IF_R);
+  oc_resource_set_request_handler(res, OC_GET, get_blob, NULL);
+  ASSERT(oc_add_resource(res));
+}
+
+static void
+blob_response(oc_client_response_t *data)
+{
+  oc_rep_t *rep = data->payload;
+  done = true;
+  received_size = 0;
+  received_intact = false;
+  if (data->code != OC_STATUS_OK || rep == NULL ||
+      rep->type != OC_REP_BYTE_STRING) {
+    return;
+  }
+  received_size = oc_string_len(rep->value.string);
+  received_intact = (received_size == BLOB_SIZE &&
+                     memcmp(oc_string(rep->value.string), blob,
+                            BLOB_SIZE) == 0);
+}
+
+static double
+fetch_blob(uint8_t window, int drop_to_server, int drop_to_client)
+{
+  struct timespec start, end;
+
+  ASSERT(oc_set_block_window(window) == 0);
+  pthread_mutex_lock(&relay.mutex);
+  relay.num_to_server = relay.num_to_client = 0;
+  relay.drop_to_server = drop_to_server;
+  relay.drop_to_client = drop_to_client;
+  pthread_mutex_unlock(&relay.mutex);
+
+  done = false;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  ASSERT(oc_do_get("/a/blob", &server, NULL, blob_response, LOW_QOS, NULL));
+  POLL_UNTIL(done, 60);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ASSERT(done);
+#ifndef OC_SECURITY
+  ASSERT(received_intact);
+#endif /* !OC_SECURITY */
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static void
+run_server(int port_fd)
+{
+  oc_endpoint_t ep;
+  test_get_endpoint(0, IPV6, &ep);
+  ASSERT(write(port_fd, &ep.addr.ipv6.port, sizeof(uint16_t)) ==
+         sizeof(uint16_t));
+  close(port_fd);
+  while (1) {
+    oc_main_poll();
+  }
+}
+
+int
+main(void)
+{
+  pthread_t thread;
+  uint16_t server_port, relay_port;
+  int port_pipe[2];
+  size_t i;
+
+  for (i = 0; i < BLOB_SIZE; i++) {
+    blob[i] = (uint8_t)(i * 7 + i / 251);
+  }
+  oc_set_max_app_data_size(BLOB_SIZE + 1024);
+
+  ASSERT(pipe(port_pipe) == 0);
+  pid_t server_pid = fork();
+  ASSERT(server_pid >= 0);
+  if (server_pid == 0) {
+    /* Do not outlive a client that failed an assertion */
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    close(port_pipe[0]);
+    test_init_stack(1, register_resources);
+    run_server(port_pipe[1]);
+  }
+  close(port_pipe[1]);
+  ASSERT(read(port_pipe[0], &server_port, sizeof(server_port)) ==
+         sizeof(server_port));
+  close(port_pipe[0]);
+  test_init_stack(1, register_resources);
+
+  memset(&relay, 0, sizeof(relay));
+  pthread_mutex_init(&relay.mutex, NULL);
+  relay.client_sock = relay_socket(&relay_port);
+  relay.server_sock = relay_socket(NULL);
+  relay.server_addr.sin6_family = AF_INET6;
+  relay.server_addr.sin6_addr = in6addr_loopback;
+  relay.server_addr.sin6_port = htons(server_port);
+  ASSERT(pthread_create(&thread, NULL, relay_thread, NULL) == 0);
+
+  memset(&server, 0, sizeof(server));
+  server.flags = IPV6;
+  server.addr.ipv6.port = relay_port;
+  server.addr.ipv6.address[15] = 1;
+
+  /* One block at a time takes a round trip per block. */
+  int num_blocks = (BLOB_SIZE + 1023) / 1024;
+  double one_block = fetch_blob(1, 0, 0);
+  double windowed = fetch_blob(WINDOW, 0, 0);
+
+  /* Lose the 20th response, and the request for one of the last blocks so
+     that the server is asked for it after it has sent the final block. The
+     requests for the two lost blocks are resent as soon as later blocks
+     arrive, well before the retransmission timeout. */
+  double lossy = fetch_blob(WINDOW, num_blocks - 3, 20);
+#ifndef OC_SECURITY
+  /* Secure builds deny the unsecured request for the first block. */
+  ASSERT(one_block > num_blocks * 2 * LINK_DELAY_MS / 1000.0);
+  ASSERT(windowed < one_block / 2);
+  ASSERT(lossy < one_block / 2);
+  ASSERT(lossy < COAP_RESPONSE_TIMEOUT);
+  ASSERT(relay.num_to_server == num_blocks + 2);
+#else  /* !OC_SECURITY */
+  (void)one_block;
+  (void)windowed;
+  (void)lossy;
+#endif /* OC_SECURITY */
+
+  relay.quit = true;
+  pthread_join(thread, NULL);
+  close(relay.client_sock);
+  close(relay.server_sock);
+  oc_main_shutdown();
+  kill(server_pid, SIGTERM);
+  waitpid(server_pid, NULL, 0);
+
+  return 0;
+}
+#else  /* OC_BLOCK_WISE && OC_DYNAMIC_ALLOCATION */
+int
+main(void)
+{
+  printf("built without OC_BLOCK_WISE or OC_DYNAMIC_ALLOCATION\n");
+  return 0;
+}
+#endif /* !OC_BLOCK_WISE || !OC_DYNAMIC_ALLOCATION */
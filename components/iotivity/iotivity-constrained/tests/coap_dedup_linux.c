@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include "messaging/coap/constants.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int num_get_requests;
+
+/* The clock is moved forward to get past the exchange lifetime. It is
+   wrapped through the linker's --wrap option. */
+oc_clock_time_t __real_oc_clock_time(void);
+static oc_clock_time_t clock_offset;
+
+oc_clock_time_t
+__wrap_oc_clock_time(void)
+{
+  return __real_oc_clock_time() + clock_offset;
+}
+
+static void
+get_handler(oc_request_t *request, oc_interface_mask_t interface,
+            void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  num_get_requests++;
+  oc_rep_start_root_object();
+  oc_rep_set_int(root, count, num_get_requests);
+  oc_rep_end_root_object();
+  oc_send_response(request, OC_STATUS_OK);
+}
+
+static void
+register_resources(void)
+{
+  oc_resource_t *res = oc_new_resource(NULL, "/a", 1, 0);
+  ASSERT(res != NULL);
+  oc_resource_bind_resource_type(res, "core.counter");
+  oc_resource_set_request_handler(res, OC_GET, get_handler, NULL);
+  ASSERT(oc_add_resource(res));
+}
+
+int
+main(void)
+{
+  oc_endpoint_t server;
+
+  test_init_stack(1, register_resources);
+  test_get_endpoint(0, IPV6, &server);
+  int sock = test_connect_udp(&server);
+
+  /* CON GET /a, MID 0x1234, token 0x42 */
+  const uint8_t request[] = { 0x41, 0x01, 0x12, 0x34, 0x42, 0xb1, 'a' };
+  uint8_t first[256], second[256];
+
+  ssize_t first_len =
+    test_exchange(sock, request, sizeof(request), first, sizeof(first));
+  ASSERT(first_len > 4);
+  ASSERT(first[2] == 0x12 && first[3] == 0x34);
+
+  ssize_t second_len =
+    test_exchange(sock, request, sizeof(request), second, sizeof(second));
+  ASSERT(second_len > 4);
+  ASSERT(second[2] == 0x12 && second[3] == 0x34);
+
+#ifdef OC_DYNAMIC_ALLOCATION
+  /* The duplicate was answered from the cache, not by the handler. */
+  ASSERT(second_len == first_len);
+  ASSERT(memcmp(first, second, first_len) == 0);
+#ifndef OC_SECURITY
+  ASSERT(num_get_requests == 1);
+#endif /* !OC_SECURITY */
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+  /* The same MID from another source port is a different exchange. */
+  int handled = num_get_requests;
+  int other_sock = test_connect_udp(&server);
+  ASSERT(test_exchange(other_sock, request, sizeof(request), second,
+                       sizeof(second)) > 4);
+  ASSERT(second[2] == 0x12 && second[3] == 0x34);
+#ifndef OC_SECURITY
+  ASSERT(num_get_requests == handled + 1);
+#endif /* !OC_SECURITY */
+  close(other_sock);
+
+  /* Once the exchange lifetime has passed, the MID may be reused for a
+     new request. */
+  handled = num_get_requests;
+  clock_offset += (OC_EXCHANGE_LIFETIME + 1) * OC_CLOCK_SECOND;
+  ASSERT(test_exchange(sock, request, sizeof(request), second,
+                       sizeof(second)) > 4);
+  ASSERT(second[2] == 0x12 && second[3] == 0x34);
+#ifndef OC_SECURITY
+  ASSERT(num_get_requests == handled + 1);
+#endif /* !OC_SECURITY */
+  (void)handled;
+
+  close(sock);
+  oc_main_shutdown();
+
+  return 0;
+}
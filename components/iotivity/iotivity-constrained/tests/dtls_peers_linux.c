@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* More DTLS clients than there are peer buckets hold sessions with a server
+ * at once. Each must be answered over its own session, closing some must not
+ * disturb the rest, and handshakes left waiting must be retransmitted.
+ */
+
+#include "test.h"
+
+#if defined(OC_SECURITY) && defined(OC_DYNAMIC_ALLOCATION)
+#include "security/oc_cred.h"
+#include "security/oc_dtls.h"
+
+#include <sys/socket.h>
+
+#define NUM_CLIENTS (OC_DTLS_PEER_BUCKETS + OC_DTLS_PEER_BUCKETS / 2)
+
+static test_dtls_client_t clients[NUM_CLIENTS];
+static bool replied[NUM_CLIENTS];
+static const uint8_t key[16] = { 0x0b, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+                                 0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0 };
+
+/* Every third client goes silent once the server has answered its
+   ClientHello, leaving the server's flight to be retransmitted. */
+static bool
+is_silent(int i)
+{
+  return i % 3 == 0;
+}
+
+static bool
+has_datagram(int i)
+{
+  uint8_t byte;
+  return recv(clients[i].sock, &byte, 1, MSG_PEEK | MSG_DONTWAIT) > 0;
+}
+
+static void
+drain(int i)
+{
+  uint8_t buf[1500];
+  while (recv(clients[i].sock, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+  }
+}
+
+/* The server's flight begins with a ServerHello, which follows the 13 byte
+   DTLS record header. */
+static bool
+has_server_flight(int i)
+{
+  uint8_t header[14];
+  return recv(clients[i].sock, header, sizeof(header),
+              MSG_PEEK | MSG_DONTWAIT) == (ssize_t)sizeof(header) &&
+         header[0] == MBEDTLS_SSL_MSG_HANDSHAKE &&
+         header[13] == MBEDTLS_SSL_HS_SERVER_HELLO;
+}
+
+/* Advances every handshake that is not done or held back, and returns
+   whether none is left to advance. */
+static bool
+step_handshakes(bool hold_silent)
+{
+  bool done = true;
+  int i;
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    if (clients[i].ssl.state == MBEDTLS_SSL_HANDSHAKE_OVER ||
+        (hold_silent && is_silent(i) && has_server_flight(i))) {
+      continue;
+    }
+    int ret = mbedtls_ssl_handshake(&clients[i].ssl);
+    ASSERT(ret == 0 || ret == MBEDTLS_ERR_SSL_WANT_READ);
+    done = done && ret == 0;
+  }
+  return done;
+}
+
+static bool
+silent_clients_have_datagrams(void)
+{
+  int i;
+  for (i = 0; i < NUM_CLIENTS; i += 3) {
+    if (!has_datagram(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void
+send_requests(int first, int step)
+{
+  int i;
+  for (i = first; i < NUM_CLIENTS; i += step) {
+    uint8_t request[] = { 0x40, 0x01, (uint8_t)(i >> 8), (uint8_t)i,
+                          0xb3, 'o',  'i',  'c',  0x01, 'd' };
+    replied[i] = false;
+    ASSERT(mbedtls_ssl_write(&clients[i].ssl, request, sizeof(request)) ==
+           (int)sizeof(request));
+  }
+}
+
+static bool
+read_replies(void)
+{
+  bool all = true;
+  int i;
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    uint8_t reply[256];
+    int ret = mbedtls_ssl_read(&clients[i].ssl, reply, sizeof(reply));
+    if (ret >= 4) {
+      ASSERT(reply[2] == (uint8_t)(i >> 8) && reply[3] == (uint8_t)i);
+      replied[i] = true;
+    }
+    all = all && replied[i];
+  }
+  return all;
+}
+
+static int
+count_replies(int first, int step)
+{
+  int n = 0, i;
+  for (i = first; i < NUM_CLIENTS; i += step) {
+    n += replied[i];
+  }
+  return n;
+}
+
+int
+main(void)
+{
+  oc_uuid_t identity;
+  oc_endpoint_t server;
+  int i;
+
+  test_init_stack(1, NULL);
+  test_get_endpoint(0, IPV6 | SECURED, &server);
+
+  oc_gen_uuid(&identity);
+  oc_sec_cred_t *cred = oc_sec_get_cred(&identity, 0);
+  ASSERT(cred != NULL);
+  cred->credtype = 1;
+  memcpy(cred->key, key, sizeof(key));
+
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    test_dtls_client_init(&clients[i], &server, &identity, key);
+  }
+
+  /* All handshakes run side by side, and the silent clients stop once the
+     server's flight reaches them. */
+  bool done = false;
+  POLL_UNTIL((done = step_handshakes(true)), 10);
+  ASSERT(done);
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    if (is_silent(i)) {
+      ASSERT(clients[i].ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER);
+      drain(i);
+    }
+  }
+
+  /* The server's retransmission timer finds every pending handshake; its
+     timeout doubles after each retransmission, starting at 2.5 seconds. */
+  test_run_for(OC_CLOCK_SECOND / 10);
+  POLL_UNTIL(silent_clients_have_datagrams(), 10);
+  ASSERT(silent_clients_have_datagrams());
+  done = false;
+  POLL_UNTIL((done = step_handshakes(false)), 5);
+  ASSERT(done);
+
+  /* Every client is answered over its own session. */
+  send_requests(0, 1);
+  POLL_UNTIL(read_replies(), 5);
+  ASSERT(count_replies(0, 1) == NUM_CLIENTS);
+
+  /* Closing every other session removes those peers and leaves the rest. */
+  for (i = 0; i < NUM_CLIENTS; i += 2) {
+    mbedtls_ssl_close_notify(&clients[i].ssl);
+  }
+  test_run_for(OC_CLOCK_SECOND / 2);
+  send_requests(0, 1);
+  POLL_UNTIL((read_replies(), count_replies(1, 2) == NUM_CLIENTS / 2), 5);
+  test_run_for(OC_CLOCK_SECOND / 2);
+  read_replies();
+  ASSERT(count_replies(1, 2) == NUM_CLIENTS / 2);
+  ASSERT(count_replies(0, 2) == 0);
+
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    test_dtls_client_free(&clients[i]);
+  }
+  oc_main_shutdown();
+
+  return 0;
+}
+#else  /* OC_SECURITY && OC_DYNAMIC_ALLOCATION */
+int
+main(void)
+{
+  printf("built without OC_SECURITY or OC_DYNAMIC_ALLOCATION\n");
+  return 0;
+}
+#endif /* !OC_SECURITY || !OC_DYNAMIC_ALLOCATION */
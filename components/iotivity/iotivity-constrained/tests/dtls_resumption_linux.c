@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* A client that reconnects with the session of an earlier PSK handshake
+ * resumes it, unless the credential the session was established with has
+ * since changed or been removed.
+ */
+
+#include "test.h"
+
+#if defined(OC_SECURITY) && defined(OC_DYNAMIC_ALLOCATION)
+#include "security/oc_cred.h"
+
+static const uint8_t key[16] = { 0x0b, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+                                 0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0 };
+static const uint8_t new_key[16] = { 0xf0, 0xe1, 0xd2, 0xc3, 0xb4, 0xa5,
+                                     0x96, 0x87, 0x78, 0x69, 0x5a, 0x4b,
+                                     0x3c, 0x2d, 0x1e, 0x0b };
+static oc_uuid_t identity;
+static oc_endpoint_t server;
+
+/* Connects with the key, offering session if it has an ID, and leaves the
+   session that was established in session. Returns the handshake result. */
+static int
+reconnect(const uint8_t *psk, mbedtls_ssl_session *session, bool *resumed)
+{
+  test_dtls_client_t client;
+  test_dtls_client_init(&client, &server, &identity, psk);
+  if (session->id_len > 0) {
+    ASSERT(mbedtls_ssl_set_session(&client.ssl, session) == 0);
+  }
+  int ret = test_dtls_client_handshake(&client);
+  if (ret == 0) {
+    *resumed = (client.num_key_exchanges == 0);
+    mbedtls_ssl_session_free(session);
+    mbedtls_ssl_session_init(session);
+    ASSERT(mbedtls_ssl_get_session(&client.ssl, session) == 0);
+  }
+  test_dtls_client_free(&client);
+  /* Let the server see close_notify. */
+  test_run_for(OC_CLOCK_SECOND / 10);
+  return ret;
+}
+
+int
+main(void)
+{
+  mbedtls_ssl_session session;
+  unsigned char first_id[32];
+  size_t first_id_len;
+  bool resumed = true;
+  char uuid[37];
+
+  test_init_stack(1, NULL);
+  test_get_endpoint(0, IPV6 | SECURED, &server);
+
+  oc_gen_uuid(&identity);
+  oc_sec_cred_t *cred = oc_sec_get_cred(&identity, 0);
+  ASSERT(cred != NULL);
+  cred->credtype = 1;
+  memcpy(cred->key, key, sizeof(key));
+
+  /* The first connection takes a full handshake. */
+  mbedtls_ssl_session_init(&session);
+  ASSERT(reconnect(key, &session, &resumed) == 0);
+  ASSERT(!resumed);
+  first_id_len = session.id_len;
+  ASSERT(first_id_len > 0);
+  memcpy(first_id, session.id, first_id_len);
+
+  /* Reconnecting with its session skips the key exchange. */
+  ASSERT(reconnect(key, &session, &resumed) == 0);
+  ASSERT(resumed);
+  ASSERT(session.id_len == first_id_len &&
+         memcmp(session.id, first_id, first_id_len) == 0);
+
+  /* Once the credential changes, the session is refused and the client
+     needs the new key. */
+  memcpy(cred->key, new_key, sizeof(new_key));
+  ASSERT(reconnect(new_key, &session, &resumed) == 0);
+  ASSERT(!resumed);
+  ASSERT(session.id_len != first_id_len ||
+         memcmp(session.id, first_id, first_id_len) != 0);
+  ASSERT(reconnect(new_key, &session, &resumed) == 0);
+  ASSERT(resumed);
+
+  /* Once the credential is removed, neither resumption nor a full handshake
+     succeeds. */
+  oc_uuid_to_str(&identity, uuid, sizeof(uuid));
+  ASSERT(oc_cred_remove_subject(uuid, 0));
+  ASSERT(reconnect(new_key, &session, &resumed) != 0);
+
+  mbedtls_ssl_session_free(&session);
+  oc_main_shutdown();
+
+  return 0;
+}
+#else  /* OC_SECURITY && OC_DYNAMIC_ALLOCATION */
+int
+main(void)
+{
+  printf("built without OC_SECURITY or OC_DYNAMIC_ALLOCATION\n");
+  return 0;
+}
+#endif /* !OC_SECURITY || !OC_DYNAMIC_ALLOCATION */
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include "port/oc_clock.h"
+#include "util/oc_etimer.h"
+#include "util/oc_process.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_TIMERS (10000)
+
+static struct oc_etimer timers[NUM_TIMERS];
+static int num_expired;
+static oc_clock_time_t last_expiration;
+
+OC_PROCESS(stress_process, "Timer stress");
+OC_PROCESS_THREAD(stress_process, ev, data)
+{
+  OC_PROCESS_BEGIN();
+
+  while (1) {
+    OC_PROCESS_YIELD();
+    if (ev == OC_PROCESS_EVENT_TIMER) {
+      struct oc_etimer *t = data;
+      oc_clock_time_t expiration = oc_etimer_expiration_time(t);
+      ASSERT(t >= timers && t < timers + NUM_TIMERS);
+      ASSERT((t - timers) % 2 == 0);
+      ASSERT(oc_etimer_expired(t));
+      /* Timers must fire in order of expiration. */
+      ASSERT(expiration >= last_expiration);
+      last_expiration = expiration;
+      num_expired++;
+    }
+  }
+
+  OC_PROCESS_END();
+}
+
+static double
+elapsed_ns(struct timespec *start, struct timespec *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+int
+main(void)
+{
+  int i;
+  struct timespec start, end;
+
+  oc_clock_init();
+  oc_process_init();
+  oc_process_start(&oc_etimer_process, NULL);
+  oc_process_start(&stress_process, NULL);
+  srand(1);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  OC_PROCESS_CONTEXT_BEGIN(&stress_process);
+  for (i = 0; i < NUM_TIMERS; i++) {
+    oc_etimer_set(&timers[i],
+                  OC_CLOCK_SECOND / 100 + rand() % (OC_CLOCK_SECOND / 20));
+  }
+  OC_PROCESS_CONTEXT_END(&stress_process);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double arm_ns = elapsed_ns(&start, &end);
+
+  /* Re-arming a pending timer must not duplicate it. */
+  OC_PROCESS_CONTEXT_BEGIN(&stress_process);
+  oc_etimer_restart(&timers[0]);
+  OC_PROCESS_CONTEXT_END(&stress_process);
+  ASSERT(oc_etimer_pending());
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 1; i < NUM_TIMERS; i += 2) {
+    oc_etimer_stop(&timers[i]);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double cancel_ns = elapsed_ns(&start, &end);
+
+  for (i = 0; i < NUM_TIMERS; i++) {
+    ASSERT(oc_etimer_expired(&timers[i]) == (i % 2));
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  oc_clock_time_t deadline = oc_clock_time() + 5 * OC_CLOCK_SECOND;
+  while (num_expired < NUM_TIMERS / 2 && oc_clock_time() < deadline) {
+    oc_etimer_request_poll();
+    while (oc_process_run()) {
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  ASSERT(num_expired == NUM_TIMERS / 2);
+  ASSERT(!oc_etimer_pending());
+  ASSERT(oc_etimer_next_expiration_time() == 0);
+
+  printf("%d timers: arm %.1f ns/timer, cancel %.1f ns/timer, "
+         "all expired after %.1f ms\n",
+         NUM_TIMERS, arm_ns / NUM_TIMERS, cancel_ns / (NUM_TIMERS / 2),
+         elapsed_ns(&start, &end) / 1e6);
+
+  oc_process_exit(&stress_process);
+  oc_process_exit(&oc_etimer_process);
+
+  return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include "util/oc_memb.h"
+
+#define NUM_BLOCKS (8)
+#define NUM_CHURN_BLOCKS (64)
+#define NUM_ROUNDS (100)
+
+typedef struct
+{
+  void *next;
+  uint8_t data[40];
+} item_t;
+
+OC_MEMB(plain_s, item_t, NUM_BLOCKS);
+OC_MEMB_ZEROED(zeroed_s, item_t, NUM_BLOCKS);
+OC_MEMB(churn_s, item_t, NUM_CHURN_BLOCKS);
+
+static void
+check_stats(struct oc_memb *m, unsigned int current, unsigned int peak,
+            unsigned int failures)
+{
+  oc_memb_stats_t stats;
+  oc_memb_get_stats(m, &stats);
+  ASSERT(stats.current == current);
+  ASSERT(stats.peak == peak);
+  ASSERT(stats.failures == failures);
+}
+
+static void
+test_exhaustion(void)
+{
+  item_t *items[NUM_BLOCKS];
+  int i, j;
+
+  for (i = 0; i < NUM_BLOCKS; i++) {
+    items[i] = oc_memb_alloc(&plain_s);
+    ASSERT(items[i] != NULL);
+    for (j = 0; j < i; j++) {
+      ASSERT(items[i] != items[j]);
+    }
+  }
+  check_stats(&plain_s, NUM_BLOCKS, NUM_BLOCKS, 0);
+
+#ifndef OC_DYNAMIC_ALLOCATION
+  ASSERT(oc_memb_alloc(&plain_s) == NULL);
+  check_stats(&plain_s, NUM_BLOCKS, NUM_BLOCKS, 1);
+  ASSERT(oc_memb_numfree(&plain_s) == 0);
+
+  /* Pointers outside of the pool or into the middle of a block are
+     rejected. */
+  item_t outside;
+  ASSERT(oc_memb_free(&plain_s, &outside) == -1);
+  ASSERT(oc_memb_free(&plain_s, items[0]->data) == -1);
+
+  /* The most recently freed block is handed out first, and freeing a block
+     twice does not put it on the free list twice. */
+  ASSERT(oc_memb_free(&plain_s, items[5]) == 0);
+  ASSERT(oc_memb_free(&plain_s, items[5]) == 0);
+  ASSERT(oc_memb_free(&plain_s, items[2]) == 0);
+  ASSERT(oc_memb_numfree(&plain_s) == 2);
+  check_stats(&plain_s, NUM_BLOCKS - 2, NUM_BLOCKS, 1);
+  items[2] = oc_memb_alloc(&plain_s);
+  items[5] = oc_memb_alloc(&plain_s);
+  ASSERT(items[2] != NULL && items[5] != NULL && items[2] != items[5]);
+  ASSERT(oc_memb_alloc(&plain_s) == NULL);
+  check_stats(&plain_s, NUM_BLOCKS, NUM_BLOCKS, 2);
+#endif /* !OC_DYNAMIC_ALLOCATION */
+
+  for (i = 0; i < NUM_BLOCKS; i++) {
+    ASSERT(oc_memb_free(&plain_s, items[i]) == 0);
+  }
+  oc_memb_stats_t stats;
+  oc_memb_get_stats(&plain_s, &stats);
+  ASSERT(stats.current == 0);
+  ASSERT(stats.peak == NUM_BLOCKS);
+}
+
+static void
+test_zeroing(void)
+{
+  int round, i;
+
+  for (round = 0; round < 3; round++) {
+    item_t *item = oc_memb_alloc(&zeroed_s);
+    ASSERT(item != NULL);
+    ASSERT(item->next == NULL);
+    for (i = 0; i < (int)sizeof(item->data); i++) {
+      ASSERT(item->data[i] == 0);
+    }
+    item->next = item;
+    memset(item->data, 0xa5, sizeof(item->data));
+    oc_memb_free(&zeroed_s, item);
+  }
+  check_stats(&zeroed_s, 0, 1, 0);
+}
+
+static void
+test_churn(void)
+{
+  item_t *items[NUM_CHURN_BLOCKS];
+#ifndef OC_DYNAMIC_ALLOCATION
+  item_t *freed[NUM_CHURN_BLOCKS];
+#endif /* !OC_DYNAMIC_ALLOCATION */
+  int round, i;
+
+  for (round = 0; round < NUM_ROUNDS; round++) {
+    for (i = 0; i < NUM_CHURN_BLOCKS; i++) {
+      items[i] = oc_memb_alloc(&churn_s);
+      ASSERT(items[i] != NULL);
+#ifndef OC_DYNAMIC_ALLOCATION
+      /* Blocks come off the free list in the reverse order of their
+         release, without a scan of the pool. */
+      if (round > 0) {
+        ASSERT(items[i] == freed[NUM_CHURN_BLOCKS - 1 - i]);
+      }
+#endif /* !OC_DYNAMIC_ALLOCATION */
+    }
+    for (i = 0; i < NUM_CHURN_BLOCKS; i++) {
+      ASSERT(oc_memb_free(&churn_s, items[i]) == 0);
+#ifndef OC_DYNAMIC_ALLOCATION
+      freed[i] = items[i];
+#endif /* !OC_DYNAMIC_ALLOCATION */
+    }
+  }
+  check_stats(&churn_s, 0, NUM_CHURN_BLOCKS, 0);
+}
+
+int
+main(void)
+{
+  test_exhaustion();
+  test_zeroing();
+  test_churn();
+  return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include "oc_api.h"
+#include "oc_buffer.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define NUM_ROUNDS (100000)
+#define BATCH_SIZE (8)
+#define NUM_THREADS (4)
+
+#ifdef OC_MESSAGE_POOL
+static void
+print_stats(const char *name, oc_message_size_class_t size_class)
+{
+  oc_message_pool_stats_t stats;
+  oc_message_pool_get_stats(size_class, &stats);
+  printf("%s: in use %u, high water %u, capacity %u, heap fallbacks %u\n",
+         name, stats.in_use, stats.high_water, stats.capacity,
+         stats.heap_fallbacks);
+}
+
+static void *
+worker(void *data)
+{
+  oc_message_t *batch[BATCH_SIZE];
+  uint8_t tag = (uint8_t)(intptr_t)data;
+  int i, j;
+
+  for (i = 0; i < NUM_ROUNDS / 10; i++) {
+    for (j = 0; j < BATCH_SIZE; j++) {
+      batch[j] = (j & 1) ? oc_allocate_small_message() : oc_allocate_message();
+      ASSERT(batch[j] != NULL);
+      memset(batch[j]->data, tag, 32);
+      batch[j]->length = j;
+    }
+    for (j = 0; j < BATCH_SIZE; j++) {
+      /* No block may be handed out twice at the same time. */
+      ASSERT(batch[j]->data[0] == tag && batch[j]->data[31] == tag);
+      ASSERT(batch[j]->length == (size_t)j);
+      oc_message_unref(batch[j]);
+    }
+  }
+  return NULL;
+}
+#endif /* OC_MESSAGE_POOL */
+
+int
+main(void)
+{
+  oc_message_t *batch[BATCH_SIZE];
+  struct timespec start, end;
+  int i, j;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < NUM_ROUNDS; i++) {
+    for (j = 0; j < BATCH_SIZE / 2; j++) {
+      batch[j] = oc_allocate_message();
+      ASSERT(batch[j] != NULL);
+      ASSERT(batch[j]->ref_count == 1);
+      batch[j]->data[OC_PDU_SIZE - 1] = 0;
+    }
+    for (j = 0; j < BATCH_SIZE / 2; j++) {
+      oc_message_add_ref(batch[j]);
+      oc_message_unref(batch[j]);
+      oc_message_unref(batch[j]);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double elapsed_s =
+    (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%d message allocations: %.0f allocations/s\n",
+         NUM_ROUNDS * BATCH_SIZE / 2, NUM_ROUNDS * BATCH_SIZE / 2 / elapsed_s);
+
+  oc_message_t *small = oc_allocate_small_message();
+  ASSERT(small != NULL);
+  oc_message_unref(small);
+
+#ifdef OC_MESSAGE_POOL
+  oc_message_pool_stats_t stats;
+  oc_message_pool_get_stats(OC_MESSAGE_FULL, &stats);
+  /* Steady state traffic is served from the pool without growing it. */
+  ASSERT(stats.in_use == 0);
+  ASSERT(stats.high_water == BATCH_SIZE / 2);
+  ASSERT(stats.heap_fallbacks == 0);
+  uint32_t capacity = stats.capacity;
+
+  pthread_t threads[NUM_THREADS];
+  for (i = 0; i < NUM_THREADS; i++) {
+    ASSERT(pthread_create(&threads[i], NULL, worker,
+                          (void *)(intptr_t)(i + 1)) == 0);
+  }
+  for (i = 0; i < NUM_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  oc_message_pool_get_stats(OC_MESSAGE_FULL, &stats);
+  ASSERT(stats.in_use == 0);
+  ASSERT(stats.high_water <= NUM_THREADS * BATCH_SIZE / 2 + BATCH_SIZE / 2);
+  ASSERT(stats.capacity >= capacity);
+  oc_message_pool_get_stats(OC_MESSAGE_SMALL, &stats);
+  ASSERT(stats.in_use == 0);
+  ASSERT(stats.high_water >= 1);
+
+  print_stats("full", OC_MESSAGE_FULL);
+  print_stats("small", OC_MESSAGE_SMALL);
+#endif /* OC_MESSAGE_POOL */
+
+  return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include <stdio.h>
+
+#ifndef OC_DYNAMIC_ALLOCATION
+#include "util/oc_mmem.h"
+
+#define NUM_REQUESTS (100000)
+#define MAX_REQUEST_BLOCKS (12)
+#define NUM_LONG_LIVED (4)
+
+typedef struct
+{
+  struct oc_mmem handle;
+  pool pool_type;
+  uint8_t tag;
+} block_t;
+
+static uint32_t seed = 1;
+
+static uint32_t
+next_random(void)
+{
+  seed = seed * 1103515245u + 12345u;
+  return (seed >> 16) & 0x7fff;
+}
+
+static size_t
+unit_size(pool pool_type)
+{
+  return (pool_type == BYTE_POOL) ? 1 : (pool_type == INT_POOL)
+                                          ? sizeof(int)
+                                          : sizeof(double);
+}
+
+static void
+alloc_block(block_t *block, pool pool_type, unsigned int size)
+{
+  block->pool_type = pool_type;
+  block->tag = (uint8_t)next_random();
+  ASSERT(oc_mmem_alloc(&block->handle, size, pool_type) == 1);
+  memset(block->handle.ptr, block->tag, size * unit_size(pool_type));
+}
+
+static void
+free_block(block_t *block)
+{
+  size_t i, len = block->handle.size * unit_size(block->pool_type);
+  const uint8_t *data = block->handle.ptr;
+  for (i = 0; i < len; i++) {
+    ASSERT(data[i] == block->tag);
+  }
+  oc_mmem_free(&block->handle, block->pool_type);
+}
+
+/* The allocations made while a request is parsed and served: a name per
+   property, string values, and now and then an int array or an array of
+   resource types. */
+static int
+alloc_request(block_t *blocks)
+{
+  int i, num_blocks = 2 + next_random() % (MAX_REQUEST_BLOCKS - 2);
+  for (i = 0; i < num_blocks; i++) {
+    uint32_t kind = next_random() % 16;
+    if (kind == 0) {
+      alloc_block(&blocks[i], INT_POOL, 1 + next_random() % 8);
+    } else if (kind == 1) {
+      alloc_block(&blocks[i], BYTE_POOL, 32 * (1 + next_random() % 3));
+    } else if (kind < 8) {
+      alloc_block(&blocks[i], BYTE_POOL, 8 + next_random() % 32);
+    } else {
+      alloc_block(&blocks[i], BYTE_POOL, 3 + next_random() % 10);
+    }
+  }
+  return num_blocks;
+}
+
+int
+main(void)
+{
+  block_t resources[8], long_lived[NUM_LONG_LIVED];
+  block_t blocks[MAX_REQUEST_BLOCKS];
+  oc_mmem_stats_t stats;
+  int i, j;
+
+  oc_mmem_init();
+
+  /* URIs, names and types of the resources registered at start-up */
+  for (i = 0; i < 8; i++) {
+    alloc_block(&resources[i], BYTE_POOL, 6 + next_random() % 20);
+  }
+  for (i = 0; i < NUM_LONG_LIVED; i++) {
+    alloc_block(&long_lived[i], BYTE_POOL, 10 + next_random() % 30);
+  }
+
+  unsigned int max_blocks = 0, min_largest = OC_BYTES_POOL_SIZE;
+  for (i = 0; i < NUM_REQUESTS; i++) {
+    int num_blocks = alloc_request(blocks);
+    oc_mmem_get_stats(BYTE_POOL, &stats);
+    if (stats.free_blocks > max_blocks) {
+      max_blocks = stats.free_blocks;
+    }
+    if (stats.largest_free < min_largest) {
+      min_largest = stats.largest_free;
+    }
+    /* oc_free_rep() releases a tree from its last property backwards. */
+    for (j = num_blocks - 1; j >= 0; j--) {
+      free_block(&blocks[j]);
+    }
+    /* Query strings of observations and block-wise transfers outlive the
+       requests that created them, and end in no particular order. */
+    if (next_random() % 4 == 0) {
+      j = next_random() % NUM_LONG_LIVED;
+      free_block(&long_lived[j]);
+      alloc_block(&long_lived[j], BYTE_POOL, 10 + next_random() % 30);
+    }
+  }
+  /* Freed blocks coalesce, so the pool never fragments into many small
+     pieces. */
+  ASSERT(max_blocks <= 8);
+  ASSERT(min_largest >= OC_BYTES_POOL_SIZE / 2);
+
+  for (i = 0; i < 8; i++) {
+    free_block(&resources[i]);
+  }
+  for (i = 0; i < NUM_LONG_LIVED; i++) {
+    free_block(&long_lived[i]);
+  }
+
+  /* Freeing the oldest string of a full pool */
+  static block_t strings[OC_BYTES_POOL_SIZE / 32];
+  int num_strings = OC_BYTES_POOL_SIZE / 32;
+  for (i = 0; i < 1000; i++) {
+    for (j = 0; j < num_strings; j++) {
+      alloc_block(&strings[j], BYTE_POOL, 32);
+    }
+    for (j = 0; j < num_strings; j++) {
+      free_block(&strings[j]);
+    }
+  }
+
+  /* Empty blocks and handles that were already released take nothing from
+     the pool and free nothing either. */
+  struct oc_mmem empty;
+  ASSERT(oc_mmem_alloc(&empty, 0, BYTE_POOL) == 1);
+  oc_mmem_free(&empty, BYTE_POOL);
+  memset(&empty, 0, sizeof(empty));
+  oc_mmem_free(&empty, BYTE_POOL);
+  oc_mmem_free(&empty, INT_POOL);
+
+  /* Everything coalesces back into a single free block. */
+  pool pools[] = { BYTE_POOL, INT_POOL, DOUBLE_POOL };
+  for (i = 0; i < 3; i++) {
+    oc_mmem_get_stats(pools[i], &stats);
+    ASSERT(stats.used == 0);
+    ASSERT(stats.free_blocks == 1);
+    ASSERT(stats.largest_free == stats.size);
+  }
+
+  return 0;
+}
+#else /* !OC_DYNAMIC_ALLOCATION */
+int
+main(void)
+{
+  printf("Memory pool test requires a build without OC_DYNAMIC_ALLOCATION\n");
+  return 0;
+}
+#endif /* OC_DYNAMIC_ALLOCATION */
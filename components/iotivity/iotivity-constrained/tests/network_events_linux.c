@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Built against api/oc_network_events.c and util/oc_process.c only, with
+ * the consumer side (oc_recv_message) provided here, so that the handoff
+ * between the network threads and the event loop is measured in
+ * isolation.
+ */
+
+#include "test.h"
+
+#include "oc_buffer.h"
+#include "oc_network_events.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define NUM_PRODUCERS (4)
+#define MESSAGES_PER_PRODUCER (50000)
+#define POOL_SIZE (64)
+
+static oc_message_t pools[NUM_PRODUCERS][POOL_SIZE];
+static size_t next_sequence[NUM_PRODUCERS];
+static size_t num_received;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void
+oc_network_event_handler_mutex_init(void)
+{
+}
+
+void
+oc_network_event_handler_mutex_lock(void)
+{
+  pthread_mutex_lock(&mutex);
+}
+
+void
+oc_network_event_handler_mutex_unlock(void)
+{
+  pthread_mutex_unlock(&mutex);
+}
+
+void
+oc_network_event_handler_mutex_destroy(void)
+{
+}
+
+void
+_oc_signal_event_loop(void)
+{
+}
+
+void
+oc_recv_message(oc_message_t *message)
+{
+  int producer = message->endpoint.device;
+  ASSERT(producer >= 0 && producer < NUM_PRODUCERS);
+  /* Messages from each producer must arrive in the order they were sent. */
+  ASSERT(message->length == next_sequence[producer]);
+  next_sequence[producer]++;
+  num_received++;
+  __atomic_store_n(&message->ref_count, 0, __ATOMIC_RELEASE);
+}
+
+static void *
+producer(void *data)
+{
+  int id = (int)(intptr_t)data;
+  size_t i;
+
+  for (i = 0; i < MESSAGES_PER_PRODUCER; i++) {
+    oc_message_t *message = &pools[id][i % POOL_SIZE];
+    while (__atomic_load_n(&message->ref_count, __ATOMIC_ACQUIRE) != 0) {
+      sched_yield();
+    }
+    message->ref_count = 1;
+    message->length = i;
+    message->endpoint.device = id;
+    oc_network_event(message);
+  }
+  return NULL;
+}
+
+int
+main(void)
+{
+  pthread_t threads[NUM_PRODUCERS];
+  struct timespec start, end;
+  int i;
+
+  oc_process_init();
+  oc_process_start(&oc_network_events, NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < NUM_PRODUCERS; i++) {
+    ASSERT(pthread_create(&threads[i], NULL, producer, (void *)(intptr_t)i) ==
+           0);
+  }
+  while (num_received < NUM_PRODUCERS * MESSAGES_PER_PRODUCER) {
+    oc_process_run();
+  }
+  for (i = 0; i < NUM_PRODUCERS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  for (i = 0; i < NUM_PRODUCERS; i++) {
+    ASSERT(next_sequence[i] == MESSAGES_PER_PRODUCER);
+  }
+
+  double elapsed_s =
+    (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%d producers, %d messages: %.0f messages/s\n", NUM_PRODUCERS,
+         NUM_PRODUCERS * MESSAGES_PER_PRODUCER,
+         NUM_PRODUCERS * MESSAGES_PER_PRODUCER / elapsed_s);
+
+  oc_process_exit(&oc_network_events);
+
+  return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include "oc_api.h"
+#include "port/oc_clock.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef OC_DYNAMIC_ALLOCATION
+#define NUM_DEVICES (32)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define NUM_DEVICES (1)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+
+static int num_callbacks;
+
+static oc_event_callback_retval_t
+delayed_callback(void *data)
+{
+  (void)data;
+  num_callbacks++;
+  return OC_EVENT_DONE;
+}
+
+static int
+count_threads(void)
+{
+  int count = 0;
+  struct dirent *entry;
+  DIR *dir = opendir("/proc/self/task");
+  ASSERT(dir != NULL);
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] != '.') {
+      count++;
+    }
+  }
+  closedir(dir);
+  return count;
+}
+
+int
+main(void)
+{
+  int i, signals;
+  int socks[NUM_DEVICES];
+
+  test_init_stack(NUM_DEVICES, NULL);
+
+  /* All logical devices are served by the reactor threads. */
+  ASSERT(count_threads() == 1 + OC_NETWORK_THREADS);
+
+  /* CON GET /oic/d to every device */
+  uint8_t request[] = { 0x41, 0x01, 0, 0, 0x42, 0xb3, 'o', 'i', 'c', 0x01, 'd' };
+  int received = 0;
+  for (i = 0; i < NUM_DEVICES; i++) {
+    oc_endpoint_t server;
+    test_get_endpoint(i, IPV6, &server);
+    socks[i] = test_connect_udp(&server);
+    request[3] = (uint8_t)i;
+    ASSERT(send(socks[i], request, sizeof(request), 0) ==
+           (ssize_t)sizeof(request));
+  }
+
+  uint8_t buffer[512];
+  oc_clock_time_t deadline = oc_clock_time() + 2 * OC_CLOCK_SECOND;
+  while (received < NUM_DEVICES && oc_clock_time() < deadline) {
+    oc_main_poll();
+    for (i = 0; i < NUM_DEVICES; i++) {
+      while (recv(socks[i], buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+        received++;
+      }
+    }
+  }
+  ASSERT(received == NUM_DEVICES);
+  for (i = 0; i < NUM_DEVICES; i++) {
+    close(socks[i]);
+  }
+
+  /* The reactor's timer signals the event loop once the next event
+     returned by oc_main_poll() is due. */
+  oc_set_delayed_callback(NULL, delayed_callback, 1);
+  oc_clock_time_t next_event = oc_main_poll();
+  ASSERT(next_event != 0);
+  signals = test_signal_count();
+  deadline = oc_clock_time() + 3 * OC_CLOCK_SECOND;
+  while (test_signal_count() == signals && oc_clock_time() < deadline) {
+    usleep(10000);
+  }
+  ASSERT(test_signal_count() != signals);
+  ASSERT(oc_clock_time() >= next_event);
+  oc_main_poll();
+  ASSERT(num_callbacks == 1);
+
+  oc_main_shutdown();
+
+  return 0;
+}
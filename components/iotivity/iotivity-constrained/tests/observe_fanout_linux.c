@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include "messaging/coap/coap.h"
+#include "oc_api.h"
+#include "port/oc_clock.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef OC_DYNAMIC_ALLOCATION
+#define NUM_OBSERVERS (64)
+#define NUM_NOTIFICATIONS (20)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define NUM_OBSERVERS (2)
+#define NUM_NOTIFICATIONS (3)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+
+static oc_resource_t *res;
+static int value;
+
+static void
+get_handler(oc_request_t *request, oc_interface_mask_t interface,
+            void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_rep_start_root_object();
+  oc_rep_set_int(root, value, value);
+  oc_rep_end_root_object();
+  oc_send_response(request, OC_STATUS_OK);
+}
+
+static int
+app_init(void)
+{
+  int ret;
+
+  ret = oc_init_platform("Intel", NULL, NULL);
+  ASSERT(ret == 0);
+
+  ret = oc_add_device("/oic/d", "oic.d.test-observe", "Observe test", "1.0",
+                      "1.0", NULL, NULL);
+  return ret;
+}
+
+static void
+signal_event_loop(void)
+{
+}
+
+static void
+register_resources(void)
+{
+  res = oc_new_resource(NULL, "/a", 1, 0);
+  ASSERT(res != NULL);
+  oc_resource_bind_resource_type(res, "core.a");
+  oc_resource_set_observable(res, true);
+  oc_resource_set_request_handler(res, OC_GET, get_handler, NULL);
+  ASSERT(oc_add_resource(res));
+}
+
+/* Runs the event loop until a message arrived on sock. */
+static void
+receive(int sock, coap_packet_t *packet, uint8_t *buffer, size_t buffer_size)
+{
+  ssize_t len = -1;
+  oc_clock_time_t deadline = oc_clock_time() + 2 * OC_CLOCK_SECOND;
+  while (len <= 0 && oc_clock_time() < deadline) {
+    oc_main_poll();
+    len = recv(sock, buffer, buffer_size, MSG_DONTWAIT);
+  }
+  ASSERT(len > 0);
+  ASSERT(coap_parse_message(packet, buffer, (uint16_t)len) == COAP_NO_ERROR);
+}
+
+int
+main(void)
+{
+  int init, i, n;
+  int socks[NUM_OBSERVERS];
+  const oc_handler_t handler = {
+    .init = app_init,
+    .signal_event_loop = signal_event_loop,
+    .register_resources = register_resources,
+  };
+
+  init = oc_main_init(&handler);
+  ASSERT(init == 0);
+
+  oc_endpoint_t *ep = oc_connectivity_get_endpoints(0);
+  while (ep && (ep->flags & (SECURED | IPV4))) {
+    ep = ep->next;
+  }
+  ASSERT(ep != NULL);
+
+  struct sockaddr_in6 server;
+  memset(&server, 0, sizeof(server));
+  server.sin6_family = AF_INET6;
+  server.sin6_addr = in6addr_loopback;
+  server.sin6_port = htons(ep->addr.ipv6.port);
+
+  uint8_t buffer[512];
+  coap_packet_t packet[1];
+  uint32_t observe;
+
+  /* CON GET /a, Observe: 0, a two byte token per observer */
+  uint8_t request[] = { 0x42, 0x01, 0, 0, 0, 0, 0x60, 0x51, 'a' };
+  for (i = 0; i < NUM_OBSERVERS; i++) {
+    socks[i] = socket(AF_INET6, SOCK_DGRAM, 0);
+    ASSERT(socks[i] >= 0);
+    ASSERT(connect(socks[i], (struct sockaddr *)&server, sizeof(server)) ==
+           0);
+    request[3] = (uint8_t)i;
+    request[4] = 0x7a;
+    request[5] = (uint8_t)i;
+    ASSERT(send(socks[i], request, sizeof(request), 0) ==
+           (ssize_t)sizeof(request));
+    receive(socks[i], packet, buffer, sizeof(buffer));
+#ifdef OC_SECURITY
+    /* Unsecured requests are rejected by the ACL. */
+    ASSERT(packet->code == UNAUTHORIZED_4_01);
+#else  /* OC_SECURITY */
+    ASSERT(packet->code == CONTENT_2_05);
+    ASSERT(coap_get_header_observe(packet, &observe));
+#endif /* !OC_SECURITY */
+  }
+
+#ifndef OC_SECURITY
+  ASSERT(res->num_observers == NUM_OBSERVERS);
+
+  struct timespec start, end;
+  double elapsed_s = 0;
+  uint32_t last_observe[NUM_OBSERVERS] = { 0 };
+  for (n = 0; n < NUM_NOTIFICATIONS; n++) {
+    value = n + 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ASSERT(oc_notify_observers(res) == NUM_OBSERVERS);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed_s +=
+      (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    uint8_t payload0[64];
+    int payload0_len = -1;
+    for (i = 0; i < NUM_OBSERVERS; i++) {
+      receive(socks[i], packet, buffer, sizeof(buffer));
+      /* Every observer gets its own token and a fresh Observe value... */
+      ASSERT(packet->code == CONTENT_2_05);
+      ASSERT(packet->token_len == 2);
+      ASSERT(packet->token[0] == 0x7a && packet->token[1] == (uint8_t)i);
+      ASSERT(coap_get_header_observe(packet, &observe));
+      ASSERT(observe > last_observe[i]);
+      last_observe[i] = observe;
+      ASSERT(IS_OPTION(packet, COAP_OPTION_CONTENT_FORMAT));
+      ASSERT(packet->content_format == APPLICATION_VND_OCF_CBOR);
+      /* ...around the same payload. */
+      const uint8_t *payload;
+      int payload_len = coap_get_payload(packet, &payload);
+      ASSERT(payload_len > 0 && payload_len <= (int)sizeof(payload0));
+      if (payload0_len < 0) {
+        payload0_len = payload_len;
+        memcpy(payload0, payload, payload_len);
+      } else {
+        ASSERT(payload_len == payload0_len);
+        ASSERT(memcmp(payload, payload0, payload_len) == 0);
+      }
+      if (packet->type == COAP_TYPE_CON) {
+        uint8_t ack[] = { 0x60, 0, 0, 0 };
+        ack[2] = (uint8_t)(packet->mid >> 8);
+        ack[3] = (uint8_t)packet->mid;
+        ASSERT(send(socks[i], ack, sizeof(ack), 0) == (ssize_t)sizeof(ack));
+      }
+    }
+    /* Let the ACKs close the CON transactions. */
+    oc_clock_time_t deadline = oc_clock_time() + OC_CLOCK_SECOND / 10;
+    while (oc_clock_time() < deadline) {
+      oc_main_poll();
+    }
+  }
+
+  printf("%d notifications to %d observers: %.1f us per notification\n",
+         NUM_NOTIFICATIONS, NUM_OBSERVERS,
+         elapsed_s * 1e6 / NUM_NOTIFICATIONS);
+#else  /* !OC_SECURITY */
+  (void)n;
+  (void)observe;
+#endif /* OC_SECURITY */
+
+  for (i = 0; i < NUM_OBSERVERS; i++) {
+    close(socks[i]);
+  }
+  oc_main_shutdown();
+
+  return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Drives the observer registry in messaging/coap/observe.c directly with
+ * Observe requests, without going through the network.
+ */
+
+#include "test.h"
+
+#include "messaging/coap/observe.h"
+#include "oc_api.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#ifdef OC_DYNAMIC_ALLOCATION
+#define NUM_RESOURCES (10)
+#define NUM_CLIENTS (200)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define NUM_RESOURCES (2)
+#define NUM_CLIENTS (2)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+
+static oc_resource_t resources[NUM_RESOURCES];
+static char uris[NUM_RESOURCES][8];
+
+static void
+make_client(oc_endpoint_t *endpoint, int client)
+{
+  memset(endpoint, 0, sizeof(*endpoint));
+  endpoint->flags = IPV6;
+  endpoint->addr.ipv6.address[0] = 0xfe;
+  endpoint->addr.ipv6.address[1] = 0x80;
+  endpoint->addr.ipv6.address[14] = (uint8_t)(client >> 8);
+  endpoint->addr.ipv6.address[15] = (uint8_t)client;
+  endpoint->addr.ipv6.port = 5683;
+}
+
+static int
+observe(int resource, int client, uint32_t observe)
+{
+  coap_packet_t request[1], response[1];
+  oc_endpoint_t endpoint;
+  uint8_t token[4] = { (uint8_t)resource, (uint8_t)(client >> 8),
+                       (uint8_t)client, 0x5a };
+
+  make_client(&endpoint, client);
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_token(request, token, sizeof(token));
+  coap_set_header_uri_path(request, uris[resource], strlen(uris[resource]));
+  coap_set_header_observe(request, observe);
+  coap_init_message(response, COAP_TYPE_ACK, CONTENT_2_05, 0);
+#ifdef OC_BLOCK_WISE
+  return coap_observe_handler(request, response, &resources[resource], 1024,
+                              &endpoint);
+#else  /* OC_BLOCK_WISE */
+  return coap_observe_handler(request, response, &resources[resource],
+                              &endpoint);
+#endif /* !OC_BLOCK_WISE */
+}
+
+int
+main(void)
+{
+  int r, c;
+  struct timespec start, end;
+
+  for (r = 0; r < NUM_RESOURCES; r++) {
+    sprintf(uris[r], "r%d", r);
+    oc_new_string(&resources[r].uri, uris[r], strlen(uris[r]));
+  }
+
+  for (c = 0; c < NUM_CLIENTS; c++) {
+    for (r = 0; r < NUM_RESOURCES; r++) {
+      ASSERT(observe(r, c, 0) == 0);
+    }
+  }
+  for (r = 0; r < NUM_RESOURCES; r++) {
+    ASSERT(oc_get_num_observers(&resources[r]) == NUM_CLIENTS);
+  }
+
+  /* Re-registering replaces the existing relationship. */
+  ASSERT(observe(0, 0, 0) == 1);
+  ASSERT(oc_get_num_observers(&resources[0]) == NUM_CLIENTS);
+
+  /* Deregistration by token */
+  ASSERT(observe(1, 1, 1) == 1);
+  ASSERT(oc_get_num_observers(&resources[1]) == NUM_CLIENTS - 1);
+  ASSERT(observe(1, 1, 1) == 0);
+
+  /* Client eviction drops the client's observers of every resource. */
+  oc_endpoint_t endpoint;
+  make_client(&endpoint, 0);
+  ASSERT(coap_remove_observer_by_client(&endpoint) == NUM_RESOURCES);
+  ASSERT(coap_remove_observer_by_client(&endpoint) == 0);
+  for (r = 0; r < NUM_RESOURCES; r++) {
+    ASSERT(oc_get_num_observers(&resources[r]) ==
+           NUM_CLIENTS - 1 - (r == 1 ? 1 : 0));
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (c = 1; c < NUM_CLIENTS; c++) {
+    make_client(&endpoint, c);
+    ASSERT(coap_remove_observer_by_client(&endpoint) ==
+           NUM_RESOURCES - (c == 1 ? 1 : 0));
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  for (r = 0; r < NUM_RESOURCES; r++) {
+    ASSERT(oc_get_num_observers(&resources[r]) == 0);
+    ASSERT(resources[r].observers == NULL);
+  }
+
+  double elapsed_s =
+    (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("evicted %d clients observing %d resources: %.2f us per client\n",
+         NUM_CLIENTS - 1, NUM_RESOURCES, elapsed_s * 1e6 / (NUM_CLIENTS - 1));
+
+  for (r = 0; r < NUM_RESOURCES; r++) {
+    oc_free_string(&resources[r].uri);
+  }
+
+  return 0;
+}
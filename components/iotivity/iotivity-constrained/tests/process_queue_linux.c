@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include "util/oc_process.h"
+
+#include <stdint.h>
+
+#ifdef OC_DYNAMIC_ALLOCATION
+#define BURST_SIZE (4096)
+#endif /* OC_DYNAMIC_ALLOCATION */
+#define NUM_ROUNDS (200)
+
+static oc_process_event_t test_event;
+static uintptr_t next_expected;
+static unsigned long num_received;
+
+OC_PROCESS(consumer, "Event queue consumer");
+OC_PROCESS_THREAD(consumer, ev, data)
+{
+  OC_PROCESS_BEGIN();
+  while (1) {
+    OC_PROCESS_YIELD();
+    if (ev == test_event) {
+      /* Events must be delivered in the order they were posted. */
+      ASSERT((uintptr_t)data == next_expected);
+      next_expected++;
+      num_received++;
+    }
+  }
+  OC_PROCESS_END();
+}
+
+static void
+drain(void)
+{
+  while (oc_process_run())
+    ;
+}
+
+static unsigned long
+post_burst(uintptr_t *seq, unsigned long count)
+{
+  unsigned long i, posted = 0;
+  for (i = 0; i < count; i++) {
+    if (oc_process_post(&consumer, test_event, (void *)*seq) !=
+        OC_PROCESS_ERR_OK) {
+      break;
+    }
+    (*seq)++;
+    posted++;
+  }
+  return posted;
+}
+
+int
+main(void)
+{
+  oc_process_event_stats_t stats;
+  uintptr_t seq = 0;
+  unsigned long burst, capacity;
+  int round;
+
+  oc_process_init();
+  test_event = oc_process_alloc_event();
+  oc_process_start(&consumer, NULL);
+  drain();
+
+  oc_process_get_event_stats(&stats);
+  ASSERT(stats.queued == 0);
+  ASSERT(stats.capacity >= 10);
+  capacity = stats.capacity;
+
+#ifdef OC_DYNAMIC_ALLOCATION
+  /* The queue grows to hold a burst much larger than its initial
+     capacity. */
+  burst = BURST_SIZE;
+  ASSERT(post_burst(&seq, burst) == burst);
+  oc_process_get_event_stats(&stats);
+  ASSERT(stats.queued == burst);
+  ASSERT(stats.peak == burst);
+  ASSERT(stats.capacity >= burst && stats.capacity > capacity);
+  ASSERT(stats.dropped == 0);
+#else  /* OC_DYNAMIC_ALLOCATION */
+  /* A full queue rejects the post and counts the drop. */
+  burst = capacity;
+  ASSERT(post_burst(&seq, burst + 1) == burst);
+  oc_process_get_event_stats(&stats);
+  ASSERT(stats.queued == burst);
+  ASSERT(stats.capacity == capacity);
+  ASSERT(stats.dropped == 1);
+#endif /* !OC_DYNAMIC_ALLOCATION */
+  drain();
+  ASSERT(num_received == burst);
+  oc_process_get_event_stats(&stats);
+  ASSERT(stats.queued == 0);
+  capacity = stats.capacity;
+
+  /* Drained chunks are reused, so refilling the queue does not grow it. */
+  for (round = 0; round < NUM_ROUNDS; round++) {
+    ASSERT(post_burst(&seq, burst) == burst);
+    drain();
+  }
+  ASSERT(num_received == burst * (NUM_ROUNDS + 1));
+  oc_process_get_event_stats(&stats);
+  ASSERT(stats.capacity == capacity);
+
+  /* Interleave posting and delivery so that the queue wraps across chunk
+     boundaries while it is not empty. */
+  for (round = 0; round < 1000; round++) {
+    ASSERT(post_burst(&seq, 3) == 3);
+    oc_process_run();
+    oc_process_run();
+    if (round % 4 == 3) {
+      drain();
+    }
+  }
+  drain();
+  ASSERT(next_expected == seq);
+
+  oc_process_exit(&consumer);
+
+  return 0;
+}
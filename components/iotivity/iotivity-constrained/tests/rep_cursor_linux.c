@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include "oc_collection.h"
+
+#include <unistd.h>
+
+static int num_puts;
+static int value;
+static char name[16];
+static bool flag;
+static int sum;
+
+static void
+read_payload(const oc_rep_cursor_t *root)
+{
+  oc_rep_cursor_t obj, arr;
+
+  ASSERT(oc_rep_cursor_get_int(root, "value", &value));
+  size_t len = sizeof(name);
+  ASSERT(oc_rep_cursor_get_string(root, "name", name, &len));
+  ASSERT(len == strlen(name));
+  ASSERT(oc_rep_cursor_get_object(root, "obj", &obj));
+  ASSERT(oc_rep_cursor_get_bool(&obj, "flag", &flag));
+  ASSERT(oc_rep_cursor_get_array(root, "arr", &arr));
+  for (sum = 0; !oc_rep_cursor_at_end(&arr); oc_rep_cursor_advance(&arr)) {
+    int item;
+    ASSERT(oc_rep_cursor_read_int(&arr, &item));
+    sum += item;
+  }
+  /* Missing keys and type mismatches are reported, not coerced. */
+  int missing;
+  ASSERT(!oc_rep_cursor_get_int(root, "missing", &missing));
+  ASSERT(!oc_rep_cursor_get_int(root, "name", &missing));
+  /* Strings that do not fit the buffer are rejected. */
+  char small[4];
+  len = sizeof(small);
+  ASSERT(!oc_rep_cursor_get_string(root, "name", small, &len));
+}
+
+static void
+put_handler(oc_request_t *request, oc_interface_mask_t interface,
+            void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_rep_cursor_t root;
+
+  num_puts++;
+  ASSERT(request->request_payload == NULL);
+  ASSERT(oc_get_request_cursor(request, &root));
+  read_payload(&root);
+  oc_send_response(request, OC_STATUS_CHANGED);
+}
+
+static void
+register_resources(void)
+{
+  oc_resource_t *res = oc_new_resource(NULL, "/a", 1, 0);
+  ASSERT(res != NULL);
+  oc_resource_bind_resource_type(res, "core.a");
+  oc_resource_set_request_handler(res, OC_PUT, put_handler, NULL);
+  oc_resource_set_lazy_payload(res, true);
+  ASSERT(oc_add_resource(res));
+
+#ifdef OC_COLLECTIONS
+  /* Collections keep parsing payloads into a tree, and asking otherwise
+     leaves their links alone. */
+  oc_resource_t *col = oc_new_collection(NULL, "/c", 1, 0);
+  ASSERT(col != NULL);
+  oc_resource_bind_resource_type(col, "core.c");
+  oc_link_t *link = oc_new_link(res);
+  ASSERT(link != NULL);
+  oc_collection_add_link(col, link);
+  ASSERT(oc_add_collection(col));
+  oc_resource_set_lazy_payload(col, true);
+  ASSERT(!col->lazy_payload);
+  ASSERT(oc_list_head(((oc_collection_t *)col)->links) == link);
+#endif /* OC_COLLECTIONS */
+}
+
+#ifndef OC_SECURITY
+/* Sends a NON PUT /a carrying payload and returns the response code. */
+static uint8_t
+put(int sock, uint16_t mid, const uint8_t *payload, int payload_len)
+{
+  uint8_t request[256] = { 0x51, 0x03, (uint8_t)(mid >> 8), (uint8_t)mid,
+                           0x42, 0xb1, 'a',  0x11, 0x3c, 0xff };
+  int len = 10;
+  memcpy(request + len, payload, payload_len);
+  len += payload_len;
+
+  uint8_t response[256];
+  if (test_exchange(sock, request, len, response, sizeof(response)) < 2) {
+    return 0;
+  }
+  return response[1];
+}
+#endif /* !OC_SECURITY */
+
+static void
+check_payload(const uint8_t *payload, int payload_len)
+{
+  oc_rep_cursor_t root;
+  value = 0;
+  name[0] = '\0';
+  flag = false;
+  sum = 0;
+  ASSERT(oc_rep_cursor_init(&root, payload, payload_len));
+  read_payload(&root);
+  ASSERT(value == 42);
+  ASSERT(strcmp(name, "cursor") == 0);
+  ASSERT(flag);
+  ASSERT(sum == 10);
+}
+
+int
+main(void)
+{
+  test_init_stack(1, register_resources);
+
+  uint8_t payload[128];
+  int items[] = { 1, 2, 3, 4 };
+  oc_rep_new(payload, sizeof(payload));
+  oc_rep_start_root_object();
+  oc_rep_set_int(root, value, 42);
+  oc_rep_set_text_string(root, name, "cursor");
+  oc_rep_set_object(root, obj);
+  oc_rep_set_boolean(obj, flag, true);
+  oc_rep_close_object(root, obj);
+  oc_rep_set_int_array(root, arr, items, 4);
+  oc_rep_end_root_object();
+  int payload_len = oc_rep_finalize();
+  ASSERT(payload_len > 0);
+  check_payload(payload, payload_len);
+
+#ifndef OC_SECURITY
+  /* Secure builds deny unsecured requests to /a, so the payload is only
+     delivered to the handler over plain CoAP. */
+  oc_endpoint_t server;
+  test_get_endpoint(0, IPV6, &server);
+  int sock = test_connect_udp(&server);
+
+  ASSERT(put(sock, 1, payload, payload_len) == 0x44);
+  ASSERT(num_puts == 1);
+  ASSERT(value == 42);
+  ASSERT(strcmp(name, "cursor") == 0);
+  ASSERT(flag);
+  ASSERT(sum == 10);
+
+  /* Malformed payloads are still rejected before reaching the handler. */
+  ASSERT(put(sock, 2, payload, payload_len - 3) == 0x8d);
+  uint8_t bad[] = { 0xa1, 0x61, 'k', 0xff };
+  ASSERT(put(sock, 3, bad, sizeof(bad)) == 0x80);
+  ASSERT(num_puts == 1);
+  close(sock);
+#endif /* !OC_SECURITY */
+
+  oc_main_shutdown();
+
+  return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define NUM_REQUESTS (1000)
+
+/* Average heap calls per request. Parsing no longer touches the heap; what
+   remains is state that outlives the request: the block-wise request and
+   response buffers with their hrefs, segments and expiry callbacks, the
+   duplicate detection entry and its cached response, the transaction and
+   one timed callback. */
+#define MAX_ALLOCS_PER_REQUEST (12)
+
+/* Heap calls are counted through the linker's --wrap option. */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+static unsigned long num_allocs;
+static void *watched;
+static bool watched_freed;
+
+void *
+__wrap_malloc(size_t size)
+{
+  num_allocs++;
+  return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size)
+{
+  num_allocs++;
+  return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+  num_allocs++;
+  return __real_realloc(ptr, size);
+}
+
+void
+__wrap_free(void *ptr)
+{
+  if (ptr && ptr == watched) {
+    watched_freed = true;
+  }
+  __real_free(ptr);
+}
+
+#ifndef OC_SECURITY
+static bool light_state;
+static int light_power;
+static int num_posts;
+static oc_rep_t *kept_rep;
+
+/* Reads the payload the way the server_linux sample's handlers do. */
+static void
+post_light(oc_request_t *request, oc_interface_mask_t interface,
+           void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  /* A tree parsed before the request is not in the arena and must still
+     be freed. */
+  if (kept_rep) {
+    oc_free_rep(kept_rep);
+    kept_rep = NULL;
+  }
+  oc_rep_t *rep = request->request_payload;
+  while (rep != NULL) {
+    switch (rep->type) {
+    case OC_REP_BOOL:
+      light_state = rep->value.boolean;
+      break;
+    case OC_REP_INT:
+      light_power = rep->value.integer;
+      break;
+    case OC_REP_STRING:
+      ASSERT(strcmp(oc_string(rep->value.string), "living room") == 0);
+      break;
+    default:
+      oc_send_response(request, OC_STATUS_BAD_REQUEST);
+      return;
+    }
+    rep = rep->next;
+  }
+  num_posts++;
+  oc_send_response(request, OC_STATUS_CHANGED);
+}
+
+static void
+register_resources(void)
+{
+  oc_resource_t *res = oc_new_resource("lightbulb", "/light/1", 1, 0);
+  ASSERT(res != NULL);
+  oc_resource_bind_resource_type(res, "oic.r.light");
+  oc_resource_bind_resource_interface(res, OC_IF_RW);
+  oc_resource_set_default_interface(res, OC_IF_RW);
+  oc_resource_set_request_handler(res, OC_POST, post_light, NULL);
+  ASSERT(oc_add_resource(res));
+}
+
+#ifdef OC_DYNAMIC_ALLOCATION
+#include "util/oc_arena.h"
+#include "util/oc_memb.h"
+
+OC_MEMB(kept_objects, oc_rep_t, 8);
+
+static void
+test_arena_cap(void)
+{
+  oc_arena_t arena = { 0 };
+  int i;
+
+  /* An arena that settles on a moderate size stops touching the heap... */
+  for (i = 0; i < 4; i++) {
+    ASSERT(oc_arena_alloc(&arena, 400) && oc_arena_alloc(&arena, 400));
+    oc_arena_reset(&arena);
+  }
+  unsigned long start = num_allocs;
+  ASSERT(oc_arena_alloc(&arena, 400) && oc_arena_alloc(&arena, 400));
+  oc_arena_reset(&arena);
+  ASSERT(num_allocs == start);
+
+  /* ...but does not hold on to the memory of one large burst. */
+  ASSERT(oc_arena_alloc(&arena, 16384));
+  ASSERT(oc_arena_alloc(&arena, 16384));
+  oc_arena_reset(&arena);
+  start = num_allocs;
+  ASSERT(oc_arena_alloc(&arena, 16384));
+  ASSERT(num_allocs == start + 1);
+  oc_arena_release(&arena);
+}
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+int
+main(void)
+{
+  oc_endpoint_t server;
+
+#ifdef OC_DYNAMIC_ALLOCATION
+  test_arena_cap();
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+  test_init_stack(1, register_resources);
+  test_get_endpoint(0, IPV6, &server);
+  int sock = test_connect_udp(&server);
+
+  uint8_t payload[64];
+  oc_rep_new(payload, sizeof(payload));
+  oc_rep_start_root_object();
+  oc_rep_set_boolean(root, state, true);
+  oc_rep_set_int(root, power, 75);
+  oc_rep_set_text_string(root, name, "living room");
+  oc_rep_end_root_object();
+  int payload_len = oc_rep_finalize();
+  ASSERT(payload_len > 0);
+#ifdef OC_DYNAMIC_ALLOCATION
+  oc_rep_set_pool(&kept_objects);
+  ASSERT(oc_parse_rep(payload, payload_len, &kept_rep) == 0 && kept_rep);
+  watched = kept_rep;
+#endif /* OC_DYNAMIC_ALLOCATION */
+
+  /* NON POST /light/1, Content-Format: application/cbor */
+  uint8_t request[128] = { 0x51, 0x02, 0,   0,   0x42, 0xb5, 'l', 'i', 'g',
+                           'h',  't',  0x01, '1', 0x11, 0x3c, 0xff };
+  int len = 16;
+  memcpy(request + len, payload, payload_len);
+  len += payload_len;
+
+  uint8_t response[256];
+  int i;
+  unsigned long start = num_allocs;
+  for (i = 0; i < NUM_REQUESTS; i++) {
+    request[2] = (uint8_t)(i >> 8);
+    request[3] = (uint8_t)i;
+    ASSERT(test_exchange(sock, request, len, response, sizeof(response)) > 0);
+    ASSERT(response[1] == 0x44);
+  }
+  ASSERT(num_posts == NUM_REQUESTS);
+#ifdef OC_DYNAMIC_ALLOCATION
+  ASSERT(!kept_rep && watched_freed);
+#endif /* OC_DYNAMIC_ALLOCATION */
+  ASSERT(light_state && light_power == 75);
+  ASSERT((num_allocs - start) / NUM_REQUESTS <= MAX_ALLOCS_PER_REQUEST);
+
+  close(sock);
+  oc_main_shutdown();
+
+  return 0;
+}
+#else /* !OC_SECURITY */
+int
+main(void)
+{
+  /* Unsecured requests to /light/1 are denied by the default ACL. */
+  printf("Request arena test requires a build without OC_SECURITY\n");
+  return 0;
+}
+#endif /* OC_SECURITY */
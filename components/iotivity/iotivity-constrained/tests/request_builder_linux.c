@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* The client and the server of server_linux's /a/light share this process,
+ * and requests travel between them over the loopback interface.
+ */
+
+#include "test.h"
+
+#define NUM_REQUESTS (10000)
+#ifdef OC_DYNAMIC_ALLOCATION
+#define WINDOW (32)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define WINDOW (2)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+
+static bool light_state = false;
+static int light_power;
+static oc_endpoint_t server;
+static int num_sent, num_received, num_ok;
+static int max_in_flight;
+
+static void
+get_light(oc_request_t *request, oc_interface_mask_t interface,
+          void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_rep_start_root_object();
+  oc_rep_set_boolean(root, state, light_state);
+  oc_rep_set_int(root, power, light_power);
+  oc_rep_end_root_object();
+  oc_send_response(request, OC_STATUS_OK);
+}
+
+static void
+post_light(oc_request_t *request, oc_interface_mask_t interface,
+           void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_rep_t *rep = request->request_payload;
+  while (rep != NULL) {
+    if (rep->type == OC_REP_BOOL) {
+      light_state = rep->value.boolean;
+    } else if (rep->type == OC_REP_INT) {
+      light_power += rep->value.integer;
+    }
+    rep = rep->next;
+  }
+  oc_send_response(request, OC_STATUS_CHANGED);
+}
+
+static void
+register_resources(void)
+{
+  oc_resource_t *res = oc_new_resource(NULL, "/a/light", 1, 0);
+  ASSERT(res != NULL);
+  oc_resource_bind_resource_type(res, "core.light");
+  oc_resource_bind_resource_interface(res, OC_IF_RW);
+  oc_resource_set_default_interface(res, OC_IF_RW);
+  oc_resource_set_request_handler(res, OC_GET, get_light, NULL);
+  oc_resource_set_request_handler(res, OC_POST, post_light, NULL);
+  ASSERT(oc_add_resource(res));
+}
+
+static void
+count_response(oc_client_response_t *data)
+{
+  num_received++;
+  if (data->code == OC_STATUS_OK || data->code == OC_STATUS_CHANGED) {
+    num_ok++;
+  }
+}
+
+static void pipelined_response(oc_client_response_t *data);
+
+static bool
+send_get(void)
+{
+  oc_request_builder_t builder;
+  if (!oc_request_builder_init(&builder, OC_GET, "/a/light", &server, NULL,
+                               pipelined_response, LOW_QOS, NULL)) {
+    return false;
+  }
+  num_sent++;
+  if (num_sent - num_received > max_in_flight) {
+    max_in_flight = num_sent - num_received;
+  }
+  return oc_request_builder_dispatch(&builder);
+}
+
+static void
+pipelined_response(oc_client_response_t *data)
+{
+  count_response(data);
+  if (num_sent < NUM_REQUESTS) {
+    ASSERT(send_get());
+  }
+}
+
+static void
+run_until(int count)
+{
+  POLL_UNTIL(num_received >= count, 30);
+  ASSERT(num_received == count);
+}
+
+int
+main(void)
+{
+  int i;
+
+  test_init_stack(1, register_resources);
+  test_get_endpoint(0, IPV6, &server);
+
+  /* Two POSTs are prepared side by side, each given its payload, and then
+     dispatched in the opposite order. */
+  oc_request_builder_t on, power;
+  ASSERT(oc_request_builder_init(&on, OC_POST, "/a/light", &server, NULL,
+                                 count_response, LOW_QOS, NULL));
+  ASSERT(oc_request_builder_init(&power, OC_POST, "/a/light", &server, NULL,
+                                 count_response, LOW_QOS, NULL));
+  ASSERT(oc_request_builder_begin_payload(&power));
+  oc_rep_start_root_object();
+  oc_rep_set_int(root, power, 40);
+  oc_rep_end_root_object();
+  ASSERT(oc_request_builder_end_payload(&power));
+  ASSERT(oc_request_builder_begin_payload(&on));
+  oc_rep_start_root_object();
+  oc_rep_set_boolean(root, state, true);
+  oc_rep_end_root_object();
+  ASSERT(oc_request_builder_end_payload(&on));
+  ASSERT(oc_request_builder_dispatch(&power));
+  ASSERT(oc_request_builder_dispatch(&on));
+  run_until(2);
+#ifndef OC_SECURITY
+  ASSERT(num_ok == 2);
+  ASSERT(light_state == true);
+  ASSERT(light_power == 40);
+#endif /* !OC_SECURITY */
+
+  /* A discarded builder releases its resources without sending. */
+  oc_request_builder_t discarded;
+  for (i = 0; i < 2 * WINDOW; i++) {
+    ASSERT(oc_request_builder_init(&discarded, OC_POST, "/a/light", &server,
+                                   NULL, count_response, LOW_QOS, NULL));
+    oc_request_builder_discard(&discarded);
+  }
+
+  /* Keep WINDOW GETs in flight until NUM_REQUESTS were answered. */
+  num_sent = num_received = num_ok = 0;
+  for (i = 0; i < WINDOW; i++) {
+    ASSERT(send_get());
+  }
+  run_until(NUM_REQUESTS);
+  ASSERT(num_sent == NUM_REQUESTS);
+  ASSERT(max_in_flight == WINDOW);
+#ifndef OC_SECURITY
+  ASSERT(num_ok == NUM_REQUESTS);
+#endif /* !OC_SECURITY */
+
+  oc_main_shutdown();
+
+  return 0;
+}
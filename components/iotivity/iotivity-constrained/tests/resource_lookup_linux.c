@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include "oc_api.h"
+#include "port/oc_clock.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#ifdef OC_DYNAMIC_ALLOCATION
+#define NUM_DEVICES (4)
+#define NUM_RESOURCES_PER_DEVICE (250)
+#define NUM_LOOKUPS (200000)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define NUM_DEVICES (1)
+#define NUM_RESOURCES_PER_DEVICE (OC_MAX_APP_RESOURCES)
+#define NUM_LOOKUPS (10000)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+
+static void
+get_handler(oc_request_t *request, oc_interface_mask_t interface,
+            void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_send_response(request, OC_STATUS_OK);
+}
+
+static int
+app_init(void)
+{
+  int ret, i;
+
+  ret = oc_init_platform("Intel", NULL, NULL);
+  ASSERT(ret == 0);
+
+  for (i = 0; i < NUM_DEVICES; i++) {
+    ret = oc_add_device("/oic/d", "oic.d.test-lookup", "Lookup test", "1.0",
+                        "1.0", NULL, NULL);
+    ASSERT(ret == 0);
+  }
+  return ret;
+}
+
+static void
+signal_event_loop(void)
+{
+}
+
+static void
+register_resources(void)
+{
+  char uri[32];
+  int device, i;
+
+  for (device = 0; device < NUM_DEVICES; device++) {
+    for (i = 0; i < NUM_RESOURCES_PER_DEVICE; i++) {
+      snprintf(uri, sizeof(uri), "/a/light/%d", i);
+      oc_resource_t *res = oc_new_resource(NULL, uri, 1, device);
+      ASSERT(res != NULL);
+      oc_resource_bind_resource_type(res, "core.light");
+      oc_resource_set_request_handler(res, OC_GET, get_handler, NULL);
+      ASSERT(oc_add_resource(res));
+    }
+  }
+}
+
+/* The dispatch lookup as it was before the uri index was introduced. */
+static oc_resource_t *
+list_scan(const char *uri, int uri_len, int device)
+{
+  oc_resource_t *res = oc_ri_get_app_resources();
+  while (res != NULL) {
+    if ((int)oc_string_len(res->uri) == (uri_len + 1) &&
+        strncmp(uri, oc_string(res->uri) + 1, uri_len) == 0 &&
+        res->device == device)
+      return res;
+    res = res->next;
+  }
+  return NULL;
+}
+
+static double
+elapsed_us(struct timespec *start, struct timespec *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1e6 +
+         (end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+int
+main(void)
+{
+  int init, i;
+  char uris[NUM_RESOURCES_PER_DEVICE][32];
+  struct timespec start, end;
+  const oc_handler_t handler = {
+    .init = app_init,
+    .signal_event_loop = signal_event_loop,
+    .register_resources = register_resources,
+  };
+
+  init = oc_main_init(&handler);
+  ASSERT(init == 0);
+
+  for (i = 0; i < NUM_RESOURCES_PER_DEVICE; i++) {
+    snprintf(uris[i], sizeof(uris[i]), "a/light/%d", i);
+  }
+
+  /* The index and the list scan must agree on every (device, uri). */
+  for (i = 0; i < NUM_DEVICES * NUM_RESOURCES_PER_DEVICE; i++) {
+    const char *uri = uris[i % NUM_RESOURCES_PER_DEVICE];
+    int device = i / NUM_RESOURCES_PER_DEVICE;
+    oc_resource_t *res =
+      oc_ri_get_app_resource_by_uri(uri, strlen(uri), device);
+    ASSERT(res != NULL);
+    ASSERT(res == list_scan(uri, strlen(uri), device));
+    ASSERT(res == oc_ri_get_app_resource_by_uri(oc_string(res->uri),
+                                                oc_string_len(res->uri),
+                                                device));
+  }
+  ASSERT(oc_ri_get_app_resource_by_uri("a/light", 7, 0) == NULL);
+  ASSERT(oc_ri_get_app_resource_by_uri("a/light/0", 9, NUM_DEVICES) == NULL);
+
+  volatile oc_resource_t *sink = NULL;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < NUM_LOOKUPS; i++) {
+    const char *uri = uris[i % NUM_RESOURCES_PER_DEVICE];
+    sink = list_scan(uri, strlen(uri), i % NUM_DEVICES);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double scan_us = elapsed_us(&start, &end);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < NUM_LOOKUPS; i++) {
+    const char *uri = uris[i % NUM_RESOURCES_PER_DEVICE];
+    sink = oc_ri_get_app_resource_by_uri(uri, strlen(uri), i % NUM_DEVICES);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double index_us = elapsed_us(&start, &end);
+  (void)sink;
+
+  printf("%d resources, %d lookups: list scan %.1f ns/lookup, "
+         "uri index %.1f ns/lookup\n",
+         NUM_DEVICES * NUM_RESOURCES_PER_DEVICE, NUM_LOOKUPS,
+         scan_us * 1e3 / NUM_LOOKUPS, index_us * 1e3 / NUM_LOOKUPS);
+
+  /* Deleted resources must drop out of the index. */
+  oc_resource_t *res = oc_ri_get_app_resource_by_uri(uris[0], 9, 0);
+  ASSERT(res != NULL);
+  oc_delete_resource(res);
+  ASSERT(oc_ri_get_app_resource_by_uri(uris[0], 9, 0) == NULL);
+
+  oc_main_shutdown();
+
+  return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include "messaging/coap/coap.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef OC_SECURITY
+#define LARGE_VALUE_SIZE (1500)
+
+static int num_small_requests;
+static int num_large_requests;
+static char large_value[LARGE_VALUE_SIZE + 1];
+
+static void
+get_small(oc_request_t *request, oc_interface_mask_t interface,
+          void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  num_small_requests++;
+  oc_rep_start_root_object();
+  oc_rep_set_int(root, count, num_small_requests);
+  oc_rep_end_root_object();
+  oc_send_response(request, OC_STATUS_OK);
+}
+
+static void
+get_large(oc_request_t *request, oc_interface_mask_t interface,
+          void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  num_large_requests++;
+  oc_rep_start_root_object();
+  oc_rep_set_text_string(root, value, large_value);
+  oc_rep_end_root_object();
+  oc_send_response(request, OC_STATUS_OK);
+}
+
+static void
+register_resources(void)
+{
+  oc_resource_t *res = oc_new_resource(NULL, "/s", 1, 0);
+  ASSERT(res != NULL);
+  oc_resource_bind_resource_type(res, "core.s");
+  oc_resource_set_request_handler(res, OC_GET, get_small, NULL);
+  ASSERT(oc_add_resource(res));
+
+  res = oc_new_resource(NULL, "/l", 1, 0);
+  ASSERT(res != NULL);
+  oc_resource_bind_resource_type(res, "core.l");
+  oc_resource_set_request_handler(res, OC_GET, get_large, NULL);
+  ASSERT(oc_add_resource(res));
+}
+
+/* Sends a CON GET for the one letter path, asking for block num of
+   2^(szx + 4) bytes if szx is not negative, and parses the response. */
+static void
+get(int sock, char path, uint16_t mid, int num, int szx, uint8_t *buffer,
+    size_t buffer_size, coap_packet_t *response)
+{
+  uint8_t request[] = { 0x41, 0x01, 0, 0, 0x42, 0xb1, 0, 0xc1, 0 };
+  size_t len = sizeof(request);
+  request[2] = (uint8_t)(mid >> 8);
+  request[3] = (uint8_t)mid;
+  request[6] = (uint8_t)path;
+  if (szx < 0) {
+    len -= 2;
+  } else {
+    /* Block2: delta 12 from Uri-Path, length 1 */
+    request[8] = (uint8_t)(num << 4 | szx);
+  }
+
+  ssize_t reply_len = test_exchange(sock, request, len, buffer, buffer_size);
+  ASSERT(reply_len > 0);
+  ASSERT(coap_parse_message(response, buffer, (uint16_t)reply_len) ==
+         COAP_NO_ERROR);
+  ASSERT(response->type == COAP_TYPE_ACK);
+  ASSERT(response->mid == mid);
+}
+
+int
+main(void)
+{
+  oc_endpoint_t server;
+
+  memset(large_value, 'x', LARGE_VALUE_SIZE);
+
+  test_init_stack(1, register_resources);
+  test_get_endpoint(0, IPV6, &server);
+  int sock = test_connect_udp(&server);
+
+  uint8_t buffer[2048];
+  coap_packet_t response[1];
+  const uint8_t *payload;
+  uint32_t num, offset;
+  uint8_t more;
+  uint16_t size;
+
+  /* A response that fits in one block is sent without block options. */
+  get(sock, 's', 1, 0, -1, buffer, sizeof(buffer), response);
+  ASSERT(response->code == CONTENT_2_05);
+  ASSERT(num_small_requests == 1);
+  ASSERT(!coap_get_header_block2(response, &num, &more, &size, &offset));
+  int payload_len = coap_get_payload(response, &payload);
+  ASSERT(payload_len > 0);
+  /* {"count": 1} */
+  ASSERT(payload[0] == 0xbf || payload[0] == 0xa1);
+
+  /* A larger response falls back to a block-wise transfer. */
+  get(sock, 'l', 2, 0, -1, buffer, sizeof(buffer), response);
+  ASSERT(response->code == CONTENT_2_05);
+  ASSERT(num_large_requests == 1);
+  ASSERT(coap_get_header_block2(response, &num, &more, &size, &offset));
+  ASSERT(num == 0 && more == 1);
+  uint32_t size2 = 0;
+  ASSERT(coap_get_header_size2(response, &size2));
+  ASSERT(size2 > LARGE_VALUE_SIZE);
+  payload_len = coap_get_payload(response, &payload);
+  ASSERT(payload_len == size);
+
+  /* The following blocks are served from the payload encoded for the
+     first one, without calling the handler again. */
+  int szx = 0;
+  while ((16 << szx) < size) {
+    szx++;
+  }
+  uint32_t received = (uint32_t)payload_len;
+  /* The body the handler encodes */
+  static uint8_t expected[LARGE_VALUE_SIZE + 64], body[LARGE_VALUE_SIZE + 64];
+  oc_rep_new(expected, sizeof(expected));
+  oc_rep_start_root_object();
+  oc_rep_set_text_string(root, value, large_value);
+  oc_rep_end_root_object();
+  int expected_len = oc_rep_finalize();
+  ASSERT(expected_len > 0 && (uint32_t)expected_len == size2);
+  memcpy(body, payload, payload_len);
+  uint16_t mid = 3;
+  while (more) {
+    get(sock, 'l', mid++, (int)(received / size), szx, buffer, sizeof(buffer),
+        response);
+    ASSERT(response->code == CONTENT_2_05);
+    ASSERT(coap_get_header_block2(response, &num, &more, &size, &offset));
+    ASSERT(offset == received);
+    payload_len = coap_get_payload(response, &payload);
+    ASSERT(payload_len > 0);
+    ASSERT(received + payload_len <= sizeof(body));
+    memcpy(body + received, payload, payload_len);
+    received += payload_len;
+  }
+  ASSERT(received == size2);
+  ASSERT(memcmp(body, expected, expected_len) == 0);
+  ASSERT(num_large_requests == 1);
+
+  /* The in-place encoding keeps working after the fallback. */
+  get(sock, 's', mid, 0, -1, buffer, sizeof(buffer), response);
+  ASSERT(response->code == CONTENT_2_05);
+  ASSERT(num_small_requests == 2);
+  ASSERT(!coap_get_header_block2(response, &num, &more, &size, &offset));
+
+  close(sock);
+  oc_main_shutdown();
+
+  printf("small responses: %d handler calls, large response: %d handler "
+         "calls\n",
+         num_small_requests, num_large_requests);
+
+  return 0;
+}
+#else /* !OC_SECURITY */
+int
+main(void)
+{
+  /* Unsecured requests to /s and /l are denied by the default ACL. */
+  printf("Response encoding test requires a build without OC_SECURITY\n");
+  return 0;
+}
+#endif /* OC_SECURITY */
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include <stdio.h>
+
+#ifdef OC_SECURITY
+#include "port/oc_storage.h"
+#include "security/oc_acl.h"
+#include "security/oc_cred.h"
+#include "security/oc_doxm.h"
+#include "security/oc_pstat.h"
+#include "security/oc_store.h"
+
+#include <unistd.h>
+
+static const char *stores[] = { "doxm_0", "pstat_0", "cred_0", "acl_0",
+                                "u_ids_0" };
+#define NUM_STORES (sizeof(stores) / sizeof(stores[0]))
+
+static void
+persist(void (*dump)(int), bool write_through)
+{
+  dump(0);
+  if (write_through) {
+    oc_sec_store_flush();
+  }
+}
+
+/* The SVR updates made while an onboarding tool takes ownership of the
+   device and provisions it, one persisted update per request. */
+static void
+onboard(bool write_through)
+{
+  oc_sec_doxm_t *doxm = oc_sec_get_doxm(0);
+  oc_sec_pstat_t *pstat = oc_sec_get_pstat(0);
+
+  doxm->oxmsel = 0;
+  persist(oc_sec_dump_doxm, write_through);
+  pstat->om = 4;
+  persist(oc_sec_dump_pstat, write_through);
+  memset(doxm->devowneruuid.id, 0x11, 16);
+  persist(oc_sec_dump_doxm, write_through);
+  memset(doxm->rowneruuid.id, 0x11, 16);
+  persist(oc_sec_dump_doxm, write_through);
+  oc_sec_get_creds(0)->rowneruuid = doxm->rowneruuid;
+  persist(oc_sec_dump_cred, write_through);
+  doxm->owned = true;
+  persist(oc_sec_dump_doxm, write_through);
+  pstat->rowneruuid = doxm->rowneruuid;
+  persist(oc_sec_dump_pstat, write_through);
+  oc_sec_get_acl(0)->rowneruuid = doxm->rowneruuid;
+  persist(oc_sec_dump_acl, write_through);
+  pstat->s = OC_DOS_RFPRO;
+  persist(oc_sec_dump_pstat, write_through);
+  oc_sec_set_post_otm_acl(0);
+  persist(oc_sec_dump_acl, write_through);
+  persist(oc_sec_dump_unique_ids, write_through);
+  pstat->s = OC_DOS_RFNOP;
+  pstat->isop = true;
+  persist(oc_sec_dump_pstat, write_through);
+}
+
+/* Onboards the device from a factory reset into the store at dir and
+   returns the number of physical writes it took. */
+static uint32_t
+run_onboarding(const char *dir, bool write_through)
+{
+  oc_sec_store_stats_t before, after;
+
+  oc_sec_store_close();
+  ASSERT(oc_storage_config(dir) == 0);
+  oc_sec_pstat_default(0);
+  test_run_for(2 * OC_CLOCK_SECOND);
+  oc_sec_store_flush();
+
+  oc_sec_store_get_stats(&before);
+  onboard(write_through);
+  /* Long enough for the store's flush timer to fire */
+  test_run_for(2 * OC_CLOCK_SECOND);
+  oc_sec_store_get_stats(&after);
+  return after.physical_writes - before.physical_writes;
+}
+
+static void
+remove_dir(const char *dir)
+{
+  char path[128];
+  size_t i;
+  for (i = 0; i < NUM_STORES; i++) {
+    snprintf(path, sizeof(path), "%s/%s", dir, stores[i]);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/%s_j", dir, stores[i]);
+    unlink(path);
+  }
+  rmdir(dir);
+}
+
+int
+main(void)
+{
+  char write_through_dir[] = "/tmp/storage_wt_XXXXXX";
+  char coalesced_dir[] = "/tmp/storage_wb_XXXXXX";
+
+  ASSERT(mkdtemp(write_through_dir) != NULL);
+  ASSERT(mkdtemp(coalesced_dir) != NULL);
+  ASSERT(oc_storage_config(coalesced_dir) == 0);
+  test_init_stack(1, NULL);
+
+  uint32_t write_through = run_onboarding(write_through_dir, true);
+  uint32_t coalesced = run_onboarding(coalesced_dir, false);
+  ASSERT(coalesced > 0);
+  ASSERT(coalesced < write_through);
+
+  /* The final state reached storage. */
+  oc_sec_doxm_t doxm = *oc_sec_get_doxm(0);
+  oc_sec_pstat_t pstat = *oc_sec_get_pstat(0);
+  oc_sec_doxm_default(0);
+  oc_sec_load_doxm(0);
+  oc_sec_load_pstat(0);
+  ASSERT(oc_sec_get_doxm(0)->owned == doxm.owned);
+  ASSERT(memcmp(oc_sec_get_doxm(0)->rowneruuid.id, doxm.rowneruuid.id, 16) ==
+         0);
+  ASSERT(oc_sec_get_pstat(0)->s == pstat.s);
+  ASSERT(oc_sec_get_pstat(0)->isop == pstat.isop);
+
+  /* Pending writes reach storage on shutdown. */
+  oc_sec_store_stats_t before, after;
+  oc_sec_get_doxm(0)->oxmsel = 1;
+  oc_sec_get_doxm(0)->sct = 2;
+  oc_sec_store_get_stats(&before);
+  oc_sec_dump_doxm(0);
+  oc_sec_store_get_stats(&after);
+  ASSERT(after.physical_writes == before.physical_writes);
+  oc_main_shutdown();
+  oc_sec_store_get_stats(&after);
+  ASSERT(after.physical_writes > before.physical_writes);
+  oc_sec_load_doxm(0);
+  ASSERT(oc_sec_get_doxm(0)->sct == 2);
+
+  remove_dir(write_through_dir);
+  remove_dir(coalesced_dir);
+
+  return 0;
+}
+#else /* OC_SECURITY */
+int
+main(void)
+{
+  printf("Storage coalescing test requires OC_SECURITY\n");
+  return 0;
+}
+#endif /* !OC_SECURITY */
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include <stdio.h>
+
+#ifdef OC_SECURITY
+#include "port/oc_storage.h"
+#include "security/oc_store.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define NUM_ENTRIES (60)
+#define ENTRY_SIZE (24)
+#define IMAGE_SIZE (8 + NUM_ENTRIES * ENTRY_SIZE + 8)
+
+static char dir[] = "/tmp/svr_journal_XXXXXX";
+
+static long
+file_size(const char *store)
+{
+  char path[128];
+  struct stat st;
+  snprintf(path, sizeof(path), "%s/%s", dir, store);
+  if (stat(path, &st) != 0) {
+    return 0;
+  }
+  return st.st_size;
+}
+
+/* Mimics an SVR encoding: a fixed head, one record per entry and a tail that
+   follows the (indefinite-length) array of entries. */
+static size_t
+make_image(uint8_t *image, int num_entries, uint8_t tail)
+{
+  size_t len = 0;
+  int i;
+  memcpy(image, "SVRHEAD:", 8);
+  len += 8;
+  for (i = 0; i < num_entries; i++) {
+    memset(image + len, 'a' + (i % 26), ENTRY_SIZE);
+    len += ENTRY_SIZE;
+  }
+  memset(image + len, tail, 8);
+  return len + 8;
+}
+
+/* Writes are otherwise held back until the store's flush timer fires. */
+static long
+write_store(const char *store, uint8_t *buf, size_t size)
+{
+  long ret = oc_sec_store_write(store, buf, size);
+  oc_sec_store_flush();
+  return ret;
+}
+
+static void
+copy_file(const char *from, const char *to)
+{
+  uint8_t buf[IMAGE_SIZE * 2];
+  char path[128];
+  snprintf(path, sizeof(path), "%s/%s", dir, from);
+  FILE *fp = fopen(path, "rb");
+  ASSERT(fp != NULL);
+  size_t len = fread(buf, 1, sizeof(buf), fp);
+  fclose(fp);
+  snprintf(path, sizeof(path), "%s/%s", dir, to);
+  fp = fopen(path, "wb");
+  ASSERT(fp != NULL);
+  ASSERT(fwrite(buf, 1, len, fp) == len);
+  fclose(fp);
+}
+
+int
+main(void)
+{
+  uint8_t image[IMAGE_SIZE], readback[IMAGE_SIZE * 2];
+  long written = 0, rewrite_all = 0;
+  size_t len = 0;
+  int i;
+
+  ASSERT(mkdtemp(dir) != NULL);
+  ASSERT(oc_storage_config(dir) == 0);
+
+  /* Bulk provisioning: entries are added one at a time. */
+  for (i = 1; i <= NUM_ENTRIES; i++) {
+    long journal = file_size("acl_0_j");
+    len = make_image(image, i, 'z');
+    ASSERT(write_store("acl_0", image, len) == (long)len);
+    if (file_size("acl_0_j") > journal) {
+      written += file_size("acl_0_j") - journal;
+    } else {
+      written += file_size("acl_0");
+    }
+    rewrite_all += len;
+    ASSERT(oc_sec_store_read("acl_0", readback, sizeof(readback)) ==
+           (long)len);
+    ASSERT(memcmp(readback, image, len) == 0);
+  }
+  /* Appending to the journal writes a fraction of what rewriting the
+     store would. */
+  ASSERT(written * 3 < rewrite_all);
+
+  /* A torn final record is dropped, leaving the previous contents. */
+  if (file_size("acl_0_j") == 0) {
+    len = make_image(image, NUM_ENTRIES, 'y');
+    ASSERT(write_store("acl_0", image, len) == (long)len);
+  }
+  long journal = file_size("acl_0_j");
+  ASSERT(journal > 0);
+  uint8_t previous[IMAGE_SIZE];
+  size_t previous_len = make_image(previous, NUM_ENTRIES, 'x');
+  ASSERT(write_store("acl_0", previous, previous_len) ==
+         (long)previous_len);
+  ASSERT(file_size("acl_0_j") > journal);
+  char path[128];
+  snprintf(path, sizeof(path), "%s/acl_0_j", dir);
+  ASSERT(truncate(path, file_size("acl_0_j") - 3) == 0);
+  ASSERT(oc_sec_store_read("acl_0", readback, sizeof(readback)) ==
+         (long)len);
+  ASSERT(memcmp(readback, image, len) == 0);
+
+  /* The next write compacts the store and discards the damaged journal. */
+  ASSERT(write_store("acl_0", previous, previous_len) ==
+         (long)previous_len);
+  ASSERT(file_size("acl_0_j") == 0);
+  ASSERT(file_size("acl_0") == (long)previous_len);
+
+  /* A journal that survived an interrupted compaction is ignored. */
+  len = make_image(image, NUM_ENTRIES, 'w');
+  ASSERT(write_store("acl_0", image, len) == (long)len);
+  ASSERT(file_size("acl_0_j") > 0);
+  copy_file("acl_0_j", "stale_j");
+  len = make_image(image, NUM_ENTRIES, 'v');
+  image[0] = 'T';
+  ASSERT(write_store("acl_0", image, len) == (long)len);
+  ASSERT(file_size("acl_0_j") == 0);
+  copy_file("stale_j", "acl_0_j");
+  ASSERT(oc_sec_store_read("acl_0", readback, sizeof(readback)) ==
+         (long)len);
+  ASSERT(memcmp(readback, image, len) == 0);
+
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/stale_j", dir);
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/acl_0", dir);
+  unlink(path);
+  rmdir(dir);
+
+  return 0;
+}
+#else /* OC_SECURITY */
+int
+main(void)
+{
+  printf("SVR journal test requires OC_SECURITY\n");
+  return 0;
+}
+#endif /* !OC_SECURITY */
@@ -0,0 +1,490 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* A client and a server share this process and exchange CoAP over TCP
+ * through the loopback interface. A raw socket plays a peer that sends
+ * signaling messages and splits or coalesces requests in the stream, and
+ * others a peer that is slow to accept connections and one that stops
+ * reading.
+ */
+
+#include "test.h"
+
+#include <stdio.h>
+
+#ifdef OC_TCP
+#include "messaging/coap/coap.h"
+#include "oc_api.h"
+#include "port/oc_clock.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_REQUESTS (2000)
+#ifdef OC_DYNAMIC_ALLOCATION
+#define WINDOW (32)
+#define BLOB_SIZE (3000)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define WINDOW (2)
+#define BLOB_SIZE (1200)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#ifdef OC_BLOCK_WISE
+static char blob[BLOB_SIZE + 1];
+#endif /* OC_BLOCK_WISE */
+
+static bool light_state = false;
+static int light_power;
+static oc_endpoint_t server;
+static int num_sent, num_received, num_ok;
+
+static void
+get_light(oc_request_t *request, oc_interface_mask_t interface,
+          void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_rep_start_root_object();
+  oc_rep_set_boolean(root, state, light_state);
+  oc_rep_set_int(root, power, light_power);
+  oc_rep_end_root_object();
+  oc_send_response(request, OC_STATUS_OK);
+}
+
+static void
+post_light(oc_request_t *request, oc_interface_mask_t interface,
+           void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_rep_t *rep = request->request_payload;
+  while (rep != NULL) {
+    if (rep->type == OC_REP_BOOL) {
+      light_state = rep->value.boolean;
+    } else if (rep->type == OC_REP_INT) {
+      light_power += rep->value.integer;
+    }
+    rep = rep->next;
+  }
+  oc_send_response(request, OC_STATUS_CHANGED);
+}
+
+#ifdef OC_BLOCK_WISE
+static void
+get_blob(oc_request_t *request, oc_interface_mask_t interface,
+         void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_rep_start_root_object();
+  oc_rep_set_text_string(root, data, blob);
+  oc_rep_end_root_object();
+  oc_send_response(request, OC_STATUS_OK);
+}
+#endif /* OC_BLOCK_WISE */
+
+static void
+register_resources(void)
+{
+  oc_resource_t *res = oc_new_resource(NULL, "/a/light", 1, 0);
+  ASSERT(res != NULL);
+  oc_resource_bind_resource_type(res, "core.light");
+  oc_resource_bind_resource_interface(res, OC_IF_RW);
+  oc_resource_set_default_interface(res, OC_IF_RW);
+  oc_resource_set_request_handler(res, OC_GET, get_light, NULL);
+  oc_resource_set_request_handler(res, OC_POST, post_light, NULL);
+  ASSERT(oc_add_resource(res));
+#ifdef OC_BLOCK_WISE
+  res = oc_new_resource(NULL, "/a/blob", 1, 0);
+  ASSERT(res != NULL);
+  oc_resource_bind_resource_type(res, "core.blob");
+  oc_resource_bind_resource_interface(res, OC_IF_R);
+  oc_resource_set_default_interface(res, OC_IF_R);
+  oc_resource_set_request_handler(res, OC_GET, get_blob, NULL);
+  ASSERT(oc_add_resource(res));
+#endif /* OC_BLOCK_WISE */
+}
+
+static void
+count_response(oc_client_response_t *data)
+{
+  num_received++;
+  if (data->code == OC_STATUS_OK || data->code == OC_STATUS_CHANGED) {
+    num_ok++;
+  }
+}
+
+static void pipelined_response(oc_client_response_t *data);
+
+static bool
+send_get(void)
+{
+  num_sent++;
+  return oc_do_get("/a/light", &server, NULL, pipelined_response, LOW_QOS,
+                   NULL);
+}
+
+static void
+pipelined_response(oc_client_response_t *data)
+{
+  count_response(data);
+  if (num_sent < NUM_REQUESTS) {
+    ASSERT(send_get());
+  }
+}
+
+#ifdef OC_BLOCK_WISE
+static void
+blob_response(oc_client_response_t *data)
+{
+  count_response(data);
+#ifndef OC_SECURITY
+  oc_rep_t *rep = data->payload;
+  ASSERT(rep != NULL && rep->type == OC_REP_STRING);
+  ASSERT(strcmp(oc_string(rep->value.string), blob) == 0);
+#endif /* !OC_SECURITY */
+}
+#endif /* OC_BLOCK_WISE */
+
+static void
+run_until(int count)
+{
+  oc_clock_time_t deadline = oc_clock_time() + 30 * OC_CLOCK_SECOND;
+  while (num_received < count && oc_clock_time() < deadline) {
+    oc_main_poll();
+  }
+  ASSERT(num_received == count);
+}
+
+static int
+raw_connect(void)
+{
+  struct sockaddr_in6 addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_addr = in6addr_loopback;
+  addr.sin6_port = htons(server.addr.ipv6.port);
+  int fd = socket(AF_INET6, SOCK_STREAM, 0);
+  ASSERT(fd >= 0);
+  ASSERT(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  return fd;
+}
+
+/* Reads one complete message from the raw socket while running the event
+ * loop, and parses it into packet.
+ */
+static void
+raw_receive(int fd, uint8_t *buffer, coap_packet_t *packet)
+{
+  oc_clock_time_t deadline = oc_clock_time() + 10 * OC_CLOCK_SECOND;
+  size_t length = 0;
+  while (oc_clock_time() < deadline) {
+    if (length > 0 && length >= coap_tcp_get_packet_size(buffer)) {
+      break;
+    }
+    ssize_t n = recv(fd, buffer + length, 1, MSG_DONTWAIT);
+    if (n > 0) {
+      length += n;
+    } else {
+      ASSERT(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+      oc_main_poll();
+    }
+  }
+  ASSERT(length > 0 && length == coap_tcp_get_packet_size(buffer));
+  ASSERT(coap_tcp_parse_message(packet, buffer, (uint32_t)length) ==
+         COAP_NO_ERROR);
+}
+
+static size_t
+serialize_get(uint8_t *buffer, uint8_t token)
+{
+  coap_packet_t request[1];
+  coap_tcp_init_message(request, COAP_GET);
+  coap_set_token(request, &token, 1);
+  coap_set_header_uri_path(request, "/a/light", strlen("/a/light"));
+  return coap_serialize_message(request, buffer);
+}
+
+static void
+expect_light(int fd, uint8_t token)
+{
+  uint8_t buffer[512];
+  coap_packet_t response[1];
+  raw_receive(fd, buffer, response);
+  ASSERT(response->token_len == 1 && response->token[0] == token);
+#ifndef OC_SECURITY
+  ASSERT(response->code == CONTENT_2_05);
+#endif /* !OC_SECURITY */
+}
+
+static size_t
+serialize_csm(uint8_t *buffer, uint16_t max_message_size)
+{
+  size_t len = coap_tcp_serialize_header(buffer, 0, CSM_7_01, 3);
+  buffer[len++] = (COAP_SIGNAL_OPTION_MAX_MESSAGE_SIZE << 4) | 2;
+  buffer[len++] = (uint8_t)(max_message_size >> 8);
+  buffer[len++] = (uint8_t)max_message_size;
+  return len;
+}
+
+static void
+test_raw_peer(void)
+{
+  uint8_t buffer[512];
+  coap_packet_t packet[1];
+  int fd = raw_connect();
+
+  /* The server's first message is its CSM. */
+  raw_receive(fd, buffer, packet);
+  ASSERT(packet->code == CSM_7_01);
+
+  /* A Ping is answered with a Pong carrying the same token. */
+  uint8_t token[2] = { 0x5a, 0xa5 };
+  size_t len = coap_tcp_serialize_header(buffer, sizeof(token), PING_7_02, 0);
+  memcpy(buffer + len, token, sizeof(token));
+  ASSERT(send(fd, buffer, len + sizeof(token), 0) ==
+         (ssize_t)(len + sizeof(token)));
+  raw_receive(fd, buffer, packet);
+  ASSERT(packet->code == PONG_7_03);
+  ASSERT(packet->token_len == sizeof(token));
+  ASSERT(memcmp(packet->token, token, sizeof(token)) == 0);
+
+  /* A request that trickles in one byte at a time is reassembled. */
+  len = serialize_get(buffer, 1);
+  size_t i;
+  for (i = 0; i < len; i++) {
+    ASSERT(send(fd, buffer + i, 1, 0) == 1);
+    oc_main_poll();
+    struct timespec pause = { .tv_nsec = 1000000 };
+    nanosleep(&pause, NULL);
+  }
+  expect_light(fd, 1);
+
+  /* Requests that arrive back to back in one segment are all served, as is
+     one that is cut in half at the end of it. */
+  len = serialize_get(buffer, 2);
+  len += serialize_get(buffer + len, 3);
+  size_t half = serialize_get(buffer + len, 4) / 2;
+  ASSERT(send(fd, buffer, len + half, 0) == (ssize_t)(len + half));
+  expect_light(fd, 2);
+  expect_light(fd, 3);
+  len = serialize_get(buffer, 4);
+  ASSERT(send(fd, buffer + half, len - half, 0) == (ssize_t)(len - half));
+  expect_light(fd, 4);
+
+  /* Nothing larger than the Max-Message-Size of the peer's CSM is sent. */
+  len = serialize_csm(buffer, 2);
+  len += serialize_get(buffer + len, 5);
+  ASSERT(send(fd, buffer, len, 0) == (ssize_t)len);
+  oc_clock_time_t deadline = oc_clock_time() + OC_CLOCK_SECOND / 2;
+  while (oc_clock_time() < deadline) {
+    oc_main_poll();
+    ASSERT(recv(fd, buffer, 1, MSG_DONTWAIT) < 0 && errno == EAGAIN);
+  }
+  len = serialize_csm(buffer, 1152);
+  len += serialize_get(buffer + len, 6);
+  ASSERT(send(fd, buffer, len, 0) == (ssize_t)len);
+  expect_light(fd, 6);
+
+  close(fd);
+}
+
+/* A peer that stops reading never holds up the event loop: responses wait
+ * for it until too many do, and then its connection is closed. Static builds
+ * run out of buffers first and stop reading from it instead, and secure
+ * builds deny its requests with responses too small to fill the socket.
+ */
+static void
+test_stalled_peer(void)
+{
+  struct sockaddr_in6 addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_addr = in6addr_loopback;
+  addr.sin6_port = htons(server.addr.ipv6.port);
+  int fd = socket(AF_INET6, SOCK_STREAM, 0);
+  ASSERT(fd >= 0);
+  int size = 1;
+  ASSERT(setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) == 0);
+  ASSERT(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+  uint8_t buffer[64];
+  size_t len = serialize_get(buffer, 7);
+  size_t sent = 0;
+  oc_clock_time_t longest_poll = 0;
+  oc_clock_time_t deadline = oc_clock_time() + 5 * OC_CLOCK_SECOND;
+  bool closed = false;
+  while (!closed && oc_clock_time() < deadline) {
+    ssize_t n =
+      send(fd, buffer + sent, len - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0 && errno != EAGAIN) {
+      ASSERT(errno == EPIPE || errno == ECONNRESET);
+      closed = true;
+    }
+    if (n > 0) {
+      sent = (sent + n) % len;
+    }
+    oc_clock_time_t start = oc_clock_time();
+    oc_main_poll();
+    if (oc_clock_time() - start > longest_poll) {
+      longest_poll = oc_clock_time() - start;
+    }
+  }
+  /* A write that blocked would hold a poll until the peer is gone; debug
+     logging alone can stretch a busy poll past a tenth of a second. */
+  ASSERT(longest_poll < OC_CLOCK_SECOND);
+#if defined(OC_DYNAMIC_ALLOCATION) && !defined(OC_SECURITY)
+  ASSERT(closed);
+#endif /* OC_DYNAMIC_ALLOCATION && !OC_SECURITY */
+  close(fd);
+}
+
+/* A peer whose accept queue is full drops our SYNs. Messages for it wait for
+ * the connection without holding up the event loop, and follow our CSM once
+ * it is accepted.
+ */
+static void
+test_pending_connect(void)
+{
+  uint8_t buffer[512];
+  coap_packet_t packet[1];
+  struct sockaddr_in6 addr;
+  socklen_t len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_addr = in6addr_loopback;
+  int listener = socket(AF_INET6, SOCK_STREAM, 0);
+  ASSERT(listener >= 0);
+  ASSERT(bind(listener, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  ASSERT(listen(listener, 0) == 0);
+  ASSERT(getsockname(listener, (struct sockaddr *)&addr, &len) == 0);
+  int filler = socket(AF_INET6, SOCK_STREAM, 0);
+  ASSERT(filler >= 0);
+  ASSERT(connect(filler, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+  oc_endpoint_t peer;
+  memcpy(&peer, &server, sizeof(peer));
+  peer.addr.ipv6.port = ntohs(addr.sin6_port);
+  num_received = num_ok = 0;
+  oc_clock_time_t start = oc_clock_time();
+  ASSERT(oc_do_get("/a/light", &peer, NULL, count_response, LOW_QOS, NULL));
+  ASSERT(oc_do_get("/a/light", &server, NULL, count_response, LOW_QOS, NULL));
+  run_until(1);
+  ASSERT(oc_clock_time() - start < OC_CLOCK_SECOND);
+
+  /* Our SYN is retransmitted after a second, once there is room for it. */
+  ASSERT(fcntl(listener, F_SETFL, O_NONBLOCK) == 0);
+  int fd = accept(listener, NULL, NULL);
+  ASSERT(fd >= 0);
+  close(fd);
+  close(filler);
+  oc_clock_time_t deadline = oc_clock_time() + 10 * OC_CLOCK_SECOND;
+  fd = -1;
+  while (fd < 0 && oc_clock_time() < deadline) {
+    fd = accept(listener, NULL, NULL);
+    oc_main_poll();
+  }
+  ASSERT(fd >= 0);
+
+  raw_receive(fd, buffer, packet);
+  ASSERT(packet->code == CSM_7_01);
+  raw_receive(fd, buffer, packet);
+  ASSERT(packet->code == COAP_GET);
+  coap_packet_t response[1];
+  coap_tcp_init_message(response, CONTENT_2_05);
+  coap_set_token(response, packet->token, packet->token_len);
+  size_t n = coap_serialize_message(response, buffer);
+  ASSERT(send(fd, buffer, n, 0) == (ssize_t)n);
+  run_until(2);
+#ifndef OC_SECURITY
+  ASSERT(num_ok == 2);
+#endif /* !OC_SECURITY */
+
+  close(fd);
+  close(listener);
+}
+
+int
+main(void)
+{
+  struct timespec start, end;
+  int i;
+
+  test_init_stack(1, register_resources);
+  test_get_endpoint(0, IPV6 | TCP, &server);
+
+  test_raw_peer();
+  test_pending_connect();
+  test_stalled_peer();
+
+  /* A confirmable request over TCP is answered without an ACK. */
+  num_received = num_ok = 0;
+  ASSERT(oc_init_post("/a/light", &server, NULL, count_response, HIGH_QOS,
+                      NULL));
+  oc_rep_start_root_object();
+  oc_rep_set_boolean(root, state, true);
+  oc_rep_set_int(root, power, 40);
+  oc_rep_end_root_object();
+  ASSERT(oc_do_post());
+  run_until(1);
+#ifndef OC_SECURITY
+  ASSERT(num_ok == 1);
+  ASSERT(light_state == true);
+  ASSERT(light_power == 40);
+#endif /* !OC_SECURITY */
+
+#ifdef OC_BLOCK_WISE
+  /* A payload larger than a block still travels block by block. */
+  memset(blob, 'x', BLOB_SIZE);
+  num_received = num_ok = 0;
+  ASSERT(oc_do_get("/a/blob", &server, NULL, blob_response, LOW_QOS, NULL));
+  run_until(1);
+#endif /* OC_BLOCK_WISE */
+
+  /* Keep WINDOW GETs in flight on the same connection until NUM_REQUESTS
+     were answered. */
+  num_sent = num_received = num_ok = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < WINDOW; i++) {
+    ASSERT(send_get());
+  }
+  run_until(NUM_REQUESTS);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+#ifndef OC_SECURITY
+  ASSERT(num_ok == NUM_REQUESTS);
+#endif /* !OC_SECURITY */
+
+  double elapsed_s =
+    (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%d GETs over TCP, %d in flight: %.0f requests/s\n", NUM_REQUESTS,
+         WINDOW, NUM_REQUESTS / elapsed_s);
+
+  oc_main_shutdown();
+
+  return 0;
+}
+#else  /* OC_TCP */
+int
+main(void)
+{
+  printf("built without OC_TCP; nothing to test\n");
+  return 0;
+}
+#endif /* !OC_TCP */
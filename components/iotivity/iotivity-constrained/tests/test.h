@@ -17,9 +17,13 @@
 #ifndef TEST_H
 #define TEST_H
 
+#include "oc_api.h"
+#include "port/oc_clock.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
 
 #define ASSERT(expr) \
     do { \
@@ -30,4 +34,75 @@
         } \
     } while (0)
 
+/* Runs the event loop until cond holds or the given number of seconds
+ * have passed. */
+#define POLL_UNTIL(cond, seconds) \
+    do { \
+        oc_clock_time_t deadline_ = \
+            oc_clock_time() + (seconds) * OC_CLOCK_SECOND; \
+        while (!(cond) && oc_clock_time() < deadline_) { \
+            oc_main_poll(); \
+        } \
+    } while (0)
+
+/* Fixtures from test_support.c for the tests that run the stack */
+
+/* Starts the stack with num_devices devices and the resources added by
+ * register_resources, which may be NULL. */
+void test_init_stack(int num_devices, void (*register_resources)(void));
+
+/* Returns the number of times the stack signaled the event loop. */
+int test_signal_count(void);
+
+/* Fills in a loopback endpoint for the port of the device's endpoint whose
+ * transport flags are flags, e.g. IPV6 or IPV6 | SECURED. */
+void test_get_endpoint(int device, int flags, oc_endpoint_t *endpoint);
+
+/* Returns a UDP socket connected to the endpoint. */
+int test_connect_udp(const oc_endpoint_t *endpoint);
+
+/* Runs the event loop for the given time, sleeping between polls. */
+void test_run_for(oc_clock_time_t duration);
+
+/* Sends request on the connected socket and runs the event loop until a
+ * reply arrives or two seconds have passed. Returns the length of the
+ * reply, or -1 if none arrived. */
+ssize_t test_exchange(int sock, const void *request, size_t len, void *reply,
+                      size_t size);
+
+#ifdef OC_SECURITY
+#include "mbedtls/ssl.h"
+#include "oc_uuid.h"
+
+/* A DTLS client on its own UDP socket, authenticating with a PSK over the
+ * cipher suite that devices use once they are owned. */
+typedef struct
+{
+    int sock;
+    uint8_t key[16];
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    oc_clock_time_t timer_start;
+    uint32_t int_ms;
+    uint32_t fin_ms;
+    /* Number of ServerKeyExchange messages handled, i.e. of full rather
+     * than resumed handshakes */
+    int num_key_exchanges;
+} test_dtls_client_t;
+
+/* Sets up client to connect to the endpoint with the identity and 16 byte
+ * key; the handshake starts with the first call to mbedtls_ssl_handshake(),
+ * which returns MBEDTLS_ERR_SSL_WANT_READ while waiting for the server. */
+void test_dtls_client_init(test_dtls_client_t *client,
+                           const oc_endpoint_t *endpoint,
+                           const oc_uuid_t *identity, const uint8_t *key);
+
+/* Runs the event loop until the handshake completes, fails or five seconds
+ * have passed. Returns the result of the last mbedtls_ssl_handshake(). */
+int test_dtls_client_handshake(test_dtls_client_t *client);
+
+/* Sends close_notify if the handshake completed, and frees the client. */
+void test_dtls_client_free(test_dtls_client_t *client);
+#endif /* OC_SECURITY */
+
 #endif
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#ifdef OC_SECURITY
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include <errno.h>
+#endif /* OC_SECURITY */
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int num_test_devices;
+static void (*register_test_resources)(void);
+static volatile int num_signals;
+
+static int
+app_init(void)
+{
+  int ret = oc_init_platform("Intel", NULL, NULL);
+  int i;
+  for (i = 0; i < num_test_devices; i++) {
+    ret |= oc_add_device("/oic/d", "oic.d.test", "Test device", "1.0", "1.0",
+                         NULL, NULL);
+  }
+  return ret;
+}
+
+static void
+register_resources(void)
+{
+  if (register_test_resources) {
+    register_test_resources();
+  }
+}
+
+static void
+signal_event_loop(void)
+{
+  num_signals++;
+}
+
+void
+test_init_stack(int num_devices, void (*register_resources_cb)(void))
+{
+  static const oc_handler_t handler = {
+    .init = app_init,
+    .signal_event_loop = signal_event_loop,
+    .register_resources = register_resources,
+  };
+  num_test_devices = num_devices;
+  register_test_resources = register_resources_cb;
+  ASSERT(oc_main_init(&handler) == 0);
+}
+
+int
+test_signal_count(void)
+{
+  return num_signals;
+}
+
+void
+test_get_endpoint(int device, int flags, oc_endpoint_t *endpoint)
+{
+  oc_endpoint_t *ep = oc_connectivity_get_endpoints(device);
+  while (ep &&
+         (int)(ep->flags & (SECURED | IPV4 | IPV6 | TCP)) != flags) {
+    ep = ep->next;
+  }
+  ASSERT(ep != NULL);
+  memset(endpoint, 0, sizeof(oc_endpoint_t));
+  endpoint->flags = flags;
+  endpoint->addr.ipv6.port = ep->addr.ipv6.port;
+  endpoint->addr.ipv6.address[15] = 1;
+}
+
+int
+test_connect_udp(const oc_endpoint_t *endpoint)
+{
+  struct sockaddr_in6 addr;
+  int sock = socket(AF_INET6, SOCK_DGRAM, 0);
+  ASSERT(sock >= 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_addr = in6addr_loopback;
+  addr.sin6_port = htons(endpoint->addr.ipv6.port);
+  ASSERT(connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  return sock;
+}
+
+void
+test_run_for(oc_clock_time_t duration)
+{
+  oc_clock_time_t deadline = oc_clock_time() + duration;
+  while (oc_clock_time() < deadline) {
+    oc_main_poll();
+    usleep(10000);
+  }
+}
+
+ssize_t
+test_exchange(int sock, const void *request, size_t len, void *reply,
+              size_t size)
+{
+  ssize_t reply_len = -1;
+  ASSERT(send(sock, request, len, 0) == (ssize_t)len);
+  POLL_UNTIL((reply_len = recv(sock, reply, size, MSG_DONTWAIT)) > 0, 2);
+  return reply_len > 0 ? reply_len : -1;
+}
+
+#ifdef OC_SECURITY
+static mbedtls_entropy_context entropy_ctx;
+static mbedtls_ctr_drbg_context ctr_drbg_ctx;
+static bool drbg_seeded;
+static const int ciphers[2] = { MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256,
+                                0 };
+static const mbedtls_ecp_group_id curves[2] = { MBEDTLS_ECP_DP_SECP256R1,
+                                                MBEDTLS_ECP_DP_NONE };
+
+static int
+dtls_send(void *ctx, const unsigned char *buf, size_t len)
+{
+  test_dtls_client_t *client = (test_dtls_client_t *)ctx;
+  ssize_t ret = send(client->sock, buf, len, 0);
+  return ret < 0 ? MBEDTLS_ERR_SSL_INTERNAL_ERROR : (int)ret;
+}
+
+static int
+dtls_recv(void *ctx, unsigned char *buf, size_t len)
+{
+  test_dtls_client_t *client = (test_dtls_client_t *)ctx;
+  ssize_t ret = recv(client->sock, buf, len, MSG_DONTWAIT);
+  if (ret < 0) {
+    return (errno == EAGAIN || errno == EWOULDBLOCK)
+             ? MBEDTLS_ERR_SSL_WANT_READ
+             : MBEDTLS_ERR_SSL_INTERNAL_ERROR;
+  }
+  return (int)ret;
+}
+
+/* The server's identity hint names the device rather than the client, so
+   the key is set here instead of being matched against the hint. */
+static int
+dtls_get_psk(void *ctx, mbedtls_ssl_context *ssl, const unsigned char *hint,
+             size_t hint_len)
+{
+  test_dtls_client_t *client = (test_dtls_client_t *)ctx;
+  (void)hint;
+  (void)hint_len;
+  client->num_key_exchanges++;
+  return mbedtls_ssl_set_hs_psk(ssl, client->key, sizeof(client->key));
+}
+
+static void
+dtls_set_timer(void *ctx, uint32_t int_ms, uint32_t fin_ms)
+{
+  test_dtls_client_t *client = (test_dtls_client_t *)ctx;
+  client->timer_start = oc_clock_time();
+  client->int_ms = int_ms;
+  client->fin_ms = fin_ms;
+}
+
+static int
+dtls_get_timer(void *ctx)
+{
+  test_dtls_client_t *client = (test_dtls_client_t *)ctx;
+  if (client->fin_ms == 0) {
+    return -1;
+  }
+  oc_clock_time_t elapsed_ms =
+    (oc_clock_time() - client->timer_start) * 1000 / OC_CLOCK_SECOND;
+  if (elapsed_ms >= client->fin_ms) {
+    return 2;
+  }
+  return elapsed_ms >= client->int_ms ? 1 : 0;
+}
+
+void
+test_dtls_client_init(test_dtls_client_t *client,
+                      const oc_endpoint_t *endpoint, const oc_uuid_t *identity,
+                      const uint8_t *key)
+{
+  if (!drbg_seeded) {
+    mbedtls_entropy_init(&entropy_ctx);
+    mbedtls_ctr_drbg_init(&ctr_drbg_ctx);
+    ASSERT(mbedtls_ctr_drbg_seed(&ctr_drbg_ctx, mbedtls_entropy_func,
+                                 &entropy_ctx, NULL, 0) == 0);
+    drbg_seeded = true;
+  }
+  memset(client, 0, sizeof(test_dtls_client_t));
+  client->sock = test_connect_udp(endpoint);
+  mbedtls_ssl_init(&client->ssl);
+  mbedtls_ssl_config_init(&client->conf);
+  ASSERT(mbedtls_ssl_config_defaults(&client->conf, MBEDTLS_SSL_IS_CLIENT,
+                                     MBEDTLS_SSL_TRANSPORT_DATAGRAM,
+                                     MBEDTLS_SSL_PRESET_DEFAULT) == 0);
+  mbedtls_ssl_conf_rng(&client->conf, mbedtls_ctr_drbg_random, &ctr_drbg_ctx);
+  mbedtls_ssl_conf_ciphersuites(&client->conf, ciphers);
+  mbedtls_ssl_conf_curves(&client->conf, curves);
+  memcpy(client->key, key, sizeof(client->key));
+  ASSERT(mbedtls_ssl_conf_psk(&client->conf, key, 16, identity->id, 16) == 0);
+  mbedtls_ssl_conf_psk_cb(&client->conf, dtls_get_psk, client);
+  ASSERT(mbedtls_ssl_setup(&client->ssl, &client->conf) == 0);
+  mbedtls_ssl_set_bio(&client->ssl, client, dtls_send, dtls_recv, NULL);
+  mbedtls_ssl_set_timer_cb(&client->ssl, client, dtls_set_timer,
+                           dtls_get_timer);
+}
+
+int
+test_dtls_client_handshake(test_dtls_client_t *client)
+{
+  int ret = mbedtls_ssl_handshake(&client->ssl);
+  oc_clock_time_t deadline = oc_clock_time() + 5 * OC_CLOCK_SECOND;
+  while ((ret == MBEDTLS_ERR_SSL_WANT_READ ||
+          ret == MBEDTLS_ERR_SSL_WANT_WRITE) &&
+         oc_clock_time() < deadline) {
+    oc_main_poll();
+    ret = mbedtls_ssl_handshake(&client->ssl);
+  }
+  return ret;
+}
+
+void
+test_dtls_client_free(test_dtls_client_t *client)
+{
+  if (client->ssl.state == MBEDTLS_SSL_HANDSHAKE_OVER) {
+    mbedtls_ssl_close_notify(&client->ssl);
+  }
+  mbedtls_ssl_free(&client->ssl);
+  mbedtls_ssl_config_free(&client->conf);
+  close(client->sock);
+}
+#endif /* OC_SECURITY */
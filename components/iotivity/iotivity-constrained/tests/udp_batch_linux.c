@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test.h"
+
+#include "oc_api.h"
+#include "port/oc_clock.h"
+
+#include <stdio.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_REQUESTS (20000)
+#ifdef OC_DYNAMIC_ALLOCATION
+#define BURST_SIZE (32)
+#else /* OC_DYNAMIC_ALLOCATION */
+#define BURST_SIZE (1)
+#endif /* !OC_DYNAMIC_ALLOCATION */
+
+static void
+get_handler(oc_request_t *request, oc_interface_mask_t interface,
+            void *user_data)
+{
+  (void)interface;
+  (void)user_data;
+  oc_send_response(request, OC_STATUS_OK);
+}
+
+static void
+register_resources(void)
+{
+  oc_resource_t *res = oc_new_resource(NULL, "/a", 1, 0);
+  ASSERT(res != NULL);
+  oc_resource_bind_resource_type(res, "core.a");
+  oc_resource_set_request_handler(res, OC_GET, get_handler, NULL);
+  ASSERT(oc_add_resource(res));
+}
+
+/* Runs the event loop until count responses arrived on sock. */
+static int
+receive_responses(int sock, int count)
+{
+  uint8_t buffer[256];
+  int received = 0;
+  oc_clock_time_t deadline = oc_clock_time() + 2 * OC_CLOCK_SECOND;
+
+  while (received < count && oc_clock_time() < deadline) {
+    oc_main_poll();
+    while (recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+      received++;
+    }
+  }
+  return received;
+}
+
+int
+main(void)
+{
+  int i, j;
+  struct timespec start, end;
+  oc_endpoint_t server;
+
+  test_init_stack(1, register_resources);
+  test_get_endpoint(0, IPV6, &server);
+  int sock = test_connect_udp(&server);
+
+  /* NON GET /a, token 0x42, a new MID for every request */
+  uint8_t request[] = { 0x51, 0x01, 0, 0, 0x42, 0xb1, 'a' };
+  int received = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < NUM_REQUESTS; i += BURST_SIZE) {
+    for (j = 0; j < BURST_SIZE; j++) {
+      request[2] = (uint8_t)((i + j) >> 8);
+      request[3] = (uint8_t)(i + j);
+      ASSERT(send(sock, request, sizeof(request), 0) ==
+             (ssize_t)sizeof(request));
+    }
+    received += receive_responses(sock, BURST_SIZE);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  ASSERT(received == NUM_REQUESTS);
+
+  double elapsed_s =
+    (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%d requests in bursts of %d: %.0f packets/s\n", NUM_REQUESTS,
+         BURST_SIZE, 2 * NUM_REQUESTS / elapsed_s);
+
+  close(sock);
+  oc_main_shutdown();
+
+  return 0;
+}
@@ -0,0 +1,130 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "oc_arena.h"
+#include "config.h"
+
+#ifdef OC_DYNAMIC_ALLOCATION
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef OC_ARENA_BLOCK_SIZE
+#define OC_ARENA_BLOCK_SIZE (512)
+#endif /* !OC_ARENA_BLOCK_SIZE */
+
+#ifndef OC_ARENA_MAX_RETAINED
+#define OC_ARENA_MAX_RETAINED (4 * OC_ARENA_BLOCK_SIZE)
+#endif /* !OC_ARENA_MAX_RETAINED */
+
+#define ARENA_ALIGN(size)                                                      \
+  (((size) + sizeof(double) - 1) & ~(sizeof(double) - 1))
+
+struct oc_arena_block_s
+{
+  oc_arena_block_t *next;
+  size_t size;
+  size_t used;
+  double data[];
+};
+
+static oc_arena_block_t *
+new_block(size_t size)
+{
+  oc_arena_block_t *block = malloc(sizeof(oc_arena_block_t) + size);
+  if (block) {
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+  }
+  return block;
+}
+
+void *
+oc_arena_alloc(oc_arena_t *arena, size_t size)
+{
+  size = ARENA_ALIGN(size ? size : 1);
+  oc_arena_block_t *block = arena->blocks;
+  if (!block || block->size - block->used < size) {
+    size_t block_size =
+      (size > OC_ARENA_BLOCK_SIZE) ? size : OC_ARENA_BLOCK_SIZE;
+    block = new_block(block_size);
+    if (!block) {
+      return NULL;
+    }
+    block->next = arena->blocks;
+    arena->blocks = block;
+  }
+  void *ptr = (uint8_t *)block->data + block->used;
+  block->used += size;
+  arena->used += size;
+  memset(ptr, 0, size);
+  return ptr;
+}
+
+void
+oc_arena_reset(oc_arena_t *arena)
+{
+  if (arena->used > arena->high_water) {
+    arena->high_water = arena->used;
+  }
+  arena->used = 0;
+  if (!arena->blocks) {
+    return;
+  }
+  if (arena->high_water > OC_ARENA_MAX_RETAINED) {
+    /* Go back to one default-sized block and start measuring again. */
+    oc_arena_release(arena);
+    arena->high_water = 0;
+    arena->blocks = new_block(OC_ARENA_BLOCK_SIZE);
+    return;
+  }
+  if (!arena->blocks->next) {
+    arena->blocks->used = 0;
+    return;
+  }
+  /* Several blocks were needed: replace them with one that holds it all. */
+  oc_arena_release(arena);
+  arena->blocks = new_block(ARENA_ALIGN(arena->high_water));
+}
+
+void
+oc_arena_release(oc_arena_t *arena)
+{
+  oc_arena_block_t *block = arena->blocks;
+  while (block) {
+    oc_arena_block_t *next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->blocks = NULL;
+  arena->used = 0;
+}
+
+bool
+oc_arena_owns(const oc_arena_t *arena, const void *ptr)
+{
+  const oc_arena_block_t *block;
+  for (block = arena->blocks; block; block = block->next) {
+    const uint8_t *data = (const uint8_t *)block->data;
+    if ((const uint8_t *)ptr >= data &&
+        (const uint8_t *)ptr < data + block->used) {
+      return true;
+    }
+  }
+  return false;
+}
+#endif /* OC_DYNAMIC_ALLOCATION */
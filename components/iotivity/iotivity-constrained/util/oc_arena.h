@@ -0,0 +1,45 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef OC_ARENA_H
+#define OC_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A bump allocator for short-lived allocations that are all released at
+ * once. Memory is carved out of blocks obtained from the heap; resetting
+ * the arena keeps a single block, sized to the largest amount that was in
+ * use, so that an arena reused for similar work stops touching the heap.
+ * Past OC_ARENA_MAX_RETAINED bytes the arena falls back to one block of the
+ * default size, so a rare large request does not pin its memory.
+ */
+
+typedef struct oc_arena_block_s oc_arena_block_t;
+
+typedef struct
+{
+  oc_arena_block_t *blocks;
+  size_t used;
+  size_t high_water;
+} oc_arena_t;
+
+void *oc_arena_alloc(oc_arena_t *arena, size_t size);
+void oc_arena_reset(oc_arena_t *arena);
+void oc_arena_release(oc_arena_t *arena);
+bool oc_arena_owns(const oc_arena_t *arena, const void *ptr);
+
+#endif /* OC_ARENA_H */
@@ -37,31 +37,117 @@
 #include "oc_etimer.h"
 #include "oc_process.h"
 
-static struct oc_etimer *timerlist;
+/* Pending timers are kept in a pairing heap ordered by expiration time, so
+ * that the next timer to expire is always at the root. Insertion is O(1),
+ * and removal of the root or of an arbitrary timer is O(log n) amortized.
+ * A timer is in the heap if and only if its process is not
+ * OC_PROCESS_NONE.
+ */
+static struct oc_etimer *timerheap;
 static oc_clock_time_t next_expiration;
 
 OC_PROCESS(oc_etimer_process, "Event timer");
 /*---------------------------------------------------------------------------*/
-static void
-update_time(void)
+static int
+expires_before(struct oc_etimer *a, struct oc_etimer *b)
+{
+  /* Compare the distance between both expiration times to take wraps
+     into account. */
+  oc_clock_time_t diff = (a->timer.start + a->timer.interval) -
+                         (b->timer.start + b->timer.interval);
+  return diff > ((oc_clock_time_t)-1 >> 1);
+}
+/*---------------------------------------------------------------------------*/
+static struct oc_etimer *
+meld(struct oc_etimer *a, struct oc_etimer *b)
 {
-  oc_clock_time_t tdist;
-  oc_clock_time_t now;
   struct oc_etimer *t;
 
-  if (timerlist == NULL) {
-    next_expiration = 0;
+  if (a == NULL) {
+    return b;
+  }
+  if (b == NULL) {
+    return a;
+  }
+  if (expires_before(b, a)) {
+    t = a;
+    a = b;
+    b = t;
+  }
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL) {
+    a->child->prev = b;
+  }
+  a->child = b;
+  return a;
+}
+/*---------------------------------------------------------------------------*/
+static struct oc_etimer *
+merge_pairs(struct oc_etimer *first)
+{
+  struct oc_etimer *a, *b, *pairs = NULL, *heap = NULL;
+
+  /* Meld siblings pairwise from left to right, collecting the results in
+     reverse order... */
+  while (first != NULL) {
+    a = first;
+    b = a->next;
+    first = b ? b->next : NULL;
+    a->next = a->prev = NULL;
+    if (b != NULL) {
+      b->next = b->prev = NULL;
+      a = meld(a, b);
+    }
+    a->next = pairs;
+    pairs = a;
+  }
+
+  /* ...then meld the pairs together from right to left. */
+  while (pairs != NULL) {
+    a = pairs;
+    pairs = a->next;
+    a->next = NULL;
+    heap = meld(heap, a);
+  }
+  return heap;
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_insert(struct oc_etimer *t)
+{
+  t->next = t->child = t->prev = NULL;
+  timerheap = meld(timerheap, t);
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_remove(struct oc_etimer *t)
+{
+  struct oc_etimer *children = merge_pairs(t->child);
+
+  if (t == timerheap) {
+    timerheap = children;
   } else {
-    now = oc_clock_time();
-    t = timerlist;
-    /* Must calculate distance to next time into account due to wraps */
-    tdist = t->timer.start + t->timer.interval - now;
-    for (t = t->next; t != NULL; t = t->next) {
-      if (t->timer.start + t->timer.interval - now < tdist) {
-        tdist = t->timer.start + t->timer.interval - now;
-      }
+    if (t->prev->child == t) {
+      t->prev->child = t->next;
+    } else {
+      t->prev->next = t->next;
+    }
+    if (t->next != NULL) {
+      t->next->prev = t->prev;
     }
-    next_expiration = now + tdist;
+    timerheap = meld(timerheap, children);
+  }
+  t->next = t->child = t->prev = NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_time(void)
+{
+  if (timerheap == NULL) {
+    next_expiration = 0;
+  } else {
+    next_expiration = timerheap->timer.start + timerheap->timer.interval;
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -71,7 +157,7 @@ OC_PROCESS_THREAD(oc_etimer_process, ev, data)
 
   OC_PROCESS_BEGIN();
 
-  timerlist = NULL;
+  timerheap = NULL;
 
   while (1) {
     OC_PROCESS_YIELD();
@@ -79,51 +165,46 @@ OC_PROCESS_THREAD(oc_etimer_process, ev, data)
     if (ev == OC_PROCESS_EVENT_EXITED) {
       struct oc_process *p = data;
 
-      while (timerlist != NULL && timerlist->p == p) {
-        timerlist = timerlist->next;
-      }
-
-      if (timerlist != NULL) {
-        t = timerlist;
-        while (t->next != NULL) {
-          if (t->next->p == p) {
-            t->next = t->next->next;
-          } else
-            t = t->next;
+      /* Drain the heap and put back the timers that do not belong to the
+         exited process. */
+      u = NULL;
+      while (timerheap != NULL) {
+        t = timerheap;
+        heap_remove(t);
+        if (t->p == p) {
+          t->p = OC_PROCESS_NONE;
+        } else {
+          t->next = u;
+          u = t;
         }
       }
+      while (u != NULL) {
+        t = u;
+        u = u->next;
+        heap_insert(t);
+      }
+      update_time();
       continue;
     } else if (ev != OC_PROCESS_EVENT_POLL) {
       continue;
     }
 
-  again:
-
-    u = NULL;
+    while (timerheap != NULL && oc_timer_expired(&timerheap->timer)) {
+      t = timerheap;
+      if (oc_process_post(t->p, OC_PROCESS_EVENT_TIMER, t) ==
+          OC_PROCESS_ERR_OK) {
 
-    for (t = timerlist; t != NULL; t = t->next) {
-      if (oc_timer_expired(&t->timer)) {
-        if (oc_process_post(t->p, OC_PROCESS_EVENT_TIMER, t) ==
-            OC_PROCESS_ERR_OK) {
-
-          /* Reset the process ID of the event timer, to signal that the
-             etimer has expired. This is later checked in the
-             oc_etimer_expired() function. */
-          t->p = OC_PROCESS_NONE;
-          if (u != NULL) {
-            u->next = t->next;
-          } else {
-            timerlist = t->next;
-          }
-          t->next = NULL;
-          update_time();
-          goto again;
-        } else {
-          oc_etimer_request_poll();
-        }
+        /* Reset the process ID of the event timer, to signal that the
+           etimer has expired. This is later checked in the
+           oc_etimer_expired() function. */
+        heap_remove(t);
+        t->p = OC_PROCESS_NONE;
+      } else {
+        oc_etimer_request_poll();
+        break;
       }
-      u = t;
     }
+    update_time();
   }
 
   OC_PROCESS_END();
@@ -139,25 +220,15 @@ oc_etimer_request_poll(void)
 static void
 add_timer(struct oc_etimer *timer)
 {
-  struct oc_etimer *t;
-
   oc_etimer_request_poll();
 
   if (timer->p != OC_PROCESS_NONE) {
-    for (t = timerlist; t != NULL; t = t->next) {
-      if (t == timer) {
-        /* Timer already on list, bail out. */
-        timer->p = OC_PROCESS_CURRENT();
-        update_time();
-        return;
-      }
-    }
+    /* Timer already in the heap; its expiration time may have changed. */
+    heap_remove(timer);
   }
 
-  /* Timer not on list. */
   timer->p = OC_PROCESS_CURRENT();
-  timer->next = timerlist;
-  timerlist = timer;
+  heap_insert(timer);
 
   update_time();
 }
@@ -196,6 +267,10 @@ void
 oc_etimer_adjust(struct oc_etimer *et, int timediff)
 {
   et->timer.start += timediff;
+  if (et->p != OC_PROCESS_NONE) {
+    heap_remove(et);
+    heap_insert(et);
+  }
   update_time();
 }
 /*---------------------------------------------------------------------------*/
@@ -220,7 +295,7 @@ oc_etimer_start_time(struct oc_etimer *et)
 int
 oc_etimer_pending(void)
 {
-  return timerlist != NULL;
+  return timerheap != NULL;
 }
 /*---------------------------------------------------------------------------*/
 oc_clock_time_t
@@ -232,30 +307,11 @@ oc_etimer_next_expiration_time(void)
 void
 oc_etimer_stop(struct oc_etimer *et)
 {
-  struct oc_etimer *t;
-
-  /* First check if et is the first event timer on the list. */
-  if (et == timerlist) {
-    timerlist = timerlist->next;
+  if (et->p != OC_PROCESS_NONE) {
+    heap_remove(et);
     update_time();
-  } else {
-    /* Else walk through the list and try to find the item before the
-       et timer. */
-    for (t = timerlist; t != NULL && t->next != et; t = t->next)
-      ;
-
-    if (t != NULL) {
-      /* We've found the item before the event timer that we are about
-   to remove. We point the items next pointer to the event after
-   the removed item. */
-      t->next = et->next;
-
-      update_time();
-    }
   }
 
-  /* Remove the next pointer from the item to be removed. */
-  et->next = NULL;
   /* Set the timer as expired */
   et->p = OC_PROCESS_NONE;
 }
@@ -68,7 +68,9 @@
 struct oc_etimer
 {
   struct oc_timer timer;
-  struct oc_etimer *next;
+  struct oc_etimer *next;  /* next sibling in the timer heap */
+  struct oc_etimer *child; /* first child in the timer heap */
+  struct oc_etimer *prev;  /* previous sibling, or parent if first child */
   struct oc_process *p;
 };
 
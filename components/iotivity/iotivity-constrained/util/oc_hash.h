@@ -0,0 +1,32 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#ifndef OC_HASH_H
+#define OC_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* FNV-1a, for the hash tables that index resources, endpoints and other
+ * keys. Hashing a key made of several fields chains the calls, passing the
+ * previous result as the seed of the next; the first call takes
+ * OC_FNV1A_INIT.
+ */
+#define OC_FNV1A_INIT (2166136261u)
+
+uint32_t oc_fnv1a(uint32_t hash, const void *data, size_t len);
+
+#endif /* OC_HASH_H */
@@ -35,6 +35,45 @@
 #include "oc_memb.h"
 #include <string.h>
 
+#ifdef OC_MEMB_STATS
+/* Pools such as the message buffers are shared with the network threads, so
+   the counters are updated atomically where the compiler allows it. */
+#ifdef __GNUC__
+#define MEMB_STATS_ALLOC(m) memb_stats_alloc(&(m)->stats)
+#define MEMB_STATS_FREE(m)                                                     \
+  __atomic_sub_fetch(&(m)->stats.current, 1, __ATOMIC_RELAXED)
+#define MEMB_STATS_FAIL(m)                                                     \
+  __atomic_add_fetch(&(m)->stats.failures, 1, __ATOMIC_RELAXED)
+#define MEMB_STATS_LOAD(v) __atomic_load_n(&(v), __ATOMIC_RELAXED)
+
+static void
+memb_stats_alloc(oc_memb_stats_t *stats)
+{
+  unsigned int current =
+    __atomic_add_fetch(&stats->current, 1, __ATOMIC_RELAXED);
+  unsigned int peak = __atomic_load_n(&stats->peak, __ATOMIC_RELAXED);
+  while (current > peak &&
+         !__atomic_compare_exchange_n(&stats->peak, &peak, current, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+#else /* __GNUC__ */
+#define MEMB_STATS_ALLOC(m)                                                    \
+  do {                                                                         \
+    if (++(m)->stats.current > (m)->stats.peak) {                             \
+      (m)->stats.peak = (m)->stats.current;                                    \
+    }                                                                          \
+  } while (0)
+#define MEMB_STATS_FREE(m) (--(m)->stats.current)
+#define MEMB_STATS_FAIL(m) (++(m)->stats.failures)
+#define MEMB_STATS_LOAD(v) (v)
+#endif /* !__GNUC__ */
+#else /* OC_MEMB_STATS */
+#define MEMB_STATS_ALLOC(m)
+#define MEMB_STATS_FREE(m)
+#define MEMB_STATS_FAIL(m)
+#endif /* !OC_MEMB_STATS */
+
 /*---------------------------------------------------------------------------*/
 void
 oc_memb_init(struct oc_memb *m)
@@ -42,34 +81,53 @@ oc_memb_init(struct oc_memb *m)
 #ifndef OC_DYNAMIC_ALLOCATION
   memset(m->count, 0, m->num);
   memset(m->mem, 0, (unsigned)m->size * (unsigned)m->num);
-#else  /* !OC_DYNAMIC_ALLOCATION */
+  m->free_head = 0;
+  m->fresh = 0;
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#ifdef OC_MEMB_STATS
+  memset(&m->stats, 0, sizeof(m->stats));
+#endif /* OC_MEMB_STATS */
   (void)m;
-#endif /* OC_DYNAMIC_ALLOCATION */
 }
 /*---------------------------------------------------------------------------*/
 void *
 oc_memb_alloc(struct oc_memb *m)
 {
 #ifdef OC_DYNAMIC_ALLOCATION
-  return calloc(1, m->size);
+  void *mem =
+    (m->flags & OC_MEMB_ZERO) ? calloc(1, m->size) : malloc(m->size);
+  if (!mem) {
+    MEMB_STATS_FAIL(m);
+    return NULL;
+  }
+  MEMB_STATS_ALLOC(m);
+  return mem;
 #else  /* OC_DYNAMIC_ALLOCATION */
-  int i;
+  unsigned short i;
+  char *mem;
 
-  for (i = 0; i < m->num; ++i) {
-    if (m->count[i] == 0) {
-      /* If this block was unused, we increase the reference count to
-   indicate that it now is used and return a pointer to the
-   memory block. */
-      ++(m->count[i]);
-      void *mem = (void *)((char *)m->mem + (i * m->size));
-      memset(mem, 0, m->size);
-      return mem;
-    }
+  /* Reuse the most recently freed block, or else the first block that
+     was never handed out. */
+  if (m->free_head != 0) {
+    i = m->free_head - 1;
+    mem = (char *)m->mem + i * m->size;
+    memcpy(&m->free_head, mem, sizeof(m->free_head));
+  } else if (m->fresh < m->num) {
+    i = m->fresh++;
+    mem = (char *)m->mem + i * m->size;
+  } else {
+    /* No free block was found, so we return NULL to indicate failure to
+       allocate block. */
+    MEMB_STATS_FAIL(m);
+    return NULL;
   }
 
-  /* No free block was found, so we return NULL to indicate failure to
-     allocate block. */
-  return NULL;
+  m->count[i] = 1;
+  if (m->flags & OC_MEMB_ZERO) {
+    memset(mem, 0, m->size);
+  }
+  MEMB_STATS_ALLOC(m);
+  return mem;
 #endif /* !OC_DYNAMIC_ALLOCATION */
 }
 /*---------------------------------------------------------------------------*/
@@ -77,30 +135,31 @@ char
 oc_memb_free(struct oc_memb *m, void *ptr)
 {
 #ifdef OC_DYNAMIC_ALLOCATION
+  if (ptr) {
+    MEMB_STATS_FREE(m);
+  }
   (void)m;
   free(ptr);
   return 0;
 #else  /* OC_DYNAMIC_ALLOCATION */
-  int i;
-  char *ptr2;
+  if (!oc_memb_inmemb(m, ptr)) {
+    return -1;
+  }
 
-  /* Walk through the list of blocks and try to find the block to
-     which the pointer "ptr" points to. */
-  ptr2 = (char *)m->mem;
-  for (i = 0; i < m->num; ++i) {
+  size_t offset = (size_t)((char *)ptr - (char *)m->mem);
+  if (offset % m->size != 0) {
+    return -1;
+  }
 
-    if (ptr2 == (char *)ptr) {
-      /* We've found to block to which "ptr" points so we decrease the
-   reference count and return the new value of it. */
-      if (m->count[i] > 0) {
-        /* Make sure that we don't deallocate free memory. */
-        --(m->count[i]);
-      }
-      return m->count[i];
-    }
-    ptr2 += m->size;
+  /* Make sure that we don't deallocate free memory, and link the block
+     into the free list once its reference count drops to zero. */
+  unsigned short i = (unsigned short)(offset / m->size);
+  if (m->count[i] > 0 && --(m->count[i]) == 0) {
+    memcpy(ptr, &m->free_head, sizeof(m->free_head));
+    m->free_head = i + 1;
+    MEMB_STATS_FREE(m);
   }
-  return -1;
+  return m->count[i];
 #endif /* !OC_DYNAMIC_ALLOCATION */
 }
 /*---------------------------------------------------------------------------*/
@@ -127,3 +186,13 @@ oc_memb_numfree(struct oc_memb *m)
   return num_free;
 }
 #endif /* !OC_DYNAMIC_ALLOCATION */
+/*---------------------------------------------------------------------------*/
+#ifdef OC_MEMB_STATS
+void
+oc_memb_get_stats(struct oc_memb *m, oc_memb_stats_t *stats)
+{
+  stats->current = MEMB_STATS_LOAD(m->stats.current);
+  stats->peak = MEMB_STATS_LOAD(m->stats.peak);
+  stats->failures = MEMB_STATS_LOAD(m->stats.failures);
+}
+#endif /* OC_MEMB_STATS */
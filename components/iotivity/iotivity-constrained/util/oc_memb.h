@@ -78,26 +78,64 @@
  *
  * \param num The total number of memory chunks in the block.
  *
+ * Blocks handed out by oc_memb_alloc() are not cleared; pools whose users
+ * rely on zeroed blocks are declared with OC_MEMB_ZEROED() instead.
+ *
  */
+#define OC_MEMB(name, structure, num) OC_MEMB_FLAGS(name, structure, num, 0)
+#define OC_MEMB_ZEROED(name, structure, num)                                   \
+  OC_MEMB_FLAGS(name, structure, num, OC_MEMB_ZERO)
+
+/* Clear every block on allocation */
+#define OC_MEMB_ZERO (1 << 0)
+
 #ifdef OC_DYNAMIC_ALLOCATION
 #include <stdlib.h>
-#define OC_MEMB(name, structure, num)                                          \
-  static struct oc_memb name = { sizeof(structure), 0, 0, 0 }
+#define OC_MEMB_FLAGS(name, structure, num_blocks, memb_flags)                 \
+  static struct oc_memb name = { .size = sizeof(structure),                    \
+                                 .flags = memb_flags }
 #else /* OC_DYNAMIC_ALLOCATION */
-#define OC_MEMB(name, structure, num)                                          \
-  static char CC_CONCAT(name, _memb_count)[num];                               \
-  static structure CC_CONCAT(name, _memb_mem)[num];                            \
-  static struct oc_memb name = { sizeof(structure), num,                       \
-                                 CC_CONCAT(name, _memb_count),                 \
-                                 (void *)CC_CONCAT(name, _memb_mem) }
+/* Free blocks hold the index of the next free block, so a structure must be
+   at least as large as that index; smaller ones fail to compile. */
+#define OC_MEMB_FLAGS(name, structure, num_blocks, memb_flags)                 \
+  typedef char CC_CONCAT(name, _memb_size_check)                              \
+    [sizeof(structure) >= sizeof(unsigned short) ? 1 : -1];                    \
+  static char CC_CONCAT(name, _memb_count)[num_blocks];                        \
+  static structure CC_CONCAT(name, _memb_mem)[num_blocks];                     \
+  static struct oc_memb name = { .size = sizeof(structure),                    \
+                                 .num = num_blocks,                            \
+                                 .count = CC_CONCAT(name, _memb_count),        \
+                                 .mem = (void *)CC_CONCAT(name, _memb_mem),    \
+                                 .flags = memb_flags }
 #endif /* !OC_DYNAMIC_ALLOCATION */
 
+#ifdef OC_MEMB_STATS
+typedef struct
+{
+  unsigned int current;
+  unsigned int peak;
+  unsigned int failures;
+} oc_memb_stats_t;
+#endif /* OC_MEMB_STATS */
+
 struct oc_memb
 {
   unsigned short size;
   unsigned short num;
   char *count;
   void *mem;
+  unsigned char flags;
+#ifndef OC_DYNAMIC_ALLOCATION
+  /* Index + 1 of the most recently freed block, 0 if there is none. The
+     index of the next free block is kept in the first bytes of each free
+     block. */
+  unsigned short free_head;
+  /* Blocks from this index on have never been allocated. */
+  unsigned short fresh;
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#ifdef OC_MEMB_STATS
+  oc_memb_stats_t stats;
+#endif /* OC_MEMB_STATS */
 };
 
 /**
@@ -132,4 +170,12 @@ int oc_memb_inmemb(struct oc_memb *m, void *ptr);
 
 int oc_memb_numfree(struct oc_memb *m);
 
+#ifdef OC_MEMB_STATS
+/**
+ * Retrieve the number of blocks currently in use, the most that were ever in
+ * use at once and the number of allocations that failed.
+ */
+void oc_memb_get_stats(struct oc_memb *m, oc_memb_stats_t *stats);
+#endif /* OC_MEMB_STATS */
+
 #endif /* OC_MEMB_H */
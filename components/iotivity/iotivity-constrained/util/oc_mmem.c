@@ -36,6 +36,7 @@
 #include "config.h"
 #include "oc_list.h"
 #include "port/oc_log.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -48,22 +49,86 @@
 static double doubles[OC_DOUBLES_POOL_SIZE];
 static int ints[OC_INTS_POOL_SIZE];
 static unsigned char bytes[OC_BYTES_POOL_SIZE];
+
+#ifndef OC_MMEM_FREE_LIST
 static unsigned int avail_bytes, avail_ints, avail_doubles;
 
 OC_LIST(bytes_list);
 OC_LIST(ints_list);
 OC_LIST(doubles_list);
+#else /* !OC_MMEM_FREE_LIST */
+/* Segregated free lists with immediate coalescing. Each pool is carved into
+ * 8-byte granules. A free block keeps its size and list links in its first
+ * granule and its size again in its last one, and two bitmaps mark the first
+ * and last granule of every free block, so a freed block finds its free
+ * neighbours without searching. Allocated blocks carry no header, as their
+ * size is known from the handle. Blocks never move: a free touches no other
+ * allocation, and pointers into a block stay valid until it is freed.
+ */
+#define GRANULE (8)
+#define NUM_GRANULES(size) ((size) / GRANULE)
+#define BITMAP_SIZE(granules) ((granules) / 8 + 1)
+#define NUM_CLASSES (16)
+#define NIL (0xffff)
+
+enum { SIZE_FIELD = 0, NEXT_FIELD, PREV_FIELD };
+
+typedef struct
+{
+  uint8_t *mem;
+  uint8_t *first_free;
+  uint8_t *last_free;
+  uint16_t num_granules;
+  uint16_t used_granules;
+  uint16_t unit;
+  uint16_t heads[NUM_CLASSES];
+} free_list_pool_t;
+
+#define BYTES_GRANULES NUM_GRANULES(OC_BYTES_POOL_SIZE)
+#define INTS_GRANULES NUM_GRANULES(OC_INTS_POOL_SIZE * sizeof(int))
+#define DOUBLES_GRANULES NUM_GRANULES(OC_DOUBLES_POOL_SIZE * sizeof(double))
+
+static uint8_t bytes_bitmaps[2][BITMAP_SIZE(BYTES_GRANULES)];
+static uint8_t ints_bitmaps[2][BITMAP_SIZE(INTS_GRANULES)];
+static uint8_t doubles_bitmaps[2][BITMAP_SIZE(DOUBLES_GRANULES)];
+
+static free_list_pool_t pools[] = {
+  { bytes, bytes_bitmaps[0], bytes_bitmaps[1], BYTES_GRANULES, 0, 1, { 0 } },
+  { (uint8_t *)ints, ints_bitmaps[0], ints_bitmaps[1], INTS_GRANULES, 0,
+    sizeof(int), { 0 } },
+  { (uint8_t *)doubles, doubles_bitmaps[0], doubles_bitmaps[1],
+    DOUBLES_GRANULES, 0, sizeof(double), { 0 } }
+};
+#endif /* OC_MMEM_FREE_LIST */
 #else /* !OC_DYNAMIC_ALLOCATION */
 #include <stdlib.h>
+
+static oc_arena_t *mmem_arena;
+
+void
+oc_mmem_set_arena(oc_arena_t *arena)
+{
+  mmem_arena = arena;
+}
+
+static void *
+mmem_malloc(size_t size)
+{
+  if (mmem_arena) {
+    return oc_arena_alloc(mmem_arena, size);
+  }
+  return malloc(size);
+}
 #endif /* OC_DYNAMIC_ALLOCATION */
 /*---------------------------------------------------------------------------*/
+#if defined(OC_DYNAMIC_ALLOCATION) || !defined(OC_MMEM_FREE_LIST)
 int
 oc_mmem_alloc(struct oc_mmem *m, unsigned int size, pool pool_type)
 {
   switch (pool_type) {
   case BYTE_POOL:
 #ifdef OC_DYNAMIC_ALLOCATION
-    m->ptr = malloc(size);
+    m->ptr = mmem_malloc(size);
     m->size = size;
 #else  /* OC_DYNAMIC_ALLOCATION */
     if (avail_bytes < size) {
@@ -78,7 +143,7 @@ oc_mmem_alloc(struct oc_mmem *m, unsigned int size, pool pool_type)
     break;
   case INT_POOL:
 #ifdef OC_DYNAMIC_ALLOCATION
-    m->ptr = malloc(size * sizeof(int));
+    m->ptr = mmem_malloc(size * sizeof(int));
     m->size = size;
 #else  /* OC_DYNAMIC_ALLOCATION */
     if (avail_ints < size) {
@@ -93,7 +158,7 @@ oc_mmem_alloc(struct oc_mmem *m, unsigned int size, pool pool_type)
     break;
   case DOUBLE_POOL:
 #ifdef OC_DYNAMIC_ALLOCATION
-    m->ptr = malloc(size * sizeof(double));
+    m->ptr = mmem_malloc(size * sizeof(double));
     m->size = size;
 #else  /* OC_DYNAMIC_ALLOCATION */
     if (avail_doubles < size) {
@@ -181,4 +246,233 @@ oc_mmem_init(void)
   inited = 1;
 #endif /* OC_DYNAMIC_ALLOCATION */
 }
+
+#ifndef OC_DYNAMIC_ALLOCATION
+void
+oc_mmem_get_stats(pool pool_type, oc_mmem_stats_t *stats)
+{
+  switch (pool_type) {
+  case BYTE_POOL:
+    stats->size = OC_BYTES_POOL_SIZE;
+    stats->largest_free = avail_bytes;
+    break;
+  case INT_POOL:
+    stats->size = OC_INTS_POOL_SIZE;
+    stats->largest_free = avail_ints;
+    break;
+  case DOUBLE_POOL:
+    stats->size = OC_DOUBLES_POOL_SIZE;
+    stats->largest_free = avail_doubles;
+    break;
+  }
+  /* Compaction keeps all free space in one block. */
+  stats->used = stats->size - stats->largest_free;
+  stats->free_blocks = stats->largest_free ? 1 : 0;
+}
+#endif /* !OC_DYNAMIC_ALLOCATION */
+#else  /* OC_DYNAMIC_ALLOCATION || !OC_MMEM_FREE_LIST */
+static uint16_t
+get_field(free_list_pool_t *p, uint16_t granule, int field)
+{
+  uint16_t value;
+  memcpy(&value, p->mem + granule * GRANULE + field * sizeof(uint16_t),
+         sizeof(uint16_t));
+  return value;
+}
+
+static void
+set_field(free_list_pool_t *p, uint16_t granule, int field, uint16_t value)
+{
+  memcpy(p->mem + granule * GRANULE + field * sizeof(uint16_t), &value,
+         sizeof(uint16_t));
+}
+
+static bool
+test_bit(const uint8_t *bitmap, uint16_t granule)
+{
+  return (bitmap[granule / 8] >> (granule % 8)) & 1;
+}
+
+static void
+set_bit(uint8_t *bitmap, uint16_t granule, bool value)
+{
+  if (value) {
+    bitmap[granule / 8] |= (uint8_t)(1 << (granule % 8));
+  } else {
+    bitmap[granule / 8] &= (uint8_t)~(1 << (granule % 8));
+  }
+}
+
+/* Blocks of n granules are kept on list floor(log2(n)). */
+static int
+size_class(uint16_t n)
+{
+  int c = 0;
+  while (n >>= 1) {
+    c++;
+  }
+  return (c < NUM_CLASSES) ? c : NUM_CLASSES - 1;
+}
+
+static void
+insert_free(free_list_pool_t *p, uint16_t granule, uint16_t n)
+{
+  int c = size_class(n);
+  set_field(p, granule, SIZE_FIELD, n);
+  set_field(p, granule + n - 1, SIZE_FIELD, n);
+  set_field(p, granule, NEXT_FIELD, p->heads[c]);
+  set_field(p, granule, PREV_FIELD, NIL);
+  if (p->heads[c] != NIL) {
+    set_field(p, p->heads[c], PREV_FIELD, granule);
+  }
+  p->heads[c] = granule;
+  set_bit(p->first_free, granule, true);
+  set_bit(p->last_free, granule + n - 1, true);
+}
+
+static void
+remove_free(free_list_pool_t *p, uint16_t granule)
+{
+  uint16_t n = get_field(p, granule, SIZE_FIELD);
+  uint16_t next = get_field(p, granule, NEXT_FIELD);
+  uint16_t prev = get_field(p, granule, PREV_FIELD);
+  if (prev != NIL) {
+    set_field(p, prev, NEXT_FIELD, next);
+  } else {
+    p->heads[size_class(n)] = next;
+  }
+  if (next != NIL) {
+    set_field(p, next, PREV_FIELD, prev);
+  }
+  set_bit(p->first_free, granule, false);
+  set_bit(p->last_free, granule + n - 1, false);
+}
+
+static uint16_t
+block_granules(free_list_pool_t *p, unsigned int size)
+{
+  unsigned int n = (size * p->unit + GRANULE - 1) / GRANULE;
+  return (uint16_t)(n ? n : 1);
+}
+
+static uint16_t
+find_free(free_list_pool_t *p, uint16_t n)
+{
+  /* Any block on a list above floor(log2(n)) is large enough... */
+  int c = size_class(n);
+  int i;
+  for (i = ((1 << c) == n) ? c : c + 1; i < NUM_CLASSES; i++) {
+    if (p->heads[i] != NIL) {
+      return p->heads[i];
+    }
+  }
+  /* ...otherwise look for a fit among the blocks of the same class. */
+  uint16_t granule = p->heads[c];
+  while (granule != NIL && get_field(p, granule, SIZE_FIELD) < n) {
+    granule = get_field(p, granule, NEXT_FIELD);
+  }
+  return granule;
+}
+
+int
+oc_mmem_alloc(struct oc_mmem *m, unsigned int size, pool pool_type)
+{
+  free_list_pool_t *p = &pools[pool_type];
+  m->next = NULL;
+  if (size == 0) {
+    /* An empty block takes no granule, and oc_mmem_free() ignores it. */
+    m->ptr = NULL;
+    m->size = 0;
+    return 1;
+  }
+  if (size * p->unit > (unsigned int)p->num_granules * GRANULE) {
+    OC_WRN("mmem pool %d exhausted\n", pool_type);
+    return 0;
+  }
+  uint16_t n = block_granules(p, size);
+  uint16_t granule = find_free(p, n);
+  if (granule == NIL) {
+    OC_WRN("mmem pool %d exhausted\n", pool_type);
+    return 0;
+  }
+  uint16_t free_n = get_field(p, granule, SIZE_FIELD);
+  remove_free(p, granule);
+  if (free_n > n) {
+    insert_free(p, granule + n, free_n - n);
+  }
+  p->used_granules += n;
+  m->ptr = p->mem + granule * GRANULE;
+  m->size = size;
+  return 1;
+}
+
+void
+oc_mmem_free(struct oc_mmem *m, pool pool_type)
+{
+  if (!m->ptr || m->size == 0) {
+    return;
+  }
+  free_list_pool_t *p = &pools[pool_type];
+  uint16_t granule = (uint16_t)(((uint8_t *)m->ptr - p->mem) / GRANULE);
+  uint16_t n = block_granules(p, m->size);
+  p->used_granules -= n;
+
+  uint16_t next = granule + n;
+  if (next < p->num_granules && test_bit(p->first_free, next)) {
+    n += get_field(p, next, SIZE_FIELD);
+    remove_free(p, next);
+  }
+  if (granule > 0 && test_bit(p->last_free, granule - 1)) {
+    uint16_t prev = granule - get_field(p, granule - 1, SIZE_FIELD);
+    n += granule - prev;
+    remove_free(p, prev);
+    granule = prev;
+  }
+  insert_free(p, granule, n);
+}
+
+void
+oc_mmem_init(void)
+{
+  static int inited = 0;
+  if (inited) {
+    return;
+  }
+  size_t i;
+  for (i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) {
+    free_list_pool_t *p = &pools[i];
+    memset(p->first_free, 0, BITMAP_SIZE(p->num_granules));
+    memset(p->last_free, 0, BITMAP_SIZE(p->num_granules));
+    memset(p->heads, 0xff, sizeof(p->heads));
+    p->used_granules = 0;
+    if (p->num_granules > 0) {
+      insert_free(p, 0, p->num_granules);
+    }
+  }
+  inited = 1;
+}
+
+void
+oc_mmem_get_stats(pool pool_type, oc_mmem_stats_t *stats)
+{
+  free_list_pool_t *p = &pools[pool_type];
+  unsigned int per_granule = GRANULE / p->unit;
+  int c;
+  stats->size = p->num_granules * per_granule;
+  stats->used = p->used_granules * per_granule;
+  stats->free_blocks = 0;
+  stats->largest_free = 0;
+  for (c = 0; c < NUM_CLASSES; c++) {
+    uint16_t granule = p->heads[c];
+    while (granule != NIL) {
+      unsigned int n = get_field(p, granule, SIZE_FIELD) * per_granule;
+      if (n > stats->largest_free) {
+        stats->largest_free = n;
+      }
+      stats->free_blocks++;
+      granule = get_field(p, granule, NEXT_FIELD);
+    }
+  }
+}
+#endif /* !OC_DYNAMIC_ALLOCATION && OC_MMEM_FREE_LIST */
 /*---------------------------------------------------------------------------*/
@@ -35,6 +35,12 @@
 #ifndef OC_MMEM_H
 #define OC_MMEM_H
 
+#include "config.h"
+
+#ifdef OC_DYNAMIC_ALLOCATION
+#include "oc_arena.h"
+#endif /* OC_DYNAMIC_ALLOCATION */
+
 #define OC_MMEM_PTR(m) (struct oc_mmem *)(m)->ptr
 
 struct oc_mmem
@@ -50,4 +56,23 @@ int oc_mmem_alloc(struct oc_mmem *m, unsigned int size, pool pool_type);
 void oc_mmem_free(struct oc_mmem *, pool pool_type);
 void oc_mmem_init(void);
 
+#ifndef OC_DYNAMIC_ALLOCATION
+/* Occupancy of a pool, in elements of the pool's type */
+typedef struct
+{
+  unsigned int size;
+  unsigned int used;
+  unsigned int free_blocks;
+  unsigned int largest_free;
+} oc_mmem_stats_t;
+
+void oc_mmem_get_stats(pool pool_type, oc_mmem_stats_t *stats);
+#endif /* !OC_DYNAMIC_ALLOCATION */
+
+#ifdef OC_DYNAMIC_ALLOCATION
+/* While an arena is set, allocations are served from it. Such memory must
+   not be passed to oc_mmem_free(); it is released with the arena. */
+void oc_mmem_set_arena(oc_arena_t *arena);
+#endif /* OC_DYNAMIC_ALLOCATION */
+
 #endif /* OC_MMEM_H */
@@ -38,7 +38,6 @@
 #ifdef OC_DYNAMIC_ALLOCATION
 #include "port/oc_assert.h"
 #include <stdlib.h>
-#include <string.h>
 #endif /* OC_DYNAMIC_ALLOCATION */
 
 /*
@@ -59,22 +58,39 @@ struct event_data
   struct oc_process *p;
 };
 
-#ifdef OC_DYNAMIC_ALLOCATION
-static unsigned long OC_PROCESS_NUMEVENTS = 10;
-#else /* OC_DYNAMIC_ALLOCATION */
-#define OC_PROCESS_NUMEVENTS 10
-#endif /* !OC_DYNAMIC_ALLOCATION */
+/*
+ * The queue is a list of fixed-size chunks. Events are appended to the tail
+ * chunk and taken from the head chunk, and a drained head chunk is kept on
+ * a free list for reuse, so the queue grows without moving queued events.
+ */
+#ifndef OC_PROCESS_NUMEVENTS
+/* Initial capacity of the queue, rounded up to whole chunks. Static builds
+   cannot grow past it. */
+#define OC_PROCESS_NUMEVENTS (10)
+#endif /* !OC_PROCESS_NUMEVENTS */
 
-static oc_process_num_events_t nevents, fevent;
-#ifdef OC_DYNAMIC_ALLOCATION
-static struct event_data *events;
-#else  /* OC_DYNAMIC_ALLOCATION */
-static struct event_data events[OC_PROCESS_NUMEVENTS];
+#ifndef OC_PROCESS_EVENT_CHUNK_SIZE
+#define OC_PROCESS_EVENT_CHUNK_SIZE (8)
+#endif /* !OC_PROCESS_EVENT_CHUNK_SIZE */
+
+#define OC_PROCESS_EVENT_CHUNKS                                                \
+  ((OC_PROCESS_NUMEVENTS + OC_PROCESS_EVENT_CHUNK_SIZE - 1) /                  \
+   OC_PROCESS_EVENT_CHUNK_SIZE)
+
+struct event_chunk
+{
+  struct event_chunk *next;
+  struct event_data events[OC_PROCESS_EVENT_CHUNK_SIZE];
+};
+
+#ifndef OC_DYNAMIC_ALLOCATION
+static struct event_chunk event_chunks[OC_PROCESS_EVENT_CHUNKS];
 #endif /* !OC_DYNAMIC_ALLOCATION */
 
-#if OC_PROCESS_CONF_STATS
-oc_process_num_events_t process_maxevents;
-#endif
+static struct event_chunk *head_chunk, *tail_chunk, *free_chunks;
+static unsigned int head_pos, tail_pos;
+static oc_process_num_events_t nevents;
+static oc_process_event_stats_t event_stats;
 
 static volatile unsigned char poll_requested;
 
@@ -193,20 +209,37 @@ oc_process_exit(struct oc_process *p)
 void
 oc_process_init(void)
 {
+  if (!head_chunk) {
+    int i;
+    for (i = 0; i < OC_PROCESS_EVENT_CHUNKS; i++) {
 #ifdef OC_DYNAMIC_ALLOCATION
-  events = (struct event_data *)calloc(OC_PROCESS_NUMEVENTS,
-                                       sizeof(struct event_data));
-  if (!events) {
-    oc_abort("Insufficient memory");
+      struct event_chunk *chunk =
+        (struct event_chunk *)malloc(sizeof(struct event_chunk));
+      if (!chunk) {
+        oc_abort("Insufficient memory");
+      }
+#else  /* OC_DYNAMIC_ALLOCATION */
+      struct event_chunk *chunk = &event_chunks[i];
+#endif /* !OC_DYNAMIC_ALLOCATION */
+      chunk->next = free_chunks;
+      free_chunks = chunk;
+    }
+    event_stats.capacity = OC_PROCESS_EVENT_CHUNKS * OC_PROCESS_EVENT_CHUNK_SIZE;
+  } else {
+    /* Return every queued chunk to the free list. */
+    tail_chunk->next = free_chunks;
+    free_chunks = head_chunk;
   }
-#endif /* OC_DYNAMIC_ALLOCATION */
+  head_chunk = tail_chunk = free_chunks;
+  free_chunks = free_chunks->next;
+  head_chunk->next = NULL;
+  head_pos = tail_pos = 0;
 
   lastevent = OC_PROCESS_EVENT_MAX;
 
-  nevents = fevent = 0;
-#if OC_PROCESS_CONF_STATS
-  process_maxevents = 0;
-#endif /* OC_PROCESS_CONF_STATS */
+  nevents = 0;
+  event_stats.peak = 0;
+  event_stats.dropped = 0;
 
   oc_process_current = oc_process_list = NULL;
 }
@@ -255,15 +288,26 @@ do_event(void)
   if (nevents > 0) {
 
     /* There are events that we should deliver. */
-    ev = events[fevent].ev;
+    ev = head_chunk->events[head_pos].ev;
 
-    data = events[fevent].data;
-    receiver = events[fevent].p;
+    data = head_chunk->events[head_pos].data;
+    receiver = head_chunk->events[head_pos].p;
 
     /* Since we have seen the new event, we move pointer upwards
        and decrease the number of events. */
-    fevent = (fevent + 1) % OC_PROCESS_NUMEVENTS;
+    ++head_pos;
     --nevents;
+    if (nevents == 0) {
+      /* The queue is empty, so its only chunk can be reused from the
+         start. */
+      head_pos = tail_pos = 0;
+    } else if (head_pos == OC_PROCESS_EVENT_CHUNK_SIZE) {
+      struct event_chunk *drained = head_chunk;
+      head_chunk = head_chunk->next;
+      head_pos = 0;
+      drained->next = free_chunks;
+      free_chunks = drained;
+    }
 
     /* If this is a broadcast event, we deliver it to all events, in
        order of their priority. */
@@ -312,47 +356,49 @@ oc_process_nevents(void)
   return nevents + poll_requested;
 }
 /*---------------------------------------------------------------------------*/
+void
+oc_process_get_event_stats(oc_process_event_stats_t *stats)
+{
+  *stats = event_stats;
+  stats->queued = nevents;
+}
+/*---------------------------------------------------------------------------*/
 int
 oc_process_post(struct oc_process *p, oc_process_event_t ev,
                 oc_process_data_t data)
 {
-  static oc_process_num_events_t snum;
-
-  if (nevents == OC_PROCESS_NUMEVENTS) {
-#ifdef OC_DYNAMIC_ALLOCATION
-    OC_PROCESS_NUMEVENTS <<= 1;
-    events = (struct event_data *)realloc(events, (OC_PROCESS_NUMEVENTS) *
-                                                    sizeof(struct event_data));
-    if (!events) {
-      oc_abort("Insufficient memory");
+  if (tail_pos == OC_PROCESS_EVENT_CHUNK_SIZE) {
+    struct event_chunk *chunk = free_chunks;
+    if (chunk) {
+      free_chunks = chunk->next;
     }
-    oc_process_num_events_t i = fevent, n = nevents - fevent, j = 0;
-    while (i < (OC_PROCESS_NUMEVENTS - n)) {
-      if (i < nevents) {
-        memcpy(&events[OC_PROCESS_NUMEVENTS - n + j], &events[i],
-               sizeof(struct event_data));
-        j++;
+#ifdef OC_DYNAMIC_ALLOCATION
+    else {
+      chunk = (struct event_chunk *)malloc(sizeof(struct event_chunk));
+      if (chunk) {
+        event_stats.capacity += OC_PROCESS_EVENT_CHUNK_SIZE;
       }
-      memset(&events[i], 0, sizeof(struct event_data));
-      i++;
     }
-    fevent = OC_PROCESS_NUMEVENTS - n;
-#else  /* OC_DYNAMIC_ALLOCATION */
-    return OC_PROCESS_ERR_FULL;
-#endif /* !OC_DYNAMIC_ALLOCATION */
+#endif /* OC_DYNAMIC_ALLOCATION */
+    if (!chunk) {
+      event_stats.dropped++;
+      return OC_PROCESS_ERR_FULL;
+    }
+    chunk->next = NULL;
+    tail_chunk->next = chunk;
+    tail_chunk = chunk;
+    tail_pos = 0;
   }
 
-  snum = (oc_process_num_events_t)(fevent + nevents) % OC_PROCESS_NUMEVENTS;
-  events[snum].ev = ev;
-  events[snum].data = data;
-  events[snum].p = p;
+  tail_chunk->events[tail_pos].ev = ev;
+  tail_chunk->events[tail_pos].data = data;
+  tail_chunk->events[tail_pos].p = p;
+  ++tail_pos;
   ++nevents;
 
-#if OC_PROCESS_CONF_STATS
-  if (nevents > process_maxevents) {
-    process_maxevents = nevents;
+  if (nevents > event_stats.peak) {
+    event_stats.peak = nevents;
   }
-#endif /* OC_PROCESS_CONF_STATS */
 
   return OC_PROCESS_ERR_OK;
 }
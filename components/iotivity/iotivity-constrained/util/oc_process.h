@@ -518,6 +518,21 @@ int oc_process_is_running(struct oc_process *p);
  */
 int oc_process_nevents(void);
 
+typedef struct
+{
+  unsigned long queued;   /* events waiting in the queue */
+  unsigned long peak;     /* most events ever waiting at once */
+  unsigned long capacity; /* events the allocated chunks can hold */
+  unsigned long dropped;  /* posts that failed because the queue was full */
+} oc_process_event_stats_t;
+
+/**
+ * Retrieve the occupancy and drop counters of the event queue.
+ *
+ * \param stats Filled in with the current counters.
+ */
+void oc_process_get_event_stats(oc_process_event_stats_t *stats);
+
 /** @} */
 
 extern struct oc_process *oc_process_list;